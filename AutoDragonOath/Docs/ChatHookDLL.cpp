@@ -1,17 +1,22 @@
 // ChatHookDLL.cpp - DLL to intercept Dragon Oath chat messages
-// Compile with: cl /LD ChatHookDLL.cpp /link detours.lib
+// Compile with: cl /LD /std:c++17 /EHsc ChatHookDLL.cpp /link detours.lib
 // Or use Visual Studio and link against Detours library
 
 #include <Windows.h>
 #include <stdio.h>
 #include <detours.h>  // Microsoft Detours library
+#include "HookLib/GameSignatures.h"  // Shared signature table + scanner
+#include "HookLib/AsyncLog.h"        // Background log writer
+#include "HookLib/ChatLog.h"         // Binary chat record file
+#include "HookLib/ChatArchive.h"     // Rotating compressed chat archive
+#include "HookLib/ChatPacket.h"      // Lazy packet view, subscribers, message pool
+#include "HookLib/ChatWorker.h"      // Callback thread, game-thread call queue
+#include "HookLib/ChatTriggers.h"    // Keyword rules, one pass per message
 
 // ============================================================================
 // PACKET STRUCTURE DEFINITIONS (from source code analysis)
 // ============================================================================
 
-#define MAX_CHAT_SIZE 1024
-
 // GCChat packet structure (reconstructed from source code)
 class GCChat {
 public:
@@ -47,31 +52,36 @@ GCChatHandler_Execute_t Original_GCChatHandler_Execute = NULL;
 
 #define ENABLE_FILE_LOGGING    1
 #define ENABLE_CONSOLE_OUTPUT  0
+#define ADDRESS_CACHE_PATH     "C:\\DragonOath_AddressCache.txt"
 #define LOG_FILE_PATH          "C:\\DragonOath_ChatLog.txt"
+#define ENABLE_CHAT_RECORD     0
+#define CHAT_RECORD_PATH       "C:\\DragonOath_Chat.hcl"   // Read with tools/ChatLogDecode
+#define ENABLE_CHAT_ARCHIVE    1
+#define CHAT_ARCHIVE_PREFIX    "C:\\DragonOath_Chat"       // + "-YYYYMMDD-HHMMSS-NN.hca"
+#define CHAT_ARCHIVE_DICTIONARY "C:\\DragonOath_Chat.dict" // Optional, from tools/ChatArchivePack train
 
 // ============================================================================
 // LOGGING FUNCTIONS
 // ============================================================================
 
-void LogToFile(const char* format, ...) {
-#if ENABLE_FILE_LOGGING
-    FILE* logFile = fopen(LOG_FILE_PATH, "a");
-    if (logFile) {
-        SYSTEMTIME st;
-        GetLocalTime(&st);
+// Opened in DLL_PROCESS_ATTACH, closed in DLL_PROCESS_DETACH. LogToFile only
+// copies its arguments into the queue; formatting and the file are left to
+// the log's own thread. The format is checked against the arguments at
+// compile time (HookLib/LogFormat.h); with ENABLE_FILE_LOGGING 0 the calls
+// compile to nothing.
+HookLib::AsyncLog g_Log;
 
-        fprintf(logFile, "[%02d:%02d:%02d] ", st.wHour, st.wMinute, st.wSecond);
+#define LogToFile(...) \
+    HOOKLIB_LOG(g_Log, ENABLE_FILE_LOGGING ? HookLib::LOG_INFO : HookLib::LOG_DISABLED, __VA_ARGS__)
 
-        va_list args;
-        va_start(args, format);
-        vfprintf(logFile, format, args);
-        va_end(args);
+// Every chat event with its date, microseconds and sender camp. Appended
+// from the hook only; the records go straight into a mapped file.
+HookLib::ChatLogWriter g_ChatRecord;
 
-        fprintf(logFile, "\n");
-        fclose(logFile);
-    }
-#endif
-}
+// The same events as compressed segments, one per day or 64 MB, each with
+// a sender / channel index (tools/ChatQuery). The hook only queues; the
+// archive's own thread compresses and writes.
+HookLib::ChatArchiveWriter g_ChatArchive;
 
 void OutputDebug(const char* format, ...) {
 #if ENABLE_CONSOLE_OUTPUT
@@ -85,10 +95,32 @@ void OutputDebug(const char* format, ...) {
 #endif
 }
 
+// ============================================================================
+// KEYWORD TRIGGERS
+// ============================================================================
+
+// Every keyword rule of the callback, compiled into one automaton: a
+// message is scanned once however many rules there are, and only whole GBK
+// characters match (HookLib/ChatTriggers.h). Keywords are GBK bytes.
+HookLib::ChatTriggers g_ChatTriggers;
+HookLib::ChatTriggerHits g_TriggerHits;     // Chat worker only
+int g_HelpTrigger = -1;
+
+void RegisterChatTriggers() {
+    g_HelpTrigger = g_ChatTriggers.Add(HookLib::ChatTriggerRule("\xB0\xEF\xD6\xFA"));  // "帮助" (Help)
+    // e.g. HookLib::ChatTriggerRule("...").Or("...").Channels({ 3 }).From("...")
+    g_ChatTriggers.Build();
+}
+
 // ============================================================================
 // CHAT MESSAGE CALLBACK (CUSTOMIZE THIS)
 // ============================================================================
 
+// Runs on g_ChatWorker's thread, not the game's: it may block without
+// stalling packets. Game functions must not be called from here - post them
+// with g_GameCalls.Post([=]() { ... }), capturing values only; they run on
+// the game thread with the next chat packet.
+
 void OnChatMessageReceived(const char* senderName, const char* messageText, unsigned char channelType) {
     // Log to file
     LogToFile("[Channel %d] %s: %s", channelType, senderName, messageText);
@@ -100,8 +132,9 @@ void OnChatMessageReceived(const char* senderName, const char* messageText, unsi
     // - Parse commands from specific players
     // - etc.
 
-    // Example: Check for specific keyword
-    if (strstr(messageText, "帮助") != NULL) {  // "Help" in Chinese
+    // Example: Check for specific keyword (all rules in one scan)
+    g_ChatTriggers.Scan(messageText, strlen(messageText), channelType, senderName, strlen(senderName), &g_TriggerHits);
+    if (g_TriggerHits.Fired(g_HelpTrigger)) {  // "Help" in Chinese
         LogToFile("  -> Help request detected!");
         // Could trigger some automated response
     }
@@ -112,43 +145,81 @@ void OnChatMessageReceived(const char* senderName, const char* messageText, unsi
     }
 }
 
+// ============================================================================
+// SUBSCRIBERS
+// ============================================================================
+
+// Each consumer says which channels / camps it wants. The hook reads only
+// channel and camp from the packet; sender and text are fetched and copied
+// (into a slot of g_ChatPool) only if some subscriber wants the message.
+// Registered in DLL_PROCESS_ATTACH, before the hook is installed.
+HookLib::ChatSubscribers g_ChatSubscribers;
+HookLib::ChatMessagePool g_ChatPool;
+int g_RecordSubscriber = -1;     // Chat record / archive: everything
+int g_CallbackSubscriber = -1;   // OnChatMessageReceived
+HookLib::ChatWorker g_ChatWorker(&g_ChatPool);
+HookLib::GameThreadQueue g_GameCalls;
+
+void RegisterChatSubscribers() {
+#if ENABLE_CHAT_RECORD || ENABLE_CHAT_ARCHIVE
+    g_RecordSubscriber = g_ChatSubscribers.Add(HookLib::ChatSubscription());
+#endif
+    // e.g. HookLib::ChatSubscription().Channels({ 3, 5 }) to leave the other
+    // channels uncopied
+    g_CallbackSubscriber = g_ChatSubscribers.Add(HookLib::ChatSubscription());
+}
+
+bool Wants(const HookLib::ChatMessage& message, int subscriber) {
+    return subscriber >= 0 && (message.subscribers & (1u << subscriber)) != 0;
+}
+
+// On the worker thread
+void HandleChatMessage(const HookLib::ChatMessage& message) {
+    OnChatMessageReceived(message.sender, message.text, message.channel);
+}
+
+// On the game thread. The record and archive only queue the message, so
+// they stay here; the callback gets the slot through g_ChatWorker. Returns
+// true if the slot was handed over.
+bool DispatchChatMessage(HookLib::ChatMessage* message) {
+    if (Wants(*message, g_RecordSubscriber)) {
+#if ENABLE_CHAT_RECORD
+        g_ChatRecord.Append(message->channel, message->camp, message->sender, message->senderLength, message->text,
+                            message->textLength);
+#endif
+#if ENABLE_CHAT_ARCHIVE
+        g_ChatArchive.Append(message->channel, message->camp, message->sender, message->senderLength,
+                             message->text, message->textLength);
+#endif
+    }
+    if (Wants(*message, g_CallbackSubscriber)) {
+        g_ChatWorker.Publish(message);   // Released by the worker, or here if its queue is full
+        return true;
+    }
+    return false;
+}
+
 // ============================================================================
 // HOOKED FUNCTION
 // ============================================================================
 
 unsigned int __fastcall Hooked_GCChatHandler_Execute(void* thisPtr, void* edx, GCChat* pPacket, Player* pPlayer) {
-    // Extract data from packet BEFORE calling original function
-    char senderName[MAX_CHAT_SIZE] = {0};
-    char messageText[MAX_CHAT_SIZE] = {0};
-    unsigned char channelType = 0;
+    // Game calls posted by the callback run here, on the game thread
+    g_GameCalls.RunPending();
 
+    // Extract data from packet BEFORE calling original function
     if (pPacket) {
+        HookLib::ChatMessage* message = NULL;
         try {
-            // Safely extract sender name
-            char* sourName = pPacket->GetSourName();
-            int sourNameSize = pPacket->GetSourNameSize();
-            if (sourName && sourNameSize > 0 && sourNameSize < MAX_CHAT_SIZE) {
-                memcpy(senderName, sourName, sourNameSize);
-                senderName[sourNameSize] = '\0';
+            HookLib::ChatPacketView<GCChat> view(pPacket);   // Channel and camp only
+            if (HookLib::TakeChatMessage(view, g_ChatSubscribers, &g_ChatPool, &message) &&
+                DispatchChatMessage(message)) {
+                message = NULL;
             }
-
-            // Safely extract message content
-            char* context = pPacket->GetContex();
-            int contextSize = pPacket->GetContexSize();
-            if (context && contextSize > 0 && contextSize < MAX_CHAT_SIZE) {
-                memcpy(messageText, context, contextSize);
-                messageText[contextSize] = '\0';
-            }
-
-            // Get channel type
-            channelType = pPacket->GetChatType();
-
-            // Call our callback
-            OnChatMessageReceived(senderName, messageText, channelType);
-
         } catch (...) {
             LogToFile("ERROR: Exception while extracting packet data");
         }
+        if (message) g_ChatPool.Release(message);
     }
 
     // IMPORTANT: Call the original function to maintain normal game behavior
@@ -169,25 +240,6 @@ unsigned int __fastcall Hooked_GCChatHandler_Execute(void* thisPtr, void* edx, G
 // PATTERN SCANNING (to find function addresses dynamically)
 // ============================================================================
 
-DWORD FindPattern(BYTE* pattern, const char* mask, DWORD startAddress, DWORD searchSize) {
-    DWORD patternLength = strlen(mask);
-
-    for (DWORD i = 0; i < searchSize - patternLength; i++) {
-        bool found = true;
-        for (DWORD j = 0; j < patternLength; j++) {
-            if (mask[j] != '?' && pattern[j] != *(BYTE*)(startAddress + i + j)) {
-                found = false;
-                break;
-            }
-        }
-        if (found) {
-            return startAddress + i;
-        }
-    }
-
-    return 0;
-}
-
 DWORD FindGCChatHandlerExecute() {
     // Get Game.exe module base
     HMODULE gameModule = GetModuleHandleA("Game.exe");
@@ -203,24 +255,40 @@ DWORD FindGCChatHandlerExecute() {
     DWORD baseAddress = (DWORD)modInfo.lpBaseOfDll;
     DWORD moduleSize = modInfo.SizeOfImage;
 
-    // Example pattern for GCChatHandler::Execute (YOU NEED TO UPDATE THIS)
-    // This is a placeholder - you must use IDA Pro to get the real pattern
-    // Pattern: 55 8B EC 83 EC ?? 53 56 57 8B F9 89 7D ??
-    // Mask:    xxx xx x  xx xx xx xx xx xx xx xx xx
-    BYTE pattern[] = { 0x55, 0x8B, 0xEC, 0x83, 0xEC, 0x00, 0x53, 0x56, 0x57, 0x8B, 0xF9, 0x89, 0x7D, 0x00 };
-    const char* mask = "xxxxx?xxxxxxx?";
+    // All hook targets live in HookLib/GameSignatures.h and are resolved in ONE pass.
+    // GCChatHandler::Execute is still a placeholder (YOU NEED TO UPDATE THIS) -
+    // the verified HandleRecvTalkPacket signatures are used when it does not match.
+    static const int preference[] = {
+        HookLib::SIG_GCCHAT_HANDLER_EXECUTE,
+        HookLib::SIG_HANDLE_RECV_TALK_PACKET_1,
+        HookLib::SIG_HANDLE_RECV_TALK_PACKET_2
+    };
 
     LogToFile("Searching for GCChatHandler::Execute...");
     LogToFile("  Base: 0x%08X, Size: 0x%08X", baseAddress, moduleSize);
 
-    DWORD address = FindPattern(pattern, mask, baseAddress, moduleSize);
+    // Cached RVA for this exact Game.exe build -> expected offset -> one full scan -> closest match
+    HookLib::ResolveResult result;
+    HookLib::ResolveGameSignature((const uint8_t*)baseAddress, moduleSize, preference, 3,
+                                  ADDRESS_CACHE_PATH, HookLib::DefaultScanThreads(), &result);
 
-    if (address) {
-        LogToFile("  Found at: 0x%08X", address);
-    } else {
+    LogToFile("  Resolved via: %s", HookLib::ResolveMethodName(result.method));
+    if (result.method == HookLib::RESOLVE_APPROXIMATE) {
+        LogToFile("  WARNING: %u byte(s) differ from the signature - update it in HookLib/GameSignatures.h",
+                  result.mismatches);
+    }
+
+    size_t offset = result.offset;
+    int chosen = result.signature;
+
+    if (offset == HookLib::NPOS) {
         LogToFile("  NOT FOUND - Pattern needs updating!");
+        return 0;
     }
 
+    DWORD address = baseAddress + (DWORD)offset;
+    LogToFile("  Found %s at: 0x%08X", HookLib::kGameSignatures[chosen].name, address);
+
     return address;
 }
 
@@ -271,6 +339,13 @@ void UninstallHook() {
     }
 }
 
+// The signature scan runs on worker threads, which must not be waited on
+// while DllMain holds the loader lock - so the hook is installed from here.
+DWORD WINAPI HookInitThread(LPVOID) {
+    InstallHook();
+    return 0;
+}
+
 // ============================================================================
 // DLL ENTRY POINT
 // ============================================================================
@@ -280,19 +355,45 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD reason, LPVOID lpReserved) {
         case DLL_PROCESS_ATTACH:
             // Disable DLL_THREAD_ATTACH/DETACH notifications for performance
             DisableThreadLibraryCalls(hModule);
+            RegisterChatSubscribers();
+            RegisterChatTriggers();
+            g_ChatWorker.Start(HandleChatMessage);
+
+#if ENABLE_FILE_LOGGING
+            g_Log.Open(LOG_FILE_PATH);
+#endif
+#if ENABLE_CHAT_RECORD
+            g_ChatRecord.Open(CHAT_RECORD_PATH);
+#endif
+#if ENABLE_CHAT_ARCHIVE
+            {
+                HookLib::ChatArchiveOptions archive;
+                archive.pathPrefix = CHAT_ARCHIVE_PREFIX;
+                HookLib::LoadChatDictionary(CHAT_ARCHIVE_DICTIONARY, &archive.dictionary);   // None: no dictionary
+                g_ChatArchive.Open(archive);
+            }
+#endif
 
             // Optional: Wait for debugger (uncomment for debugging)
             // while (!IsDebuggerPresent()) Sleep(100);
             // __debugbreak();
 
-            // Install the hook
-            InstallHook();
+            // Install the hook (off the loader lock, see HookInitThread)
+            {
+                HANDLE initThread = CreateThread(NULL, 0, HookInitThread, NULL, 0, NULL);
+                if (initThread) CloseHandle(initThread);
+            }
             break;
 
         case DLL_PROCESS_DETACH:
-            // Clean up
+            // Clean up. lpReserved != NULL: the process is exiting and the
+            // other threads are already gone (HookLib/ThreadDone.h)
             UninstallHook();
+            g_ChatWorker.Stop(lpReserved != NULL);   // Handles what is still queued, unless exiting
             LogToFile("=== ChatHook DLL Unloaded ===");
+            g_Log.Close(lpReserved != NULL);   // Writes out whatever is still queued
+            g_ChatRecord.Close();
+            g_ChatArchive.Close(lpReserved != NULL);   // Last block, index and trailer
             break;
     }
 
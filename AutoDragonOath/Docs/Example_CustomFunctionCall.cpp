@@ -6,6 +6,14 @@
 #include <stdio.h>
 #include <string.h>
 #include <detours.h>
+#include "HookLib/GameSignatures.h"
+#include "HookLib/AsyncLog.h"
+#include "HookLib/ChatPacket.h"
+#include "HookLib/ChatWorker.h"
+#include "HookLib/TimerWheel.h"
+#include "HookLib/GameTick.h"
+#include "HookLib/ChatCommands.h"
+#include "HookLib/ChatTriggers.h"
 
 // ============================================================================
 // GAME FUNCTION DEFINITIONS (Find these addresses in IDA)
@@ -61,21 +69,75 @@ HandleRecvTalkPacket_t Original_HandleRecvTalkPacket = NULL;
 // LOGGING
 // ============================================================================
 
-void Log(const char* format, ...) {
-    FILE* f = fopen("C:\\ChatHookExample.log", "a");
-    if (f) {
-        SYSTEMTIME st;
-        GetLocalTime(&st);
-        fprintf(f, "[%02d:%02d:%02d] ", st.wHour, st.wMinute, st.wSecond);
+// Formatted and written by a background thread (HookLib/AsyncLog.h), so
+// logging from the hook only copies the arguments on the game thread
+HookLib::AsyncLog g_Log;
 
-        va_list args;
-        va_start(args, format);
-        vfprintf(f, format, args);
-        va_end(args);
+#define Log(...) HOOKLIB_LOG(g_Log, HookLib::LOG_INFO, __VA_ARGS__)
 
-        fprintf(f, "\n");
-        fclose(f);
-    }
+// ============================================================================
+// THREADS
+// ============================================================================
+
+// The hook only hands each message to g_ChatWorker; ProcessChatCommand and
+// the handlers below run on the worker's thread, so a slow handler holds up
+// later chat, not the game's packets (HookLib/ChatWorker.h). Game functions
+// must still be called on the game thread: the handlers post them to
+// g_GameCalls, which the game window's tick runs within GAME_TICK_MS, chat
+// or not (HookLib/GameTick.h), and the hook with the next packet.
+HookLib::ChatSubscribers g_ChatSubscribers;
+HookLib::ChatMessagePool g_ChatPool;
+HookLib::ChatWorker g_ChatWorker(&g_ChatPool);
+HookLib::GameThreadQueue g_GameCalls;
+
+// Delayed and periodic actions run on g_Timers' driver thread, at their
+// time rather than with the next message (HookLib/TimerWheel.h). Like the
+// handlers, they post game calls to g_GameCalls.
+HookLib::TimerWheel g_Timers;
+
+// Posted calls capture copies, never pointers into the chat message
+struct ChatReply {
+    char text[200];
+    int channel;
+};
+
+// SendChatMessage(text, channel) on the game thread
+void PostChatMessage(const char* text, int channel) {
+    ChatReply reply;
+    snprintf(reply.text, sizeof(reply.text), "%s", text);
+    reply.channel = channel;
+    g_GameCalls.Post([reply]() {
+        if (SendChatMessage) SendChatMessage(reply.text, reply.channel);
+    });
+}
+
+// ============================================================================
+// KEYWORD TRIGGERS
+// ============================================================================
+
+// All keyword rules are one automaton: a message is scanned once, whatever
+// the number of rules, and only whole GBK characters match
+// (HookLib/ChatTriggers.h). Keywords are GBK bytes, the game's encoding.
+// Registered in DLL_PROCESS_ATTACH; scanned on the chat worker.
+HookLib::ChatTriggers g_ChatTriggers;
+HookLib::ChatTriggerHits g_TriggerHits;     // Chat worker only
+int g_HelpTrigger = -1;
+int g_PartyInviteTrigger = -1;
+int g_GuildGatheringTrigger = -1;
+int g_BossSpawnTrigger = -1;
+
+void RegisterChatTriggers() {
+    g_HelpTrigger = g_ChatTriggers.Add(HookLib::ChatTriggerRule("\xB0\xEF\xD6\xFA"));  // "帮助" (Help)
+    // "玩家 [PlayerName] 邀请你加入队伍" on the system channel
+    g_PartyInviteTrigger = g_ChatTriggers.Add(
+        HookLib::ChatTriggerRule("\xD1\xFB\xC7\xEB\xC4\xE3\xBC\xD3\xC8\xEB\xB6\xD3\xCE\xE9")  // "邀请你加入队伍"
+            .Or("invites you to party")
+            .Channels({ 5 }));
+    g_GuildGatheringTrigger = g_ChatTriggers.Add(
+        HookLib::ChatTriggerRule("\xB9\xAB\xBB\xE1\xBC\xAF\xBA\xCF").Channels({ 3 }));  // "公会集合" in guild chat
+    g_BossSpawnTrigger = g_ChatTriggers.Add(
+        HookLib::ChatTriggerRule("BOSS\xCB\xA2\xD0\xC2").Or("Boss spawned"));  // "BOSS刷新"
+    g_ChatTriggers.Build();
 }
 
 // ============================================================================
@@ -87,131 +149,113 @@ void HandleHelpRequest(const char* sender, const char* message) {
     Log("Help request from %s", sender);
 
     // Send help message back
-    if (SendChatMessage) {
-        SendChatMessage("Available commands: !help, !status, !follow, !heal", 1);  // Channel 1 = Near
-    }
+    PostChatMessage("Available commands: !help, !status, !follow, !heal", 1);  // Channel 1 = Near
 }
 
 // Example 2: Status command
-void HandleStatusCommand(const char* sender, const char* message) {
-    Log("Status request from %s", sender);
-
-    if (GetPlayerHP && GetPlayerMaxHP && SendChatMessage) {
-        int hp = GetPlayerHP();
-        int maxHp = GetPlayerMaxHP();
-        int hpPercent = (hp * 100) / maxHp;
-
-        char buffer[256];
-        sprintf(buffer, "HP: %d/%d (%d%%)", hp, maxHp, hpPercent);
-        SendChatMessage(buffer, 1);
-
-        // If low HP, use healing item
-        if (hpPercent < 30 && UseItem) {
-            Log("  -> Low HP detected, using healing item");
-            UseItem(12345);  // Replace with actual healing item ID
+void HandleStatusCommand(const HookLib::ChatCommandCall& call) {
+    Log("Status request from %s", call.sender);
+
+    // Reads and changes game state: all of it on the game thread
+    g_GameCalls.Post([]() {
+        if (GetPlayerHP && GetPlayerMaxHP && SendChatMessage) {
+            int hp = GetPlayerHP();
+            int maxHp = GetPlayerMaxHP();
+            int hpPercent = (hp * 100) / maxHp;
+
+            char buffer[256];
+            sprintf(buffer, "HP: %d/%d (%d%%)", hp, maxHp, hpPercent);
+            SendChatMessage(buffer, 1);
+
+            // If low HP, use healing item
+            if (hpPercent < 30 && UseItem) {
+                Log("  -> Low HP detected, using healing item");
+                UseItem(12345);  // Replace with actual healing item ID
+            }
         }
-    }
+    });
 }
 
 // Example 3: Follow command
-void HandleFollowCommand(const char* sender, const char* message) {
-    Log("Follow request from %s", sender);
-
-    // Parse: "!follow PlayerName"
-    const char* targetName = strchr(message, ' ');
-    if (targetName) {
-        targetName++;  // Skip space
-
-        if (strlen(targetName) > 0 && FollowPlayer) {
-            Log("  -> Following player: %s", targetName);
-            FollowPlayer(targetName);
-
-            if (SendChatMessage) {
-                char reply[128];
-                sprintf(reply, "Now following %s", targetName);
-                SendChatMessage(reply, 1);
-            }
+void HandleFollowCommand(const HookLib::ChatCommandCall& call) {
+    Log("Follow request from %s", call.sender);
+
+    // "!follow PlayerName" (args[0]), or "!follow" for the sender
+    struct { char name[64]; } target;
+    if (call.argCount == 1) {
+        if (FollowPlayer) {
+            Log("  -> Following player: %s", call.args[0]);
+            snprintf(target.name, sizeof(target.name), "%s", call.args[0]);
+            g_GameCalls.Post([target]() { FollowPlayer(target.name); });
+
+            char reply[128];
+            snprintf(reply, sizeof(reply), "Now following %s", call.args[0]);
+            PostChatMessage(reply, 1);
         }
     } else {
         // Follow the sender if no target specified
         if (FollowPlayer) {
-            Log("  -> Following sender: %s", sender);
-            FollowPlayer(sender);
+            Log("  -> Following sender: %s", call.sender);
+            snprintf(target.name, sizeof(target.name), "%s", call.sender);
+            g_GameCalls.Post([target]() { FollowPlayer(target.name); });
         }
     }
 }
 
 // Example 4: Party invite auto-accept
+// Called when g_PartyInviteTrigger fired: system message
+// "玩家 [PlayerName] 邀请你加入队伍" ("Player [PlayerName] invites you to party")
 void HandlePartyInvite(const char* message) {
-    // System message format: "玩家 [PlayerName] 邀请你加入队伍"
-    // Translation: "Player [PlayerName] invites you to party"
-
-    if (strstr(message, "邀请你加入队伍") || strstr(message, "invites you to party")) {
-        Log("Party invite detected!");
+    Log("Party invite detected!");
 
-        if (AcceptPartyInvite) {
-            Log("  -> Auto-accepting party invite");
-            AcceptPartyInvite();
+    if (AcceptPartyInvite) {
+        Log("  -> Auto-accepting party invite");
+        g_GameCalls.Post([]() { AcceptPartyInvite(); });
 
-            Sleep(500);  // Wait a bit
-
-            if (SendChatMessage) {
-                SendChatMessage("Thanks for the invite!", 2);  // Channel 2 = Team
-            }
-        }
+        // Thank them a bit later, without holding up the chat worker
+        g_Timers.Schedule(500, []() { PostChatMessage("Thanks for the invite!", 2); });  // Channel 2 = Team
     }
 }
 
 // Example 5: Trade bot
-void HandleTradeRequest(const char* sender, const char* message) {
-    // Example: "!buy sword 1000" or "!sell potion 50"
+// "!buy sword 1000" or "!sell potion 50": args[0] is the item, args[1] the price
+void HandleBuyCommand(const HookLib::ChatCommandCall& call) {
+    Log("Buy request from %s: %s (price %s)", call.sender, call.args[0], call.argCount > 1 ? call.args[1] : "-");
 
-    if (strncmp(message, "!buy", 4) == 0) {
-        Log("Buy request from %s: %s", sender, message);
+    // In real implementation, check inventory, prices, etc.
 
-        // Parse item and price
-        // In real implementation, check inventory, prices, etc.
+    PostChatMessage("Sorry, I'm not selling that item right now.", 4);  // Channel 4 = Private
+}
 
-        if (SendChatMessage) {
-            SendChatMessage("Sorry, I'm not selling that item right now.", 4);  // Channel 4 = Private
-        }
-    }
-    else if (strncmp(message, "!sell", 5) == 0) {
-        Log("Sell request from %s: %s", sender, message);
+void HandleSellCommand(const HookLib::ChatCommandCall& call) {
+    Log("Sell request from %s: %s (price %s)", call.sender, call.args[0], call.argCount > 1 ? call.args[1] : "-");
 
-        if (SendChatMessage) {
-            SendChatMessage("I can buy that! Let's trade.", 4);
-        }
+    PostChatMessage("I can buy that! Let's trade.", 4);
 
-        // Could call OpenTradeWindow(sender) here
-    }
+    // Could call OpenTradeWindow(sender) here
 }
 
 // Example 6: Keyword trigger
-void HandleKeywordTrigger(const char* sender, const char* message, int channel) {
-    // Monitor for specific keywords and react
+void HandleKeywordTrigger(const char* sender, const HookLib::ChatTriggerHits& hits) {
+    // React to the keyword rules that fired (see RegisterChatTriggers)
 
-    // Example: Guild gathering announcement
-    if (channel == 3 && strstr(message, "公会集合")) {  // "Guild gathering" in Chinese
+    // Example: Guild gathering announcement ("公会集合" in guild chat)
+    if (hits.Fired(g_GuildGatheringTrigger)) {
         Log("Guild gathering announcement detected!");
 
         // Auto-respond
-        if (SendChatMessage) {
-            SendChatMessage("收到！马上来！", 3);  // "Received! Coming now!" in guild chat
-        }
+        PostChatMessage("收到！马上来！", 3);  // "Received! Coming now!" in guild chat
 
         // Could auto-navigate to meeting point here
         // TeleportToGuildHall();
     }
 
     // Example: Boss spawn notification
-    if (strstr(message, "BOSS刷新") || strstr(message, "Boss spawned")) {
+    if (hits.Fired(g_BossSpawnTrigger)) {
         Log("Boss spawn detected!");
 
         // Alert or auto-navigate
-        if (SendChatMessage) {
-            SendChatMessage("On my way to boss!", 1);
-        }
+        PostChatMessage("On my way to boss!", 1);
 
         // NavigateToBossLocation();
     }
@@ -221,32 +265,52 @@ void HandleKeywordTrigger(const char* sender, const char* message, int channel)
 // COMMAND DISPATCHER
 // ============================================================================
 
-void ProcessChatCommand(const char* sender, const char* message, int channel) {
-    // Command router - calls appropriate function based on message content
+void HandleHelpCommand(const HookLib::ChatCommandCall& call) {
+    HandleHelpRequest(call.sender, call.message);
+}
 
-    // Help command
-    if (strcmp(message, "!help") == 0 || strstr(message, "帮助")) {
-        HandleHelpRequest(sender, message);
-    }
-    // Status command
-    else if (strcmp(message, "!status") == 0) {
-        HandleStatusCommand(sender, message);
+// To add a command, add a line: dispatch is one hash of the first word and
+// one compare, however many lines there are (HookLib/ChatCommands.h)
+static constexpr HookLib::ChatCommand kChatCommands[] = {
+    // Token       Handler               Arguments                    Reply when they are wrong
+    { "!help",     HandleHelpCommand,    HookLib::ChatNoArgs,         nullptr },
+    { "!status",   HandleStatusCommand,  HookLib::ChatNoArgs,         nullptr },
+    { "!follow",   HandleFollowCommand,  HookLib::ChatWords<0, 1>,    "Usage: !follow [player]" },
+    { "!buy",      HandleBuyCommand,     HookLib::ChatWords<1, 2>,    "Usage: !buy item [price]" },
+    { "!sell",     HandleSellCommand,    HookLib::ChatWords<1, 2>,    "Usage: !sell item [price]" },
+};
+static constexpr auto g_ChatCommands = HookLib::MakeChatCommandTable(kChatCommands);
+
+void ProcessChatCommand(const char* sender, const char* message, int channel) {
+    // Commands: "!verb arguments"
+    const HookLib::ChatCommand* command = NULL;
+    switch (g_ChatCommands.Dispatch(sender, message, channel, &command)) {
+        case HookLib::CHAT_COMMAND_RAN:
+            return;
+        case HookLib::CHAT_COMMAND_BAD_ARGS:
+            if (command->usage) PostChatMessage(command->usage, 1);
+            return;
+        case HookLib::CHAT_COMMAND_NONE:
+            break;
     }
-    // Follow command
-    else if (strncmp(message, "!follow", 7) == 0) {
-        HandleFollowCommand(sender, message);
+
+    // Keyword rules: one pass over the message for all of them
+    if (g_ChatTriggers.Scan(message, strlen(message), (unsigned char)channel, sender, strlen(sender),
+                            &g_TriggerHits) == 0) {
+        return;
     }
-    // Trade commands
-    else if (strncmp(message, "!buy", 4) == 0 || strncmp(message, "!sell", 5) == 0) {
-        HandleTradeRequest(sender, message);
+
+    // Help asked for in Chinese, anywhere in the message
+    if (g_TriggerHits.Fired(g_HelpTrigger)) {
+        HandleHelpRequest(sender, message);
     }
     // System messages (party invites, etc.)
-    else if (channel == 5) {  // System channel
+    else if (g_TriggerHits.Fired(g_PartyInviteTrigger)) {
         HandlePartyInvite(message);
     }
     // Keyword monitoring
     else {
-        HandleKeywordTrigger(sender, message, channel);
+        HandleKeywordTrigger(sender, g_TriggerHits);
     }
 }
 
@@ -254,37 +318,41 @@ void ProcessChatCommand(const char* sender, const char* message, int channel) {
 // HOOKED FUNCTION
 // ============================================================================
 
+// The packet's channel is read first; sender and text are copied (into a
+// pool slot, HookLib/ChatPacket.h) only for messages a subscriber wants.
+// Registered in DLL_PROCESS_ATTACH, before the hook is installed.
+void RegisterChatSubscribers() {
+    // The command dispatcher looks at every channel; narrow this with
+    // .Channels({ ... }) if it only needs some
+    g_ChatSubscribers.Add(HookLib::ChatSubscription());
+}
+
+// Runs on g_ChatWorker's thread, one message at a time
+void HandleChatMessage(const HookLib::ChatMessage& message) {
+    // Log the message
+    Log("[Channel %d] %s: %s", message.channel, message.sender, message.text);
+
+    // Process commands and automation
+    ProcessChatCommand(message.sender, message.text, message.channel);
+}
+
 int __fastcall Hooked_HandleRecvTalkPacket(void* thisPtr, void* edx, GCChat* pPacket) {
-    char senderName[256] = {0};
-    char messageText[1024] = {0};
-    unsigned char channelType = 0;
+    // On the game thread: run the game calls the handlers have posted
+    g_GameCalls.RunPending();
 
     if (pPacket) {
+        HookLib::ChatMessage* message = NULL;
         __try {
-            // Extract data from packet
-            char* sender = pPacket->GetSourName();
-            int senderSize = pPacket->GetSourNameSize();
-            if (sender && senderSize > 0 && senderSize < 256) {
-                memcpy(senderName, sender, senderSize);
-            }
-
-            char* message = pPacket->GetContex();
-            int messageSize = pPacket->GetContexSize();
-            if (message && messageSize > 0 && messageSize < 1024) {
-                memcpy(messageText, message, messageSize);
+            HookLib::ChatPacketView<GCChat> view(pPacket);
+            if (HookLib::TakeChatMessage(view, g_ChatSubscribers, &g_ChatPool, &message)) {
+                HookLib::ChatMessage* published = message;
+                message = NULL;   // The worker releases it from here on
+                g_ChatWorker.Publish(published);
             }
-
-            channelType = pPacket->GetChatType();
-
-            // Log the message
-            Log("[Channel %d] %s: %s", channelType, senderName, messageText);
-
-            // Process commands and automation
-            ProcessChatCommand(senderName, messageText, channelType);
-
         } __except (EXCEPTION_EXECUTE_HANDLER) {
             Log("ERROR: Exception in hook");
         }
+        if (message) g_ChatPool.Release(message);
     }
 
     // Call original function
@@ -315,16 +383,14 @@ class SimpleBot {
 private:
     BotState currentState;
     char currentTarget[64];
-    DWORD lastActionTime;
+    std::atomic<bool> replyCoolingDown;   // Cleared by a g_Timers action
 
 public:
-    SimpleBot() : currentState(STATE_IDLE), lastActionTime(0) {
+    SimpleBot() : currentState(STATE_IDLE), replyCoolingDown(false) {
         memset(currentTarget, 0, sizeof(currentTarget));
     }
 
     void OnChatReceived(const char* sender, const char* message, int channel) {
-        DWORD currentTime = GetTickCount();
-
         switch (currentState) {
             case STATE_IDLE:
                 if (strstr(message, "!trade")) {
@@ -373,11 +439,9 @@ public:
 
             case STATE_COMBAT:
                 // Auto-reply to chat while in combat
-                if (currentTime - lastActionTime > 5000) {  // Every 5 seconds
-                    if (SendChatMessage) {
-                        SendChatMessage("I'm in combat, will respond later!", 4);
-                    }
-                    lastActionTime = currentTime;
+                if (!replyCoolingDown.exchange(true)) {  // At most every 5 seconds
+                    PostChatMessage("I'm in combat, will respond later!", 4);
+                    g_Timers.Schedule(5000, [this]() { replyCoolingDown = false; });
                 }
                 break;
         }
@@ -391,21 +455,6 @@ SimpleBot g_Bot;
 // PATTERN SCANNING & HOOK INSTALLATION
 // ============================================================================
 
-DWORD FindPattern(BYTE* pattern, const char* mask, DWORD base, DWORD size) {
-    DWORD patternLen = strlen(mask);
-    for (DWORD i = 0; i < size - patternLen; i++) {
-        bool found = true;
-        for (DWORD j = 0; j < patternLen; j++) {
-            if (mask[j] != '?' && pattern[j] != *(BYTE*)(base + i + j)) {
-                found = false;
-                break;
-            }
-        }
-        if (found) return base + i;
-    }
-    return 0;
-}
-
 bool InstallHook() {
     Log("=== Chat Hook Example DLL Loaded ===");
 
@@ -419,11 +468,19 @@ bool InstallHook() {
     MODULEINFO modInfo;
     GetModuleInformation(GetCurrentProcess(), gameModule, &modInfo, sizeof(modInfo));
 
-    // TODO: Update this pattern from your IDA analysis
-    BYTE pattern[] = { 0x55, 0x8B, 0xEC, 0x83, 0xEC, 0x00, 0x53, 0x56, 0x57, 0x8B, 0xF9 };
-    const char* mask = "xxxxx?xxxxx";
-
-    DWORD address = FindPattern(pattern, mask, (DWORD)modInfo.lpBaseOfDll, modInfo.SizeOfImage);
+    // TODO: Update SIG_GENERIC_TALK_PROLOGUE in HookLib/GameSignatures.h from your IDA analysis
+    // The whole signature table is resolved in one pass over the module
+    HookLib::MultiScanMatches matches;
+    HookLib::ScanGameSignatures((const uint8_t*)modInfo.lpBaseOfDll, modInfo.SizeOfImage, &matches,
+                                HookLib::DefaultScanThreads());
+
+    // Candidates that fail the entry's verifiers were already dropped during the scan
+    const std::vector<size_t>& hits = matches[HookLib::SIG_GENERIC_TALK_PROLOGUE];
+    DWORD address = hits.empty() ? 0 : (DWORD)modInfo.lpBaseOfDll + (DWORD)hits[0];
+    if (HookLib::ClassifyMatches(hits.size()) == HookLib::MATCH_AMBIGUOUS) {
+        Log("WARNING: %u candidates match, using the first. Add a verifier to make it unique.",
+            (unsigned)hits.size());
+    }
 
     if (!address) {
         Log("ERROR: Pattern not found");
@@ -459,6 +516,16 @@ void UninstallHook() {
     }
 }
 
+// Installs the hook off the loader lock (see HookInitThread in ChatHookDLL.cpp),
+// then waits for the game's window for the window tick
+DWORD WINAPI HookInitThread(LPVOID) {
+    InstallHook();
+    if (!HookLib::GameTick::Install(&g_GameCalls)) {
+        Log("WARNING: game window not found, posted calls run with chat packets only");
+    }
+    return 0;
+}
+
 // ============================================================================
 // DLL ENTRY POINT
 // ============================================================================
@@ -466,7 +533,14 @@ void UninstallHook() {
 BOOL APIENTRY DllMain(HMODULE hModule, DWORD reason, LPVOID lpReserved) {
     if (reason == DLL_PROCESS_ATTACH) {
         DisableThreadLibraryCalls(hModule);
-        InstallHook();
+        g_Log.Open("C:\\ChatHookExample.log");
+        RegisterChatSubscribers();
+        RegisterChatTriggers();
+        g_ChatWorker.Start(HandleChatMessage);
+        g_Timers.Start();
+
+        HANDLE initThread = CreateThread(NULL, 0, HookInitThread, NULL, 0, NULL);
+        if (initThread) CloseHandle(initThread);
 
         // Initialize game function pointers here
         // TODO: Find these addresses in IDA and update
@@ -480,8 +554,14 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD reason, LPVOID lpReserved) {
         */
     }
     else if (reason == DLL_PROCESS_DETACH) {
+        // lpReserved != NULL: the process is exiting and the other threads
+        // are already gone (HookLib/ThreadDone.h)
         UninstallHook();
+        if (lpReserved == NULL) HookLib::GameTick::Uninstall();
+        g_Timers.Stop(lpReserved != NULL);
+        g_ChatWorker.Stop(lpReserved != NULL);   // Handles what is still queued, unless exiting
         Log("=== Chat Hook Example DLL Unloaded ===");
+        g_Log.Close(lpReserved != NULL);
     }
 
     return TRUE;
@@ -501,7 +581,7 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD reason, LPVOID lpReserved) {
  * 2. Update the function pointers at the top of this file
  *
  * 3. Compile:
- *    cl /LD /MT Example_CustomFunctionCall.cpp /I"C:\Detours\include" ^
+ *    cl /LD /MT /std:c++17 /EHsc Example_CustomFunctionCall.cpp /I"C:\Detours\include" ^
  *       /link /LIBPATH:"C:\Detours\lib.X86" detours.lib
  *
  * 4. Inject into Game.exe
@@ -0,0 +1,219 @@
+// AddressCache.h - On-disk cache of resolved addresses, keyed by module fingerprint
+//
+// Game.exe only changes with game patches, so a signature resolved once
+// keeps its RVA until the next patch. The cache maps
+//     (module fingerprint, signature name) -> RVA
+// On a hit, the caller checks the signature at the cached RVA with one
+// MatchAt and skips the scan completely.
+//
+// Fingerprint = PE TimeDateStamp + SizeOfImage + FNV-1a hash of the PE
+// headers and a few pages sampled evenly from the code range. Only code is
+// sampled, because data pages change while the game runs.
+//
+// File format (plain text, one entry per line):
+//     # HookLib address cache v1
+//     <timestamp>-<sizeOfImage>-<hash> <signature name> <rva>
+// e.g.
+//     5F3A1B2C-01A3C000-0123456789ABCDEF HandleRecvTalkPacket#1 0x0008D6F0
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "PeImage.h"
+
+namespace HookLib {
+
+static const size_t FINGERPRINT_SAMPLE_PAGES = 8;
+static const size_t FINGERPRINT_PAGE_SIZE = 0x1000;
+static const size_t ADDRESS_CACHE_MAX_ENTRIES = 256;
+
+// ============================================================================
+// FINGERPRINT
+// ============================================================================
+
+struct ModuleFingerprint {
+    uint32_t timeDateStamp;
+    uint32_t sizeOfImage;
+    uint64_t contentHash;
+
+    bool operator==(const ModuleFingerprint& other) const {
+        return timeDateStamp == other.timeDateStamp && sizeOfImage == other.sizeOfImage &&
+               contentHash == other.contentHash;
+    }
+};
+
+inline uint64_t Fnv1a64(const uint8_t* data, size_t size, uint64_t hash = 0xCBF29CE484222325ULL) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// Computes the fingerprint of a module mapped in memory layout (RVA = offset),
+// e.g. a loaded module or a dump of one. Returns false if the PE headers are
+// not readable.
+inline bool ComputeModuleFingerprint(const uint8_t* image, size_t size, ModuleFingerprint* out) {
+    PeImage pe;
+    if (!pe.Parse(image, size, PE_LAYOUT_MAPPED)) {
+        return false;
+    }
+
+    out->timeDateStamp = pe.timeDateStamp;
+    out->sizeOfImage = pe.sizeOfImage;
+
+    size_t headerBytes = pe.sizeOfHeaders;
+    if (headerBytes == 0 || headerBytes > FINGERPRINT_PAGE_SIZE) headerBytes = FINGERPRINT_PAGE_SIZE;
+    if (headerBytes > size) headerBytes = size;
+    uint64_t hash = Fnv1a64(image, headerBytes);
+
+    // Sample pages spread evenly over the code range (clamped to the span)
+    size_t codeStart = pe.baseOfCode;
+    size_t codeEnd = (size_t)pe.baseOfCode + pe.sizeOfCode;
+    if (codeEnd > size) codeEnd = size;
+    if (codeStart < codeEnd && codeEnd - codeStart >= FINGERPRINT_PAGE_SIZE) {
+        size_t span = codeEnd - codeStart - FINGERPRINT_PAGE_SIZE;
+        for (size_t i = 0; i < FINGERPRINT_SAMPLE_PAGES; i++) {
+            // Multiply first: span / 7 rounded down would never reach the last page
+            size_t page = codeStart + span * i / (FINGERPRINT_SAMPLE_PAGES - 1);
+            page &= ~(FINGERPRINT_PAGE_SIZE - 1);
+            if (page < codeStart) page = codeStart;
+            hash = Fnv1a64(image + page, FINGERPRINT_PAGE_SIZE, hash);
+        }
+    }
+
+    out->contentHash = hash;
+    return true;
+}
+
+// ============================================================================
+// CACHE
+// ============================================================================
+
+class AddressCache {
+public:
+    // Loads entries from disk. A missing or unreadable file leaves the cache
+    // empty and returns false; malformed lines are skipped.
+    bool Load(const char* path) {
+        entries.clear();
+        FILE* file = fopen(path, "r");
+        if (!file) {
+            return false;
+        }
+
+        char line[512];
+        while (fgets(line, sizeof(line), file)) {
+            if (line[0] == '#' || line[0] == '\n') {
+                continue;
+            }
+
+            Entry entry;
+            unsigned int stamp, imageSize;
+            unsigned long long hash, rva;
+            char name[256];
+            if (sscanf(line, "%8X-%8X-%16llX %255s %llX", &stamp, &imageSize, &hash, name, &rva) != 5) {
+                continue;
+            }
+            entry.fingerprint.timeDateStamp = stamp;
+            entry.fingerprint.sizeOfImage = imageSize;
+            entry.fingerprint.contentHash = hash;
+            entry.name = name;
+            entry.rva = (size_t)rva;
+            entries.push_back(entry);
+        }
+
+        fclose(file);
+        return true;
+    }
+
+    // Writes the cache to a temporary file and renames it over `path`, so a
+    // crash mid-write never leaves a truncated cache behind.
+    bool Save(const char* path) const {
+        char tempPath[512];
+        snprintf(tempPath, sizeof(tempPath), "%s.%08lX.tmp", path,
+                 (unsigned long)((uintptr_t)this ^ (uintptr_t)clock() ^ (uintptr_t)time(NULL)));
+
+        FILE* file = fopen(tempPath, "w");
+        if (!file) {
+            return false;
+        }
+
+        fprintf(file, "# HookLib address cache v1\n");
+        for (size_t i = 0; i < entries.size(); i++) {
+            const Entry& entry = entries[i];
+            fprintf(file, "%08X-%08X-%016llX %s 0x%08llX\n",
+                    entry.fingerprint.timeDateStamp, entry.fingerprint.sizeOfImage,
+                    (unsigned long long)entry.fingerprint.contentHash, entry.name.c_str(),
+                    (unsigned long long)entry.rva);
+        }
+
+        bool ok = (fflush(file) == 0);
+        fclose(file);
+        if (!ok) {
+            remove(tempPath);
+            return false;
+        }
+
+        // rename() does not replace an existing file on Windows
+        remove(path);
+        if (rename(tempPath, path) != 0) {
+            remove(tempPath);
+            return false;
+        }
+        return true;
+    }
+
+    bool Lookup(const ModuleFingerprint& fingerprint, const char* name, size_t* rva) const {
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (entries[i].fingerprint == fingerprint && entries[i].name == name) {
+                *rva = entries[i].rva;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Adds or replaces an entry. The oldest entries are dropped beyond
+    // ADDRESS_CACHE_MAX_ENTRIES (old game versions pile up otherwise).
+    void Store(const ModuleFingerprint& fingerprint, const char* name, size_t rva) {
+        Forget(fingerprint, name);
+
+        Entry entry;
+        entry.fingerprint = fingerprint;
+        entry.name = name;
+        entry.rva = rva;
+        entries.push_back(entry);
+
+        if (entries.size() > ADDRESS_CACHE_MAX_ENTRIES) {
+            entries.erase(entries.begin(), entries.begin() + (entries.size() - ADDRESS_CACHE_MAX_ENTRIES));
+        }
+    }
+
+    void Forget(const ModuleFingerprint& fingerprint, const char* name) {
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (entries[i].fingerprint == fingerprint && entries[i].name == name) {
+                entries.erase(entries.begin() + i);
+                return;
+            }
+        }
+    }
+
+    size_t Count() const { return entries.size(); }
+
+private:
+    struct Entry {
+        ModuleFingerprint fingerprint;
+        std::string name;
+        size_t rva;
+    };
+
+    std::vector<Entry> entries;
+};
+
+} // namespace HookLib
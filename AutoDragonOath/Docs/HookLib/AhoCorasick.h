@@ -0,0 +1,169 @@
+// AhoCorasick.h - Byte-level Aho-Corasick automaton
+//
+// Compiles a set of byte strings ("keys") into a DFA. Feeding a buffer one
+// byte at a time reports every key that ends at the current position, at a
+// cost of one table lookup per byte no matter how many keys there are.
+//
+// The transition table is stored per byte class rather than per byte: every
+// byte that never appears in a key shares class 0. This keeps the table small
+// when the keys only use part of the alphabet.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace HookLib {
+
+class AhoCorasick {
+public:
+    AhoCorasick() : classCount(1), built(false) {
+        for (int c = 0; c < 256; c++) byteClass[c] = 0;
+        NewNode();  // Root
+    }
+
+    // Adds a key and returns its id (0, 1, 2... in insertion order).
+    // Empty keys are ignored and return -1.
+    int AddKey(const uint8_t* key, size_t length) {
+        if (length == 0) {
+            return -1;
+        }
+
+        int32_t node = 0;
+        for (size_t i = 0; i < length; i++) {
+            int32_t next = FindChild(node, key[i]);
+            if (next < 0) {
+                next = NewNode();
+                trieEdges[node].push_back(Edge(key[i], next));
+            }
+            node = next;
+        }
+
+        int id = (int)keyLengths.size();
+        keyLengths.push_back(length);
+        ownOutputs[node].push_back(id);
+        built = false;
+        return id;
+    }
+
+    size_t KeyCount() const { return keyLengths.size(); }
+    size_t KeyLength(int id) const { return keyLengths[id]; }
+    size_t StateCount() const { return trieEdges.size(); }
+
+    // Builds failure links, the DFA table and the merged output lists.
+    void Build() {
+        size_t stateCount = trieEdges.size();
+
+        // Bytes used by any key get their own class
+        classCount = 1;
+        for (int c = 0; c < 256; c++) byteClass[c] = 0;
+        for (size_t s = 0; s < stateCount; s++) {
+            for (size_t e = 0; e < trieEdges[s].size(); e++) {
+                uint8_t b = trieEdges[s][e].byte;
+                if (byteClass[b] == 0) {
+                    byteClass[b] = (uint16_t)classCount++;
+                }
+            }
+        }
+
+        delta.assign(stateCount * classCount, 0);
+        std::vector<int32_t> fail(stateCount, 0);
+        std::vector<int32_t> order;
+        order.reserve(stateCount);
+
+        // Breadth-first over the trie; every state's fail target is finished first
+        for (size_t e = 0; e < trieEdges[0].size(); e++) {
+            const Edge& edge = trieEdges[0][e];
+            delta[byteClass[edge.byte]] = edge.target;
+            order.push_back(edge.target);
+        }
+        for (size_t head = 0; head < order.size(); head++) {
+            int32_t state = order[head];
+            int32_t* row = &delta[(size_t)state * classCount];
+            const int32_t* failRow = &delta[(size_t)fail[state] * classCount];
+            for (size_t c = 0; c < classCount; c++) {
+                row[c] = failRow[c];
+            }
+            for (size_t e = 0; e < trieEdges[state].size(); e++) {
+                const Edge& edge = trieEdges[state][e];
+                fail[edge.target] = failRow[byteClass[edge.byte]];
+                row[byteClass[edge.byte]] = edge.target;
+                order.push_back(edge.target);
+            }
+        }
+
+        // Merge outputs along fail links (fail targets are always earlier in BFS order)
+        std::vector<std::vector<int32_t> > merged(ownOutputs);
+        for (size_t i = 0; i < order.size(); i++) {
+            int32_t state = order[i];
+            const std::vector<int32_t>& inherited = merged[fail[state]];
+            merged[state].insert(merged[state].end(), inherited.begin(), inherited.end());
+        }
+
+        outputStart.assign(stateCount + 1, 0);
+        outputKeys.clear();
+        for (size_t s = 0; s < stateCount; s++) {
+            outputStart[s] = (uint32_t)outputKeys.size();
+            outputKeys.insert(outputKeys.end(), merged[s].begin(), merged[s].end());
+        }
+        outputStart[stateCount] = (uint32_t)outputKeys.size();
+        built = true;
+    }
+
+    bool IsBuilt() const { return built; }
+
+    int32_t Step(int32_t state, uint8_t byte) const {
+        return delta[(size_t)state * classCount + byteClass[byte]];
+    }
+
+    bool HasOutput(int32_t state) const {
+        return outputStart[state] != outputStart[state + 1];
+    }
+
+    // Keys ending in this state: [OutputBegin, OutputEnd)
+    const int32_t* OutputBegin(int32_t state) const { return outputKeys.data() + outputStart[state]; }
+    const int32_t* OutputEnd(int32_t state) const { return outputKeys.data() + outputStart[state + 1]; }
+
+    // Approximate heap footprint of the compiled automaton
+    size_t MemoryBytes() const {
+        return delta.size() * sizeof(int32_t) + outputKeys.size() * sizeof(int32_t) +
+               outputStart.size() * sizeof(uint32_t);
+    }
+
+private:
+    struct Edge {
+        Edge(uint8_t b, int32_t t) : byte(b), target(t) {}
+        uint8_t byte;
+        int32_t target;
+    };
+
+    int32_t NewNode() {
+        trieEdges.push_back(std::vector<Edge>());
+        ownOutputs.push_back(std::vector<int32_t>());
+        return (int32_t)trieEdges.size() - 1;
+    }
+
+    int32_t FindChild(int32_t node, uint8_t byte) const {
+        const std::vector<Edge>& edges = trieEdges[node];
+        for (size_t i = 0; i < edges.size(); i++) {
+            if (edges[i].byte == byte) return edges[i].target;
+        }
+        return -1;
+    }
+
+    // Construction data
+    std::vector<std::vector<Edge> > trieEdges;
+    std::vector<std::vector<int32_t> > ownOutputs;
+    std::vector<size_t> keyLengths;
+
+    // Compiled automaton
+    uint16_t byteClass[256];
+    size_t classCount;
+    std::vector<int32_t> delta;
+    std::vector<uint32_t> outputStart;
+    std::vector<int32_t> outputKeys;
+    bool built;
+};
+
+} // namespace HookLib
@@ -0,0 +1,134 @@
+// ApproxScan.h - Signature matching with up to k mismatching bytes
+//
+// A small patch often changes one immediate in a prologue (sub esp, 118h ->
+// sub esp, 11Ch is the whole difference between Pattern1 and Pattern2), and
+// the exact scan then finds nothing. This scanner accepts up to k exact or
+// partially masked bytes that differ; wildcards never count.
+//
+// Bit-parallel Shift-And for Hamming distance (Baeza-Yates / Gonnet, Wu /
+// Manber): one 64-bit state word per allowed mismatch count. Bit j of R[d]
+// is set when the last j + 1 bytes match the first j + 1 pattern bytes with
+// at most d mismatches. Per byte:
+//     R[0] = ((R[0] << 1) | 1) & T[c]
+//     R[d] = (((R[d] << 1) | 1) & T[c]) | (old R[d-1] << 1) | 1
+// which is O(n * (k + 1)) for the whole buffer, independent of the
+// signature's wildcards. Bytes past the first 64 are checked directly.
+
+#pragma once
+
+#include <algorithm>
+
+#include "PatternScan.h"
+
+namespace HookLib {
+
+static const size_t APPROX_WORD_BITS = 64;
+static const unsigned APPROX_MAX_K = 8;
+
+struct ApproxMatch {
+    size_t offset;
+    unsigned mismatches;
+};
+
+// Mismatching non-wildcard bytes at p (no early exit)
+inline unsigned CountMismatches(const uint8_t* p, const PatternView& pattern, size_t from = 0) {
+    unsigned count = 0;
+    for (size_t j = from; j < pattern.length; j++) {
+        if ((p[j] & pattern.mask[j]) != pattern.value[j]) count++;
+    }
+    return count;
+}
+
+// Finds start offsets in data[0, size) where `pattern` matches with at most
+// maxMismatches differing bytes. Keeps the best maxResults candidates
+// (fewest mismatches, then lowest offset) in *best, sorted that way. Once
+// maxResults candidates with d mismatches are known, worse ones are no
+// longer tracked, which also makes the rest of the scan cheaper.
+inline void FindApproxPatterns(const uint8_t* data, size_t size, const PatternView& pattern,
+                               unsigned maxMismatches, size_t maxResults, std::vector<ApproxMatch>* best) {
+    best->clear();
+    if (pattern.length == 0 || pattern.length > size || maxResults == 0) {
+        return;
+    }
+    if (maxMismatches > APPROX_MAX_K) maxMismatches = APPROX_MAX_K;
+
+    size_t exactBytes = 0;
+    for (size_t j = 0; j < pattern.length; j++) {
+        if (pattern.mask[j] != MASK_WILDCARD) exactBytes++;
+    }
+    if (maxMismatches >= exactBytes) {
+        // Every position would qualify; that is not a signature search
+        if (exactBytes == 0) return;
+        maxMismatches = (unsigned)exactBytes - 1;
+    }
+
+    // Bit-parallel part covers the first 64 bytes; the tail is counted directly
+    size_t head = (pattern.length < APPROX_WORD_BITS) ? pattern.length : APPROX_WORD_BITS;
+    uint64_t table[256];
+    for (int c = 0; c < 256; c++) {
+        uint64_t bits = 0;
+        for (size_t j = 0; j < head; j++) {
+            if (((uint8_t)c & pattern.mask[j]) == pattern.value[j]) bits |= (uint64_t)1 << j;
+        }
+        table[c] = bits;
+    }
+    const uint64_t accept = (uint64_t)1 << (head - 1);
+
+    // buckets[d] = candidates with exactly d mismatches, ascending offsets
+    std::vector<std::vector<ApproxMatch> > buckets(maxMismatches + 1);
+    size_t kept = 0;
+    unsigned limit = maxMismatches;   // Shrinks once enough better candidates exist
+
+    uint64_t state[APPROX_MAX_K + 1] = {};
+    size_t lastStart = size - pattern.length;
+
+    for (size_t i = 0; i < size; i++) {
+        uint64_t mask = table[data[i]];
+        uint64_t previous = state[0];
+        state[0] = ((state[0] << 1) | 1) & mask;
+        for (unsigned d = 1; d <= limit; d++) {
+            uint64_t current = state[d];
+            state[d] = (((current << 1) | 1) & mask) | (previous << 1) | 1;
+            previous = current;
+        }
+
+        if (!(state[limit] & accept) || i + 1 < head) {
+            continue;
+        }
+        size_t start = i + 1 - head;
+        if (start > lastStart) {
+            break;
+        }
+
+        unsigned mismatches = 0;
+        while (!(state[mismatches] & accept)) mismatches++;
+        if (head < pattern.length) {
+            mismatches += CountMismatches(data + start, pattern, head);
+            if (mismatches > limit) continue;
+        }
+
+        buckets[mismatches].push_back(ApproxMatch{ start, mismatches });
+        kept++;
+
+        // Drop the worst bucket while the better ones already fill maxResults
+        while (limit > 0 && kept - buckets[limit].size() >= maxResults) {
+            kept -= buckets[limit].size();
+            buckets[limit].clear();
+            limit--;
+        }
+    }
+
+    for (unsigned d = 0; d <= limit && best->size() < maxResults; d++) {
+        for (size_t i = 0; i < buckets[d].size() && best->size() < maxResults; i++) {
+            best->push_back(buckets[d][i]);
+        }
+    }
+}
+
+// True if best[0] is the only candidate with its mismatch count, i.e. the
+// approximate result points at one address.
+inline bool IsUniqueBestMatch(const std::vector<ApproxMatch>& best) {
+    return !best.empty() && (best.size() == 1 || best[1].mismatches > best[0].mismatches);
+}
+
+} // namespace HookLib
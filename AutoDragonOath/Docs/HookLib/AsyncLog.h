@@ -0,0 +1,401 @@
+// AsyncLog.h - Log file writer that keeps file I/O off the calling thread
+//
+// The DLLs log from inside the chat hook, on the game's packet thread. The
+// old LogToFile opened the file, wrote one line and closed it again for
+// every call. With AsyncLog the caller only formats into a fixed-size slot
+// of a preallocated ring and returns; a background thread takes the slots
+// in batches, adds the "[HH:MM:SS] " prefix and writes them to a file that
+// stays open.
+//
+//   - The ring is a bounded multi-producer / single-consumer queue (one
+//     sequence number per slot, after Vyukov). Producers never wait: when it
+//     is full the line is dropped and counted, and the writer reports the
+//     count in the log.
+//   - Memory is capacity x LOG_SLOT_BYTES, allocated once in Open. Longer
+//     lines are cut and marked.
+//   - Close drains what is left and closes the file. It is safe from
+//     DLL_PROCESS_DETACH: it waits for the writer's last step, not for the
+//     thread to exit (ThreadDone.h).
+//   - HOOKLIB_LOG (LogFormat.h) does not format on the caller either: it
+//     copies the raw arguments into the slot and the writer formats them.
+//     Opened with LOG_OUTPUT_BINARY, the writer does not format at all and
+//     stores the records for tools/LogDecode.
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "LogFormat.h"
+#include "ThreadDone.h"
+
+namespace HookLib {
+
+static const size_t LOG_SLOT_BYTES = 512;
+static const size_t LOG_DEFAULT_CAPACITY = 2048;        // 1 MB of slots
+static const unsigned LOG_IDLE_WAIT_MS = 20;            // Writer poll interval when woken late
+static const size_t LOG_WRITE_BUFFER = 64 * 1024;
+
+enum LogOutput {
+    LOG_OUTPUT_TEXT = 0,    // "[HH:MM:SS] line", formatted by the writer thread
+    LOG_OUTPUT_BINARY       // LogFormat.h file layout, formatted by tools/LogDecode
+};
+
+// Checked, leveled logging without formatting on the calling thread:
+//
+//     HOOKLIB_LOG(g_Log, HookLib::LOG_INFO, "[Channel %d] %s", channel, text);
+//
+// A format that does not match its arguments does not compile. `level` must
+// be a constant; below HOOKLIB_LOG_MIN_LEVEL the arguments are not evaluated.
+#define HOOKLIB_LOG(log, level, format, ...)                                                              \
+    do {                                                                                                   \
+        static constexpr ::HookLib::LogFormat kHookLibLogFormat_ = ::HookLib::MakeLogFormat(              \
+            decltype(::HookLib::LogArgList(__VA_ARGS__))(), (level), format, __FILE__, __LINE__);         \
+        static_assert(::HookLib::LogFormatMatches(kHookLibLogFormat_), "log format does not match its arguments"); \
+        if constexpr ((level) >= HOOKLIB_LOG_MIN_LEVEL && (level) < ::HookLib::LOG_DISABLED) {           \
+            (log).WriteRecord(&kHookLibLogFormat_, ##__VA_ARGS__);                                        \
+        }                                                                                                  \
+    } while (0)
+
+class AsyncLog {
+public:
+    AsyncLog() : file(nullptr), output(LOG_OUTPUT_TEXT), mask(0), head(0), tail(0), dropped(0), reported(0), stopping(false),
+                 writerIdle(false), consumer(false), cachedSecond(-1) {
+        cachedPrefix[0] = '\0';
+    }
+
+    ~AsyncLog() { Close(); }
+
+    // Opens `path` for appending and starts the writer. `capacity` is
+    // rounded up to a power of two.
+    bool Open(const char* path, size_t capacity = LOG_DEFAULT_CAPACITY, LogOutput mode = LOG_OUTPUT_TEXT) {
+        Close();
+        file = fopen(path, (mode == LOG_OUTPUT_BINARY) ? "ab" : "a");
+        if (file == nullptr) {
+            return false;
+        }
+        setvbuf(file, nullptr, _IOFBF, LOG_WRITE_BUFFER);
+        output = mode;
+        if (output == LOG_OUTPUT_BINARY) {
+            StartBinarySession();
+        }
+
+        size_t slotCount = 2;
+        while (slotCount < capacity) slotCount <<= 1;
+        slots = std::vector<Slot>(slotCount);
+        for (size_t i = 0; i < slotCount; i++) slots[i].sequence.store(i, std::memory_order_relaxed);
+        mask = slotCount - 1;
+        head = 0;
+        tail.store(0, std::memory_order_relaxed);
+        dropped.store(0, std::memory_order_relaxed);
+        reported = 0;
+        stopping.store(false, std::memory_order_relaxed);
+        consumer.store(false, std::memory_order_relaxed);
+
+        writer.Start([this]() { WriterLoop(); });
+        return true;
+    }
+
+    bool IsOpen() const { return file != nullptr; }
+
+    // printf-style line, without the trailing newline. Never blocks.
+    void Write(const char* format, ...) {
+        va_list args;
+        va_start(args, format);
+        WriteV(format, args);
+        va_end(args);
+    }
+
+    void WriteV(const char* format, va_list args) {
+        if (file == nullptr) {
+            return;
+        }
+        size_t position;
+        Slot* slot = Claim(&position);
+        if (slot == nullptr) {
+            return;
+        }
+
+        slot->time = NowMicroseconds();
+        slot->format = nullptr;
+        int length = vsnprintf(slot->text, sizeof(slot->text), format, args);
+        slot->truncated = length >= (int)sizeof(slot->text);
+        slot->length = (uint16_t)((length < 0) ? 0 : slot->truncated ? sizeof(slot->text) - 1 : length);
+        Publish(slot, position);
+    }
+
+    // One HOOKLIB_LOG call: copies the arguments, formats nothing. Never
+    // blocks. `format` must outlive the log (HOOKLIB_LOG's is static).
+    template <class... T>
+    void WriteRecord(const LogFormat* format, const T&... args) {
+        if (file == nullptr) {
+            return;
+        }
+        size_t position;
+        Slot* slot = Claim(&position);
+        if (slot == nullptr) {
+            return;
+        }
+
+        slot->time = NowMicroseconds();
+        slot->format = format;
+        LogArgWriter writer = { (uint8_t*)slot->text, (uint8_t*)slot->text + sizeof(slot->text), false };
+        PackLogArgs(&writer, args...);
+        slot->length = (uint16_t)(writer.at - (uint8_t*)slot->text);
+        slot->truncated = writer.truncated;
+        Publish(slot, position);
+    }
+
+    // Lines lost because the ring was full
+    uint64_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+
+    // Writes out everything queued so far and closes the file.
+    //
+    // From DLL_PROCESS_DETACH pass processExiting = (lpReserved != NULL),
+    // as described in ThreadDone.h. On FreeLibrary the writer is asked to
+    // stop and waited for; Close then drains the rest itself. At process
+    // exit the writer has already been killed: Close drains only if the
+    // writer did not die while draining. When it cannot take the consumer
+    // role, the writer may have died inside the CRT with the FILE locked,
+    // and the file is left to the CRT's own exit flush.
+    void Close(bool processExiting = false) {
+        if (file == nullptr) {
+            return;
+        }
+        stopping.store(true, std::memory_order_release);
+        if (!processExiting) {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            wake.notify_one();
+        }
+        writer.Stop(processExiting);
+        if (!consumer.exchange(true, std::memory_order_acquire)) {
+            Drain();
+            fclose(file);
+        }
+        file = nullptr;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;   // == position: free; == position + 1: filled
+        int64_t time;                   // Microseconds since the epoch
+        const LogFormat* format;        // NULL: text is a formatted line; else packed arguments
+        uint16_t length;
+        bool truncated;
+        char text[LOG_SLOT_BYTES - sizeof(std::atomic<size_t>) - sizeof(int64_t) - sizeof(void*) - sizeof(uint16_t) - 1];
+
+        Slot() : sequence(0), time(0), format(nullptr), length(0), truncated(false) {}
+    };
+
+    static int64_t NowMicroseconds() {
+        using namespace std::chrono;
+        return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+    }
+
+    // Reserves the next free slot, or counts a drop and returns NULL
+    Slot* Claim(size_t* position) {
+        size_t at = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot* slot = &slots[at & mask];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t)sequence - (intptr_t)at;
+            if (difference == 0) {
+                if (tail.compare_exchange_weak(at, at + 1, std::memory_order_relaxed)) {
+                    *position = at;
+                    return slot;
+                }
+            } else if (difference < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            } else {
+                at = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void Publish(Slot* slot, size_t position) {
+        slot->sequence.store(position + 1, std::memory_order_release);
+        if (writerIdle.load(std::memory_order_relaxed)) {
+            wake.notify_one();
+        }
+    }
+
+    // Consumer side: writes every filled slot, in order. Returns the count.
+    size_t Drain() {
+        size_t written = 0;
+        for (;;) {
+            Slot& slot = slots[head & mask];
+            if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+                break;
+            }
+            WriteSlot(slot);
+            slot.sequence.store(head + mask + 1, std::memory_order_release);
+            head++;
+            written++;
+        }
+
+        uint64_t lost = dropped.load(std::memory_order_relaxed);
+        if (lost != reported && output == LOG_OUTPUT_BINARY) {
+            uint64_t count = lost - reported;
+            PutBinary<uint8_t>(LOG_ENTRY_DROPPED);
+            PutBinary<int64_t>(NowMicroseconds());
+            PutBinary<uint64_t>(count);
+            reported = lost;
+        } else if (lost != reported) {
+            char note[64];
+            int length = snprintf(note, sizeof(note), "(log ring full, %llu line(s) dropped)",
+                                  (unsigned long long)(lost - reported));
+            WriteLine(NowMicroseconds(), note, (size_t)length, false);
+            reported = lost;
+        }
+        if (written != 0) {
+            fflush(file);
+        }
+        return written;
+    }
+
+    void WriteSlot(const Slot& slot) {
+        if (output == LOG_OUTPUT_BINARY) {
+            WriteBinarySlot(slot);
+        } else if (slot.format == nullptr) {
+            WriteLine(slot.time, slot.text, slot.length, slot.truncated);
+        } else {
+            record.clear();
+            if (slot.format->level != LOG_INFO) {
+                record.append(LogLevelName(slot.format->level));
+                record.append(": ");
+            }
+            FormatLogRecord(slot.format->format, slot.format->args, slot.format->argCount,
+                            (const uint8_t*)slot.text, slot.length, &record);
+            WriteLine(slot.time, record.data(), record.size(), slot.truncated);
+        }
+    }
+
+    // ========================================================================
+    // BINARY OUTPUT (layout in LogFormat.h; x86 only, so host order is LE)
+    // ========================================================================
+
+    template <class T>
+    void PutBinary(T value) {
+        fwrite(&value, sizeof(value), 1, file);
+    }
+
+    void PutBinaryText(const char* text, size_t length) {
+        if (length > 0xFFFF) length = 0xFFFF;
+        PutBinary<uint16_t>((uint16_t)length);
+        fwrite(text, 1, length, file);
+    }
+
+    void StartBinarySession() {
+        fseek(file, 0, SEEK_END);
+        if (ftell(file) == 0) {
+            fwrite(LOG_FILE_MAGIC, 1, sizeof(LOG_FILE_MAGIC), file);
+            PutBinary<uint16_t>(LOG_FILE_VERSION);
+        }
+        PutBinary<uint8_t>(LOG_ENTRY_SESSION);
+        PutBinary<int64_t>(NowMicroseconds());
+        formatIds.clear();
+    }
+
+    void WriteBinarySlot(const Slot& slot) {
+        if (slot.format == nullptr) {
+            PutBinary<uint8_t>(LOG_ENTRY_TEXT);
+            PutBinary<int64_t>(slot.time);
+            PutBinary<uint8_t>(slot.truncated ? 1 : 0);
+            PutBinaryText(slot.text, slot.length);
+            return;
+        }
+
+        auto found = formatIds.find(slot.format);
+        uint32_t id;
+        if (found != formatIds.end()) {
+            id = found->second;
+        } else {
+            const LogFormat& format = *slot.format;
+            id = (uint32_t)formatIds.size();
+            formatIds[slot.format] = id;
+            PutBinary<uint8_t>(LOG_ENTRY_FORMAT);
+            PutBinary<uint32_t>(id);
+            PutBinary<uint8_t>((uint8_t)format.level);
+            PutBinary<uint8_t>(format.argCount);
+            fwrite(format.args, 1, format.argCount, file);
+            PutBinary<uint32_t>((uint32_t)format.line);
+            PutBinaryText(format.file, strlen(format.file));
+            PutBinaryText(format.format, strlen(format.format));
+        }
+        PutBinary<uint8_t>(LOG_ENTRY_RECORD);
+        PutBinary<uint32_t>(id);
+        PutBinary<int64_t>(slot.time);
+        PutBinary<uint8_t>(slot.truncated ? 1 : 0);
+        PutBinaryText(slot.text, slot.length);
+    }
+
+    void WriteLine(int64_t time, const char* text, size_t length, bool truncated) {
+        time_t second = (time_t)(time / 1000000);
+        if (second != cachedSecond) {
+            struct tm local;
+#ifdef _WIN32
+            localtime_s(&local, &second);
+#else
+            localtime_r(&second, &local);
+#endif
+            snprintf(cachedPrefix, sizeof(cachedPrefix), "[%02d:%02d:%02d] ", local.tm_hour, local.tm_min,
+                     local.tm_sec);
+            cachedSecond = second;
+        }
+        fputs(cachedPrefix, file);
+        fwrite(text, 1, length, file);
+        if (truncated) fputs(LOG_TRUNCATED_MARK, file);
+        fputc('\n', file);
+    }
+
+    void WriterLoop() {
+        while (!stopping.load(std::memory_order_acquire)) {
+            size_t written = 0;
+            if (!consumer.exchange(true, std::memory_order_acquire)) {
+                written = Drain();
+                consumer.store(false, std::memory_order_release);
+            }
+            if (written == 0) {
+                // Producers only notify while writerIdle is set; a wakeup
+                // lost in between costs at most one LOG_IDLE_WAIT_MS
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                writerIdle.store(true, std::memory_order_relaxed);
+                wake.wait_for(lock, std::chrono::milliseconds(LOG_IDLE_WAIT_MS));
+                writerIdle.store(false, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    FILE* file;
+    LogOutput output;
+    std::vector<Slot> slots;
+    size_t mask;
+    size_t head;                        // Consumer only
+    std::atomic<size_t> tail;
+    std::atomic<uint64_t> dropped;
+    uint64_t reported;                  // Consumer only: drops already written out
+    std::atomic<bool> stopping;
+    std::atomic<bool> writerIdle;
+    std::atomic<bool> consumer;         // Held by whoever drains: the writer, or Close
+    BackgroundThread writer;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    time_t cachedSecond;
+    char cachedPrefix[16];
+    std::string record;                                         // Consumer only: text of a record
+    std::unordered_map<const LogFormat*, uint32_t> formatIds;   // Consumer only: binary format ids
+};
+
+} // namespace HookLib
@@ -0,0 +1,175 @@
+// CandidateScan.h - Every match of a signature, with uniqueness and verifiers
+//
+// A short prologue signature ("55 8B EC 83 EC ?? 53 56 57") matches hundreds
+// of functions. Instead of taking the first hit, FindAllPatterns collects
+// every candidate and runs verifier callbacks on each one as it is found,
+// e.g. "calls function X within 0x80 bytes" or "reads the security cookie".
+// Candidates that fail a verifier are dropped in the same pass, so a weak
+// signature plus one or two verifiers usually resolves to a unique address
+// with no second scan. MultiPatternScanner runs the same verifiers.
+//
+// Offsets are buffer offsets. For a loaded module or a dump that is the RVA.
+
+#pragma once
+
+#include "PatternScan.h"
+#include "PeImage.h"
+
+namespace HookLib {
+
+// ============================================================================
+// VERIFIERS
+// ============================================================================
+
+// A candidate check. `check` gets the whole buffer and the candidate offset
+// and returns true to keep it. value/window/context are its parameters.
+struct CandidateVerifier {
+    const char* name;
+    bool (*check)(const CandidateVerifier& self, const uint8_t* data, size_t size, size_t offset);
+    uint64_t value;         // Target offset, address... (meaning depends on check)
+    size_t window;          // Bytes from the candidate start to inspect
+    const void* context;    // Extra data for custom checks
+};
+
+// Window clamped to the buffer
+inline size_t VerifierWindowEnd(const CandidateVerifier& self, size_t size, size_t offset) {
+    return (size - offset < self.window) ? size : offset + self.window;
+}
+
+inline bool CheckCallTo(const CandidateVerifier& self, const uint8_t* data, size_t size, size_t offset) {
+    size_t end = VerifierWindowEnd(self, size, offset);
+    for (size_t k = offset; k + 5 <= end; k++) {
+        if (data[k] != 0xE8) continue;
+        size_t target = k + 5 + (size_t)(intptr_t)(int32_t)ReadLe32(data + k + 1);
+        if (target == self.value) return true;
+    }
+    return false;
+}
+
+inline bool CheckReferencesAddress(const CandidateVerifier& self, const uint8_t* data, size_t size, size_t offset) {
+    size_t end = VerifierWindowEnd(self, size, offset);
+    for (size_t k = offset; k + 4 <= end; k++) {
+        if (ReadLe32(data + k) == (uint32_t)self.value) return true;
+    }
+    return false;
+}
+
+inline bool CheckContainsPattern(const CandidateVerifier& self, const uint8_t* data, size_t size, size_t offset) {
+    const PatternView& inner = *(const PatternView*)self.context;
+    size_t end = VerifierWindowEnd(self, size, offset);
+    if (end - offset < inner.length) {
+        return false;
+    }
+    return FindPatternRangeWith(SIMD_SCALAR, data, offset, end - inner.length, inner) != NPOS;
+}
+
+// "a call rel32 to targetOffset starts within `window` bytes"
+constexpr CandidateVerifier VerifyCallTo(size_t targetOffset, size_t window) {
+    return CandidateVerifier{ "calls target", &CheckCallTo, targetOffset, window, nullptr };
+}
+
+// "a 32-bit immediate/displacement equal to `address` occurs within `window`
+// bytes", e.g. the security cookie VA (mov eax, [__security_cookie] = A1 xx xx xx xx).
+// Absolute addresses assume the module sits at its preferred ImageBase.
+constexpr CandidateVerifier VerifyReferencesAddress(uint32_t address, size_t window) {
+    return CandidateVerifier{ "references address", &CheckReferencesAddress, address, window, nullptr };
+}
+
+// "`inner` matches somewhere within `window` bytes". `inner` must outlive the verifier.
+constexpr CandidateVerifier VerifyContainsPattern(const PatternView* inner, size_t window) {
+    return CandidateVerifier{ "contains pattern", &CheckContainsPattern, 0, window, inner };
+}
+
+inline bool PassesVerifiers(const CandidateVerifier* verifiers, size_t count, const uint8_t* data,
+                            size_t size, size_t offset) {
+    for (size_t v = 0; v < count; v++) {
+        if (!verifiers[v].check(verifiers[v], data, size, offset)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ============================================================================
+// UNIQUENESS
+// ============================================================================
+
+enum MatchUniqueness {
+    MATCH_MISSING = 0,
+    MATCH_UNIQUE,
+    MATCH_AMBIGUOUS
+};
+
+inline MatchUniqueness ClassifyMatches(size_t count) {
+    return (count == 0) ? MATCH_MISSING : (count == 1) ? MATCH_UNIQUE : MATCH_AMBIGUOUS;
+}
+
+inline const char* MatchUniquenessName(MatchUniqueness uniqueness) {
+    switch (uniqueness) {
+        case MATCH_UNIQUE:    return "unique";
+        case MATCH_AMBIGUOUS: return "ambiguous";
+        default:              return "missing";
+    }
+}
+
+// ============================================================================
+// FIND ALL
+// ============================================================================
+
+struct FindAllOptions {
+    size_t limit;                           // Keep at most this many accepted matches (0 = all)
+    const CandidateVerifier* verifiers;     // All must pass (may be NULL)
+    size_t verifierCount;
+};
+
+struct FindAllResult {
+    std::vector<size_t> matches;    // Accepted matches, ascending
+    size_t candidates;              // Signature hits seen, before verifiers
+    size_t rejected;                // Hits dropped by a verifier
+    bool truncated;                 // Another accepted match exists past the limit
+
+    MatchUniqueness Uniqueness() const {
+        return truncated ? MATCH_AMBIGUOUS : ClassifyMatches(matches.size());
+    }
+};
+
+inline FindAllOptions DefaultFindAllOptions() {
+    FindAllOptions options = { 0, nullptr, 0 };
+    return options;
+}
+
+// Collects every match of `pattern` in data[0, size) that passes the
+// verifiers. With a limit, the scan stops at the first accepted match past
+// it (not stored, sets truncated), so limit 1 is a cheap uniqueness check.
+inline void FindAllPatterns(const uint8_t* data, size_t size, const PatternView& pattern,
+                            const FindAllOptions& options, FindAllResult* result) {
+    result->matches.clear();
+    result->candidates = 0;
+    result->rejected = 0;
+    result->truncated = false;
+
+    if (pattern.length == 0 || pattern.length > size) {
+        return;
+    }
+
+    SimdLevel level = GetSimdLevel();
+    size_t last = size - pattern.length;
+    for (size_t at = 0; at <= last; at++) {
+        at = FindPatternRangeWith(level, data, at, last, pattern);
+        if (at == NPOS) break;
+
+        result->candidates++;
+        if (!PassesVerifiers(options.verifiers, options.verifierCount, data, size, at)) {
+            result->rejected++;
+            continue;
+        }
+
+        if (options.limit != 0 && result->matches.size() == options.limit) {
+            result->truncated = true;
+            break;
+        }
+        result->matches.push_back(at);
+    }
+}
+
+} // namespace HookLib
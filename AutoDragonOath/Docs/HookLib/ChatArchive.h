@@ -0,0 +1,756 @@
+// ChatArchive.h - Rotating, block-compressed chat archive
+//
+// ChatLog.h keeps one uncompressed file that grows for as long as the game
+// is played. The archive splits the chat into segment files and each
+// segment into independently compressed blocks:
+//
+//   segment   <prefix>-YYYYMMDD-HHMMSS-NN.hca (NN: segments begun in the
+//             same second), so the names sort in time order. Closed after
+//             segmentBytes or segmentSeconds, whichever comes first.
+//   header    "HCHA", uint16 version, uint16 0, int64 first record time,
+//             uint32 dictionary size, uint32 dictionary crc, dictionary
+//   block     uint32 compressed size, uint32 raw size, uint32 raw crc,
+//             int64 first time, LzBlock.h data
+//   index     per block: uint64 offset, int64 first time, int64 last time,
+//             uint32 records, uint32 raw size
+//   trailer   uint64 index offset, uint32 block count, uint32 index crc, "HCHI"
+//
+// A raw block is a run of records: zigzag varint time delta (microseconds,
+// from the previous record, the first from the block's first time),
+// uint8 channel, uint8 camp, varint + sender, varint + text (GBK).
+//
+// The hook only copies the event into a preallocated queue under a short
+// lock. The writer thread takes the queue every CHATARCHIVE_POLL_MS,
+// encodes, compresses and writes whole blocks; a block that is not full is
+// written anyway after flushMilliseconds, so a crash loses at most that
+// much. A segment cut off by a crash has no index; the reader then finds
+// the blocks by walking their headers.
+//
+// The optional dictionary (TrainChatDictionary, tools/ChatArchivePack) is
+// stored in every segment, so a segment can always be read on its own.
+//
+// Next to each finished segment the writer puts its sender and channel
+// index (ChatIndex.h, tools/ChatQuery).
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ChatIndex.h"
+#include "ChatLog.h"
+#include "LzBlock.h"
+#include "ThreadDone.h"
+
+namespace HookLib {
+
+static const char CHATARCHIVE_MAGIC[4] = { 'H', 'C', 'H', 'A' };
+static const char CHATARCHIVE_INDEX_MAGIC[4] = { 'H', 'C', 'H', 'I' };
+static const uint16_t CHATARCHIVE_VERSION = 1;
+static const size_t CHATARCHIVE_HEADER_BYTES = 24;                 // Before the dictionary
+static const size_t CHATARCHIVE_BLOCK_HEADER_BYTES = 20;
+static const size_t CHATARCHIVE_INDEX_ENTRY_BYTES = 32;
+static const size_t CHATARCHIVE_TRAILER_BYTES = 20;
+
+static const size_t CHATARCHIVE_BLOCK_BYTES = 64 * 1024;           // Raw records per block
+static const uint64_t CHATARCHIVE_SEGMENT_BYTES = 64ull * 1024 * 1024;
+static const unsigned CHATARCHIVE_SEGMENT_SECONDS = 24 * 60 * 60;
+static const unsigned CHATARCHIVE_FLUSH_MS = 2000;                 // Longest a record waits in a partial block
+static const unsigned CHATARCHIVE_POLL_MS = 250;
+static const size_t CHATARCHIVE_QUEUE_BYTES = 1024 * 1024;         // Events waiting for the writer
+static const size_t CHATARCHIVE_MAX_DICTIONARY = LZ_MAX_OFFSET;    // Reachable by a match
+
+// ============================================================================
+// RECORDS
+// ============================================================================
+
+inline uint64_t ZigZag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+inline int64_t UnZigZag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// Bytes EncodeChatRecord needs at most
+inline size_t ChatRecordBound(size_t senderLength, size_t textLength) {
+    return 10 + 2 + 10 + senderLength + 10 + textLength;
+}
+
+inline uint8_t* EncodeChatRecord(uint8_t* at, int64_t delta, uint8_t channel, uint8_t camp, const char* sender,
+                                 size_t senderLength, const char* text, size_t textLength) {
+    at = PutVarint(at, ZigZag(delta));
+    *at++ = channel;
+    *at++ = camp;
+    at = PutVarint(at, senderLength);
+    memcpy(at, sender, senderLength);
+    at += senderLength;
+    at = PutVarint(at, textLength);
+    memcpy(at, text, textLength);
+    return at + textLength;
+}
+
+// Walks the records of one decompressed block
+class ChatBlockCursor {
+public:
+    ChatBlockCursor() : at(nullptr), end(nullptr), time(0) {}
+
+    void Reset(const uint8_t* raw, size_t rawSize, int64_t firstTime) {
+        at = raw;
+        end = raw + rawSize;
+        time = firstTime;
+    }
+
+    // False at the end of the block (or at a record that does not parse)
+    bool Next(ChatEvent* event) {
+        uint64_t delta, senderLength, textLength;
+        const uint8_t* p = GetVarint(at, end, &delta);
+        if (p == nullptr || end - p < 2) return false;
+        event->channel = p[0];
+        event->camp = p[1];
+        p = GetVarint(p + 2, end, &senderLength);
+        if (p == nullptr || (uint64_t)(end - p) < senderLength) return false;
+        event->sender = (const char*)p;
+        event->senderLength = (size_t)senderLength;
+        p = GetVarint(p + senderLength, end, &textLength);
+        if (p == nullptr || (uint64_t)(end - p) < textLength) return false;
+        event->text = (const char*)p;
+        event->textLength = (size_t)textLength;
+        time += UnZigZag(delta);
+        event->time = time;
+        at = p + textLength;
+        return true;
+    }
+
+private:
+    const uint8_t* at;
+    const uint8_t* end;
+    int64_t time;
+};
+
+// ============================================================================
+// READING
+// ============================================================================
+
+struct ChatArchiveBlock {
+    uint64_t offset;            // Of the block header in the segment
+    int64_t firstTime;
+    int64_t lastTime;           // Without an index: the next block's first time
+    uint32_t records;           // Without an index: 0
+    uint32_t rawSize;
+};
+
+class ChatArchiveReader {
+public:
+    ChatArchiveReader() : data(nullptr), size(0), dictionary(nullptr), dictionarySize(0), indexed(false), startTime(0) {}
+
+    // `data` is a whole segment. Loads the index, or finds the blocks
+    // without it if the segment was never finished.
+    bool Open(const uint8_t* segment, size_t segmentSize) {
+        data = segment;
+        size = segmentSize;
+        blocks.clear();
+        indexed = false;
+        if (size < CHATARCHIVE_HEADER_BYTES || memcmp(data, CHATARCHIVE_MAGIC, sizeof(CHATARCHIVE_MAGIC)) != 0) {
+            return false;
+        }
+        uint16_t version;
+        uint32_t dictionaryCrc, dictionaryBytes;
+        memcpy(&version, data + 4, 2);
+        memcpy(&startTime, data + 8, 8);
+        memcpy(&dictionaryBytes, data + 16, 4);
+        memcpy(&dictionaryCrc, data + 20, 4);
+        if (version != CHATARCHIVE_VERSION || dictionaryBytes > size - CHATARCHIVE_HEADER_BYTES) {
+            return false;
+        }
+        dictionary = data + CHATARCHIVE_HEADER_BYTES;
+        dictionarySize = dictionaryBytes;
+        if (Crc32(dictionary, dictionarySize) != dictionaryCrc) {
+            return false;
+        }
+        if (!LoadIndex()) {
+            ScanBlocks(IndexOffset());
+        }
+        return true;
+    }
+
+    size_t BlockCount() const { return blocks.size(); }
+    const ChatArchiveBlock& Block(size_t index) const { return blocks[index]; }
+    bool Indexed() const { return indexed; }
+    int64_t StartTime() const { return startTime; }   // Time of the first record
+
+    // First block that may hold records at or after `time`
+    size_t FindBlock(int64_t time) const {
+        size_t lo = 0, hi = blocks.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (blocks[mid].lastTime < time) lo = mid + 1; else hi = mid;
+        }
+        return lo;
+    }
+
+    // Decompresses block `index` into *raw and checks its crc
+    bool ReadBlock(size_t index, std::vector<uint8_t>* raw) const {
+        const ChatArchiveBlock& block = blocks[index];
+        uint32_t compressedSize, rawSize, rawCrc;
+        memcpy(&compressedSize, data + block.offset, 4);
+        memcpy(&rawSize, data + block.offset + 4, 4);
+        memcpy(&rawCrc, data + block.offset + 8, 4);
+        if (rawSize > CHATARCHIVE_QUEUE_BYTES + ChatRecordBound(CHATLOG_MAX_FIELD, CHATLOG_MAX_FIELD)) {
+            return false;   // Larger than any block the writer makes
+        }
+        raw->resize(rawSize);
+        return LzDecompress(data + block.offset + CHATARCHIVE_BLOCK_HEADER_BYTES, compressedSize, dictionary,
+                            dictionarySize, raw->data(), rawSize) &&
+               Crc32(raw->data(), rawSize) == rawCrc;
+    }
+
+private:
+    bool LoadIndex() {
+        if (size < CHATARCHIVE_TRAILER_BYTES) return false;
+        const uint8_t* trailer = data + size - CHATARCHIVE_TRAILER_BYTES;
+        if (memcmp(trailer + 16, CHATARCHIVE_INDEX_MAGIC, sizeof(CHATARCHIVE_INDEX_MAGIC)) != 0) return false;
+        uint64_t indexOffset;
+        uint32_t count, indexCrc;
+        memcpy(&indexOffset, trailer, 8);
+        memcpy(&count, trailer + 8, 4);
+        memcpy(&indexCrc, trailer + 12, 4);
+        uint64_t indexBytes = (uint64_t)count * CHATARCHIVE_INDEX_ENTRY_BYTES;
+        if (indexOffset > size - CHATARCHIVE_TRAILER_BYTES || size - CHATARCHIVE_TRAILER_BYTES - indexOffset != indexBytes ||
+            Crc32(data + indexOffset, (size_t)indexBytes) != indexCrc) {
+            return false;
+        }
+        blocks.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            const uint8_t* entry = data + indexOffset + (uint64_t)i * CHATARCHIVE_INDEX_ENTRY_BYTES;
+            ChatArchiveBlock& block = blocks[i];
+            memcpy(&block.offset, entry, 8);
+            memcpy(&block.firstTime, entry + 8, 8);
+            memcpy(&block.lastTime, entry + 16, 8);
+            memcpy(&block.records, entry + 24, 4);
+            memcpy(&block.rawSize, entry + 28, 4);
+            if (!BlockFits(block.offset, indexOffset)) {
+                blocks.clear();
+                return false;
+            }
+        }
+        indexed = true;
+        return true;
+    }
+
+    // Where the blocks end: at the index if the trailer is there, even if
+    // the index itself is damaged, else at the end of the data
+    uint64_t IndexOffset() const {
+        if (size < CHATARCHIVE_TRAILER_BYTES) return size;
+        const uint8_t* trailer = data + size - CHATARCHIVE_TRAILER_BYTES;
+        if (memcmp(trailer + 16, CHATARCHIVE_INDEX_MAGIC, sizeof(CHATARCHIVE_INDEX_MAGIC)) != 0) return size;
+        uint64_t indexOffset;
+        memcpy(&indexOffset, trailer, 8);
+        return (indexOffset <= size - CHATARCHIVE_TRAILER_BYTES) ? indexOffset : size;
+    }
+
+    // Follows the block headers from the dictionary on, up to `limit`;
+    // stops at the first one that is cut off
+    void ScanBlocks(uint64_t limit) {
+        uint64_t at = CHATARCHIVE_HEADER_BYTES + dictionarySize;
+        while (at + CHATARCHIVE_BLOCK_HEADER_BYTES <= limit && BlockFits(at, limit)) {
+            ChatArchiveBlock block;
+            uint32_t compressedSize;
+            memcpy(&compressedSize, data + at, 4);
+            memcpy(&block.rawSize, data + at + 4, 4);
+            memcpy(&block.firstTime, data + at + 12, 8);
+            block.offset = at;
+            block.records = 0;
+            block.lastTime = INT64_MAX;
+            if (!blocks.empty()) blocks.back().lastTime = block.firstTime;
+            blocks.push_back(block);
+            at += CHATARCHIVE_BLOCK_HEADER_BYTES + compressedSize;
+        }
+    }
+
+    bool BlockFits(uint64_t offset, uint64_t limit) const {
+        if (offset + CHATARCHIVE_BLOCK_HEADER_BYTES > limit) return false;
+        uint32_t compressedSize;
+        memcpy(&compressedSize, data + offset, 4);
+        return compressedSize != 0 && offset + CHATARCHIVE_BLOCK_HEADER_BYTES + compressedSize <= limit;
+    }
+
+    const uint8_t* data;
+    size_t size;
+    const uint8_t* dictionary;
+    size_t dictionarySize;
+    bool indexed;
+    int64_t startTime;
+    std::vector<ChatArchiveBlock> blocks;
+};
+
+// ============================================================================
+// DICTIONARY
+// ============================================================================
+
+// Builds a dictionary of at most `capacity` bytes from sample raw records
+// (EncodeChatRecord output). Scores 32-byte pieces of the samples by how
+// often their 6-byte substrings occur, then takes the best pieces, each
+// substring counted once; the most useful end up last, closest to the
+// block and so at the shortest offsets.
+inline void TrainChatDictionary(const uint8_t* samples, size_t size, size_t capacity, std::vector<uint8_t>* out) {
+    static const size_t GRAM = 6;
+    static const size_t PIECE = 32;
+    static const unsigned TABLE_BITS = 20;
+    out->clear();
+    if (capacity > CHATARCHIVE_MAX_DICTIONARY) capacity = CHATARCHIVE_MAX_DICTIONARY;
+    if (size < PIECE) return;
+
+    auto gramHash = [samples](size_t at) {
+        uint64_t v = 0;
+        memcpy(&v, samples + at, GRAM);
+        return (uint32_t)((v * 0x9E3779B97F4A7C15ull) >> (64 - TABLE_BITS));
+    };
+    std::vector<uint32_t> counts((size_t)1 << TABLE_BITS, 0);
+    for (size_t i = 0; i + GRAM <= size; i++) counts[gramHash(i)]++;
+
+    auto score = [&](size_t piece) {
+        uint64_t total = 0;
+        for (size_t i = piece; i + GRAM <= piece + PIECE; i++) total += counts[gramHash(i)];
+        return total;
+    };
+
+    // Lazy greedy: a popped piece is rescored; it is taken only if it still
+    // beats the next one's (stale, so optimistic) score
+    typedef std::pair<uint64_t, size_t> Scored;
+    std::priority_queue<Scored> heap;
+    for (size_t piece = 0; piece + PIECE <= size; piece += PIECE / 2) heap.push(Scored(score(piece), piece));
+
+    std::vector<size_t> chosen;
+    while (!heap.empty() && chosen.size() * PIECE + PIECE <= capacity) {
+        Scored top = heap.top();
+        heap.pop();
+        uint64_t current = score(top.second);
+        if (current <= 1) break;
+        if (!heap.empty() && current < heap.top().first) {
+            heap.push(Scored(current, top.second));
+            continue;
+        }
+        chosen.push_back(top.second);
+        for (size_t i = top.second; i + GRAM <= top.second + PIECE; i++) counts[gramHash(i)] = 0;
+    }
+    for (size_t i = chosen.size(); i-- > 0;) {
+        out->insert(out->end(), samples + chosen[i], samples + chosen[i] + PIECE);
+    }
+}
+
+// Reads a dictionary file written by tools/ChatArchivePack. False if there
+// is none; the archive then works without one.
+inline bool LoadChatDictionary(const char* path, std::vector<uint8_t>* dictionary) {
+    dictionary->clear();
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    dictionary->resize(CHATARCHIVE_MAX_DICTIONARY);
+    size_t read = fread(dictionary->data(), 1, dictionary->size(), file);
+    fclose(file);
+    dictionary->resize(read);
+    return read != 0;
+}
+
+// ============================================================================
+// WRITING
+// ============================================================================
+
+struct ChatArchiveOptions {
+    std::string pathPrefix;             // Segments are "<pathPrefix>-YYYYMMDD-HHMMSS-NN.hca"
+    uint64_t segmentBytes;
+    unsigned segmentSeconds;
+    size_t blockBytes;
+    unsigned flushMilliseconds;
+    std::vector<uint8_t> dictionary;    // Empty: none
+    bool writeIndex;                    // A ChatIndex.h file next to each finished segment
+
+    ChatArchiveOptions()
+        : segmentBytes(CHATARCHIVE_SEGMENT_BYTES), segmentSeconds(CHATARCHIVE_SEGMENT_SECONDS),
+          blockBytes(CHATARCHIVE_BLOCK_BYTES), flushMilliseconds(CHATARCHIVE_FLUSH_MS), writeIndex(true) {}
+};
+
+class ChatArchiveWriter {
+public:
+    ChatArchiveWriter() : running(false), dropped(0), stopping(false), consumer(false),
+                          segment(nullptr), segmentSize(0), segmentOpened(0), blockFirst(0), blockLast(0),
+                          blockRecords(0), blockStarted(0), segmentsWritten(0) {}
+
+    ~ChatArchiveWriter() { Close(); }
+
+    // Starts the writer thread. The first segment is created with the
+    // first block.
+    bool Open(const ChatArchiveOptions& archiveOptions) {
+        Close();
+        options = archiveOptions;
+        if (options.dictionary.size() > CHATARCHIVE_MAX_DICTIONARY) {
+            options.dictionary.erase(options.dictionary.begin(),
+                                     options.dictionary.end() - CHATARCHIVE_MAX_DICTIONARY);
+        }
+        if (options.blockBytes == 0 || options.blockBytes > CHATARCHIVE_QUEUE_BYTES) {
+            options.blockBytes = CHATARCHIVE_BLOCK_BYTES;
+        }
+        pending.clear();
+        pending.reserve(CHATARCHIVE_QUEUE_BYTES);
+        taken.clear();
+        taken.reserve(CHATARCHIVE_QUEUE_BYTES);
+        raw.clear();
+        raw.reserve(options.blockBytes + ChatRecordBound(CHATLOG_MAX_FIELD, CHATLOG_MAX_FIELD));
+        dropped.store(0, std::memory_order_relaxed);
+        stopping.store(false, std::memory_order_relaxed);
+        wakeRequested = false;
+        consumer.store(false, std::memory_order_relaxed);
+        segmentsWritten = 0;
+        senderIndex.DiscardBlock();
+        senderIndex.Clear();
+
+        running = true;
+        writer.Start([this]() { WriterLoop(); });
+        return true;
+    }
+
+    bool IsOpen() const { return running; }
+
+    // Called from the hook: copies the event into the queue. Never does
+    // I/O or compression. False if the queue is full (the writer is stuck).
+    bool Append(uint8_t channel, uint8_t camp, const char* sender, size_t senderLength, const char* text,
+                size_t textLength) {
+        return AppendAt(ChatLogWallMicroseconds(), channel, camp, sender, senderLength, text, textLength);
+    }
+
+    // Same with a given time (microseconds since the epoch), for converting
+    // recorded chat (tools/ChatArchivePack)
+    bool AppendAt(int64_t time, uint8_t channel, uint8_t camp, const char* sender, size_t senderLength,
+                  const char* text, size_t textLength) {
+        if (!running) {
+            return false;
+        }
+        if (senderLength > CHATLOG_MAX_FIELD) senderLength = CHATLOG_MAX_FIELD;
+        if (textLength > CHATLOG_MAX_FIELD) textLength = CHATLOG_MAX_FIELD;
+        size_t need = QUEUE_ENTRY_BYTES + senderLength + textLength;
+
+        bool wakeWriter;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            size_t at = pending.size();
+            if (at + need > CHATARCHIVE_QUEUE_BYTES) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            pending.resize(at + need);   // Within the reserved capacity: no allocation
+            uint8_t* entry = &pending[at];
+            uint16_t lengths[2] = { (uint16_t)senderLength, (uint16_t)textLength };
+            memcpy(entry, &time, 8);
+            entry[8] = channel;
+            entry[9] = camp;
+            memcpy(entry + 10, lengths, 4);
+            memcpy(entry + QUEUE_ENTRY_BYTES, sender, senderLength);
+            memcpy(entry + QUEUE_ENTRY_BYTES + senderLength, text, textLength);
+            wakeWriter = pending.size() >= options.blockBytes && at < options.blockBytes;
+        }
+        if (wakeWriter) {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            wakeRequested = true;
+            wake.notify_one();
+        }
+        return true;
+    }
+
+    // Events lost because the queue was full
+    uint64_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+
+    // Writes out the queue and the last block, finishes the segment (index
+    // and trailer) and stops the writer. From DLL_PROCESS_DETACH pass
+    // processExiting = (lpReserved != NULL), as described in ThreadDone.h.
+    //
+    // On FreeLibrary Close waits for the writer to finish the block it is
+    // on and return, then finishes the segment itself. At process exit
+    // nothing is waited for and no lock is taken that a killed thread could
+    // hold: what can be reached is written as a last block and the segment
+    // is closed without its index. The reader walks its block headers, and
+    // tools/ChatQuery --build makes its sender index.
+    void Close(bool processExiting = false) {
+        if (!running) {
+            return;
+        }
+        if (processExiting) {
+            stopping.store(true, std::memory_order_release);
+        } else {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopping.store(true, std::memory_order_release);
+            wake.notify_one();
+        }
+        writer.Stop(processExiting);
+
+        if (!consumer.exchange(true, std::memory_order_acquire)) {
+            if (processExiting) {
+                SaveAtExit();
+            } else {
+                Process(true);
+            }
+        }
+        running = false;
+    }
+
+    // Segments finished so far (writer side; for tests and tools)
+    unsigned SegmentsWritten() const { return segmentsWritten; }
+
+private:
+    ChatArchiveWriter(const ChatArchiveWriter&);
+    ChatArchiveWriter& operator=(const ChatArchiveWriter&);
+
+    // int64 time, uint8 channel, uint8 camp, uint16 sender length, uint16 text length
+    static const size_t QUEUE_ENTRY_BYTES = 14;
+
+    struct IndexEntry {
+        uint64_t offset;
+        int64_t firstTime;
+        int64_t lastTime;
+        uint32_t records;
+        uint32_t rawSize;
+    };
+
+    void WriterLoop() {
+        while (!stopping.load(std::memory_order_acquire)) {
+            if (!consumer.exchange(true, std::memory_order_acquire)) {
+                Process(false);
+                consumer.store(false, std::memory_order_release);
+            }
+            // The flag keeps a wake-up sent while Process ran from being lost
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait_for(lock, std::chrono::milliseconds(CHATARCHIVE_POLL_MS), [this] {
+                return wakeRequested || stopping.load(std::memory_order_acquire);
+            });
+            wakeRequested = false;
+        }
+    }
+
+    // Consumer side: takes the queue, fills blocks, writes the full ones and
+    // any older than flushMilliseconds. `final` writes everything and
+    // finishes the segment.
+    void Process(bool final) {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            taken.swap(pending);
+        }
+        AddTaken();
+
+        int64_t now = ChatLogMonotonicMicroseconds();
+        if (blockRecords != 0 && (final || now - blockStarted >= (int64_t)options.flushMilliseconds * 1000)) {
+            WriteBlock();
+        }
+        // By record time, not the clock: AppendAt may be converting old chat
+        if (segment != nullptr && (final || SegmentExpired(blockLast))) {
+            FinishSegment();
+        }
+    }
+
+    // Consumer side, at process exit: the queue only if no hook thread died
+    // holding its lock, then the last block. The segment keeps no index.
+    void SaveAtExit() {
+        if (queueMutex.try_lock()) {
+            taken.swap(pending);
+            queueMutex.unlock();
+            AddTaken();
+        }
+        if (blockRecords != 0) {
+            WriteBlock();
+        }
+        if (segment != nullptr) {
+            fclose(segment);
+            segment = nullptr;
+        }
+    }
+
+    void AddTaken() {
+        for (size_t at = 0; at + QUEUE_ENTRY_BYTES <= taken.size();) {
+            const uint8_t* entry = &taken[at];
+            int64_t time;
+            uint16_t lengths[2];
+            memcpy(&time, entry, 8);
+            memcpy(lengths, entry + 10, 4);
+            const char* sender = (const char*)entry + QUEUE_ENTRY_BYTES;
+            AddRecord(time, entry[8], entry[9], sender, lengths[0], sender + lengths[0], lengths[1]);
+            at += QUEUE_ENTRY_BYTES + lengths[0] + lengths[1];
+        }
+        taken.clear();
+    }
+
+    void AddRecord(int64_t time, uint8_t channel, uint8_t camp, const char* sender, size_t senderLength,
+                   const char* text, size_t textLength) {
+        if (blockRecords == 0) {
+            blockFirst = blockLast = time;
+            blockStarted = ChatLogMonotonicMicroseconds();
+        }
+        size_t at = raw.size();
+        raw.resize(at + ChatRecordBound(senderLength, textLength));
+        uint8_t* end = EncodeChatRecord(&raw[at], time - blockLast, channel, camp, sender, senderLength, text,
+                                        textLength);
+        raw.resize((size_t)(end - raw.data()));
+        if (options.writeIndex) senderIndex.AddRecord(time, channel, sender, senderLength);
+        blockLast = time;
+        blockRecords++;
+        if (raw.size() >= options.blockBytes) {
+            WriteBlock();
+        }
+    }
+
+    bool SegmentExpired(int64_t time) const {
+        return time - segmentOpened >= (int64_t)options.segmentSeconds * 1000000;
+    }
+
+    void WriteBlock() {
+        if (segment != nullptr && SegmentExpired(blockFirst)) {
+            FinishSegment();
+        }
+        if (segment == nullptr && !OpenSegment()) {
+            senderIndex.DiscardBlock();
+            ResetBlock();   // Cannot write: the block is lost, the next one tries again
+            return;
+        }
+        compressed.resize(LzBound(raw.size()));
+        size_t compressedSize = LzCompress(raw.data(), raw.size(), options.dictionary.data(),
+                                           options.dictionary.size(), compressed.data(), &lz);
+
+        uint8_t header[CHATARCHIVE_BLOCK_HEADER_BYTES];
+        PutLe32(header, (uint32_t)compressedSize);
+        PutLe32(header + 4, (uint32_t)raw.size());
+        PutLe32(header + 8, Crc32(raw.data(), raw.size()));
+        PutLe64(header + 12, (uint64_t)blockFirst);
+        fwrite(header, 1, sizeof(header), segment);
+        fwrite(compressed.data(), 1, compressedSize, segment);
+        fflush(segment);
+
+        IndexEntry entry = { segmentSize, blockFirst, blockLast, blockRecords, (uint32_t)raw.size() };
+        index.push_back(entry);
+        if (options.writeIndex) senderIndex.EndBlock();
+        segmentSize += sizeof(header) + compressedSize;
+        ResetBlock();
+
+        if (segmentSize >= options.segmentBytes) {
+            FinishSegment();
+        }
+    }
+
+    void ResetBlock() {
+        raw.clear();
+        blockRecords = 0;
+    }
+
+    bool OpenSegment() {
+        time_t second = (time_t)(blockFirst / 1000000);
+        struct tm local;
+#ifdef _WIN32
+        localtime_s(&local, &second);
+#else
+        localtime_r(&second, &local);
+#endif
+        char stamp[80];
+        snprintf(stamp, sizeof(stamp), "-%04d%02d%02d-%02d%02d%02d", local.tm_year + 1900, local.tm_mon + 1,
+                 local.tm_mday, local.tm_hour, local.tm_min, local.tm_sec);
+
+        // Never overwrite: a second segment in the same second gets the next number
+        std::string path;
+        for (unsigned attempt = 0; attempt < 100; attempt++) {
+            char number[8];
+            snprintf(number, sizeof(number), "-%02u.hca", attempt);
+            path = options.pathPrefix + stamp + number;
+            FILE* existing = fopen(path.c_str(), "rb");
+            if (existing == nullptr) break;
+            fclose(existing);
+        }
+        segment = fopen(path.c_str(), "wb");
+        if (segment == nullptr) {
+            return false;
+        }
+        segmentPath = path;
+
+        uint8_t header[CHATARCHIVE_HEADER_BYTES] = {};
+        memcpy(header, CHATARCHIVE_MAGIC, sizeof(CHATARCHIVE_MAGIC));
+        uint16_t version = CHATARCHIVE_VERSION;
+        memcpy(header + 4, &version, 2);
+        segmentOpened = blockFirst;
+        PutLe64(header + 8, (uint64_t)segmentOpened);
+        PutLe32(header + 16, (uint32_t)options.dictionary.size());
+        PutLe32(header + 20, Crc32(options.dictionary.data(), options.dictionary.size()));
+        fwrite(header, 1, sizeof(header), segment);
+        if (!options.dictionary.empty()) fwrite(options.dictionary.data(), 1, options.dictionary.size(), segment);
+        segmentSize = sizeof(header) + options.dictionary.size();
+        index.clear();
+        return true;
+    }
+
+    void FinishSegment() {
+        std::vector<uint8_t> table(index.size() * CHATARCHIVE_INDEX_ENTRY_BYTES);
+        for (size_t i = 0; i < index.size(); i++) {
+            uint8_t* entry = &table[i * CHATARCHIVE_INDEX_ENTRY_BYTES];
+            PutLe64(entry, index[i].offset);
+            PutLe64(entry + 8, (uint64_t)index[i].firstTime);
+            PutLe64(entry + 16, (uint64_t)index[i].lastTime);
+            PutLe32(entry + 24, index[i].records);
+            PutLe32(entry + 28, index[i].rawSize);
+        }
+        uint8_t trailer[CHATARCHIVE_TRAILER_BYTES];
+        PutLe64(trailer, segmentSize);
+        PutLe32(trailer + 8, (uint32_t)index.size());
+        PutLe32(trailer + 12, Crc32(table.data(), table.size()));
+        memcpy(trailer + 16, CHATARCHIVE_INDEX_MAGIC, sizeof(CHATARCHIVE_INDEX_MAGIC));
+        fwrite(table.data(), 1, table.size(), segment);
+        fwrite(trailer, 1, sizeof(trailer), segment);
+        fclose(segment);
+        segment = nullptr;
+        if (options.writeIndex) {
+            senderIndex.Write(ChatIndexPath(segmentPath).c_str(), segmentSize + table.size() + sizeof(trailer));
+            senderIndex.Clear();   // Keeps the block being filled, if any: it opens the next segment
+        }
+        index.clear();
+        segmentsWritten++;
+    }
+
+    ChatArchiveOptions options;
+    bool running;
+
+    // Shared with the hook
+    std::mutex queueMutex;
+    std::vector<uint8_t> pending;           // Queue entries, capacity CHATARCHIVE_QUEUE_BYTES
+    std::atomic<uint64_t> dropped;
+    std::atomic<bool> stopping;
+    std::atomic<bool> consumer;             // Held by whoever processes: the writer, or Close
+    BackgroundThread writer;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool wakeRequested;                     // Under wakeMutex
+
+    // Consumer only
+    std::vector<uint8_t> taken;
+    std::vector<uint8_t> raw;               // The block being filled
+    std::vector<uint8_t> compressed;
+    LzWork lz;
+    FILE* segment;
+    std::string segmentPath;
+    uint64_t segmentSize;
+    int64_t segmentOpened;                  // Time of its first record
+    std::vector<IndexEntry> index;
+    ChatIndexBuilder senderIndex;           // Senders and channels of the segment's blocks
+    int64_t blockFirst;
+    int64_t blockLast;
+    uint32_t blockRecords;
+    int64_t blockStarted;                   // Monotonic
+    unsigned segmentsWritten;
+};
+
+} // namespace HookLib
@@ -0,0 +1,262 @@
+// ChatCommands.h - Chat command table with a compile-time perfect hash
+//
+// The chat dispatcher used to be an if / else chain of strcmp / strncmp /
+// strstr, so every message paid for all the comparisons before the last
+// one, and each new command slowed down the ones after it. Now commands
+// are a table, { "!verb", handler, argument parser }, turned at compile
+// time into a perfect hash over the first token of the message:
+//
+//   1. The 64-bit FNV-1a hash of the token picks a bucket.
+//   2. The bucket's displacement, found at compile time, mixes the hash
+//      into a slot that no other command uses.
+//   3. One length check and one memcmp against the command in that slot.
+//
+// That is the whole lookup, however many commands there are. Buckets are
+// placed largest first with the smallest displacement that lands each of
+// their names in free slots (hash and displace), with twice as many slots
+// as commands. Two commands with the same name stop the build.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ChatPacket.h"
+
+namespace HookLib {
+
+static const size_t CHAT_COMMAND_MAX_ARGS = 8;
+
+// One command as its handler sees it
+struct ChatCommandCall {
+    const char* sender;
+    const char* message;                        // The whole message
+    int channel;
+    size_t argCount;
+    const char* args[CHAT_COMMAND_MAX_ARGS];    // NUL-terminated, in `buffer`
+    char buffer[CHAT_TEXT_CAPACITY];
+};
+
+// Fills call->args from the text after the command token (leading spaces
+// skipped). False: the arguments are wrong, the handler is not called.
+typedef bool (*ChatArgParser)(const char* text, ChatCommandCall* call);
+typedef void (*ChatCommandHandler)(const ChatCommandCall& call);
+
+struct ChatCommand {
+    const char* name;           // The token, e.g. "!follow"
+    ChatCommandHandler handler;
+    ChatArgParser parse;
+    const char* usage;          // For a reply when parse fails; may be nullptr
+};
+
+enum ChatCommandResult {
+    CHAT_COMMAND_NONE,          // The first token is no command
+    CHAT_COMMAND_RAN,
+    CHAT_COMMAND_BAD_ARGS,      // A command, but its parser refused the arguments
+};
+
+// ============================================================================
+// ARGUMENT PARSERS
+// ============================================================================
+
+// Ignores whatever follows the command
+inline bool ChatNoArgs(const char* text, ChatCommandCall* call) {
+    (void)text;
+    call->argCount = 0;
+    return true;
+}
+
+// The rest of the line as one argument, or none if it is empty
+inline bool ChatRestOfLine(const char* text, ChatCommandCall* call) {
+    size_t length = strlen(text);
+    if (length > sizeof(call->buffer) - 1) length = sizeof(call->buffer) - 1;
+    memcpy(call->buffer, text, length);
+    call->buffer[length] = '\0';
+    call->args[0] = call->buffer;
+    call->argCount = length != 0 ? 1 : 0;
+    return true;
+}
+
+// Space-separated words, between MinWords and MaxWords of them
+template <size_t MinWords, size_t MaxWords>
+bool ChatWords(const char* text, ChatCommandCall* call) {
+    static_assert(MinWords <= MaxWords && MaxWords <= CHAT_COMMAND_MAX_ARGS, "too many words");
+    size_t length = strlen(text);
+    if (length > sizeof(call->buffer) - 1) length = sizeof(call->buffer) - 1;
+    memcpy(call->buffer, text, length);
+    call->buffer[length] = '\0';
+
+    call->argCount = 0;
+    char* at = call->buffer;
+    for (;;) {
+        while (*at == ' ') at++;
+        if (*at == '\0') break;
+        if (call->argCount == MaxWords) return false;
+        call->args[call->argCount++] = at;
+        while (*at != ' ' && *at != '\0') at++;
+        if (*at == ' ') *at++ = '\0';
+    }
+    return call->argCount >= MinWords;
+}
+
+// ============================================================================
+// PERFECT HASH
+// ============================================================================
+
+constexpr uint64_t ChatCommandHash(const char* token, size_t length) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)token[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+// The slot of a hash under a displacement (high bits; the bucket uses the low ones)
+constexpr uint64_t ChatCommandMix(uint64_t hash, uint32_t displacement) {
+    uint64_t x = hash ^ ((uint64_t)displacement * 0x9E3779B97F4A7C15ull);
+    x ^= x >> 29;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 32;
+    return x;
+}
+
+constexpr size_t ChatCommandLength(const char* name) {
+    size_t length = 0;
+    while (name[length] != '\0') length++;
+    return length;
+}
+
+constexpr size_t ChatCommandPowerOfTwo(size_t atLeast) {
+    size_t size = 1;
+    while (size < atLeast) size <<= 1;
+    return size;
+}
+
+// Not constexpr: reaching either in a constant expression stops the build
+inline void ChatCommandTableHasDuplicates() {}      // Two commands with the same name
+inline void ChatCommandTableCannotPlace() {}        // No displacement fits a bucket (not seen in practice)
+
+template <size_t N>
+class ChatCommandTable {
+public:
+    static const size_t BUCKETS = ChatCommandPowerOfTwo(N);
+    static const size_t SLOTS = ChatCommandPowerOfTwo(2 * N);
+
+    constexpr explicit ChatCommandTable(const ChatCommand (&list)[N])
+        : commands(), lengths(), displacements(), slots(), maxLength(0) {
+        uint64_t hashes[N] = {};
+        size_t bucketSize[BUCKETS] = {};
+        for (size_t i = 0; i < N; i++) {
+            commands[i] = list[i];
+            lengths[i] = ChatCommandLength(list[i].name);
+            if (lengths[i] > maxLength) maxLength = lengths[i];
+            hashes[i] = ChatCommandHash(list[i].name, lengths[i]);
+            bucketSize[hashes[i] & (BUCKETS - 1)]++;
+        }
+
+        // Equal names have equal hashes, which no displacement separates:
+        // caught here, before placement would try every displacement
+        for (size_t i = 0; i < N; i++) {
+            for (size_t j = i + 1; j < N; j++) {
+                if (hashes[i] == hashes[j]) ChatCommandTableHasDuplicates();
+            }
+        }
+
+        // Largest buckets first, while most slots are still free
+        bool placed[BUCKETS] = {};
+        for (size_t round = 0; round < BUCKETS; round++) {
+            size_t bucket = 0;
+            size_t largest = 0;
+            for (size_t b = 0; b < BUCKETS; b++) {
+                if (!placed[b] && (largest == 0 || bucketSize[b] > bucketSize[bucket])) {
+                    bucket = b;
+                    largest = 1;
+                }
+            }
+            placed[bucket] = true;
+            if (bucketSize[bucket] != 0) PlaceBucket(bucket, hashes);
+        }
+    }
+
+    // The command whose name is `token`, or nullptr
+    const ChatCommand* Find(const char* token, size_t length) const {
+        if (length == 0 || length > maxLength) {
+            return nullptr;
+        }
+        uint64_t hash = ChatCommandHash(token, length);
+        uint16_t slot = slots[ChatCommandMix(hash, displacements[hash & (BUCKETS - 1)]) & (SLOTS - 1)];
+        if (slot == 0 || lengths[slot - 1] != length || memcmp(commands[slot - 1].name, token, length) != 0) {
+            return nullptr;
+        }
+        return &commands[slot - 1];
+    }
+
+    // Splits off the first token of `message`, looks it up, parses the
+    // arguments and calls the handler. *command is the command found, if
+    // any (for its usage line).
+    ChatCommandResult Dispatch(const char* sender, const char* message, int channel,
+                               const ChatCommand** command = nullptr) const {
+        size_t length = 0;
+        while (length <= maxLength && message[length] != ' ' && message[length] != '\0') length++;
+        const ChatCommand* found = Find(message, length);
+        if (command != nullptr) *command = found;
+        if (found == nullptr) {
+            return CHAT_COMMAND_NONE;
+        }
+
+        ChatCommandCall call;
+        call.sender = sender;
+        call.message = message;
+        call.channel = channel;
+        call.argCount = 0;
+        const char* text = message + length;
+        while (*text == ' ') text++;
+        if (found->parse != nullptr && !found->parse(text, &call)) {
+            return CHAT_COMMAND_BAD_ARGS;
+        }
+        found->handler(call);
+        return CHAT_COMMAND_RAN;
+    }
+
+    constexpr size_t Count() const { return N; }
+    constexpr const ChatCommand& Command(size_t i) const { return commands[i]; }
+
+private:
+    constexpr void PlaceBucket(size_t bucket, const uint64_t (&hashes)[N]) {
+        for (uint32_t displacement = 0; displacement < 0x10000; displacement++) {
+            size_t taken[N] = {};
+            size_t count = 0;
+            bool fits = true;
+            for (size_t i = 0; i < N && fits; i++) {
+                if ((hashes[i] & (BUCKETS - 1)) != bucket) continue;
+                size_t slot = ChatCommandMix(hashes[i], displacement) & (SLOTS - 1);
+                fits = slots[slot] == 0;
+                for (size_t k = 0; k < count && fits; k++) fits = taken[k] != slot;
+                if (fits) taken[count++] = slot;
+            }
+            if (!fits) continue;
+            displacements[bucket] = (uint16_t)displacement;
+            count = 0;
+            for (size_t i = 0; i < N; i++) {
+                if ((hashes[i] & (BUCKETS - 1)) == bucket) slots[taken[count++]] = (uint16_t)(i + 1);
+            }
+            return;
+        }
+        ChatCommandTableCannotPlace();
+    }
+
+    ChatCommand commands[N];
+    size_t lengths[N];
+    uint16_t displacements[BUCKETS];
+    uint16_t slots[SLOTS];              // Command index + 1; 0 is free
+    size_t maxLength;
+};
+
+// constexpr auto table = MakeChatCommandTable(list); deduces N
+template <size_t N>
+constexpr ChatCommandTable<N> MakeChatCommandTable(const ChatCommand (&list)[N]) {
+    return ChatCommandTable<N>(list);
+}
+
+} // namespace HookLib
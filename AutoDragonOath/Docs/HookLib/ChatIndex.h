@@ -0,0 +1,339 @@
+// ChatIndex.h - Sender and channel index for chat archive segments
+//
+// Finding what one player said means decompressing every block of every
+// segment. Next to each segment ChatArchiveWriter writes an index file
+// (ChatIndexPath: same name, .hcx) saying which blocks hold which senders
+// and channels, so a query decompresses only those:
+//
+//   header    "HCHX", uint16 version, uint16 0, uint32 block count,
+//             uint32 channel count, uint32 sender count, uint32 slot count,
+//             uint64 segment size, int64 first time, int64 last time
+//   channels  per channel present: uint32 channel, bitmap of its blocks
+//             ((block count + 7) / 8 bytes, bit b of byte b / 8: block b)
+//   slots     open-addressed table (slot count a power of two) of
+//             uint32 FNV-1a hash of the sender, uint32 offset of its entry
+//             (0: empty slot)
+//   entries   varint + sender (GBK), varint block count, varint block
+//             numbers as ascending deltas
+//   trailer   uint32 crc of everything before it
+//
+// Block numbers are positions in the segment's own block index
+// (ChatArchiveReader). The segment size in the header ties an index file to
+// the segment it was built from; a segment that was cut short by a crash
+// has none and is indexed again by tools/ChatQuery --build.
+//
+// The builder runs on the archive's writer thread, not in the hook.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ChatLog.h"
+
+namespace HookLib {
+
+static const char CHATINDEX_MAGIC[4] = { 'H', 'C', 'H', 'X' };
+static const uint16_t CHATINDEX_VERSION = 1;
+static const size_t CHATINDEX_HEADER_BYTES = 48;
+static const size_t CHATINDEX_SLOT_BYTES = 8;
+static const uint32_t CHATINDEX_PENDING_BLOCK = 0xFFFFFFFFu;   // Builder: posting for the block being filled
+
+inline uint32_t ChatSenderHash(const char* sender, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) hash = (hash ^ (uint8_t)sender[i]) * 16777619u;
+    return hash;
+}
+
+// "DragonOath_Chat-20240501-211403-00.hca" -> "DragonOath_Chat-20240501-211403-00.hcx"
+inline std::string ChatIndexPath(const std::string& segmentPath) {
+    std::string path = segmentPath;
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) path.erase(dot);
+    return path + ".hcx";
+}
+
+// ============================================================================
+// BUILDING
+// ============================================================================
+
+class ChatIndexBuilder {
+public:
+    ChatIndexBuilder() : blocks(0), firstTime(0), lastTime(0), blockRecords(0), blockFirst(0), blockLast(0) {
+        memset(blockChannels, 0, sizeof(blockChannels));
+    }
+
+    // A new segment starts. Forgets the blocks ended so far; the block being
+    // filled carries over, it goes into the new segment.
+    void Clear() {
+        std::vector<std::string> carried;
+        for (size_t i = 0; i < blockSenders.size(); i++) carried.push_back(blockSenders[i]->first);
+        senders.clear();
+        blockSenders.clear();
+        for (size_t i = 0; i < carried.size(); i++) {
+            Postings pending(1, CHATINDEX_PENDING_BLOCK);
+            blockSenders.push_back(&*senders.insert(SenderMap::value_type(carried[i], pending)).first);
+        }
+        for (int c = 0; c < 256; c++) channels[c].clear();
+        blocks = 0;
+    }
+
+    // A record of the block being filled
+    void AddRecord(int64_t time, uint8_t channel, const char* sender, size_t senderLength) {
+        if (blockRecords++ == 0) blockFirst = time;
+        blockLast = time;
+        blockChannels[channel >> 6] |= 1ull << (channel & 63);
+        auto& entry = *senders.insert(SenderMap::value_type(std::string(sender, senderLength), Postings())).first;
+        if (entry.second.empty() || entry.second.back() != CHATINDEX_PENDING_BLOCK) {
+            entry.second.push_back(CHATINDEX_PENDING_BLOCK);
+            blockSenders.push_back(&entry);
+        }
+    }
+
+    // The block went into the segment as its next block
+    void EndBlock() {
+        for (size_t i = 0; i < blockSenders.size(); i++) blockSenders[i]->second.back() = blocks;
+        for (int c = 0; c < 256; c++) {
+            if (blockChannels[c >> 6] & (1ull << (c & 63))) {
+                channels[c].resize((blocks >> 3) + 1, 0);
+                channels[c][blocks >> 3] |= (uint8_t)(1 << (blocks & 7));
+            }
+        }
+        if (blocks == 0) firstTime = blockFirst;
+        lastTime = blockLast;
+        blocks++;
+        blockSenders.clear();
+        memset(blockChannels, 0, sizeof(blockChannels));
+        blockRecords = 0;
+    }
+
+    // The block was not written: its records are taken out again
+    void DiscardBlock() {
+        for (size_t i = 0; i < blockSenders.size(); i++) blockSenders[i]->second.pop_back();
+        blockSenders.clear();
+        memset(blockChannels, 0, sizeof(blockChannels));
+        blockRecords = 0;
+    }
+
+    uint32_t BlockCount() const { return blocks; }
+
+    // Encodes the index of the blocks ended so far; `segmentSize` is the
+    // size of the finished segment file
+    void Encode(uint64_t segmentSize, std::vector<uint8_t>* out) const {
+        size_t bitmapBytes = (blocks + 7) / 8;
+        uint32_t channelCount = 0;
+        for (int c = 0; c < 256; c++) channelCount += !channels[c].empty();
+        uint32_t senderCount = 0;
+        for (auto it = senders.begin(); it != senders.end(); ++it) senderCount += CommittedCount(it->second) != 0;
+        uint32_t slotCount = 16;
+        while (slotCount < senderCount * 2) slotCount <<= 1;
+
+        size_t slots = CHATINDEX_HEADER_BYTES + channelCount * (4 + bitmapBytes);
+        out->assign(slots + (size_t)slotCount * CHATINDEX_SLOT_BYTES, 0);
+        uint8_t* header = out->data();
+        memcpy(header, CHATINDEX_MAGIC, sizeof(CHATINDEX_MAGIC));
+        uint16_t version = CHATINDEX_VERSION;
+        memcpy(header + 4, &version, 2);
+        PutLe32(header + 8, blocks);
+        PutLe32(header + 12, channelCount);
+        PutLe32(header + 16, senderCount);
+        PutLe32(header + 20, slotCount);
+        PutLe64(header + 24, segmentSize);
+        PutLe64(header + 32, (uint64_t)firstTime);
+        PutLe64(header + 40, (uint64_t)lastTime);
+
+        size_t at = CHATINDEX_HEADER_BYTES;
+        for (int c = 0; c < 256; c++) {
+            if (channels[c].empty()) continue;
+            PutLe32(&(*out)[at], (uint32_t)c);
+            memcpy(&(*out)[at + 4], channels[c].data(), channels[c].size());   // Shorter: the rest stays 0
+            at += 4 + bitmapBytes;
+        }
+
+        uint8_t varint[10];
+        for (auto it = senders.begin(); it != senders.end(); ++it) {
+            const Postings& postings = it->second;
+            size_t count = CommittedCount(postings);
+            if (count == 0) continue;
+            uint32_t hash = ChatSenderHash(it->first.data(), it->first.size());
+            uint32_t slot = hash & (slotCount - 1);
+            uint32_t used;
+            while (memcpy(&used, &(*out)[slots + slot * CHATINDEX_SLOT_BYTES + 4], 4), used != 0) {
+                slot = (slot + 1) & (slotCount - 1);
+            }
+            PutLe32(&(*out)[slots + slot * CHATINDEX_SLOT_BYTES], hash);
+            PutLe32(&(*out)[slots + slot * CHATINDEX_SLOT_BYTES + 4], (uint32_t)out->size());
+
+            out->insert(out->end(), varint, PutVarint(varint, it->first.size()));
+            out->insert(out->end(), it->first.begin(), it->first.end());
+            out->insert(out->end(), varint, PutVarint(varint, count));
+            uint32_t last = 0;
+            for (size_t i = 0; i < count; i++) {
+                out->insert(out->end(), varint, PutVarint(varint, postings[i] - last));
+                last = postings[i];
+            }
+        }
+
+        uint8_t crc[4];
+        PutLe32(crc, Crc32(out->data(), out->size()));
+        out->insert(out->end(), crc, crc + 4);
+    }
+
+    // Encodes the index and writes it to `path`
+    bool Write(const char* path, uint64_t segmentSize) const {
+        std::vector<uint8_t> bytes;
+        Encode(segmentSize, &bytes);
+        FILE* file = fopen(path, "wb");
+        if (file == nullptr) {
+            return false;
+        }
+        bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        return (fclose(file) == 0) && ok;
+    }
+
+private:
+    typedef std::vector<uint32_t> Postings;     // Ascending block numbers
+    typedef std::unordered_map<std::string, Postings> SenderMap;
+
+    static size_t CommittedCount(const Postings& postings) {
+        return postings.size() - (!postings.empty() && postings.back() == CHATINDEX_PENDING_BLOCK);
+    }
+
+    SenderMap senders;
+    std::vector<uint8_t> channels[256];         // Block bitmaps, trimmed after the last set bit
+    uint32_t blocks;
+    int64_t firstTime;
+    int64_t lastTime;
+
+    // The block being filled
+    std::vector<SenderMap::value_type*> blockSenders;   // Map nodes: stable across rehashing
+    uint64_t blockChannels[4];
+    uint32_t blockRecords;
+    int64_t blockFirst;
+    int64_t blockLast;
+};
+
+// ============================================================================
+// READING
+// ============================================================================
+
+// Block numbers of one sender, ascending
+class ChatPostings {
+public:
+    ChatPostings() : at(nullptr), end(nullptr), left(0), block(0) {}
+    ChatPostings(const uint8_t* postings, const uint8_t* limit, uint64_t count)
+        : at(postings), end(limit), left(count), block(0) {}
+
+    size_t Count() const { return (size_t)left; }   // Before the first Next
+
+    bool Next(uint32_t* blockNumber) {
+        uint64_t delta;
+        if (left == 0 || (at = GetVarint(at, end, &delta)) == nullptr) {
+            left = 0;
+            return false;
+        }
+        left--;
+        block += (uint32_t)delta;
+        *blockNumber = block;
+        return true;
+    }
+
+private:
+    const uint8_t* at;
+    const uint8_t* end;
+    uint64_t left;
+    uint32_t block;
+};
+
+class ChatIndexReader {
+public:
+    ChatIndexReader()
+        : data(nullptr), size(0), blocks(0), channelCount(0), senderCount(0), slotCount(0), segmentSize(0),
+          firstTime(0), lastTime(0) {}
+
+    // `data` is a whole index file; checked against its crc
+    bool Open(const uint8_t* index, size_t indexSize) {
+        data = index;
+        size = indexSize;
+        if (size < CHATINDEX_HEADER_BYTES + 4 || memcmp(data, CHATINDEX_MAGIC, sizeof(CHATINDEX_MAGIC)) != 0) {
+            return false;
+        }
+        uint16_t version;
+        uint32_t crc;
+        memcpy(&version, data + 4, 2);
+        memcpy(&blocks, data + 8, 4);
+        memcpy(&channelCount, data + 12, 4);
+        memcpy(&senderCount, data + 16, 4);
+        memcpy(&slotCount, data + 20, 4);
+        memcpy(&segmentSize, data + 24, 8);
+        memcpy(&firstTime, data + 32, 8);
+        memcpy(&lastTime, data + 40, 8);
+        memcpy(&crc, data + size - 4, 4);
+        uint64_t fixed = CHATINDEX_HEADER_BYTES + (uint64_t)channelCount * (4 + BitmapBytes()) +
+                         (uint64_t)slotCount * CHATINDEX_SLOT_BYTES;
+        return version == CHATINDEX_VERSION && channelCount <= 256 && slotCount != 0 &&
+               (slotCount & (slotCount - 1)) == 0 && fixed <= size - 4 && Crc32(data, size - 4) == crc;
+    }
+
+    uint32_t BlockCount() const { return blocks; }
+    uint32_t SenderCount() const { return senderCount; }
+    uint64_t SegmentSize() const { return segmentSize; }
+    int64_t FirstTime() const { return firstTime; }
+    int64_t LastTime() const { return lastTime; }
+
+    // Bitmap of the blocks with records on `channel`; nullptr if none has
+    const uint8_t* ChannelBlocks(uint8_t channel) const {
+        const uint8_t* at = data + CHATINDEX_HEADER_BYTES;
+        for (uint32_t i = 0; i < channelCount; i++, at += 4 + BitmapBytes()) {
+            uint32_t c;
+            memcpy(&c, at, 4);
+            if (c == channel) return at + 4;
+        }
+        return nullptr;
+    }
+
+    // Blocks with records from `sender`; empty if there are none
+    ChatPostings FindSender(const char* sender, size_t senderLength) const {
+        const uint8_t* slots = data + CHATINDEX_HEADER_BYTES + (size_t)channelCount * (4 + BitmapBytes());
+        const uint8_t* end = data + size - 4;
+        uint32_t hash = ChatSenderHash(sender, senderLength);
+        for (uint32_t probe = 0, slot = hash & (slotCount - 1); probe < slotCount;
+             probe++, slot = (slot + 1) & (slotCount - 1)) {
+            uint32_t slotHash, offset;
+            memcpy(&slotHash, slots + (size_t)slot * CHATINDEX_SLOT_BYTES, 4);
+            memcpy(&offset, slots + (size_t)slot * CHATINDEX_SLOT_BYTES + 4, 4);
+            if (offset == 0) break;
+            if (slotHash != hash || offset >= size - 4) continue;
+
+            uint64_t nameLength, count;
+            const uint8_t* at = GetVarint(data + offset, end, &nameLength);
+            if (at == nullptr || (uint64_t)(end - at) < nameLength) break;
+            if (nameLength != senderLength || memcmp(at, sender, senderLength) != 0) continue;
+            at = GetVarint(at + nameLength, end, &count);
+            if (at == nullptr) break;
+            return ChatPostings(at, end, count);
+        }
+        return ChatPostings();
+    }
+
+private:
+    size_t BitmapBytes() const { return ((size_t)blocks + 7) / 8; }
+
+    const uint8_t* data;
+    size_t size;
+    uint32_t blocks;
+    uint32_t channelCount;
+    uint32_t senderCount;
+    uint32_t slotCount;
+    uint64_t segmentSize;
+    int64_t firstTime;
+    int64_t lastTime;
+};
+
+} // namespace HookLib
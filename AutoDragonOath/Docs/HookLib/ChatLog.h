@@ -0,0 +1,585 @@
+// ChatLog.h - Append-only binary chat record file
+//
+// The text log spends most of a line on "[HH:MM:SS] [Channel 3] ", drops
+// the date, the sender camp and anything below a second, and has to be
+// parsed back with sscanf. A chat log file holds the same events as
+// compact binary records:
+//
+//   header    "HCHT", uint16 version, uint16 header size, uint64 end hint
+//   SESSION   uint8 type, int64 wall time, int64 monotonic time, uint32 crc
+//   CHAT      uint8 type, varint time delta, uint8 channel, uint8 camp,
+//             varint + sender bytes, varint + text bytes, uint32 crc
+//
+// All times are microseconds, integers little-endian, varints LEB128.
+// Each Open writes a SESSION that ties the monotonic clock to the wall
+// clock; a CHAT stores the monotonic time elapsed since the record before
+// it, usually 1-3 bytes. Sender and text are the game's GBK bytes as they
+// came, not converted. The crc (CRC-32, as zlib) covers the record from its
+// type byte on.
+//
+// The writer maps a window at the end of the file and encodes records
+// straight into it: no system call per record. The file grows a window at
+// a time, and the dirty pages are written back by the OS in the background.
+// If the game dies, the rest of the last window stays zero; a zero type byte
+// ends the records, so the next Open carries on from there.
+//
+// ChatLogReader walks the records of a file in memory (tools/ChatLogDecode).
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace HookLib {
+
+static const char CHATLOG_MAGIC[4] = { 'H', 'C', 'H', 'T' };
+static const uint16_t CHATLOG_VERSION = 1;
+static const size_t CHATLOG_HEADER_BYTES = 16;
+static const size_t CHATLOG_MAX_FIELD = 0xFFFF;                // Longer sender / text are cut
+static const size_t CHATLOG_WINDOW_BYTES = 4 * 1024 * 1024;    // Mapped at once; the file grows by this
+static const size_t CHATLOG_WINDOW_ALIGN = 64 * 1024;          // Windows allocation granularity
+
+enum ChatLogRecordType : uint8_t {
+    CHATLOG_RECORD_END = 0,     // Unwritten (zero) space after the last record
+    CHATLOG_RECORD_SESSION,
+    CHATLOG_RECORD_CHAT
+};
+
+// Largest record: type, delta, channel, camp, two fields with their varints, crc
+static const size_t CHATLOG_MAX_RECORD = 1 + 10 + 1 + 1 + 2 * (3 + CHATLOG_MAX_FIELD) + 4;
+
+// ============================================================================
+// ENCODING
+// ============================================================================
+
+// CRC-32 (reflected 0xEDB88320), slicing by 8: the decoder checks every
+// record, and at one byte per step the checksum would be its bottleneck
+inline const uint32_t (*Crc32Tables())[256] {
+    static const struct Tables {
+        uint32_t t[8][256];
+        Tables() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[0][i] = c;
+            }
+            for (uint32_t i = 0; i < 256; i++) {
+                for (int s = 1; s < 8; s++) t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xFF];
+            }
+        }
+    } tables;
+    return tables.t;
+}
+
+inline uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    const uint32_t (*t)[256] = Crc32Tables();
+    crc = ~crc;
+    while (size >= 8) {
+        uint32_t lo = crc ^ ((uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24);
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+        data += 8;
+        size -= 8;
+    }
+    while (size-- != 0) crc = t[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline uint8_t* PutVarint(uint8_t* at, uint64_t value) {
+    while (value >= 0x80) {
+        *at++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *at++ = (uint8_t)value;
+    return at;
+}
+
+// Reads a varint from [at, end). Returns NULL if it is cut off or too long.
+inline const uint8_t* GetVarint(const uint8_t* at, const uint8_t* end, uint64_t* value) {
+    uint64_t result = 0;
+    for (unsigned shift = 0; at < end && shift < 64; shift += 7) {
+        uint8_t byte = *at++;
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return at;
+        }
+    }
+    return nullptr;
+}
+
+inline void PutLe32(uint8_t* at, uint32_t value) { memcpy(at, &value, 4); }   // x86: host order is LE
+inline void PutLe64(uint8_t* at, uint64_t value) { memcpy(at, &value, 8); }
+
+inline int64_t ChatLogWallMicroseconds() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+inline int64_t ChatLogMonotonicMicroseconds() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// ============================================================================
+// READING
+// ============================================================================
+
+struct ChatEvent {
+    int64_t time;               // Wall clock, microseconds since the Unix epoch
+    uint8_t channel;
+    uint8_t camp;
+    const char* sender;         // GBK, not terminated; points into the file
+    size_t senderLength;
+    const char* text;
+    size_t textLength;
+};
+
+enum ChatLogStatus {
+    CHATLOG_OK = 0,
+    CHATLOG_DONE,               // End of the records
+    CHATLOG_CORRUPT             // Bad header, checksum or record; Offset() tells where
+};
+
+class ChatLogReader {
+public:
+    ChatLogReader() : data(nullptr), size(0), at(0), sessionWall(0), sessionMonotonic(0), last(0), sessions(0) {}
+
+    // `data` is the whole file. Fails if the header is not a chat log's.
+    bool Open(const uint8_t* fileData, size_t fileSize) {
+        data = fileData;
+        size = fileSize;
+        at = CHATLOG_HEADER_BYTES;
+        sessions = 0;
+        uint16_t version;
+        if (size < CHATLOG_HEADER_BYTES || memcmp(data, CHATLOG_MAGIC, sizeof(CHATLOG_MAGIC)) != 0) {
+            return false;
+        }
+        memcpy(&version, data + 4, 2);
+        return version == CHATLOG_VERSION;
+    }
+
+    // Next chat event; SESSION records are taken in passing
+    ChatLogStatus Next(ChatEvent* event) {
+        for (;;) {
+            if (at >= size || data[at] == CHATLOG_RECORD_END) {
+                return CHATLOG_DONE;
+            }
+            const uint8_t* record = data + at;
+            const uint8_t* end = data + size;
+            const uint8_t* p = record + 1;
+
+            if (*record == CHATLOG_RECORD_SESSION) {
+                if (end - p < 16 + 4) return CHATLOG_CORRUPT;
+                int64_t wall, monotonic;
+                memcpy(&wall, p, 8);
+                memcpy(&monotonic, p + 8, 8);
+                p += 16;
+                if (!CheckCrc(record, p)) return CHATLOG_CORRUPT;
+                sessionWall = wall;
+                sessionMonotonic = monotonic;
+                last = monotonic;
+                sessions++;
+                at = (size_t)(p + 4 - data);
+                continue;
+            }
+            if (*record != CHATLOG_RECORD_CHAT || sessions == 0) {
+                return CHATLOG_CORRUPT;
+            }
+
+            uint64_t delta, senderLength, textLength;
+            p = GetVarint(p, end, &delta);
+            if (p == nullptr || end - p < 2) return CHATLOG_CORRUPT;
+            uint8_t channel = p[0];
+            uint8_t camp = p[1];
+            p = GetVarint(p + 2, end, &senderLength);
+            if (p == nullptr || (uint64_t)(end - p) < senderLength) return CHATLOG_CORRUPT;
+            const uint8_t* sender = p;
+            p = GetVarint(p + senderLength, end, &textLength);
+            if (p == nullptr || (uint64_t)(end - p) < textLength) return CHATLOG_CORRUPT;
+            const uint8_t* text = p;
+            p += textLength;
+            if (!CheckCrc(record, p)) return CHATLOG_CORRUPT;
+
+            last += (int64_t)delta;
+            event->time = sessionWall + (last - sessionMonotonic);
+            event->channel = channel;
+            event->camp = camp;
+            event->sender = (const char*)sender;
+            event->senderLength = (size_t)senderLength;
+            event->text = (const char*)text;
+            event->textLength = (size_t)textLength;
+            at = (size_t)(p + 4 - data);
+            return CHATLOG_OK;
+        }
+    }
+
+    // File offset of the next record (after CHATLOG_CORRUPT: of the bad one)
+    size_t Offset() const { return at; }
+    unsigned Sessions() const { return sessions; }
+
+private:
+    // The crc follows [record, body)
+    bool CheckCrc(const uint8_t* record, const uint8_t* body) const {
+        if ((size_t)(data + size - body) < 4) return false;
+        uint32_t stored;
+        memcpy(&stored, body, 4);
+        return stored == Crc32(record, (size_t)(body - record));
+    }
+
+    const uint8_t* data;
+    size_t size;
+    size_t at;
+    int64_t sessionWall;
+    int64_t sessionMonotonic;
+    int64_t last;               // Monotonic time of the previous record
+    unsigned sessions;
+};
+
+// ============================================================================
+// WRITING
+// ============================================================================
+
+// Appends to one file from one thread at a time (the chat hook).
+class ChatLogWriter {
+public:
+    ChatLogWriter() : view(nullptr), viewStart(0), viewSize(0), end(0), last(0) {
+#ifdef _WIN32
+        file = INVALID_HANDLE_VALUE;
+        mapping = NULL;
+#else
+        file = -1;
+#endif
+    }
+
+    ~ChatLogWriter() { Close(); }
+
+    // Opens or creates `path` and starts a session after its last valid
+    // record. Anything after that (a record cut off by a crash) is
+    // overwritten.
+    bool Open(const char* path) {
+        Close();
+        if (!OpenFile(path)) {
+            return false;
+        }
+        uint64_t fileSize = FileSize();
+        uint8_t header[CHATLOG_HEADER_BYTES];
+        if (fileSize < CHATLOG_HEADER_BYTES) {
+            memcpy(header, CHATLOG_MAGIC, sizeof(CHATLOG_MAGIC));
+            uint16_t version = CHATLOG_VERSION, headerBytes = (uint16_t)CHATLOG_HEADER_BYTES;
+            memcpy(header + 4, &version, 2);
+            memcpy(header + 6, &headerBytes, 2);
+            PutLe64(header + 8, CHATLOG_HEADER_BYTES);
+            if (!WriteAt(0, header, sizeof(header))) {
+                Close();
+                return false;
+            }
+            end = CHATLOG_HEADER_BYTES;
+        } else if (!FindEnd(fileSize)) {
+            Close();   // Not a chat log: leave it alone
+            return false;
+        }
+
+        int64_t monotonic = ChatLogMonotonicMicroseconds();
+        uint8_t* record = Reserve(1 + 16 + 4);
+        if (record == nullptr) {
+            Close();
+            return false;
+        }
+        record[0] = CHATLOG_RECORD_SESSION;
+        PutLe64(record + 1, (uint64_t)ChatLogWallMicroseconds());
+        PutLe64(record + 9, (uint64_t)monotonic);
+        PutLe32(record + 17, Crc32(record, 17));
+        end += 21;
+        last = monotonic;
+        return true;
+    }
+
+    bool IsOpen() const { return view != nullptr; }
+
+    // One chat event. Sender and text are cut to CHATLOG_MAX_FIELD bytes.
+    bool Append(uint8_t channel, uint8_t camp, const char* sender, size_t senderLength, const char* text,
+                size_t textLength) {
+        if (view == nullptr) {
+            return false;
+        }
+        if (senderLength > CHATLOG_MAX_FIELD) senderLength = CHATLOG_MAX_FIELD;
+        if (textLength > CHATLOG_MAX_FIELD) textLength = CHATLOG_MAX_FIELD;
+        uint8_t* record = Reserve(CHATLOG_MAX_RECORD - 2 * CHATLOG_MAX_FIELD + senderLength + textLength);
+        if (record == nullptr) {
+            return false;
+        }
+
+        int64_t monotonic = ChatLogMonotonicMicroseconds();
+        uint8_t* p = record;
+        *p++ = CHATLOG_RECORD_CHAT;
+        p = PutVarint(p, (uint64_t)(monotonic - last));
+        *p++ = channel;
+        *p++ = camp;
+        p = PutVarint(p, senderLength);
+        memcpy(p, sender, senderLength);
+        p += senderLength;
+        p = PutVarint(p, textLength);
+        memcpy(p, text, textLength);
+        p += textLength;
+        PutLe32(p, Crc32(record, (size_t)(p - record)));
+        p += 4;
+
+        end += (uint64_t)(p - record);
+        last = monotonic;
+        return true;
+    }
+
+    // Bytes of records so far, header included
+    uint64_t Size() const { return end; }
+
+    // Asks the OS to write the mapped records out now (they are written
+    // back in the background anyway)
+    void Flush() {
+        if (view == nullptr) {
+            return;
+        }
+        UpdateEndHint();
+#ifdef _WIN32
+        FlushViewOfFile(view, (SIZE_T)(end - viewStart));
+#else
+        msync(view, (size_t)(end - viewStart), MS_ASYNC);
+#endif
+    }
+
+    // Unmaps the window and cuts the file to its records
+    void Close() {
+        if (view != nullptr) {
+            UpdateEndHint();
+            Unmap();
+            Truncate(end);
+        }
+#ifdef _WIN32
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (file >= 0) close(file);
+        file = -1;
+#endif
+        end = 0;
+    }
+
+private:
+    ChatLogWriter(const ChatLogWriter&);
+    ChatLogWriter& operator=(const ChatLogWriter&);
+
+    // Space for `bytes` at `end`, sliding the window (and growing the file)
+    // when it does not fit
+    uint8_t* Reserve(size_t bytes) {
+        if (view == nullptr || end + bytes > viewStart + viewSize) {
+            Unmap();
+            UpdateEndHint();
+            uint64_t start = end / CHATLOG_WINDOW_ALIGN * CHATLOG_WINDOW_ALIGN;
+            if (!Map(start, CHATLOG_WINDOW_BYTES)) {
+                return nullptr;
+            }
+        }
+        return view + (end - viewStart);
+    }
+
+    // Reads the file from the header's end hint on, up to the first record
+    // that does not check out
+    bool FindEnd(uint64_t fileSize) {
+        uint8_t header[CHATLOG_HEADER_BYTES];
+        if (!ReadAt(0, header, sizeof(header)) || memcmp(header, CHATLOG_MAGIC, sizeof(CHATLOG_MAGIC)) != 0) {
+            return false;
+        }
+        uint64_t hint;
+        memcpy(&hint, header + 8, 8);
+        if (hint < CHATLOG_HEADER_BYTES || hint > fileSize) hint = CHATLOG_HEADER_BYTES;
+        end = hint;
+
+        // Records after the hint were written after the last Flush / window
+        // move. A record that runs past the window is read again from the
+        // next one.
+        for (;;) {
+            if (end >= fileSize) {
+                return true;
+            }
+            if (!Map(end / CHATLOG_WINDOW_ALIGN * CHATLOG_WINDOW_ALIGN, CHATLOG_WINDOW_BYTES)) {
+                return false;
+            }
+            uint64_t windowEnd = viewStart + viewSize;
+            uint64_t limit = (windowEnd < fileSize) ? windowEnd : fileSize;
+            bool cut = false;
+            while (end < limit) {
+                size_t length = RecordLength(view + (end - viewStart), limit - end);
+                if (length == 0) {
+                    cut = limit - end < CHATLOG_MAX_RECORD && windowEnd < fileSize;
+                    break;
+                }
+                end += length;
+            }
+            Unmap();
+            if (!cut && !(end == limit && limit < fileSize)) {
+                return true;
+            }
+        }
+    }
+
+    // Length of the valid record at `at`, or 0
+    static size_t RecordLength(const uint8_t* at, uint64_t available) {
+        const uint8_t* end = at + ((available < CHATLOG_MAX_RECORD) ? available : CHATLOG_MAX_RECORD);
+        const uint8_t* p = at + 1;
+        uint64_t length;
+        if (available == 0) return 0;
+        if (*at == CHATLOG_RECORD_SESSION) {
+            if (end - p < 16) return 0;
+            p += 16;
+        } else if (*at == CHATLOG_RECORD_CHAT) {
+            if ((p = GetVarint(p, end, &length)) == nullptr || end - p < 2) return 0;
+            if ((p = GetVarint(p + 2, end, &length)) == nullptr || (uint64_t)(end - p) < length) return 0;
+            if ((p = GetVarint(p + length, end, &length)) == nullptr || (uint64_t)(end - p) < length) return 0;
+            p += length;
+        } else {
+            return 0;
+        }
+        if (end - p < 4) return 0;
+        uint32_t stored;
+        memcpy(&stored, p, 4);
+        return (stored == Crc32(at, (size_t)(p - at))) ? (size_t)(p + 4 - at) : 0;
+    }
+
+    void UpdateEndHint() {
+        uint8_t hint[8];
+        PutLe64(hint, end);
+        WriteAt(8, hint, sizeof(hint));
+    }
+
+    // ========================================================================
+    // PLATFORM
+    // ========================================================================
+
+#ifdef _WIN32
+    bool OpenFile(const char* path) {
+        file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+        return file != INVALID_HANDLE_VALUE;
+    }
+
+    uint64_t FileSize() const {
+        LARGE_INTEGER size;
+        return GetFileSizeEx(file, &size) ? (uint64_t)size.QuadPart : 0;
+    }
+
+    bool ReadAt(uint64_t offset, void* buffer, size_t bytes) {
+        OVERLAPPED position = {};
+        position.Offset = (DWORD)offset;
+        position.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD done = 0;
+        return ReadFile(file, buffer, (DWORD)bytes, &done, &position) && done == bytes;
+    }
+
+    bool WriteAt(uint64_t offset, const void* buffer, size_t bytes) {
+        OVERLAPPED position = {};
+        position.Offset = (DWORD)offset;
+        position.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD done = 0;
+        return WriteFile(file, buffer, (DWORD)bytes, &done, &position) && done == bytes;
+    }
+
+    // Maps [start, start + bytes), growing the file to cover it
+    bool Map(uint64_t start, size_t bytes) {
+        uint64_t limit = start + bytes;
+        mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)(limit >> 32), (DWORD)limit, NULL);
+        if (mapping == NULL) {
+            return false;
+        }
+        view = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_WRITE, (DWORD)(start >> 32), (DWORD)start, bytes);
+        if (view == nullptr) {
+            CloseHandle(mapping);
+            mapping = NULL;
+            return false;
+        }
+        viewStart = start;
+        viewSize = bytes;
+        return true;
+    }
+
+    void Unmap() {
+        if (view != nullptr) UnmapViewOfFile(view);
+        if (mapping != NULL) CloseHandle(mapping);
+        view = nullptr;
+        mapping = NULL;
+    }
+
+    void Truncate(uint64_t size) {
+        LARGE_INTEGER position;
+        position.QuadPart = (LONGLONG)size;
+        if (SetFilePointerEx(file, position, NULL, FILE_BEGIN)) SetEndOfFile(file);
+    }
+#else
+    bool OpenFile(const char* path) {
+        file = open(path, O_RDWR | O_CREAT, 0644);
+        return file >= 0;
+    }
+
+    uint64_t FileSize() const {
+        struct stat info;
+        return (fstat(file, &info) == 0) ? (uint64_t)info.st_size : 0;
+    }
+
+    bool ReadAt(uint64_t offset, void* buffer, size_t bytes) {
+        return pread(file, buffer, bytes, (off_t)offset) == (ssize_t)bytes;
+    }
+
+    bool WriteAt(uint64_t offset, const void* buffer, size_t bytes) {
+        return pwrite(file, buffer, bytes, (off_t)offset) == (ssize_t)bytes;
+    }
+
+    bool Map(uint64_t start, size_t bytes) {
+        if (FileSize() < start + bytes && ftruncate(file, (off_t)(start + bytes)) != 0) {
+            return false;
+        }
+        void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, (off_t)start);
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+        view = (uint8_t*)mapped;
+        viewStart = start;
+        viewSize = bytes;
+        return true;
+    }
+
+    void Unmap() {
+        if (view != nullptr) munmap(view, viewSize);
+        view = nullptr;
+    }
+
+    void Truncate(uint64_t size) {
+        if (ftruncate(file, (off_t)size) != 0) {
+            // Keeps the zero tail; readers stop at it
+        }
+    }
+#endif
+
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int file;
+#endif
+    uint8_t* view;              // Mapped window [viewStart, viewStart + viewSize)
+    uint64_t viewStart;
+    size_t viewSize;
+    uint64_t end;               // File offset after the last record
+    int64_t last;               // Monotonic time of the last record
+};
+
+} // namespace HookLib
@@ -0,0 +1,251 @@
+// ChatPacket.h - Lazy GCChat packet view, subscriber filter, message pool
+//
+// The chat hooks used to zero two 1 KB stack buffers and call every getter
+// of the packet (each one a virtual call into Game.exe) for every packet,
+// whether or not anything wanted that channel. Now:
+//
+//   1. ChatPacketView reads the channel and the camp, nothing else.
+//   2. ChatSubscribers::Match runs the consumers' filters on those two
+//      bytes and returns the set of consumers that want the message.
+//   3. Only then are sender and text fetched and copied, into a slot of a
+//      preallocated ChatMessagePool (no allocation, no zeroing; the strings
+//      are NUL-terminated and cut at the slot's capacity).
+//
+// The packet type is a template parameter: anything with the GCChat
+// getters works, so the DLLs pass their GCChat declaration and a check on
+// Linux passes a mock (see README). GetSourCamp is optional.
+//
+// The pool is a lock-free stack of slot indexes, so a slot can be handed to
+// another thread and released there.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace HookLib {
+
+static const size_t CHAT_SENDER_CAPACITY = 256;     // Bytes, with the NUL
+static const size_t CHAT_TEXT_CAPACITY = 1024;      // MAX_CHAT_SIZE of the DLLs
+static const size_t CHAT_POOL_SLOTS = 256;
+static const size_t CHAT_MAX_SUBSCRIBERS = 32;      // One bit each in ChatMessage::subscribers
+
+// One accepted chat message, in a pool slot
+struct ChatMessage {
+    uint8_t channel;
+    uint8_t camp;
+    uint16_t senderLength;
+    uint16_t textLength;
+    uint32_t subscribers;                   // Bit i: subscriber i accepted it
+    char sender[CHAT_SENDER_CAPACITY];      // GBK, NUL-terminated
+    char text[CHAT_TEXT_CAPACITY];
+};
+
+// ============================================================================
+// PACKET VIEW
+// ============================================================================
+
+template <class Packet, class = void>
+struct ChatPacketHasCamp : std::false_type {};
+
+template <class Packet>
+struct ChatPacketHasCamp<Packet, decltype((void)std::declval<Packet&>().GetSourCamp())> : std::true_type {};
+
+// Reads channel and camp on construction; sender and text only on CopyTo
+template <class Packet>
+class ChatPacketView {
+public:
+    explicit ChatPacketView(Packet* chatPacket)
+        : packet(chatPacket), channel(chatPacket->GetChatType()), camp(ReadCamp(chatPacket)) {}
+
+    uint8_t Channel() const { return channel; }
+    uint8_t Camp() const { return camp; }      // 0 if the packet type has no GetSourCamp
+
+    // Fills `message`. A field the packet reports as null or of a negative
+    // size is left empty; a longer one is cut at the slot's capacity.
+    void CopyTo(ChatMessage* message, uint32_t subscribers) const {
+        message->channel = channel;
+        message->camp = camp;
+        message->subscribers = subscribers;
+        message->senderLength = (uint16_t)CopyField(packet->GetSourName(), packet->GetSourNameSize(),
+                                                    message->sender, CHAT_SENDER_CAPACITY);
+        message->textLength = (uint16_t)CopyField(packet->GetContex(), packet->GetContexSize(), message->text,
+                                                  CHAT_TEXT_CAPACITY);
+    }
+
+private:
+    static uint8_t ReadCamp(Packet* chatPacket) {
+        if constexpr (ChatPacketHasCamp<Packet>::value) {
+            return (uint8_t)chatPacket->GetSourCamp();
+        } else {
+            (void)chatPacket;
+            return 0;
+        }
+    }
+
+    static size_t CopyField(const char* from, int size, char* to, size_t capacity) {
+        size_t length = (from != nullptr && size > 0) ? (size_t)size : 0;
+        if (length > capacity - 1) length = capacity - 1;
+        if (length != 0) memcpy(to, from, length);   // `from` may be null
+        to[length] = '\0';
+        return length;
+    }
+
+    Packet* packet;
+    uint8_t channel;
+    uint8_t camp;
+};
+
+// ============================================================================
+// SUBSCRIBERS
+// ============================================================================
+
+// Optional last test of a subscription, on channel and camp only
+typedef bool (*ChatPredicate)(uint8_t channel, uint8_t camp, void* context);
+
+// What one consumer wants: by default every channel and camp
+struct ChatSubscription {
+    uint64_t channels[4];       // Bit c: channel c
+    uint64_t camps[4];
+    ChatPredicate accept;       // nullptr: the masks decide
+    void* context;
+
+    explicit ChatSubscription(ChatPredicate predicate = nullptr, void* predicateContext = nullptr)
+        : accept(predicate), context(predicateContext) {
+        memset(channels, 0xFF, sizeof(channels));
+        memset(camps, 0xFF, sizeof(camps));
+    }
+
+    // Only these channels
+    ChatSubscription& Channels(std::initializer_list<uint8_t> list) {
+        memset(channels, 0, sizeof(channels));
+        for (uint8_t c : list) channels[c >> 6] |= 1ull << (c & 63);
+        return *this;
+    }
+
+    // Only these camps
+    ChatSubscription& Camps(std::initializer_list<uint8_t> list) {
+        memset(camps, 0, sizeof(camps));
+        for (uint8_t c : list) camps[c >> 6] |= 1ull << (c & 63);
+        return *this;
+    }
+};
+
+// Set up before the hook is installed; Match is then read-only
+class ChatSubscribers {
+public:
+    ChatSubscribers() : count(0) {}
+
+    // Returns the subscriber's bit number, or -1 if CHAT_MAX_SUBSCRIBERS
+    // are already registered
+    int Add(const ChatSubscription& subscription) {
+        if (count == CHAT_MAX_SUBSCRIBERS) {
+            return -1;
+        }
+        subscriptions[count] = subscription;
+        return (int)count++;
+    }
+
+    // The subscribers that want a message on `channel` from `camp`
+    uint32_t Match(uint8_t channel, uint8_t camp) const {
+        uint32_t accepted = 0;
+        for (size_t i = 0; i < count; i++) {
+            const ChatSubscription& s = subscriptions[i];
+            if (!((s.channels[channel >> 6] >> (channel & 63)) & 1) || !((s.camps[camp >> 6] >> (camp & 63)) & 1)) {
+                continue;
+            }
+            if (s.accept == nullptr || s.accept(channel, camp, s.context)) accepted |= 1u << i;
+        }
+        return accepted;
+    }
+
+private:
+    ChatSubscription subscriptions[CHAT_MAX_SUBSCRIBERS];
+    size_t count;
+};
+
+// ============================================================================
+// MESSAGE POOL
+// ============================================================================
+
+// Fixed set of ChatMessage slots, allocated once. Acquire and Release may
+// be called from any thread.
+class ChatMessagePool {
+public:
+    explicit ChatMessagePool(size_t slotCount = CHAT_POOL_SLOTS)
+        : slots(slotCount), next(slotCount), head(0), dropped(0) {
+        // Free list: head -> 1 -> 2 -> ... (indexes + 1, 0 ends it)
+        for (size_t i = 0; i < slotCount; i++) next[i].store((uint32_t)(i + 2 <= slotCount ? i + 2 : 0));
+        head.store(slotCount != 0 ? 1 : 0);
+    }
+
+    // A free slot, or nullptr (counted) if all are in use
+    ChatMessage* Acquire() {
+        uint64_t top = head.load(std::memory_order_acquire);
+        for (;;) {
+            uint32_t index = (uint32_t)top;
+            if (index == 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            // The high half counts changes, so a slot released and taken
+            // again between the load and the exchange fails it (ABA)
+            uint64_t replacement = ((top >> 32) + 1) << 32 | next[index - 1].load(std::memory_order_relaxed);
+            if (head.compare_exchange_weak(top, replacement, std::memory_order_acquire, std::memory_order_acquire)) {
+                return &slots[index - 1];
+            }
+        }
+    }
+
+    void Release(ChatMessage* message) {
+        uint32_t index = (uint32_t)(message - slots.data()) + 1;
+        uint64_t top = head.load(std::memory_order_relaxed);
+        for (;;) {
+            next[index - 1].store((uint32_t)top, std::memory_order_relaxed);
+            uint64_t replacement = ((top >> 32) + 1) << 32 | index;
+            if (head.compare_exchange_weak(top, replacement, std::memory_order_release, std::memory_order_relaxed)) {
+                return;
+            }
+        }
+    }
+
+    // Messages lost because every slot was in use
+    uint64_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    ChatMessagePool(const ChatMessagePool&);
+    ChatMessagePool& operator=(const ChatMessagePool&);
+
+    std::vector<ChatMessage> slots;
+    std::vector<std::atomic<uint32_t> > next;
+    std::atomic<uint64_t> head;             // Change count << 32 | first free index + 1
+    std::atomic<uint64_t> dropped;
+};
+
+// ============================================================================
+// HOOK HELPER
+// ============================================================================
+
+// Steps 2 and 3 for one packet. Returns false, and leaves *message
+// nullptr, if no subscriber wants it or the pool is empty. *message is set
+// before the copy, so a handler for a fault inside a packet getter can
+// still release the slot.
+template <class Packet>
+bool TakeChatMessage(const ChatPacketView<Packet>& view, const ChatSubscribers& subscribers, ChatMessagePool* pool,
+                     ChatMessage** message) {
+    *message = nullptr;
+    uint32_t accepted = subscribers.Match(view.Channel(), view.Camp());
+    if (accepted == 0 || (*message = pool->Acquire()) == nullptr) {
+        return false;
+    }
+    view.CopyTo(*message, accepted);
+    return true;
+}
+
+} // namespace HookLib
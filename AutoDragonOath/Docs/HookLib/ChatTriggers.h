@@ -0,0 +1,245 @@
+// ChatTriggers.h - Keyword trigger rules over GBK chat text, one pass per message
+//
+// The chat handlers used to strstr each message once per keyword, so every
+// new rule was another pass over the text. strstr also compares bytes, not
+// characters: in GBK the trail byte of one character and the lead byte of
+// the next can spell a third one, so a keyword could match in the middle
+// of unrelated text.
+//
+// ChatTriggers compiles the keywords of every rule into one AhoCorasick
+// automaton (AhoCorasick.h, as used by MultiPatternScan). Scan feeds the
+// message through it once, one table step per byte however many rules
+// there are. Alongside, it tracks where characters start (a lead byte
+// 0x81-0xFE takes the next byte with it). A keyword that ends at a byte
+// counts only if it started on a character. A rule fires once per
+// message, if its channel and sender filters pass.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <initializer_list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "AhoCorasick.h"
+#include "ChatPacket.h"
+
+namespace HookLib {
+
+static const size_t CHAT_TRIGGER_MAX_KEYWORD = 255;     // Bytes; Scan remembers 256 character starts
+
+// First byte of a two-byte GBK character
+inline bool GbkLeadByte(uint8_t byte) {
+    return byte >= 0x81 && byte <= 0xFE;
+}
+
+// One rule: any of its keywords, on its channels, from its sender
+struct ChatTriggerRule {
+    std::vector<std::string> keywords;      // GBK bytes, whole characters
+    uint64_t channels[4];                   // Bit c: channel c; by default all
+    std::string sender;                     // GBK; empty: anyone
+
+    explicit ChatTriggerRule(const char* keyword) : keywords(1, keyword) {
+        memset(channels, 0xFF, sizeof(channels));
+    }
+
+    // Also fires on this keyword
+    ChatTriggerRule& Or(const char* keyword) {
+        keywords.push_back(keyword);
+        return *this;
+    }
+
+    // Only these channels
+    ChatTriggerRule& Channels(std::initializer_list<uint8_t> list) {
+        memset(channels, 0, sizeof(channels));
+        for (uint8_t c : list) channels[c >> 6] |= 1ull << (c & 63);
+        return *this;
+    }
+
+    // Only messages from this player
+    ChatTriggerRule& From(const char* name) {
+        sender = name;
+        return *this;
+    }
+};
+
+struct ChatTriggerHit {
+    int rule;
+    uint32_t offset;            // Of the keyword that fired it, in the text
+};
+
+// What one Scan fired, in the order the keywords ended. Keep one per
+// scanning thread: it allocates on the first scans only.
+class ChatTriggerHits {
+public:
+    ChatTriggerHits() : serial(0) {}
+
+    size_t Count() const { return hits.size(); }
+    const ChatTriggerHit& operator[](size_t i) const { return hits[i]; }
+
+    bool Fired(int rule) const { return rule >= 0 && (size_t)rule < stamps.size() && stamps[rule] == serial; }
+
+private:
+    friend class ChatTriggers;
+
+    std::vector<ChatTriggerHit> hits;
+    std::vector<uint32_t> stamps;           // == serial: the rule fired in this scan
+    uint32_t serial;
+};
+
+// Rules are added and built before the hook is installed; Scan is then
+// read-only and may run on several threads, each with its own hits
+class ChatTriggers {
+public:
+    ChatTriggers() : built(false) { memset(anyChannel, 0, sizeof(anyChannel)); }
+
+    // Returns the rule's id (0, 1, 2... in order), or -1 if a keyword is
+    // empty, longer than CHAT_TRIGGER_MAX_KEYWORD or ends inside a character
+    int Add(const ChatTriggerRule& rule) {
+        for (size_t k = 0; k < rule.keywords.size(); k++) {
+            if (!WholeCharacters(rule.keywords[k])) return -1;
+        }
+        int id = (int)rules.size();
+        Rule compiled;
+        memcpy(compiled.channels, rule.channels, sizeof(compiled.channels));
+        compiled.sender = rule.sender;
+        rules.push_back(compiled);
+        for (size_t c = 0; c < 4; c++) anyChannel[c] |= rule.channels[c];
+
+        for (size_t k = 0; k < rule.keywords.size(); k++) {
+            const std::string& keyword = rule.keywords[k];
+            std::map<std::string, int>::iterator found = keyIds.find(keyword);
+            int key = found != keyIds.end()
+                          ? found->second
+                          : automaton.AddKey((const uint8_t*)keyword.data(), keyword.size());
+            if (found == keyIds.end()) {
+                keyIds[keyword] = key;
+                keyRules.push_back(std::vector<int>());
+            }
+            keyRules[key].push_back(id);
+        }
+        built = false;
+        return id;
+    }
+
+    void Build() {
+        automaton.Build();
+        ruleStart.assign(keyRules.size() + 1, 0);
+        ruleList.clear();
+        for (size_t key = 0; key < keyRules.size(); key++) {
+            ruleStart[key] = (uint32_t)ruleList.size();
+            ruleList.insert(ruleList.end(), keyRules[key].begin(), keyRules[key].end());
+        }
+        ruleStart[keyRules.size()] = (uint32_t)ruleList.size();
+        built = true;
+    }
+
+    size_t RuleCount() const { return rules.size(); }
+    size_t KeywordCount() const { return automaton.KeyCount(); }
+
+    // Approximate heap footprint of the compiled rules
+    size_t MemoryBytes() const {
+        return automaton.MemoryBytes() + ruleList.size() * sizeof(int) + ruleStart.size() * sizeof(uint32_t) +
+               rules.size() * sizeof(Rule);
+    }
+
+    // Runs every rule over one message. Returns how many fired.
+    size_t Scan(const char* text, size_t length, uint8_t channel, const char* sender, size_t senderLength,
+                ChatTriggerHits* hits) const {
+        hits->hits.clear();
+        if (hits->stamps.size() < rules.size()) hits->stamps.resize(rules.size(), 0);
+        if (++hits->serial == 0) {
+            std::fill(hits->stamps.begin(), hits->stamps.end(), 0);
+            hits->serial = 1;
+        }
+        if (!built || !((anyChannel[channel >> 6] >> (channel & 63)) & 1)) {
+            return 0;
+        }
+
+        // Bit (i & 255): a character starts at byte i
+        uint64_t starts[4] = { 0, 0, 0, 0 };
+        size_t nextStart = 0;
+        int32_t state = 0;
+        for (size_t i = 0; i < length; i++) {
+            uint8_t byte = (uint8_t)text[i];
+            uint64_t& word = starts[(i >> 6) & 3];
+            uint64_t bit = 1ull << (i & 63);
+            if (i == nextStart) {
+                word |= bit;
+                nextStart += GbkLeadByte(byte) ? 2 : 1;
+            } else {
+                word &= ~bit;
+            }
+
+            state = automaton.Step(state, byte);
+            if (automaton.HasOutput(state)) {
+                Report(state, i, starts, channel, sender, senderLength, hits);
+            }
+        }
+        return hits->hits.size();
+    }
+
+    size_t Scan(const ChatMessage& message, ChatTriggerHits* hits) const {
+        return Scan(message.text, message.textLength, message.channel, message.sender, message.senderLength, hits);
+    }
+
+private:
+    ChatTriggers(const ChatTriggers&);
+    ChatTriggers& operator=(const ChatTriggers&);
+
+    struct Rule {
+        uint64_t channels[4];
+        std::string sender;
+    };
+
+    static bool WholeCharacters(const std::string& keyword) {
+        if (keyword.empty() || keyword.size() > CHAT_TRIGGER_MAX_KEYWORD) {
+            return false;
+        }
+        size_t i = 0;
+        while (i < keyword.size()) i += GbkLeadByte((uint8_t)keyword[i]) ? 2 : 1;
+        return i == keyword.size();
+    }
+
+    // The keywords ending at byte `end`
+    void Report(int32_t state, size_t end, const uint64_t (&starts)[4], uint8_t channel, const char* sender,
+                size_t senderLength, ChatTriggerHits* hits) const {
+        for (const int32_t* key = automaton.OutputBegin(state); key != automaton.OutputEnd(state); key++) {
+            size_t start = end + 1 - automaton.KeyLength(*key);
+            if (!((starts[(start >> 6) & 3] >> (start & 63)) & 1)) {
+                continue;   // Starts on the second byte of a character
+            }
+            for (uint32_t r = ruleStart[*key]; r < ruleStart[*key + 1]; r++) {
+                int id = ruleList[r];
+                const Rule& rule = rules[id];
+                if (hits->stamps[id] == hits->serial || !((rule.channels[channel >> 6] >> (channel & 63)) & 1)) {
+                    continue;
+                }
+                if (!rule.sender.empty() &&
+                    (rule.sender.size() != senderLength || memcmp(rule.sender.data(), sender, senderLength) != 0)) {
+                    continue;
+                }
+                hits->stamps[id] = hits->serial;
+                ChatTriggerHit hit;
+                hit.rule = id;
+                hit.offset = (uint32_t)start;
+                hits->hits.push_back(hit);
+            }
+        }
+    }
+
+    AhoCorasick automaton;
+    std::map<std::string, int> keyIds;              // Keyword -> automaton key, while adding
+    std::vector<std::vector<int> > keyRules;        // Automaton key -> rules, while adding
+    std::vector<uint32_t> ruleStart;                // Key k's rules: ruleList[ruleStart[k], ruleStart[k + 1])
+    std::vector<int> ruleList;
+    std::vector<Rule> rules;
+    uint64_t anyChannel[4];                         // Channels any rule looks at
+    bool built;
+};
+
+} // namespace HookLib
@@ -0,0 +1,277 @@
+// ChatWorker.h - Chat handlers on a worker thread, game calls back on the game thread
+//
+// The chat handlers used to run inside the hooked packet handler, so a slow
+// one (a Sleep, a file, a pipe) held up every packet behind it. Now the
+// hook only hands the message over:
+//
+//   hook          ChatPacket.h view -> pool slot -> ChatWorker::Publish
+//   worker        runs the handler for each slot in order, releases it
+//   game thread   GameThreadQueue::RunPending, from the hook or the window
+//                 tick (GameTick.h): runs the calls the handlers posted
+//                 (SendChatMessage, UseItem...), which must not be made
+//                 from another thread
+//
+// Both queues are BoundedQueue: a fixed ring with one sequence number per
+// cell (after Vyukov, as in AsyncLog.h). Push never blocks or allocates;
+// a full queue refuses the item and the caller counts it. The worker is
+// woken only when it has gone idle, so Publish is a few atomic operations.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "ChatPacket.h"
+#include "ThreadDone.h"
+
+namespace HookLib {
+
+static const size_t CHAT_WORKER_CAPACITY = CHAT_POOL_SLOTS;     // Every pool slot fits
+static const unsigned CHAT_WORKER_IDLE_WAIT_MS = 20;            // Worker poll interval when woken late
+static const size_t GAME_CALL_BYTES = 256;                      // Captures of one posted call
+static const size_t GAME_QUEUE_CAPACITY = 64;
+
+// ============================================================================
+// BOUNDED QUEUE
+// ============================================================================
+
+// Multi-producer / single-consumer ring of trivially copyable items.
+// `capacity` is rounded up to a power of two.
+template <class T>
+class BoundedQueue {
+    static_assert(std::is_trivially_copyable<T>::value, "BoundedQueue copies items with memcpy semantics");
+
+public:
+    explicit BoundedQueue(size_t capacity) : head(0), tail(0) {
+        size_t count = 2;
+        while (count < capacity) count <<= 1;
+        cells = std::vector<Cell>(count);
+        for (size_t i = 0; i < count; i++) cells[i].sequence.store(i, std::memory_order_relaxed);
+        mask = count - 1;
+    }
+
+    // Any thread. False if the queue is full.
+    bool Push(const T& item) {
+        size_t at = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell* cell = &cells[at & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t)sequence - (intptr_t)at;
+            if (difference == 0) {
+                if (tail.compare_exchange_weak(at, at + 1, std::memory_order_relaxed)) {
+                    cell->item = item;
+                    cell->sequence.store(at + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                at = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer only. False if the queue is empty.
+    bool Pop(T* item) {
+        Cell* cell = &cells[head & mask];
+        if (cell->sequence.load(std::memory_order_acquire) != head + 1) {
+            return false;
+        }
+        *item = cell->item;
+        cell->sequence.store(head + mask + 1, std::memory_order_release);
+        head++;
+        return true;
+    }
+
+private:
+    BoundedQueue(const BoundedQueue&);
+    BoundedQueue& operator=(const BoundedQueue&);
+
+    struct Cell {
+        std::atomic<size_t> sequence;   // == position: free; == position + 1: filled
+        T item;
+
+        Cell() : sequence(0), item() {}
+    };
+
+    std::vector<Cell> cells;
+    size_t mask;
+    size_t head;                        // Consumer only
+    std::atomic<size_t> tail;
+};
+
+// ============================================================================
+// WORKER
+// ============================================================================
+
+// Runs a handler for each published message on its own thread
+class ChatWorker {
+public:
+    typedef void (*Handler)(const ChatMessage& message);
+
+    // Slots are released to `messagePool` once their handler has returned
+    explicit ChatWorker(ChatMessagePool* messagePool)
+        : handler(nullptr), pool(messagePool), queue(CHAT_WORKER_CAPACITY), dropped(0), running(false),
+          stopping(false), workerIdle(false) {}
+
+    ~ChatWorker() { Stop(); }
+
+    bool Start(Handler messageHandler) {
+        Stop();
+        handler = messageHandler;
+        dropped.store(0, std::memory_order_relaxed);
+        stopping.store(false, std::memory_order_relaxed);
+        running = true;
+        worker.Start([this]() { WorkerLoop(); });
+        return true;
+    }
+
+    // From the hook: hands the slot to the worker, which releases it. If
+    // the queue is full (the handler is stuck), the slot is released here
+    // and the message counted as dropped.
+    bool Publish(ChatMessage* message) {
+        if (!running || !queue.Push(message)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            pool->Release(message);
+            return false;
+        }
+        if (workerIdle.load(std::memory_order_relaxed)) {
+            wake.notify_one();
+        }
+        return true;
+    }
+
+    // Messages lost because the queue was full
+    uint64_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+
+    // The worker handles what is queued and exits. From DLL_PROCESS_DETACH
+    // pass processExiting = (lpReserved != NULL), as described in
+    // ThreadDone.h: on FreeLibrary Stop waits until the worker has handled
+    // the queue, so a handler must return. At process exit the worker is
+    // already gone: nothing is waited for and what is still queued is
+    // dropped.
+    void Stop(bool processExiting = false) {
+        if (!running) {
+            return;
+        }
+        if (processExiting) {
+            stopping.store(true, std::memory_order_release);
+        } else {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopping.store(true, std::memory_order_release);
+            wake.notify_one();
+        }
+        worker.Stop(processExiting);
+        running = false;
+    }
+
+private:
+    ChatWorker(const ChatWorker&);
+    ChatWorker& operator=(const ChatWorker&);
+
+    size_t Drain() {
+        size_t handled = 0;
+        ChatMessage* message;
+        while (queue.Pop(&message)) {
+            handler(*message);
+            pool->Release(message);
+            handled++;
+        }
+        return handled;
+    }
+
+    void WorkerLoop() {
+        while (!stopping.load(std::memory_order_acquire)) {
+            if (Drain() == 0) {
+                // Publish only notifies while workerIdle is set; a wakeup
+                // lost in between costs at most one CHAT_WORKER_IDLE_WAIT_MS
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                workerIdle.store(true, std::memory_order_relaxed);
+                if (!stopping.load(std::memory_order_acquire)) {
+                    wake.wait_for(lock, std::chrono::milliseconds(CHAT_WORKER_IDLE_WAIT_MS));
+                }
+                workerIdle.store(false, std::memory_order_relaxed);
+            }
+        }
+        Drain();
+    }
+
+    Handler handler;
+    ChatMessagePool* pool;
+    BoundedQueue<ChatMessage*> queue;
+    std::atomic<uint64_t> dropped;
+    bool running;
+    std::atomic<bool> stopping;
+    std::atomic<bool> workerIdle;
+    BackgroundThread worker;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+};
+
+// ============================================================================
+// GAME THREAD QUEUE
+// ============================================================================
+
+// One posted call: a copy of the callable in fixed storage
+struct GameCall {
+    void (*run)(const void* storage);
+    alignas(8) unsigned char storage[GAME_CALL_BYTES];
+};
+
+// Calls posted from the worker (or any thread), run later on the game
+// thread by whatever calls RunPending there: the hooked packet handler,
+// and GameTick.h's window tick, which runs it without chat traffic.
+class GameThreadQueue {
+public:
+    explicit GameThreadQueue(size_t capacity = GAME_QUEUE_CAPACITY) : queue(capacity), dropped(0) {}
+
+    // `call` is copied, with its captures: capture values (char arrays, not
+    // pointers into the message, which is released after the handler).
+    // False if the queue is full.
+    template <class F>
+    bool Post(const F& call) {
+        static_assert(std::is_trivially_copyable<F>::value, "capture plain values only");
+        static_assert(sizeof(F) <= GAME_CALL_BYTES && alignof(F) <= 8, "captures larger than GAME_CALL_BYTES");
+        GameCall entry;
+        entry.run = [](const void* storage) { (*static_cast<const F*>(storage))(); };
+        new (entry.storage) F(call);
+        if (!queue.Push(entry)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // Game thread only: runs up to `limit` posted calls, oldest first.
+    // Returns how many ran.
+    size_t RunPending(size_t limit = GAME_QUEUE_CAPACITY) {
+        size_t ran = 0;
+        GameCall entry;
+        while (ran < limit && queue.Pop(&entry)) {
+            entry.run(entry.storage);
+            ran++;
+        }
+        return ran;
+    }
+
+    // Calls lost because the queue was full
+    uint64_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    GameThreadQueue(const GameThreadQueue&);
+    GameThreadQueue& operator=(const GameThreadQueue&);
+
+    BoundedQueue<GameCall> queue;
+    std::atomic<uint64_t> dropped;
+};
+
+} // namespace HookLib
@@ -0,0 +1,119 @@
+// FunctionStarts.h - Where functions start, from a linear sweep of the code
+//
+// No symbols, so starts are guessed from what the image gives:
+//
+//   - the entry point
+//   - every call rel32 target
+//   - every pointer into the image found in .data / .rdata (vtables,
+//     callbacks: a virtual function is never called directly)
+//   - the first FUNCTION_ALIGNMENT-aligned byte after CC padding
+//
+// Each candidate only counts if the sweep decoded an instruction there.
+// XrefIndex.h and tools/FunctionIndex.h both use these, so the two agree on
+// what a function is.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#include "SectionScan.h"
+#include "X86Decode.h"
+
+namespace HookLib {
+
+static const size_t FUNCTION_ALIGNMENT = 16;       // MSVC function alignment after padding
+
+// Decodes pe's bytes from `from` to `end`, stepping over bytes that do not
+// decode, with instructions cut at `limit` (the end of the section). From
+// `begin` on, marks each instruction in instructionStart, calls
+// onInstruction(offset, instruction), and adds the first aligned byte after
+// CC padding to `starts`. Starting before `begin` lets a chunk of a section
+// fall in step with the instruction stream first.
+template <typename Start, typename OnInstruction>
+inline void SweepFunctionCode(const PeImage& pe, size_t from, size_t begin, size_t end, size_t limit,
+                              uint8_t* instructionStart, std::vector<Start>* starts, OnInstruction onInstruction) {
+    const uint8_t* data = pe.Data();
+    X86Mode mode = pe.Is64Bit() ? X86_MODE_64 : X86_MODE_32;
+    size_t at = from;
+    bool padding = false;
+    while (at < end) {
+        if (data[at] == 0xCC) {
+            padding = true;
+            at++;
+            continue;
+        }
+        if (padding && at >= begin && pe.OffsetToRva(at) % FUNCTION_ALIGNMENT == 0) {
+            starts->push_back((Start)at);
+        }
+        padding = false;
+
+        X86Instruction ins;
+        if (!DecodeX86(data + at, limit - at, mode, &ins)) {
+            at++;
+            continue;
+        }
+        if (at >= begin) {
+            instructionStart[at] = 1;
+            onInstruction(at, ins);
+        }
+        at += ins.length;
+    }
+}
+
+// Branch or RIP-relative target of the instruction at buffer offset `at`,
+// as a buffer offset; NPOS if it has none or the target has no bytes here.
+// Goes through the RVAs: in file layout, sections are not at their RVA
+// distance from each other.
+inline size_t CodeTarget(const PeImage& pe, const X86Instruction& ins, size_t at) {
+    size_t target = ins.Target(pe.Data(), at);
+    if (target == NPOS || pe.Layout() == PE_LAYOUT_MAPPED) {
+        return target;
+    }
+    size_t rva = pe.OffsetToRva(at);
+    return (rva == NPOS) ? NPOS : pe.RvaToOffset(rva + (target - at));
+}
+
+// True for call rel32
+inline bool IsCallRel32(const X86Instruction& ins) {
+    return ins.opcodeMap == 1 && ins.opcode == 0xE8 && ins.relative && ins.immSize == 4;
+}
+
+// Turns the candidates in `starts` (sweep results, call targets) into
+// function starts: keeps those on an instruction, adds the entry point and
+// the code pointers in the data sections, sorts and drops duplicates.
+// instructionStart has one byte per buffer byte, as filled by the sweep.
+template <typename Start>
+inline void FinishFunctionStarts(const PeImage& pe, const uint8_t* instructionStart, std::vector<Start>* starts) {
+    size_t size = pe.Size();
+    size_t kept = 0;
+    for (size_t i = 0; i < starts->size(); i++) {
+        size_t offset = (size_t)(*starts)[i];
+        if (offset < size && instructionStart[offset]) (*starts)[kept++] = (Start)offset;
+    }
+    starts->resize(kept);
+
+    size_t entry = pe.RvaToOffset(pe.entryPoint);
+    if (pe.entryPoint != 0 && entry < size && instructionStart[entry]) starts->push_back((Start)entry);
+
+    // Aligned pointers in .data / .rdata that hit an instruction start
+    std::vector<ScanRegion> data;
+    CollectScanRegions(pe, SIGNATURE_DATA, &data);
+    bool noDataSections = data.size() == 1 && data[0].begin == 0 && data[0].end == size;
+    size_t width = pe.Is64Bit() ? 8 : 4;
+    for (size_t r = 0; r < data.size() && !noDataSections; r++) {
+        for (size_t at = (data[r].begin + width - 1) / width * width; at + width <= data[r].end; at += width) {
+            uint64_t value = (width == 8) ? ReadLe64(pe.Data() + at) : ReadLe32(pe.Data() + at);
+            if (value < pe.imageBase || value - pe.imageBase >= pe.sizeOfImage) continue;
+            size_t offset = pe.RvaToOffset((size_t)(value - pe.imageBase));
+            if (offset < size && instructionStart[offset]) starts->push_back((Start)offset);
+        }
+    }
+
+    std::sort(starts->begin(), starts->end());
+    starts->erase(std::unique(starts->begin(), starts->end()), starts->end());
+}
+
+} // namespace HookLib
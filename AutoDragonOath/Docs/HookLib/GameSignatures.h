@@ -0,0 +1,374 @@
+// GameSignatures.h - Signature table for every Game.exe hook target
+//
+// All DLL variants resolve this whole table in one pass over the module
+// (MultiPatternScan.h) and then pick the entry they want to hook. Code
+// signatures are only searched in executable sections (SectionScan.h). Add new
+// targets here rather than as one-off byte arrays in a DLL source; the
+// extra cost per signature is close to zero.
+
+#pragma once
+
+#include "AddressCache.h"
+#include "ApproxScan.h"
+#include "CandidateScan.h"
+#include "ParallelScan.h"
+#include "Relocations.h"
+#include "SectionScan.h"
+#include "Signature.h"
+#include "XrefIndex.h"
+
+namespace HookLib {
+
+enum GameSignatureId {
+    SIG_HANDLE_RECV_TALK_PACKET_1 = 0,  // Memory scanner result, 0x0048D6F0
+    SIG_HANDLE_RECV_TALK_PACKET_2,      // Memory scanner result, 0x0048D790
+    SIG_GCCHAT_HANDLER_EXECUTE,         // Placeholder from source analysis
+    SIG_GENERIC_TALK_PROLOGUE,          // Short prologue used by the examples
+    SIG_COUNT
+};
+
+// Targets usually move only a few KB between client patches
+static const size_t DEFAULT_HINT_RADIUS = 0x10000;
+
+struct GameSignature {
+    const char* name;
+    PatternView pattern;
+    SignatureRangeFinder find;  // Matcher specialized for this signature (Signature.h)
+    SignatureKind kind;         // Which sections a full scan searches
+    size_t expectedRva;         // Last known offset from the module base (0 = unknown)
+    size_t searchRadius;        // How far from expectedRva to look before a full scan
+    const CandidateVerifier* verifiers;   // Extra checks on every match (CandidateScan.h)
+    size_t verifierCount;
+    const XrefRule* xrefs;      // Checked after the full scan, on one shared XrefIndex
+    size_t xrefCount;
+};
+
+#define HOOKLIB_GAME_SIGNATURE(name, signature, kind, expectedRva, searchRadius) \
+    { name, signature.View(), &::HookLib::FindSignatureRange<signature>, kind, expectedRva, searchRadius, \
+      nullptr, 0, nullptr, 0 }
+
+// Same, with a static array of CandidateVerifiers every match must pass
+#define HOOKLIB_GAME_SIGNATURE_VERIFIED(name, signature, kind, expectedRva, searchRadius, verifiers) \
+    { name, signature.View(), &::HookLib::FindSignatureRange<signature>, kind, expectedRva, searchRadius, \
+      verifiers, sizeof(verifiers) / sizeof(verifiers[0]), nullptr, 0 }
+
+// Same, with a static array of XrefRules (XrefIndex.h) every match must pass.
+// Such entries are only resolved by the full scan.
+#define HOOKLIB_GAME_SIGNATURE_XREF(name, signature, kind, expectedRva, searchRadius, xrefs) \
+    { name, signature.View(), &::HookLib::FindSignatureRange<signature>, kind, expectedRva, searchRadius, \
+      nullptr, 0, xrefs, sizeof(xrefs) / sizeof(xrefs[0]) }
+
+// __security_cookie in the analysed build (mov eax, [00644904h] in HandleRecvTalkPacket)
+static const uint32_t GAME_SECURITY_COOKIE_VA = 0x00644904;
+
+// push ebp; mov ebp, esp; sub esp, 118h; mov eax, [security cookie]; push ebx; mov ebx, [...]
+static constexpr auto kHandleRecvTalkPacket1 =
+    HOOKLIB_SIGNATURE("55 8B EC 81 EC 18 01 00 00 A1 04 49 64 00 53 8B 1D 84 A3 5E");
+
+// Same prologue with sub esp, 11Ch
+static constexpr auto kHandleRecvTalkPacket2 =
+    HOOKLIB_SIGNATURE("55 8B EC 81 EC 1C 01 00 00 A1 04 49 64 00 53 8B 1D 84 A3 5E");
+
+// Placeholder from source analysis (YOU NEED TO UPDATE THIS)
+static constexpr auto kGCChatHandlerExecute =
+    HOOKLIB_SIGNATURE("55 8B EC 83 EC ?? 53 56 57 8B F9 89 7D ??");
+
+// The NULL-packet TDAssert near the top pushes the handler's name
+// (IDA_Visual_Guide_Verification.md, "push offset aGcchathandler"), which
+// tells it apart from every other function with this prologue.
+static constexpr XrefRule kGCChatHandlerExecuteXrefs[] = {
+    XrefReferencesString("GCChatHandler"),
+};
+
+static constexpr auto kGenericTalkPrologue =
+    HOOKLIB_SIGNATURE("55 8B EC 83 EC ?? 53 56 57 8B F9");
+
+// The prologue alone matches hundreds of functions. The talk handlers are
+// /GS-protected, so keep only candidates that read the security cookie.
+static constexpr CandidateVerifier kGenericTalkPrologueVerifiers[] = {
+    VerifyReferencesAddress(GAME_SECURITY_COOKIE_VA, 0x20),
+};
+
+static constexpr GameSignature kGameSignatures[SIG_COUNT] = {
+    HOOKLIB_GAME_SIGNATURE("HandleRecvTalkPacket#1", kHandleRecvTalkPacket1, SIGNATURE_CODE, 0x8D6F0, DEFAULT_HINT_RADIUS),
+    HOOKLIB_GAME_SIGNATURE("HandleRecvTalkPacket#2", kHandleRecvTalkPacket2, SIGNATURE_CODE, 0x8D790, DEFAULT_HINT_RADIUS),
+    HOOKLIB_GAME_SIGNATURE_XREF("GCChatHandler::Execute", kGCChatHandlerExecute, SIGNATURE_CODE, 0, 0,
+                                kGCChatHandlerExecuteXrefs),
+    HOOKLIB_GAME_SIGNATURE_VERIFIED("GenericTalkPrologue", kGenericTalkPrologue, SIGNATURE_CODE, 0, 0,
+                                    kGenericTalkPrologueVerifiers),
+};
+
+inline void AddGameSignatures(MultiPatternScanner* scanner) {
+    for (int i = 0; i < SIG_COUNT; i++) {
+        scanner->Add(kGameSignatures[i].pattern, kGameSignatures[i].verifiers, kGameSignatures[i].verifierCount);
+    }
+}
+
+// Resolves the whole table with one pass per signature kind over the
+// matching sections of `pe`, split across `threads` workers (see
+// ParallelScan.h for the loader-lock caveat). Bytes on relocated slots are
+// ignored (Relocations.h). Entries with XrefRules are then filtered against
+// one XrefIndex, built only if one of them has candidates. Offsets are
+// buffer offsets.
+inline void ScanGameSignatures(const PeImage& pe, MultiScanMatches* matches, unsigned threads = 1) {
+    matches->assign(SIG_COUNT, std::vector<size_t>());
+
+    RelocationTable relocations;
+    relocations.Load(pe);
+
+    for (int kind = 0; kind < SIGNATURE_KIND_COUNT; kind++) {
+        MultiPatternScanner scanner;
+        scanner.SetRelocations(&relocations);
+        std::vector<int> ids;
+        for (int i = 0; i < SIG_COUNT; i++) {
+            if (kGameSignatures[i].kind == kind) {
+                scanner.Add(kGameSignatures[i].pattern, kGameSignatures[i].verifiers,
+                            kGameSignatures[i].verifierCount);
+                ids.push_back(i);
+            }
+        }
+        if (ids.empty()) {
+            continue;
+        }
+
+        scanner.Build();
+        MultiScanMatches local;
+        ScanSections(scanner, pe, &local, (SignatureKind)kind, threads);
+        for (size_t j = 0; j < ids.size(); j++) {
+            (*matches)[ids[j]].swap(local[j]);
+        }
+    }
+
+    bool needXrefs = false;
+    for (int i = 0; i < SIG_COUNT; i++) {
+        if (kGameSignatures[i].xrefCount != 0 && !(*matches)[i].empty()) needXrefs = true;
+    }
+    if (!needXrefs) {
+        return;
+    }
+
+    XrefIndex xrefs;
+    xrefs.Build(pe, threads);
+    for (int i = 0; i < SIG_COUNT; i++) {
+        FilterByXrefRules(xrefs, pe, kGameSignatures[i].xrefs, kGameSignatures[i].xrefCount, *matches,
+                          &(*matches)[i]);
+    }
+}
+
+// Same for a loaded module (or a dump of one) at image[0, size)
+inline void ScanGameSignatures(const uint8_t* image, size_t size, MultiScanMatches* matches,
+                               unsigned threads = 1) {
+    PeImage pe;
+    pe.Parse(image, size, PE_LAYOUT_MAPPED);
+    ScanGameSignatures(pe, matches, threads);
+}
+
+// Signature match plus the entry's verifiers at image + offset
+inline bool GameSignatureMatchesAt(const GameSignature& signature, const uint8_t* image, size_t size,
+                                   size_t offset) {
+    return offset <= size && signature.pattern.length <= size - offset &&
+           MatchAt(image + offset, signature.pattern) &&
+           PassesVerifiers(signature.verifiers, signature.verifierCount, image, size, offset);
+}
+
+// Checks each signature in preference[] around its expectedRva, in order.
+// Returns the offset of the first hit, or NPOS when none of them is near its
+// hint; the caller then falls back to ScanGameSignatures. Stops at the first
+// entry without an expectedRva or with XrefRules, since only a full scan can
+// tell whether that more-preferred target exists. *chosen receives the signature id
+// (SIG_COUNT when nothing was found).
+inline size_t FindGameSignatureNearHint(const uint8_t* image, size_t size, const int* preference,
+                                        size_t count, int* chosen) {
+    for (size_t i = 0; i < count; i++) {
+        const GameSignature& signature = kGameSignatures[preference[i]];
+        if (signature.expectedRva == 0 || signature.xrefCount != 0) {
+            break;
+        }
+
+        size_t offset = FindNearWith(signature.find, signature.pattern.length, image, size,
+                                     signature.expectedRva, signature.searchRadius);
+        if (offset != NPOS && !PassesVerifiers(signature.verifiers, signature.verifierCount, image, size, offset)) {
+            break;   // Nearest hit is a look-alike; let the full scan decide
+        }
+        if (offset != NPOS) {
+            *chosen = preference[i];
+            return offset;
+        }
+    }
+    *chosen = SIG_COUNT;
+    return NPOS;
+}
+
+// Returns the first match of the first signature in preference[] that matched,
+// or NPOS. *chosen receives the signature id (SIG_COUNT when nothing matched).
+inline size_t PickResolvedSignature(const MultiScanMatches& matches, const int* preference,
+                                    size_t count, int* chosen) {
+    for (size_t i = 0; i < count; i++) {
+        int id = preference[i];
+        if (!matches[id].empty()) {
+            *chosen = id;
+            return matches[id][0];
+        }
+    }
+    *chosen = SIG_COUNT;
+    return NPOS;
+}
+
+// ============================================================================
+// APPROXIMATE FALLBACK
+// ============================================================================
+
+// One mismatch is tolerated per this many exact bytes (and never more than
+// APPROX_RESOLVE_MAX_MISMATCHES), so short signatures stay strict.
+static const size_t APPROX_BYTES_PER_MISMATCH = 8;
+static const unsigned APPROX_RESOLVE_MAX_MISMATCHES = 2;
+
+inline unsigned GameSignatureMismatchBudget(const GameSignature& signature) {
+    size_t exactBytes = 0;
+    for (size_t j = 0; j < signature.pattern.length; j++) {
+        if (signature.pattern.mask[j] != MASK_WILDCARD) exactBytes++;
+    }
+    size_t budget = exactBytes / APPROX_BYTES_PER_MISMATCH;
+    return (budget > APPROX_RESOLVE_MAX_MISMATCHES) ? APPROX_RESOLVE_MAX_MISMATCHES : (unsigned)budget;
+}
+
+// FindApproxPatterns over the sections for the entry's kind. Candidates
+// that fail the entry's verifiers are dropped. *best is sorted by
+// mismatches, then offset.
+inline void FindGameSignatureApprox(const PeImage& pe, int id, unsigned maxMismatches, size_t maxResults,
+                                    std::vector<ApproxMatch>* best) {
+    const GameSignature& signature = kGameSignatures[id];
+    std::vector<ScanRegion> regions;
+    CollectScanRegions(pe, signature.kind, &regions);
+
+    best->clear();
+    std::vector<ApproxMatch> local;
+    for (size_t r = 0; r < regions.size(); r++) {
+        const ScanRegion& region = regions[r];
+        // Verifiers may drop some, so ask for a few more than needed
+        FindApproxPatterns(pe.Data() + region.begin, region.end - region.begin, signature.pattern,
+                           maxMismatches, maxResults + 8, &local);
+        for (size_t i = 0; i < local.size(); i++) {
+            size_t offset = region.begin + local[i].offset;
+            if (PassesVerifiers(signature.verifiers, signature.verifierCount, pe.Data(), pe.Size(), offset)) {
+                best->push_back(ApproxMatch{ offset, local[i].mismatches });
+            }
+        }
+    }
+
+    std::stable_sort(best->begin(), best->end(), [](const ApproxMatch& a, const ApproxMatch& b) {
+        return a.mismatches < b.mismatches || (a.mismatches == b.mismatches && a.offset < b.offset);
+    });
+    if (best->size() > maxResults) best->resize(maxResults);
+}
+
+// ============================================================================
+// FULL RESOLVE: CACHE -> HINT -> SINGLE-PASS SCAN -> APPROXIMATE
+// ============================================================================
+
+enum ResolveMethod {
+    RESOLVE_NONE = 0,
+    RESOLVE_CACHE,       // Cached RVA for this module fingerprint still matches
+    RESOLVE_HINT,        // Found near expectedRva
+    RESOLVE_FULL_SCAN,   // Whole-module table scan
+    RESOLVE_APPROXIMATE  // No exact match; unique closest match within the mismatch budget
+};
+
+inline const char* ResolveMethodName(ResolveMethod method) {
+    switch (method) {
+        case RESOLVE_CACHE:     return "address cache";
+        case RESOLVE_HINT:      return "expected offset";
+        case RESOLVE_FULL_SCAN: return "full scan";
+        case RESOLVE_APPROXIMATE: return "approximate match";
+        default:                return "not found";
+    }
+}
+
+struct ResolveResult {
+    size_t offset;              // NPOS when nothing matched
+    int signature;              // GameSignatureId, SIG_COUNT when nothing matched
+    ResolveMethod method;
+    unsigned mismatches;        // Differing bytes, only non-zero for RESOLVE_APPROXIMATE
+    MultiScanMatches matches;   // Filled by RESOLVE_FULL_SCAN and RESOLVE_APPROXIMATE
+};
+
+// Resolves the preferred hook target from a module mapped at `image`.
+//   1. Cache: the first preference entry cached for this fingerprint whose
+//      signature still matches at the cached RVA.
+//   2. Hints: FindGameSignatureNearHint.
+//   3. One full ScanGameSignatures pass.
+//   4. Approximate: the first preference entry whose closest match is
+//      unique and within GameSignatureMismatchBudget (e.g. a patch changed
+//      one immediate). The caller should log this; the signature needs an
+//      update. Entries with XrefRules are skipped here.
+// A hit from 2 or 3 is written back to the cache. cachePath may be NULL.
+inline void ResolveGameSignature(const uint8_t* image, size_t size, const int* preference, size_t count,
+                                 const char* cachePath, unsigned threads, ResolveResult* result) {
+    result->offset = NPOS;
+    result->signature = SIG_COUNT;
+    result->method = RESOLVE_NONE;
+    result->mismatches = 0;
+    result->matches.clear();
+
+    ModuleFingerprint fingerprint;
+    bool haveFingerprint = cachePath && ComputeModuleFingerprint(image, size, &fingerprint);
+    AddressCache cache;
+
+    if (haveFingerprint) {
+        cache.Load(cachePath);
+        for (size_t i = 0; i < count; i++) {
+            const GameSignature& signature = kGameSignatures[preference[i]];
+            size_t rva;
+            if (!cache.Lookup(fingerprint, signature.name, &rva)) {
+                continue;
+            }
+
+            if (GameSignatureMatchesAt(signature, image, size, rva)) {
+                result->offset = rva;
+                result->signature = preference[i];
+                result->method = RESOLVE_CACHE;
+                return;
+            }
+            cache.Forget(fingerprint, signature.name);   // Stale entry
+        }
+    }
+
+    int chosen;
+    size_t offset = FindGameSignatureNearHint(image, size, preference, count, &chosen);
+    if (offset != NPOS) {
+        result->method = RESOLVE_HINT;
+    } else {
+        ScanGameSignatures(image, size, &result->matches, threads);
+        offset = PickResolvedSignature(result->matches, preference, count, &chosen);
+        result->method = (offset != NPOS) ? RESOLVE_FULL_SCAN : RESOLVE_NONE;
+    }
+
+    if (offset == NPOS) {
+        PeImage pe;
+        pe.Parse(image, size, PE_LAYOUT_MAPPED);
+        for (size_t i = 0; i < count && offset == NPOS; i++) {
+            unsigned budget = GameSignatureMismatchBudget(kGameSignatures[preference[i]]);
+            if (budget == 0 || kGameSignatures[preference[i]].xrefCount != 0) continue;
+
+            std::vector<ApproxMatch> best;
+            FindGameSignatureApprox(pe, preference[i], budget, 2, &best);
+            if (IsUniqueBestMatch(best)) {
+                result->offset = best[0].offset;
+                result->signature = preference[i];
+                result->method = RESOLVE_APPROXIMATE;
+                result->mismatches = best[0].mismatches;
+                return;   // Not cached: the exact check on the next start would reject it
+            }
+        }
+    }
+
+    result->offset = offset;
+    result->signature = chosen;
+
+    if (haveFingerprint && offset != NPOS) {
+        cache.Store(fingerprint, kGameSignatures[chosen].name, offset);
+        cache.Save(cachePath);
+    }
+}
+
+} // namespace HookLib
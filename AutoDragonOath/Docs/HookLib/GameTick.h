@@ -0,0 +1,131 @@
+// GameTick.h - Runs a GameThreadQueue on the game window's thread, chat or not
+//
+// Posted game calls (ChatWorker.h) used to run only from the chat packet
+// hook, so a call posted by a timer (TimerWheel.h) waited for the next chat
+// message, however long that took. GameTick subclasses the game's main
+// window and runs the queue from its window procedure:
+//
+//   - on every message the window gets (input, paint, the game's own), and
+//   - on a WM_TIMER of its own every GAME_TICK_MS, set from the window
+//     procedure the first time it runs, so the queue also runs with no
+//     input and no chat.
+//
+// The game's window thread is its main thread, the one that handles the
+// packets and may call the game functions. Windows only; one per process.
+
+#pragma once
+
+#include <windows.h>
+
+#include "ChatWorker.h"
+
+namespace HookLib {
+
+static const UINT GAME_TICK_MS = 10;                    // Longest a posted call waits with the game idle
+static const UINT_PTR GAME_TICK_TIMER_ID = 0x48544B;    // "HTK": not one of the game's timers
+static const unsigned GAME_TICK_FIND_WAIT_MS = 30000;   // For the game to create its window
+static const unsigned GAME_TICK_FIND_POLL_MS = 100;
+
+class GameTick {
+public:
+    // Finds the process's main window, waiting up to `waitMs` for it, and
+    // subclasses it. Not from DllMain (the wait): from HookInitThread.
+    static bool Install(GameThreadQueue* queue, unsigned waitMs = GAME_TICK_FIND_WAIT_MS) {
+        State& state = GetState();
+        if (state.window != NULL) {
+            return true;
+        }
+        HWND window = NULL;
+        for (unsigned waited = 0; window == NULL; waited += GAME_TICK_FIND_POLL_MS) {
+            EnumWindows(FindMainWindow, (LPARAM)&window);
+            if (window != NULL) break;
+            if (waited >= waitMs) return false;
+            Sleep(GAME_TICK_FIND_POLL_MS);
+        }
+
+        state.queue = queue;
+        state.unicode = IsWindowUnicode(window) != FALSE;
+        state.timerSet = false;
+        // The window thread may call WindowProc as soon as it is set, so
+        // the procedure it forwards to must already be there
+        state.original = (WNDPROC)(state.unicode ? GetWindowLongPtrW(window, GWLP_WNDPROC)
+                                                 : GetWindowLongPtrA(window, GWLP_WNDPROC));
+        if (state.original == NULL) {
+            return false;
+        }
+        // The A / W variant keeps the window's own character set, so the
+        // game still gets its GBK WM_CHAR
+        LONG_PTR previous = state.unicode ? SetWindowLongPtrW(window, GWLP_WNDPROC, (LONG_PTR)WindowProc)
+                                          : SetWindowLongPtrA(window, GWLP_WNDPROC, (LONG_PTR)WindowProc);
+        if (previous == 0) {
+            state.original = NULL;
+            return false;
+        }
+        state.original = (WNDPROC)previous;     // Someone else may have subclassed it in between
+        state.window = window;
+        PostMessageA(window, WM_NULL, 0, 0);   // Runs WindowProc soon, which sets the timer
+        return true;
+    }
+
+    // Puts the game's window procedure back, if nothing has subclassed the
+    // window after us. Skip at process exit: the window is gone.
+    static void Uninstall() {
+        State& state = GetState();
+        if (state.window == NULL) {
+            return;
+        }
+        LONG_PTR current = state.unicode ? GetWindowLongPtrW(state.window, GWLP_WNDPROC)
+                                         : GetWindowLongPtrA(state.window, GWLP_WNDPROC);
+        if (current == (LONG_PTR)WindowProc) {
+            if (state.unicode) {
+                SetWindowLongPtrW(state.window, GWLP_WNDPROC, (LONG_PTR)state.original);
+            } else {
+                SetWindowLongPtrA(state.window, GWLP_WNDPROC, (LONG_PTR)state.original);
+            }
+        }
+        // Fails from another thread; a stray tick then goes to the game's
+        // window procedure, which passes unknown timers on
+        KillTimer(state.window, GAME_TICK_TIMER_ID);
+        state.window = NULL;
+    }
+
+private:
+    struct State {
+        HWND window;
+        WNDPROC original;
+        GameThreadQueue* queue;
+        bool unicode;
+        bool timerSet;          // Window thread only
+    };
+
+    static State& GetState() {
+        static State state = { NULL, NULL, nullptr, false, false };
+        return state;
+    }
+
+    // A visible top-level window of this process without an owner
+    static BOOL CALLBACK FindMainWindow(HWND window, LPARAM found) {
+        DWORD process = 0;
+        GetWindowThreadProcessId(window, &process);
+        if (process != GetCurrentProcessId() || !IsWindowVisible(window) || GetWindow(window, GW_OWNER) != NULL) {
+            return TRUE;
+        }
+        *(HWND*)found = window;
+        return FALSE;
+    }
+
+    static LRESULT CALLBACK WindowProc(HWND window, UINT message, WPARAM wParam, LPARAM lParam) {
+        State& state = GetState();
+        if (!state.timerSet) {
+            state.timerSet = SetTimer(window, GAME_TICK_TIMER_ID, GAME_TICK_MS, NULL) != 0;
+        }
+        state.queue->RunPending();
+        if (message == WM_TIMER && wParam == GAME_TICK_TIMER_ID) {
+            return 0;
+        }
+        return state.unicode ? CallWindowProcW(state.original, window, message, wParam, lParam)
+                             : CallWindowProcA(state.original, window, message, wParam, lParam);
+    }
+};
+
+} // namespace HookLib
@@ -0,0 +1,412 @@
+// LogFormat.h - Compile-time checked log formats with binary arguments
+//
+//     HOOKLIB_LOG(g_Log, HookLib::LOG_INFO, "[Channel %d] %s: %s", channel, sender, text);
+//
+// The format string never reaches printf on the calling thread. Each call
+// site owns a static LogFormat (level, format, file, line, argument kinds),
+// built and checked by the compiler; its address identifies the call site.
+// At run time only the arguments are copied, as raw bytes, into the log
+// ring: integers and doubles by value, strings as a length and their bytes.
+// The writer thread (AsyncLog.h) or the offline decoder (tools/LogDecode)
+// turns format + bytes back into text with FormatLogRecord.
+//
+// Checks: every conversion must have an argument of a matching kind, and
+// the counts must agree; a mismatch fails the build. %n, %ls, %lc and '*'
+// width/precision are not supported. Integer kinds go by size, as in a
+// varargs call: %d takes any 4-byte integer, %lld / %I64d any 8-byte one.
+// %hd and %hhd take a 4-byte integer too and print it cut, as printf does.
+//
+// Levels below HOOKLIB_LOG_MIN_LEVEL are removed at compile time: the call
+// site is still checked, but its arguments are not even evaluated.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
+
+namespace HookLib {
+
+enum LogLevel {
+    LOG_DEBUG = 0,
+    LOG_INFO,
+    LOG_WARNING,
+    LOG_ERROR,
+    LOG_DISABLED    // Never written; as HOOKLIB_LOG_MIN_LEVEL, turns all logging off
+};
+
+// Define before including to change; the default keeps everything but debug
+#ifndef HOOKLIB_LOG_MIN_LEVEL
+#define HOOKLIB_LOG_MIN_LEVEL ::HookLib::LOG_INFO
+#endif
+
+enum LogArgKind : uint8_t {
+    LOG_ARG_INT32 = 0,
+    LOG_ARG_INT64,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_STRING,     // uint16_t length + bytes, no terminator
+    LOG_ARG_POINTER,    // Stored as 8 bytes
+    LOG_ARG_INVALID
+};
+
+static const size_t LOG_MAX_ARGS = 12;
+
+static const char LOG_TRUNCATED_MARK[] = " [...]";     // Appended to cut lines and records
+
+struct LogFormat {
+    LogLevel level;
+    const char* format;
+    const char* file;
+    int line;
+    uint8_t argCount;
+    LogArgKind args[LOG_MAX_ARGS];
+};
+
+inline const char* LogLevelName(LogLevel level) {
+    switch (level) {
+        case LOG_DEBUG:   return "debug";
+        case LOG_INFO:    return "info";
+        case LOG_WARNING: return "warning";
+        case LOG_ERROR:   return "error";
+        default:          return "?";
+    }
+}
+
+// ============================================================================
+// ARGUMENT KINDS
+// ============================================================================
+
+template <class T>
+constexpr LogArgKind LogArgKindOf() {
+    typedef typename std::decay<T>::type D;
+    if (std::is_same<D, const char*>::value || std::is_same<D, char*>::value) return LOG_ARG_STRING;
+    if (std::is_pointer<D>::value) return LOG_ARG_POINTER;
+    if (std::is_floating_point<D>::value) return LOG_ARG_DOUBLE;
+    if (std::is_integral<D>::value || std::is_enum<D>::value) return (sizeof(D) <= 4) ? LOG_ARG_INT32 : LOG_ARG_INT64;
+    return LOG_ARG_INVALID;
+}
+
+template <class... T>
+constexpr LogFormat MakeLogFormat(LogLevel level, const char* format, const char* file, int line) {
+    LogFormat result = { level, format, file, line, (uint8_t)sizeof...(T), {} };
+    LogArgKind kinds[] = { LogArgKindOf<T>()..., LOG_ARG_INVALID };
+    for (size_t i = 0; i < sizeof...(T) && i < LOG_MAX_ARGS; i++) result.args[i] = kinds[i];
+    return result;
+}
+
+// Argument types of a call site as a value, for HOOKLIB_LOG: the arguments
+// only appear inside decltype, so they are not evaluated there
+template <class... T>
+struct LogArgTypes {};
+
+template <class... T>
+LogArgTypes<T...> LogArgList(const T&...);
+
+template <class... T>
+constexpr LogFormat MakeLogFormat(LogArgTypes<T...>, LogLevel level, const char* format, const char* file, int line) {
+    return MakeLogFormat<T...>(level, format, file, line);
+}
+
+// ============================================================================
+// FORMAT STRING PARSING (shared by the compile-time check and the formatter)
+// ============================================================================
+
+// One conversion: text[begin, end) is the whole "%-08.3lld" spec
+struct LogSpec {
+    size_t begin;
+    size_t end;
+    size_t lengthBegin;     // Length modifier position in text
+    size_t lengthEnd;
+    char conversion;        // '%' for a literal percent sign, 0 if malformed
+    LogArgKind kind;        // What the conversion takes
+    bool eitherInt;         // 'l': 4 or 8 bytes, depending on the compiler
+};
+
+constexpr bool IsLogFlag(char c) {
+    return c == '-' || c == '+' || c == ' ' || c == '#' || c == '0';
+}
+
+// Parses the spec starting at text[at] == '%'
+constexpr LogSpec ParseLogSpec(const char* text, size_t at) {
+    LogSpec spec = { at, at + 1, 0, 0, 0, LOG_ARG_INVALID, false };
+    size_t i = at + 1;
+    if (text[i] == '%') {
+        spec.end = i + 1;
+        spec.conversion = '%';
+        return spec;
+    }
+    while (IsLogFlag(text[i])) i++;
+    while (text[i] >= '0' && text[i] <= '9') i++;
+    if (text[i] == '.') {
+        i++;
+        while (text[i] >= '0' && text[i] <= '9') i++;
+    }
+
+    spec.lengthBegin = i;
+    int longs = 0;
+    bool wide64 = false, sizeT = false, shortInt = false, longDouble = false;
+    if (text[i] == 'h') {
+        shortInt = true;
+        i += (text[i + 1] == 'h') ? 2 : 1;
+    } else if (text[i] == 'l') {
+        longs = (text[i + 1] == 'l') ? 2 : 1;
+        i += longs;
+    } else if (text[i] == 'I' && text[i + 1] == '6' && text[i + 2] == '4') {
+        wide64 = true;
+        i += 3;
+    } else if (text[i] == 'z' || text[i] == 'j' || text[i] == 't') {
+        sizeT = text[i] == 'z' || text[i] == 't';
+        wide64 = text[i] == 'j';
+        i++;
+    } else if (text[i] == 'L') {
+        longDouble = true;
+        i++;
+    }
+    spec.lengthEnd = i;
+
+    char c = text[i];
+    spec.end = i + 1;
+    switch (c) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            if (longDouble) return spec;
+            if (c == 'c' && spec.lengthEnd != spec.lengthBegin) return spec;   // No %lc, and %hc means nothing
+            spec.conversion = c;
+            if (longs == 2 || wide64) {
+                spec.kind = LOG_ARG_INT64;
+            } else if (sizeT) {
+                spec.kind = (sizeof(size_t) == 8) ? LOG_ARG_INT64 : LOG_ARG_INT32;
+            } else if (longs == 1) {
+                spec.kind = (sizeof(long) == 8) ? LOG_ARG_INT64 : LOG_ARG_INT32;
+                spec.eitherInt = true;
+            } else {
+                spec.kind = LOG_ARG_INT32;
+            }
+            return spec;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            if (longs != 0 || wide64 || sizeT || shortInt) return spec;
+            spec.conversion = c;
+            spec.kind = LOG_ARG_DOUBLE;
+            return spec;
+        case 's':
+            if (spec.lengthEnd != spec.lengthBegin) return spec;   // No %ls
+            spec.conversion = c;
+            spec.kind = LOG_ARG_STRING;
+            return spec;
+        case 'p':
+            if (spec.lengthEnd != spec.lengthBegin) return spec;
+            spec.conversion = c;
+            spec.kind = LOG_ARG_POINTER;
+            return spec;
+        default:
+            return spec;   // %n, '*', unknown or cut off
+    }
+}
+
+// True if the conversions of `format` take exactly the given argument kinds
+constexpr bool LogFormatMatches(const LogFormat& format) {
+    const char* text = format.format;
+    size_t arg = 0;
+    for (size_t i = 0; text[i] != '\0'; i++) {
+        if (text[i] != '%') continue;
+        LogSpec spec = ParseLogSpec(text, i);
+        if (spec.conversion == 0) return false;
+        i = spec.end - 1;
+        if (spec.conversion == '%') continue;
+        if (arg >= format.argCount) return false;
+        LogArgKind kind = format.args[arg++];
+        bool intSpec = spec.kind == LOG_ARG_INT32 || spec.kind == LOG_ARG_INT64;
+        bool intArg = kind == LOG_ARG_INT32 || kind == LOG_ARG_INT64;
+        if (kind != spec.kind && !(spec.eitherInt && intSpec && intArg)) return false;
+    }
+    return arg == format.argCount && format.argCount <= LOG_MAX_ARGS;
+}
+
+// ============================================================================
+// BINARY LOG FILE
+// ============================================================================
+
+// AsyncLog with LOG_OUTPUT_BINARY writes the records as they are queued and
+// leaves all formatting to tools/LogDecode. All values little-endian.
+//
+//   file header   "HLOG", uint16 version
+//   SESSION       int64 time                        (each Open; format ids restart)
+//   FORMAT        uint32 id, uint8 level, uint8 argCount, uint8 kinds[argCount],
+//                 uint32 line, uint16 + file, uint16 + format
+//   RECORD        uint32 id, int64 time, uint8 truncated, uint16 + argument bytes
+//   TEXT          int64 time, uint8 truncated, uint16 + text   (printf-style Write)
+//   DROPPED       int64 time, uint64 count
+//
+// Each entry starts with its uint8 type; a FORMAT entry precedes the first
+// RECORD that uses its id. Times are microseconds since the Unix epoch.
+static const char LOG_FILE_MAGIC[4] = { 'H', 'L', 'O', 'G' };
+static const uint16_t LOG_FILE_VERSION = 1;
+
+enum LogEntryType : uint8_t {
+    LOG_ENTRY_SESSION = 0,
+    LOG_ENTRY_FORMAT,
+    LOG_ENTRY_RECORD,
+    LOG_ENTRY_TEXT,
+    LOG_ENTRY_DROPPED
+};
+
+// ============================================================================
+// PACKING (calling thread)
+// ============================================================================
+
+// Appends arguments to a fixed buffer. A string that does not fit is cut,
+// everything after it is dropped and `truncated` is set.
+struct LogArgWriter {
+    uint8_t* at;
+    uint8_t* end;
+    bool truncated;
+
+    void PutBytes(const void* bytes, size_t count) {
+        if ((size_t)(end - at) < count) {
+            truncated = true;
+            at = end;
+            return;
+        }
+        memcpy(at, bytes, count);
+        at += count;
+    }
+
+    void Put(const char* text) {
+        size_t length = (text != nullptr) ? strlen(text) : 0;
+        size_t room = ((size_t)(end - at) > sizeof(uint16_t)) ? (size_t)(end - at) - sizeof(uint16_t) : 0;
+        if (length > room || length > 0xFFFF) {
+            truncated = true;
+            length = (room > 0xFFFF) ? 0xFFFF : room;
+        }
+        uint16_t stored = (uint16_t)length;
+        PutBytes(&stored, sizeof(stored));
+        PutBytes(text, length);
+    }
+    void Put(char* text) { Put((const char*)text); }
+
+    template <class T>
+    void Put(T value) {
+        constexpr LogArgKind kind = LogArgKindOf<T>();
+        if constexpr (kind == LOG_ARG_INT32) {
+            int32_t v = (int32_t)value;
+            PutBytes(&v, sizeof(v));
+        } else if constexpr (kind == LOG_ARG_INT64) {
+            int64_t v = (int64_t)value;
+            PutBytes(&v, sizeof(v));
+        } else if constexpr (kind == LOG_ARG_DOUBLE) {
+            double v = (double)value;
+            PutBytes(&v, sizeof(v));
+        } else if constexpr (kind == LOG_ARG_POINTER) {
+            uint64_t v = (uint64_t)(uintptr_t)value;
+            PutBytes(&v, sizeof(v));
+        }
+    }
+};
+
+template <class... T>
+inline void PackLogArgs(LogArgWriter* writer, const T&... args) {
+    (writer->Put(args), ...);
+}
+
+// ============================================================================
+// FORMATTING (writer thread / decoder)
+// ============================================================================
+
+// snprintf of one value appended to *out; a result longer than the scratch
+// buffer (a wide field, "%.300f") is formatted again at its full size
+template <class T>
+inline int AppendLogValue(std::string* out, const char* spec, T value) {
+    char scratch[512];
+    int written = snprintf(scratch, sizeof(scratch), spec, value);
+    if (written < 0) return written;
+    if ((size_t)written < sizeof(scratch)) {
+        out->append(scratch, (size_t)written);
+    } else {
+        size_t at = out->size();
+        out->resize(at + (size_t)written + 1);
+        snprintf(&(*out)[at], (size_t)written + 1, spec, value);
+        out->resize(at + (size_t)written);
+    }
+    return written;
+}
+
+// Formats `format` with the packed arguments args[0, bytes) whose kinds are
+// kinds[0, count), appending to *out. Arguments missing from a cut record
+// print as "?".
+inline void FormatLogRecord(const char* format, const LogArgKind* kinds, size_t count, const uint8_t* args,
+                            size_t bytes, std::string* out) {
+    size_t arg = 0;
+    size_t at = 0;
+    char spec[32];
+    std::string text;
+
+    for (size_t i = 0; format[i] != '\0'; i++) {
+        if (format[i] != '%') {
+            out->push_back(format[i]);
+            continue;
+        }
+        LogSpec parsed = ParseLogSpec(format, i);
+        i = parsed.end - 1;
+        if (parsed.conversion == '%') {
+            out->push_back('%');
+            continue;
+        }
+        if (parsed.conversion == 0 || arg >= count) {
+            out->append(format + parsed.begin, parsed.end - parsed.begin);
+            continue;
+        }
+        LogArgKind kind = kinds[arg++];
+
+        // The spec without its length modifier, plus the one the stored kind
+        // needs; h and hh stay, they cut the value rather than size it
+        size_t prefix = parsed.lengthBegin - parsed.begin;
+        if (prefix + 4 >= sizeof(spec)) prefix = sizeof(spec) - 5;
+        memcpy(spec, format + parsed.begin, prefix);
+        size_t n = prefix;
+        if (kind == LOG_ARG_INT64 && parsed.conversion != 'c') {
+            spec[n++] = 'l';
+            spec[n++] = 'l';
+        } else if (kind == LOG_ARG_INT32 && format[parsed.lengthBegin] == 'h') {
+            for (size_t h = parsed.lengthBegin; h < parsed.lengthEnd; h++) spec[n++] = 'h';
+        }
+        spec[n++] = parsed.conversion;
+        spec[n] = '\0';
+
+        int written = -1;
+        if (kind == LOG_ARG_INT32 && bytes - at >= 4) {
+            int32_t v;
+            memcpy(&v, args + at, 4);
+            at += 4;
+            written = AppendLogValue(out, spec, v);
+        } else if (kind == LOG_ARG_INT64 && bytes - at >= 8) {
+            int64_t v;
+            memcpy(&v, args + at, 8);
+            at += 8;
+            written = (parsed.conversion == 'c') ? AppendLogValue(out, spec, (int)v)
+                                                 : AppendLogValue(out, spec, (long long)v);
+        } else if (kind == LOG_ARG_DOUBLE && bytes - at >= 8) {
+            double v;
+            memcpy(&v, args + at, 8);
+            at += 8;
+            written = AppendLogValue(out, spec, v);
+        } else if (kind == LOG_ARG_POINTER && bytes - at >= 8) {
+            uint64_t v;
+            memcpy(&v, args + at, 8);
+            at += 8;
+            written = AppendLogValue(out, spec, (void*)(uintptr_t)v);
+        } else if (kind == LOG_ARG_STRING && bytes - at >= 2) {
+            uint16_t length;
+            memcpy(&length, args + at, 2);
+            at += 2;
+            if (length > bytes - at) length = (uint16_t)(bytes - at);
+            text.assign((const char*)args + at, length);
+            at += length;
+            written = AppendLogValue(out, spec, text.c_str());
+        }
+        if (written < 0) out->push_back('?');
+    }
+}
+
+} // namespace HookLib
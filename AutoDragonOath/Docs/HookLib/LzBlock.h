@@ -0,0 +1,214 @@
+// LzBlock.h - Small LZ77 block codec with an optional prefix dictionary
+//
+// Used by ChatArchive.h to compress blocks of chat records. Same family and
+// the same trade-off as LZ4: greedy matching through one hash table, no
+// entropy coding, so decompression is mostly memcpy. Nothing outside
+// HookLib is needed to build the DLLs.
+//
+// A block is a series of sequences:
+//   token     high nibble: literal count, low nibble: match length - 4
+//             (15 in either: more follows as bytes of 255, ending below 255)
+//   literals
+//   offset    uint16, 1..65535 bytes back          (absent in the last one)
+//
+// The last sequence has only literals. Blocks are independent; a match may
+// reach back into the dictionary, which then counts as the bytes directly
+// before the block. Short chat lines share little with each other but a lot
+// with a dictionary of common phrases and names.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace HookLib {
+
+static const size_t LZ_MIN_MATCH = 4;
+static const size_t LZ_MAX_OFFSET = 0xFFFF;
+static const unsigned LZ_HASH_BITS = 14;
+static const size_t LZ_TAIL_LITERALS = 5;       // Matches stop this far from the end
+
+// Worst case for n input bytes (all literals)
+inline size_t LzBound(size_t n) {
+    return n + n / 255 + 16;
+}
+
+// Compressor state: a hash table of positions, reused across blocks
+struct LzWork {
+    std::vector<uint32_t> table;
+    std::vector<uint8_t> window;    // Dictionary + block, so both are one address space
+};
+
+inline uint32_t LzHash(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+inline uint8_t* LzPutLength(uint8_t* at, size_t length) {
+    while (length >= 255) {
+        *at++ = 255;
+        length -= 255;
+    }
+    *at++ = (uint8_t)length;
+    return at;
+}
+
+inline uint8_t* LzPutSequence(uint8_t* at, const uint8_t* literals, size_t literalCount, size_t matchLength,
+                              size_t offset) {
+    uint8_t* token = at++;
+    size_t matchCode = (matchLength != 0) ? matchLength - LZ_MIN_MATCH : 0;
+    *token = (uint8_t)(((literalCount < 15) ? literalCount : 15) << 4 | ((matchCode < 15) ? matchCode : 15));
+    if (literalCount >= 15) at = LzPutLength(at, literalCount - 15);
+    if (literalCount != 0) memcpy(at, literals, literalCount);
+    at += literalCount;
+    if (matchLength != 0) {
+        *at++ = (uint8_t)offset;
+        *at++ = (uint8_t)(offset >> 8);
+        if (matchCode >= 15) at = LzPutLength(at, matchCode - 15);
+    }
+    return at;
+}
+
+// Compresses src[0, size) into dst, which must hold LzBound(size) bytes.
+// `dictionary` may be NULL. Returns the compressed size.
+inline size_t LzCompress(const uint8_t* src, size_t size, const uint8_t* dictionary, size_t dictionarySize,
+                         uint8_t* dst, LzWork* work) {
+    if (dictionarySize > LZ_MAX_OFFSET) {
+        dictionary += dictionarySize - LZ_MAX_OFFSET;   // Only the last 64 KB can be reached
+        dictionarySize = LZ_MAX_OFFSET;
+    }
+    work->window.resize(dictionarySize + size);
+    if (dictionarySize != 0) memcpy(&work->window[0], dictionary, dictionarySize);
+    if (size != 0) memcpy(&work->window[dictionarySize], src, size);
+    work->table.assign((size_t)1 << LZ_HASH_BITS, 0);
+
+    const uint8_t* base = work->window.data();
+    uint32_t* table = work->table.data();
+    // Positions are stored + 1, so 0 is "empty"
+    for (size_t i = 0; i + LZ_MIN_MATCH <= dictionarySize; i++) table[LzHash(base + i)] = (uint32_t)i + 1;
+
+    size_t end = dictionarySize + size;
+    size_t matchLimit = (size > LZ_TAIL_LITERALS) ? end - LZ_TAIL_LITERALS : dictionarySize;
+    size_t anchor = dictionarySize;
+    size_t at = dictionarySize;
+    uint8_t* out = dst;
+    unsigned misses = 0;
+
+    while (at + LZ_MIN_MATCH <= matchLimit) {
+        uint32_t h = LzHash(base + at);
+        size_t candidate = table[h];
+        table[h] = (uint32_t)at + 1;
+        if (candidate == 0 || at - (candidate - 1) > LZ_MAX_OFFSET ||
+            memcmp(base + candidate - 1, base + at, LZ_MIN_MATCH) != 0) {
+            at += 1 + (misses++ >> 5);   // Skip faster through data that does not compress
+            continue;
+        }
+        misses = 0;
+        size_t from = candidate - 1;
+
+        size_t length = LZ_MIN_MATCH;
+        while (at + length < matchLimit && base[from + length] == base[at + length]) length++;
+        // Extend backwards over literals that also match
+        while (at > anchor && from > 0 && base[from - 1] == base[at - 1]) {
+            at--;
+            from--;
+            length++;
+        }
+
+        out = LzPutSequence(out, base + anchor, at - anchor, length, at - from);
+        for (size_t i = at + 1; i < at + length && i + LZ_MIN_MATCH <= end; i += 2) {
+            table[LzHash(base + i)] = (uint32_t)i + 1;
+        }
+        at += length;
+        anchor = at;
+    }
+
+    out = LzPutSequence(out, base + anchor, end - anchor, 0, 0);
+    return (size_t)(out - dst);
+}
+
+// Decompresses src[0, size) into exactly rawSize bytes at dst, with the
+// dictionary the block was compressed with. Returns false on corrupt input.
+inline bool LzDecompress(const uint8_t* src, size_t size, const uint8_t* dictionary, size_t dictionarySize,
+                         uint8_t* dst, size_t rawSize) {
+    if (dictionarySize > LZ_MAX_OFFSET) {
+        dictionary += dictionarySize - LZ_MAX_OFFSET;
+        dictionarySize = LZ_MAX_OFFSET;
+    }
+    const uint8_t* in = src;
+    const uint8_t* inEnd = src + size;
+    uint8_t* out = dst;
+    uint8_t* outEnd = dst + rawSize;
+
+    for (;;) {
+        if (in >= inEnd) return false;
+        uint8_t token = *in++;
+
+        size_t literals = token >> 4;
+        if (literals == 15) {
+            uint8_t byte;
+            do {
+                if (in >= inEnd) return false;
+                byte = *in++;
+                literals += byte;
+            } while (byte == 255);
+        }
+        if (literals <= 16 && inEnd - in >= 16 && outEnd - out >= 16) {
+            memcpy(out, in, 16);   // Fixed size: one vector copy; the bytes after are overwritten later
+        } else {
+            if ((size_t)(inEnd - in) < literals || (size_t)(outEnd - out) < literals) return false;
+            if (literals != 0) memcpy(out, in, literals);   // An empty block has no output buffer
+        }
+        in += literals;
+        out += literals;
+
+        if (in == inEnd) {
+            return out == outEnd;   // Last sequence: literals only
+        }
+
+        if (inEnd - in < 2) return false;
+        size_t offset = (size_t)in[0] | (size_t)in[1] << 8;
+        in += 2;
+        size_t length = (token & 15) + LZ_MIN_MATCH;
+        if ((token & 15) == 15) {
+            uint8_t byte;
+            do {
+                if (in >= inEnd) return false;
+                byte = *in++;
+                length += byte;
+            } while (byte == 255);
+        }
+
+        size_t produced = (size_t)(out - dst);
+        if (offset == 0 || offset > produced + dictionarySize || (size_t)(outEnd - out) < length) return false;
+        if (offset > produced) {
+            // Starts in the dictionary, may run on into the block
+            size_t fromDictionary = offset - produced;
+            const uint8_t* from = dictionary + dictionarySize - fromDictionary;
+            size_t count = (length < fromDictionary) ? length : fromDictionary;
+            memcpy(out, from, count);
+            out += count;
+            length -= count;
+            offset = (size_t)(out - dst);   // The rest copies from the block start
+        }
+        const uint8_t* from = out - offset;
+        if (offset >= 16 && length <= 32 && outEnd - out >= 32) {
+            // Chat matches are short: two fixed copies; the second may read
+            // what the first wrote, which is what the match means
+            memcpy(out, from, 16);
+            memcpy(out + 16, from + 16, 16);
+            out += length;
+        } else if (offset >= length) {
+            memcpy(out, from, length);
+            out += length;
+        } else {
+            for (size_t i = 0; i < length; i++) out[i] = from[i];   // Overlapping: repeats the pattern
+            out += length;
+        }
+    }
+}
+
+} // namespace HookLib
@@ -0,0 +1,287 @@
+// MultiPatternScan.h - Resolve a whole signature table in one pass
+//
+// Every signature contributes its longest run of exact bytes (its "key") to
+// one Aho-Corasick automaton. A single pass over the image reports each key
+// occurrence, and the full signature (wildcards included) is then checked at
+// the implied start address. The cost is about one scan for N signatures
+// instead of N scans.
+//
+// While the automaton sits in its root state, positions that cannot start a
+// key are skipped (SSE2 when there are at most four distinct start bytes).
+//
+// Signatures with no exact byte at all cannot be keyed. Those fall back to a
+// separate FindPattern loop.
+//
+// Each signature can carry candidate verifiers (CandidateScan.h). They run
+// on every full match during the pass; rejected candidates are not reported.
+//
+// With SetRelocations, bytes on relocated slots may differ (Relocations.h):
+// keys are taken from the reloc prefilter of each signature, and a key hit
+// is confirmed with RelocAwareMatchAt.
+
+#pragma once
+
+#include "AhoCorasick.h"
+#include "CandidateScan.h"
+#include "PatternScan.h"
+#include "Relocations.h"
+
+namespace HookLib {
+
+// Keys longer than this add trie states without removing many false hits
+static const size_t MULTI_SCAN_MAX_KEY = 16;
+
+// matches[i] lists every start offset of signature i, in ascending order
+typedef std::vector<std::vector<size_t> > MultiScanMatches;
+
+class MultiPatternScanner {
+public:
+    MultiPatternScanner() : relocations(nullptr), startByteCount(0) {
+        memset(startByte, 0, sizeof(startByte));
+    }
+
+    // Copies the pattern (not the verifiers, which must outlive the scanner).
+    // Returns its index in the result table.
+    size_t Add(const PatternView& pattern, const CandidateVerifier* verifiers = nullptr,
+               size_t verifierCount = 0) {
+        patterns.push_back(Pattern(pattern.value, pattern.mask, pattern.length));
+        verifierLists.push_back(verifiers);
+        verifierCounts.push_back(verifierCount);
+        keyOffsets.push_back(0);
+        keyLengths.push_back(0);
+        return patterns.size() - 1;
+    }
+
+    // Makes the scans reloc-aware; call before Build(). `table` must outlive
+    // the scanner. NULL or an empty table means exact matching.
+    void SetRelocations(const RelocationTable* table) {
+        relocations = (table != nullptr && !table->Empty()) ? table : nullptr;
+    }
+
+    size_t Count() const { return patterns.size(); }
+    PatternView Get(size_t index) const { return patterns[index].View(); }
+
+    void Build() {
+        automaton = AhoCorasick();
+        keyOwners.clear();
+        unkeyed.clear();
+        prefilters.clear();
+
+        for (size_t i = 0; i < patterns.size(); i++) {
+            PatternView view = patterns[i].View();
+            if (relocations != nullptr) {
+                prefilters.push_back(RelocPrefilter(view, *relocations));
+                view = prefilters.back().View();
+            }
+            size_t offset = 0, length = 0;
+            SelectKey(view, &offset, &length);
+            keyOffsets[i] = offset;
+            keyLengths[i] = length;
+
+            if (length == 0) {
+                unkeyed.push_back(i);
+                continue;
+            }
+
+            // Identical keys from different signatures get separate ids
+            int id = automaton.AddKey(view.value + offset, length);
+            if ((size_t)id >= keyOwners.size()) keyOwners.resize(id + 1);
+            keyOwners[id] = i;
+        }
+
+        automaton.Build();
+
+        // Bytes that can leave the root state; everything else is skipped
+        memset(startByte, 0, sizeof(startByte));
+        startByteCount = 0;
+        for (size_t i = 0; i < patterns.size(); i++) {
+            if (keyLengths[i] == 0) continue;
+            uint8_t first = Prefilter(i).value[keyOffsets[i]];
+            if (!startByte[first]) {
+                startByte[first] = 1;
+                startBytes[startByteCount < 4 ? startByteCount : 3] = first;
+                startByteCount++;
+            }
+        }
+    }
+
+    // Scans data[0, size) once and fills one match list per signature.
+    void Scan(const uint8_t* data, size_t size, MultiScanMatches* matches) const {
+        matches->assign(patterns.size(), std::vector<size_t>());
+        ScanRange(data, size, 0, size, matches);
+    }
+
+    // Reports matches whose start lies in [first, last). Bytes up to
+    // last + longest pattern are read, so chunked callers can split a range
+    // without losing signatures that cross the split.
+    void ScanRange(const uint8_t* data, size_t size, size_t first, size_t last,
+                   MultiScanMatches* matches) const {
+        if (automaton.KeyCount() > 0) {
+            ScanKeyed(data, size, first, last, matches);
+        }
+
+        for (size_t u = 0; u < unkeyed.size(); u++) {
+            size_t index = unkeyed[u];
+            PatternView view = Prefilter(index);
+            if (view.length == 0 || view.length > size) {
+                continue;
+            }
+            size_t stop = (size - view.length < last) ? size - view.length + 1 : last;
+            for (size_t at = first; at < stop; at++) {
+                at = FindPatternRangeWith(GetSimdLevel(), data, at, stop - 1, view);
+                if (at == NPOS) break;
+                if (Confirmed(index, data, at) && Verified(index, data, size, at)) {
+                    (*matches)[index].push_back(at);
+                }
+            }
+        }
+    }
+
+    size_t MaxLength() const {
+        size_t longest = 0;
+        for (size_t i = 0; i < patterns.size(); i++) {
+            if (patterns[i].Length() > longest) longest = patterns[i].Length();
+        }
+        return longest;
+    }
+
+private:
+    // Longest run of exact bytes, capped at MULTI_SCAN_MAX_KEY. Among runs of
+    // equal length the one with the rarest bytes wins.
+    static void SelectKey(const PatternView& view, size_t* keyOffset, size_t* keyLength) {
+        size_t bestOffset = 0, bestLength = 0;
+        int bestScore = 0x7FFFFFFF;
+
+        size_t i = 0;
+        while (i < view.length) {
+            if (view.mask[i] != MASK_EXACT) {
+                i++;
+                continue;
+            }
+            size_t runStart = i;
+            while (i < view.length && view.mask[i] == MASK_EXACT) i++;
+
+            // Slide a capped window over long runs
+            size_t runLength = i - runStart;
+            size_t window = (runLength < MULTI_SCAN_MAX_KEY) ? runLength : MULTI_SCAN_MAX_KEY;
+            for (size_t start = runStart; start + window <= i; start++) {
+                // The first key byte decides how often the automaton leaves its root state
+                int score = 8 * ByteCommonness(view.value[start]);
+                for (size_t k = start; k < start + window; k++) score += ByteCommonness(view.value[k]);
+                if (window > bestLength || (window == bestLength && score < bestScore)) {
+                    bestOffset = start;
+                    bestLength = window;
+                    bestScore = score;
+                }
+            }
+        }
+
+        *keyOffset = bestOffset;
+        *keyLength = bestLength;
+    }
+
+    void ScanKeyed(const uint8_t* data, size_t size, size_t first, size_t last,
+                   MultiScanMatches* matches) const {
+        // Start early enough that a key ending at the first candidate is seen
+        size_t longest = MaxLength();
+        size_t begin = first;
+        size_t end = last + longest;
+        if (end > size || end < last) end = size;
+
+        int32_t state = 0;
+        for (size_t i = begin; i < end; i++) {
+            if (state == 0) {
+                i = SkipToStartByte(data, i, end);
+                if (i == end) break;
+            }
+            state = automaton.Step(state, data[i]);
+            if (!automaton.HasOutput(state)) {
+                continue;
+            }
+
+            for (const int32_t* key = automaton.OutputBegin(state); key != automaton.OutputEnd(state); key++) {
+                size_t index = keyOwners[*key];
+                size_t keyEnd = i + 1;
+                size_t back = keyOffsets[index] + keyLengths[index];
+                if (keyEnd < back) continue;
+
+                size_t start = keyEnd - back;
+                const Pattern& pattern = patterns[index];
+                if (start < first || start >= last || start + pattern.Length() > size) continue;
+
+                if (Confirmed(index, data, start) && Verified(index, data, size, start)) {
+                    (*matches)[index].push_back(start);
+                }
+            }
+        }
+    }
+
+    // The pattern keys and prefilter scans search for
+    PatternView Prefilter(size_t index) const {
+        return prefilters.empty() ? patterns[index].View() : prefilters[index].View();
+    }
+
+    // Full check after a key or prefilter hit. Reloc-aware, only the
+    // address-like DWORDs of the signature may differ, and only on
+    // relocated slots.
+    bool Confirmed(size_t index, const uint8_t* data, size_t offset) const {
+        PatternView view = patterns[index].View();
+        if (relocations == nullptr) {
+            return MatchAt(data + offset, view);
+        }
+        return MatchAt(data + offset, prefilters[index].View()) &&
+               RelocAwareMatchAt(data, offset, view, *relocations);
+    }
+
+    bool Verified(size_t index, const uint8_t* data, size_t size, size_t offset) const {
+        return PassesVerifiers(verifierLists[index], verifierCounts[index], data, size, offset);
+    }
+
+    // Next position in [i, end) holding a byte that starts some key, or end.
+    size_t SkipToStartByte(const uint8_t* data, size_t i, size_t end) const {
+#ifdef HOOKLIB_X86
+        if (startByteCount <= 4 && GetSimdLevel() >= SIMD_SSE2) {
+            return SkipToStartByteSse2(data, i, end);
+        }
+#endif
+        while (i < end && !startByte[data[i]]) i++;
+        return i;
+    }
+
+#ifdef HOOKLIB_X86
+    // Up to four start bytes: compare 16 positions at a time
+    HOOKLIB_TARGET_SSE2
+    size_t SkipToStartByteSse2(const uint8_t* data, size_t i, size_t end) const {
+        const __m128i b0 = _mm_set1_epi8((char)startBytes[0]);
+        const __m128i b1 = _mm_set1_epi8((char)startBytes[startByteCount > 1 ? 1 : 0]);
+        const __m128i b2 = _mm_set1_epi8((char)startBytes[startByteCount > 2 ? 2 : 0]);
+        const __m128i b3 = _mm_set1_epi8((char)startBytes[startByteCount > 3 ? 3 : 0]);
+
+        for (; end - i >= 16; i += 16) {
+            __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+            __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, b0), _mm_cmpeq_epi8(block, b1)),
+                                       _mm_or_si128(_mm_cmpeq_epi8(block, b2), _mm_cmpeq_epi8(block, b3)));
+            unsigned int bits = (unsigned int)_mm_movemask_epi8(hit);
+            if (bits) return i + LowestSetBit(bits);
+        }
+        while (i < end && !startByte[data[i]]) i++;
+        return i;
+    }
+#endif
+
+    std::vector<Pattern> patterns;
+    std::vector<Pattern> prefilters;   // Reloc prefilters, empty unless reloc-aware
+    const RelocationTable* relocations;
+    std::vector<const CandidateVerifier*> verifierLists;
+    std::vector<size_t> verifierCounts;
+    std::vector<size_t> keyOffsets;
+    std::vector<size_t> keyLengths;
+    std::vector<size_t> keyOwners;   // Automaton key id -> pattern index
+    std::vector<size_t> unkeyed;     // Patterns without any exact byte
+    AhoCorasick automaton;
+    uint8_t startByte[256];
+    uint8_t startBytes[4];
+    size_t startByteCount;
+};
+
+} // namespace HookLib
@@ -0,0 +1,185 @@
+// ParallelScan.h - Chunked multi-threaded pattern scanning
+//
+// The start positions of a scan are split into fixed-size chunks. A few
+// worker threads take chunks in ascending order. A chunk reads up to
+// (pattern length - 1) bytes past its end, so a signature that straddles a
+// chunk boundary is still seen, by the chunk it starts in.
+//
+// Results are deterministic and match the single-threaded scanners:
+//   - FindPatternParallel returns the lowest matching offset. Chunks above
+//     the best match found so far are skipped; chunks below it always finish.
+//   - ScanParallel fills per-chunk match lists and merges them in chunk
+//     order, so every list stays sorted.
+//
+// NOTE: Do not call these while holding the loader lock (from DllMain).
+// Threads created there only start after DllMain returns, so waiting on
+// them deadlocks. The DLLs run InstallHook on their own init thread.
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "MultiPatternScan.h"
+
+namespace HookLib {
+
+static const size_t PARALLEL_SCAN_CHUNK = 1 << 20;   // 1 MB of start positions
+static const unsigned PARALLEL_SCAN_MAX_THREADS = 8;
+
+inline unsigned DefaultScanThreads() {
+    unsigned count = std::thread::hardware_concurrency();
+    if (count == 0) count = 1;
+    return (count > PARALLEL_SCAN_MAX_THREADS) ? PARALLEL_SCAN_MAX_THREADS : count;
+}
+
+// Runs work(workerIndex) on `threads` threads. The caller thread is worker 0.
+template <typename Work>
+inline void RunScanWorkers(unsigned threads, Work& work) {
+    if (threads <= 1) {
+        work(0u);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (unsigned i = 1; i < threads; i++) {
+        workers.push_back(std::thread([&work, i]() { work(i); }));
+    }
+    work(0u);
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+namespace Detail {
+
+struct FindFirstWork {
+    const uint8_t* data;
+    size_t last;        // Last valid start position
+    size_t chunkSize;
+    size_t chunkCount;
+    SimdLevel level;
+    const PatternView* pattern;
+    std::atomic<size_t> nextChunk;
+    std::atomic<size_t> best;
+
+    void operator()(unsigned) {
+        for (;;) {
+            size_t chunk = nextChunk.fetch_add(1);
+            if (chunk >= chunkCount) return;
+
+            size_t first = chunk * chunkSize;
+            if (first >= best.load()) return;   // Everything from here on is higher
+
+            size_t chunkLast = (last - first < chunkSize) ? last : first + chunkSize - 1;
+            size_t found = FindPatternRangeWith(level, data, first, chunkLast, *pattern);
+            if (found == NPOS) continue;
+
+            size_t current = best.load();
+            while (found < current && !best.compare_exchange_weak(current, found)) {
+            }
+        }
+    }
+};
+
+struct MultiScanWork {
+    const MultiPatternScanner* scanner;
+    const uint8_t* data;
+    size_t size;
+    size_t rangeFirst;
+    size_t rangeLast;
+    size_t chunkSize;
+    size_t chunkCount;
+    std::vector<MultiScanMatches>* chunkMatches;
+    std::atomic<size_t> nextChunk;
+
+    void operator()(unsigned) {
+        for (;;) {
+            size_t chunk = nextChunk.fetch_add(1);
+            if (chunk >= chunkCount) return;
+
+            size_t first = rangeFirst + chunk * chunkSize;
+            size_t last = (rangeLast - first < chunkSize) ? rangeLast : first + chunkSize;
+            MultiScanMatches& local = (*chunkMatches)[chunk];
+            local.assign(scanner->Count(), std::vector<size_t>());
+            scanner->ScanRange(data, size, first, last, &local);
+        }
+    }
+};
+
+} // namespace Detail
+
+// Lowest match offset in data[0, size), or NPOS. Same answer as FindPattern.
+inline size_t FindPatternParallel(const uint8_t* data, size_t size, const PatternView& pattern,
+                                  unsigned threads, size_t chunkSize = PARALLEL_SCAN_CHUNK) {
+    if (pattern.length == 0 || pattern.length > size) {
+        return NPOS;
+    }
+    if (chunkSize == 0) chunkSize = PARALLEL_SCAN_CHUNK;
+
+    Detail::FindFirstWork work;
+    work.data = data;
+    work.last = size - pattern.length;
+    work.chunkSize = chunkSize;
+    work.chunkCount = work.last / chunkSize + 1;
+    work.level = GetSimdLevel();
+    work.pattern = &pattern;
+    work.nextChunk = 0;
+    work.best = NPOS;
+
+    if (threads > work.chunkCount) threads = (unsigned)work.chunkCount;
+    RunScanWorkers(threads, work);
+    return work.best.load();
+}
+
+// Parallel version of MultiPatternScanner::ScanRange: matches starting in
+// [first, last), reading up to data[size). Builds nothing; call
+// scanner.Build() first.
+inline void ScanRangeParallel(const MultiPatternScanner& scanner, const uint8_t* data, size_t size,
+                              size_t first, size_t last, MultiScanMatches* matches, unsigned threads,
+                              size_t chunkSize = PARALLEL_SCAN_CHUNK) {
+    if (chunkSize == 0) chunkSize = PARALLEL_SCAN_CHUNK;
+    size_t span = (last > first) ? last - first : 0;
+    size_t chunkCount = (span + chunkSize - 1) / chunkSize;
+    if (threads <= 1 || chunkCount <= 1) {
+        matches->assign(scanner.Count(), std::vector<size_t>());
+        scanner.ScanRange(data, size, first, last, matches);
+        return;
+    }
+
+    std::vector<MultiScanMatches> chunkMatches(chunkCount);
+
+    Detail::MultiScanWork work;
+    work.scanner = &scanner;
+    work.data = data;
+    work.size = size;
+    work.rangeFirst = first;
+    work.rangeLast = last;
+    work.chunkSize = chunkSize;
+    work.chunkCount = chunkCount;
+    work.chunkMatches = &chunkMatches;
+    work.nextChunk = 0;
+
+    if (threads > chunkCount) threads = (unsigned)chunkCount;
+    RunScanWorkers(threads, work);
+
+    // Merge in chunk order so each list stays ascending
+    matches->assign(scanner.Count(), std::vector<size_t>());
+    for (size_t c = 0; c < chunkCount; c++) {
+        for (size_t i = 0; i < scanner.Count(); i++) {
+            const std::vector<size_t>& part = chunkMatches[c][i];
+            (*matches)[i].insert((*matches)[i].end(), part.begin(), part.end());
+        }
+    }
+}
+
+// Parallel version of MultiPatternScanner::Scan
+inline void ScanParallel(const MultiPatternScanner& scanner, const uint8_t* data, size_t size,
+                         MultiScanMatches* matches, unsigned threads,
+                         size_t chunkSize = PARALLEL_SCAN_CHUNK) {
+    ScanRangeParallel(scanner, data, size, 0, size, matches, threads, chunkSize);
+}
+
+} // namespace HookLib
@@ -0,0 +1,459 @@
+// PatternScan.h - Byte signature matching engine for the ChatHook DLLs and tools
+//
+// Replaces the byte-at-a-time FindPattern loop that every DLL used to carry.
+// The engine works on plain byte spans (pointer + size) so the same code runs
+// inside Game.exe and in Linux tools over synthetic or dumped images.
+//
+// How a scan works:
+//   1. When a pattern is built, the rarest exact byte (the "anchor") and the
+//      second rarest exact byte are picked from a static x86 byte-frequency
+//      table.
+//   2. The scanner compares 16 (SSE2) or 32 (AVX2) positions at once against
+//      those two bytes. Which path runs is decided once at runtime via CPUID.
+//   3. Only positions where both filter bytes match are checked against the
+//      full pattern.
+//
+// Header-only. Include after <Windows.h> in the DLL sources.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define HOOKLIB_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC/Clang need per-function target attributes to emit SSE2/AVX2 code that
+// is only reached after runtime detection. MSVC accepts intrinsics anywhere.
+#if defined(__GNUC__)
+#define HOOKLIB_TARGET_SSE2 __attribute__((target("sse2")))
+#define HOOKLIB_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define HOOKLIB_TARGET_SSE2
+#define HOOKLIB_TARGET_AVX2
+#endif
+
+namespace HookLib {
+
+static const size_t NPOS = (size_t)-1;
+
+// ============================================================================
+// PATTERN REPRESENTATION
+// ============================================================================
+
+// Per-byte mask values. A byte matches when (data & mask) == value.
+static const uint8_t MASK_EXACT    = 0xFF;
+static const uint8_t MASK_WILDCARD = 0x00;
+
+// Non-owning view of a pattern. value[] is pre-masked, so value[i] & ~mask[i] == 0.
+struct PatternView {
+    const uint8_t* value;
+    const uint8_t* mask;
+    size_t length;
+    size_t anchor;   // Index of the rarest exact byte (NPOS if none)
+    size_t anchor2;  // Index of the second filter byte (NPOS if none)
+};
+
+// How often a byte shows up in 32-bit MSVC code (higher = more common).
+// Rough counts from Game.exe .text; only the ordering matters.
+constexpr int ByteCommonness(uint8_t b) {
+    switch (b) {
+        case 0x00: return 255;
+        case 0xFF: return 160;
+        case 0x8B: return 150;
+        case 0xCC: return 120;
+        case 0x45: case 0x4D: case 0x55: case 0x75: return 100;
+        case 0x89: case 0x85: case 0x24: case 0xE8: return 95;
+        case 0x01: case 0x04: case 0x08: case 0x0C: case 0x10: return 90;
+        case 0x83: case 0xC4: case 0xEC: case 0xFC: case 0xF8: case 0xF4: return 85;
+        case 0x50: case 0x51: case 0x52: case 0x53: case 0x56: case 0x57: return 80;
+        case 0x5D: case 0x5E: case 0x5F: case 0xC3: case 0xC2: return 75;
+        case 0x6A: case 0x68: case 0x8D: case 0x0F: case 0x74: case 0xEB: return 70;
+        case 0x02: case 0x03: case 0x14: case 0x18: case 0x1C: case 0x20: return 60;
+        case 0x33: case 0xC0: case 0xC9: case 0xD2: case 0xF6: case 0xFE: return 55;
+        default: break;
+    }
+    // Small immediates and printable ASCII are common in both code and data
+    if (b < 0x40) return 30;
+    if (b < 0x80) return 20;
+    return 10;
+}
+
+// Picks the two rarest exact bytes as SIMD filter positions.
+constexpr void SelectAnchors(const uint8_t* mask, const uint8_t* value, size_t length,
+                             size_t* anchor, size_t* anchor2) {
+    size_t best = NPOS, second = NPOS;
+    int bestScore = 0x7FFFFFFF, secondScore = 0x7FFFFFFF;
+
+    for (size_t i = 0; i < length; i++) {
+        if (mask[i] != MASK_EXACT) {
+            continue;
+        }
+        int score = ByteCommonness(value[i]);
+        if (score < bestScore) {
+            second = best;
+            secondScore = bestScore;
+            best = i;
+            bestScore = score;
+        } else if (score < secondScore) {
+            second = i;
+            secondScore = score;
+        }
+    }
+
+    *anchor = best;
+    *anchor2 = second;
+}
+
+// Owning pattern. Build once, scan with View().
+class Pattern {
+public:
+    Pattern() : anchor(NPOS), anchor2(NPOS) {}
+
+    // Legacy form used by the DLLs: raw bytes plus "xx?x" mask ('?' = wildcard)
+    Pattern(const uint8_t* bytes, const char* legacyMask) : anchor(NPOS), anchor2(NPOS) {
+        size_t length = strlen(legacyMask);
+        value.resize(length);
+        mask.resize(length);
+        for (size_t i = 0; i < length; i++) {
+            mask[i] = (legacyMask[i] == '?') ? MASK_WILDCARD : MASK_EXACT;
+            value[i] = bytes[i] & mask[i];
+        }
+        SelectAnchors(mask.data(), value.data(), length, &anchor, &anchor2);
+    }
+
+    // Explicit value/mask pair (mask bytes may be partial, e.g. 0xF0)
+    Pattern(const uint8_t* bytes, const uint8_t* byteMask, size_t length) : anchor(NPOS), anchor2(NPOS) {
+        value.resize(length);
+        mask.assign(byteMask, byteMask + length);
+        for (size_t i = 0; i < length; i++) {
+            value[i] = bytes[i] & mask[i];
+        }
+        SelectAnchors(mask.data(), value.data(), length, &anchor, &anchor2);
+    }
+
+    size_t Length() const { return value.size(); }
+
+    PatternView View() const {
+        PatternView view = { value.data(), mask.data(), value.size(), anchor, anchor2 };
+        return view;
+    }
+
+private:
+    std::vector<uint8_t> value;
+    std::vector<uint8_t> mask;
+    size_t anchor;
+    size_t anchor2;
+};
+
+// ============================================================================
+// MATCHING
+// ============================================================================
+
+inline bool MatchAt(const uint8_t* p, const PatternView& pattern) {
+    for (size_t j = 0; j < pattern.length; j++) {
+        if ((p[j] & pattern.mask[j]) != pattern.value[j]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The search loops below are written once against a "matcher":
+//   Length(), Anchor(), Anchor2(), ValueAt(i), Match(p)
+// ViewMatcher reads everything from a runtime PatternView. Signature.h adds
+// a matcher whose length and anchors are compile-time constants.
+struct ViewMatcher {
+    explicit ViewMatcher(const PatternView& p) : pattern(p) {}
+
+    size_t Length() const { return pattern.length; }
+    size_t Anchor() const { return pattern.anchor; }
+    size_t Anchor2() const { return pattern.anchor2; }
+    uint8_t ValueAt(size_t i) const { return pattern.value[i]; }
+    bool Match(const uint8_t* p) const { return MatchAt(p, pattern); }
+
+    const PatternView& pattern;
+};
+
+// Plain loop over [first, last] start positions, no prefilter.
+template <typename Matcher>
+inline size_t ScanScalarRange(const uint8_t* data, size_t first, size_t last, const Matcher& matcher) {
+    for (size_t i = first; i <= last; i++) {
+        if (matcher.Match(data + i)) {
+            return i;
+        }
+    }
+    return NPOS;
+}
+
+// Scalar anchor prefilter over [first, last]. Also used for the SIMD tails.
+template <typename Matcher>
+inline size_t ScanAnchoredRange(const uint8_t* data, size_t first, size_t last, const Matcher& matcher) {
+    if (matcher.Anchor() == NPOS) {
+        return ScanScalarRange(data, first, last, matcher);
+    }
+
+    const uint8_t a = matcher.ValueAt(matcher.Anchor());
+    const uint8_t* anchorBase = data + matcher.Anchor();
+    for (size_t i = first; i <= last; i++) {
+        if (anchorBase[i] == a && matcher.Match(data + i)) {
+            return i;
+        }
+    }
+    return NPOS;
+}
+
+#ifdef HOOKLIB_X86
+
+inline unsigned int LowestSetBit(unsigned int bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return (unsigned int)index;
+#else
+    return (unsigned int)__builtin_ctz(bits);
+#endif
+}
+
+template <typename Matcher>
+HOOKLIB_TARGET_SSE2
+inline size_t ScanSse2Range(const uint8_t* data, size_t first, size_t last, const Matcher& matcher) {
+    if (matcher.Anchor() == NPOS) {
+        return ScanScalarRange(data, first, last, matcher);
+    }
+
+    // Without a second exact byte, filter twice on the same position
+    size_t second = (matcher.Anchor2() != NPOS) ? matcher.Anchor2() : matcher.Anchor();
+    const __m128i needle1 = _mm_set1_epi8((char)matcher.ValueAt(matcher.Anchor()));
+    const __m128i needle2 = _mm_set1_epi8((char)matcher.ValueAt(second));
+    const uint8_t* base1 = data + matcher.Anchor();
+    const uint8_t* base2 = data + second;
+
+    // Loads touch [i + anchor, i + anchor + 15], which stays inside the span
+    // as long as i + 15 <= last because anchor < pattern length.
+    size_t i = first;
+    for (; i <= last && last - i >= 15; i += 16) {
+        __m128i block1 = _mm_loadu_si128((const __m128i*)(base1 + i));
+        __m128i block2 = _mm_loadu_si128((const __m128i*)(base2 + i));
+        unsigned int bits = (unsigned int)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(block1, needle1), _mm_cmpeq_epi8(block2, needle2)));
+
+        while (bits) {
+            unsigned int bit = LowestSetBit(bits);
+            if (matcher.Match(data + i + bit)) {
+                return i + bit;
+            }
+            bits &= bits - 1;
+        }
+    }
+
+    return (i <= last) ? ScanAnchoredRange(data, i, last, matcher) : NPOS;
+}
+
+template <typename Matcher>
+HOOKLIB_TARGET_AVX2
+inline size_t ScanAvx2Range(const uint8_t* data, size_t first, size_t last, const Matcher& matcher) {
+    if (matcher.Anchor() == NPOS) {
+        return ScanScalarRange(data, first, last, matcher);
+    }
+
+    size_t second = (matcher.Anchor2() != NPOS) ? matcher.Anchor2() : matcher.Anchor();
+    const __m256i needle1 = _mm256_set1_epi8((char)matcher.ValueAt(matcher.Anchor()));
+    const __m256i needle2 = _mm256_set1_epi8((char)matcher.ValueAt(second));
+    const uint8_t* base1 = data + matcher.Anchor();
+    const uint8_t* base2 = data + second;
+
+    size_t i = first;
+    for (; i <= last && last - i >= 31; i += 32) {
+        __m256i block1 = _mm256_loadu_si256((const __m256i*)(base1 + i));
+        __m256i block2 = _mm256_loadu_si256((const __m256i*)(base2 + i));
+        unsigned int bits = (unsigned int)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(block1, needle1), _mm256_cmpeq_epi8(block2, needle2)));
+
+        while (bits) {
+            unsigned int bit = LowestSetBit(bits);
+            if (matcher.Match(data + i + bit)) {
+                return i + bit;
+            }
+            bits &= bits - 1;
+        }
+    }
+
+    return (i <= last) ? ScanAnchoredRange(data, i, last, matcher) : NPOS;
+}
+
+#endif // HOOKLIB_X86
+
+// ============================================================================
+// RUNTIME DISPATCH
+// ============================================================================
+
+enum SimdLevel {
+    SIMD_SCALAR = 0,
+    SIMD_SSE2   = 1,
+    SIMD_AVX2   = 2
+};
+
+inline SimdLevel DetectSimdLevel() {
+#if defined(HOOKLIB_X86) && defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 0);
+    int maxLeaf = regs[0];
+
+    __cpuid(regs, 1);
+    bool sse2 = (regs[3] & (1 << 26)) != 0;
+    bool osxsave = (regs[2] & (1 << 27)) != 0;
+    bool avx = (regs[2] & (1 << 28)) != 0;
+
+    if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+        __cpuidex(regs, 7, 0);
+        if (regs[1] & (1 << 5)) {
+            return SIMD_AVX2;
+        }
+    }
+    return sse2 ? SIMD_SSE2 : SIMD_SCALAR;
+#elif defined(HOOKLIB_X86) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2")) return SIMD_SSE2;
+    return SIMD_SCALAR;
+#else
+    return SIMD_SCALAR;
+#endif
+}
+
+inline SimdLevel GetSimdLevel() {
+    static const SimdLevel level = DetectSimdLevel();
+    return level;
+}
+
+// Searches start positions [first, last] with an explicit engine.
+// Callers must guarantee last + pattern length <= size of the readable span.
+template <typename Matcher>
+inline size_t ScanRangeWith(SimdLevel level, const uint8_t* data, size_t first, size_t last,
+                            const Matcher& matcher) {
+    if (first > last) {
+        return NPOS;
+    }
+#ifdef HOOKLIB_X86
+    if (level == SIMD_AVX2) return ScanAvx2Range(data, first, last, matcher);
+    if (level == SIMD_SSE2) return ScanSse2Range(data, first, last, matcher);
+#endif
+    (void)level;
+    return ScanAnchoredRange(data, first, last, matcher);
+}
+
+inline size_t FindPatternRangeWith(SimdLevel level, const uint8_t* data, size_t first, size_t last,
+                                   const PatternView& pattern) {
+    return ScanRangeWith(level, data, first, last, ViewMatcher(pattern));
+}
+
+// Returns the offset of the first match in data[0, size), or NPOS.
+inline size_t FindPatternWith(SimdLevel level, const uint8_t* data, size_t size,
+                              const PatternView& pattern) {
+    if (pattern.length == 0 || pattern.length > size) {
+        return NPOS;
+    }
+    return FindPatternRangeWith(level, data, 0, size - pattern.length, pattern);
+}
+
+inline size_t FindPattern(const uint8_t* data, size_t size, const PatternView& pattern) {
+    return FindPatternWith(GetSimdLevel(), data, size, pattern);
+}
+
+// Continues a search after a previous match (pass previous + 1).
+inline size_t FindPatternFrom(const uint8_t* data, size_t size, size_t start,
+                              const PatternView& pattern) {
+    if (pattern.length == 0 || pattern.length > size || start > size - pattern.length) {
+        return NPOS;
+    }
+    return FindPatternRangeWith(GetSimdLevel(), data, start, size - pattern.length, pattern);
+}
+
+// ============================================================================
+// OFFSET-HINTED SEARCH
+// ============================================================================
+
+static const size_t HINT_FIRST_WINDOW = 0x1000;
+
+// Match closest to `hint` within [hint - radius, hint + radius], or NPOS.
+//
+// The hint itself is checked first. After that, windows of 4 KB, 8 KB,
+// 16 KB... around it are searched, each time scanning only the two strips
+// that are new. A match is returned as soon as a window contains one, so a
+// target that moved a few KB after a patch costs a few KB of scanning.
+// Unlike FindPattern this returns the match nearest to the hint, not the
+// lowest one.
+//
+// `find(level, data, first, last)` searches start positions [first, last],
+// like FindPatternRangeWith; Signature.h passes specialized matchers here.
+template <typename RangeFind>
+inline size_t FindNearWith(RangeFind find, size_t length, const uint8_t* data, size_t size,
+                           size_t hint, size_t radius) {
+    if (length == 0 || length > size) {
+        return NPOS;
+    }
+    size_t lastStart = size - length;
+    if (hint > lastStart) {
+        hint = lastStart;
+    }
+
+    SimdLevel level = GetSimdLevel();
+    if (find(SIMD_SCALAR, data, hint, hint) == hint) {
+        return hint;
+    }
+
+    size_t searched = 0;   // [hint - searched, hint + searched] is done
+    size_t window = HINT_FIRST_WINDOW;
+
+    while (searched < radius) {
+        if (window > radius) window = radius;
+
+        // Right strip: first match in (hint + searched, hint + window]
+        size_t right = NPOS;
+        if (lastStart - hint > searched) {
+            size_t first = hint + searched + 1;
+            size_t last = (lastStart - hint > window) ? hint + window : lastStart;
+            right = find(level, data, first, last);
+        }
+
+        // Left strip: last match in [hint - window, hint - searched)
+        size_t left = NPOS;
+        if (hint > searched) {
+            size_t last = hint - searched - 1;
+            size_t first = (hint > window) ? hint - window : 0;
+            for (size_t at = first; at <= last; at++) {
+                at = find(level, data, at, last);
+                if (at == NPOS) break;
+                left = at;
+            }
+        }
+
+        if (left != NPOS && (right == NPOS || hint - left <= right - hint)) return left;
+        if (right != NPOS) return right;
+
+        if (hint <= window && lastStart - hint <= window) break;   // Whole span covered
+        searched = window;
+        window *= 2;
+    }
+
+    return NPOS;
+}
+
+inline size_t FindPatternNear(const uint8_t* data, size_t size, const PatternView& pattern,
+                              size_t hint, size_t radius) {
+    return FindNearWith(
+        [&pattern](SimdLevel level, const uint8_t* d, size_t first, size_t last) {
+            return FindPatternRangeWith(level, d, first, last, pattern);
+        },
+        pattern.length, data, size, hint, radius);
+}
+
+} // namespace HookLib
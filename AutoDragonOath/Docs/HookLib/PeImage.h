@@ -0,0 +1,259 @@
+// PeImage.h - Minimal PE header parser (no <Windows.h>)
+//
+// Reads the fields HookLib needs from a PE32 / PE32+ image: the file and
+// optional header basics, the data directories and the section table.
+// Works on two layouts:
+//
+//   PE_LAYOUT_MAPPED  a loaded module or a dump of one (offset == RVA)
+//   PE_LAYOUT_FILE    the file as stored on disk, e.g. Game.exe read or
+//                     mmap()ed on Linux (sections at PointerToRawData)
+//
+// Every read is bounds-checked against the buffer, so a truncated or
+// damaged image makes Parse() return false instead of crashing.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace HookLib {
+
+// Section characteristics (IMAGE_SCN_*)
+static const uint32_t PE_SCN_CNT_CODE               = 0x00000020;
+static const uint32_t PE_SCN_CNT_INITIALIZED_DATA   = 0x00000040;
+static const uint32_t PE_SCN_CNT_UNINITIALIZED_DATA = 0x00000080;
+static const uint32_t PE_SCN_MEM_EXECUTE            = 0x20000000;
+static const uint32_t PE_SCN_MEM_READ               = 0x40000000;
+static const uint32_t PE_SCN_MEM_WRITE              = 0x80000000;
+
+// Data directory indices (IMAGE_DIRECTORY_ENTRY_*)
+static const size_t PE_DIRECTORY_BASERELOC = 5;
+static const size_t PE_DIRECTORY_COUNT     = 16;
+
+static const uint16_t PE_MAGIC_PE32     = 0x10B;
+static const uint16_t PE_MAGIC_PE32PLUS = 0x20B;
+
+enum PeLayout {
+    PE_LAYOUT_MAPPED = 0,
+    PE_LAYOUT_FILE
+};
+
+inline uint16_t ReadLe16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+inline uint32_t ReadLe32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline uint64_t ReadLe64(const uint8_t* p) {
+    return (uint64_t)ReadLe32(p) | ((uint64_t)ReadLe32(p + 4) << 32);
+}
+
+struct PeSection {
+    char name[9];               // NUL-terminated copy of the 8-byte name
+    uint32_t virtualAddress;
+    uint32_t virtualSize;
+    uint32_t rawOffset;         // PointerToRawData
+    uint32_t rawSize;           // SizeOfRawData
+    uint32_t characteristics;
+
+    bool IsExecutable() const {
+        return (characteristics & (PE_SCN_MEM_EXECUTE | PE_SCN_CNT_CODE)) != 0;
+    }
+    bool IsWritable() const { return (characteristics & PE_SCN_MEM_WRITE) != 0; }
+    bool HasName(const char* other) const { return strcmp(name, other) == 0; }
+};
+
+class PeImage {
+public:
+    PeImage() : data(0), size(0), layout(PE_LAYOUT_MAPPED), valid(false) {
+        Reset();
+    }
+
+    // Parses the headers of data[0, size). The buffer must outlive this
+    // object. Returns false (and IsValid() stays false) if it is not a PE.
+    bool Parse(const uint8_t* image, size_t imageSize, PeLayout imageLayout) {
+        data = image;
+        size = imageSize;
+        layout = imageLayout;
+        Reset();
+
+        if (size < 0x40 || data[0] != 'M' || data[1] != 'Z') {
+            return false;
+        }
+        size_t peOffset = ReadLe32(data + 0x3C);
+        if (peOffset > size || size - peOffset < 4 + 20 || memcmp(data + peOffset, "PE\0\0", 4) != 0) {
+            return false;
+        }
+
+        const uint8_t* fileHeader = data + peOffset + 4;
+        machine = ReadLe16(fileHeader + 0);
+        uint16_t sectionCount = ReadLe16(fileHeader + 2);
+        timeDateStamp = ReadLe32(fileHeader + 4);
+        uint16_t optionalSize = ReadLe16(fileHeader + 16);
+
+        size_t optionalOffset = peOffset + 4 + 20;
+        if (optionalSize < 64 || size - optionalOffset < optionalSize) {
+            return false;
+        }
+        const uint8_t* optionalHeader = data + optionalOffset;
+        magic = ReadLe16(optionalHeader + 0);
+        if (magic != PE_MAGIC_PE32 && magic != PE_MAGIC_PE32PLUS) {
+            return false;
+        }
+
+        sizeOfCode = ReadLe32(optionalHeader + 4);
+        entryPoint = ReadLe32(optionalHeader + 16);
+        baseOfCode = ReadLe32(optionalHeader + 20);
+        imageBase = (magic == PE_MAGIC_PE32PLUS) ? ReadLe64(optionalHeader + 24) : ReadLe32(optionalHeader + 28);
+        sizeOfImage = ReadLe32(optionalHeader + 56);
+        sizeOfHeaders = ReadLe32(optionalHeader + 60);
+
+        // NumberOfRvaAndSizes, then the directories themselves
+        size_t directoryOffset = (magic == PE_MAGIC_PE32PLUS) ? 112 : 96;
+        if (optionalSize >= directoryOffset) {
+            size_t directoryCount = ReadLe32(optionalHeader + directoryOffset - 4);
+            if (directoryCount > PE_DIRECTORY_COUNT) directoryCount = PE_DIRECTORY_COUNT;
+            size_t directoryRoom = (optionalSize - directoryOffset) / 8;
+            if (directoryCount > directoryRoom) directoryCount = directoryRoom;
+            for (size_t i = 0; i < directoryCount; i++) {
+                directoryRva[i] = ReadLe32(optionalHeader + directoryOffset + i * 8);
+                directorySize[i] = ReadLe32(optionalHeader + directoryOffset + i * 8 + 4);
+            }
+        }
+
+        size_t sectionOffset = optionalOffset + optionalSize;
+        if (sectionOffset > size || (size - sectionOffset) / 40 < sectionCount) {
+            return false;
+        }
+
+        sections.resize(sectionCount);
+        for (uint16_t i = 0; i < sectionCount; i++) {
+            const uint8_t* header = data + sectionOffset + (size_t)i * 40;
+            PeSection& section = sections[i];
+            memcpy(section.name, header, 8);
+            section.name[8] = '\0';
+            section.virtualSize = ReadLe32(header + 8);
+            section.virtualAddress = ReadLe32(header + 12);
+            section.rawSize = ReadLe32(header + 16);
+            section.rawOffset = ReadLe32(header + 20);
+            section.characteristics = ReadLe32(header + 36);
+        }
+
+        valid = true;
+        return true;
+    }
+
+    bool IsValid() const { return valid; }
+    bool Is64Bit() const { return magic == PE_MAGIC_PE32PLUS; }
+    const uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+    PeLayout Layout() const { return layout; }
+
+    size_t SectionCount() const { return sections.size(); }
+    const PeSection& Section(size_t index) const { return sections[index]; }
+
+    // Index of the first section with this name, or -1
+    int FindSection(const char* name) const {
+        for (size_t i = 0; i < sections.size(); i++) {
+            if (sections[i].HasName(name)) return (int)i;
+        }
+        return -1;
+    }
+
+    // Data directory `index` (PE_DIRECTORY_*). Returns false if it is absent.
+    bool Directory(size_t index, uint32_t* rva, uint32_t* directoryBytes) const {
+        if (index >= PE_DIRECTORY_COUNT || directoryRva[index] == 0 || directorySize[index] == 0) {
+            return false;
+        }
+        *rva = directoryRva[index];
+        *directoryBytes = directorySize[index];
+        return true;
+    }
+
+    // Where the section's contents sit in the buffer, as [*begin, *end),
+    // clamped to the buffer. Returns false for sections with no bytes here
+    // (.bss in a file, or cut off by a truncated dump).
+    bool SectionRange(size_t index, size_t* begin, size_t* end) const {
+        const PeSection& section = sections[index];
+        size_t start, length;
+        if (layout == PE_LAYOUT_MAPPED) {
+            start = section.virtualAddress;
+            length = section.virtualSize ? section.virtualSize : section.rawSize;
+        } else {
+            start = section.rawOffset;
+            length = section.rawSize;
+            // Raw data is padded to FileAlignment; the tail past VirtualSize is not loaded
+            if (section.virtualSize && section.virtualSize < length) length = section.virtualSize;
+        }
+
+        if (start >= size || length == 0) {
+            return false;
+        }
+        *begin = start;
+        *end = (size - start < length) ? size : start + length;
+        return true;
+    }
+
+    // Buffer offset -> RVA. Identity for mapped images. In file layout,
+    // (size_t)-1 for bytes outside the headers and every section.
+    size_t OffsetToRva(size_t offset) const {
+        if (layout == PE_LAYOUT_MAPPED || offset < sizeOfHeaders) {
+            return offset;
+        }
+        for (size_t i = 0; i < sections.size(); i++) {
+            const PeSection& section = sections[i];
+            if (offset >= section.rawOffset && offset - section.rawOffset < section.rawSize) {
+                return section.virtualAddress + (offset - section.rawOffset);
+            }
+        }
+        return (size_t)-1;
+    }
+
+    // RVA -> buffer offset. (size_t)-1 when the RVA has no bytes in the file.
+    size_t RvaToOffset(size_t rva) const {
+        if (layout == PE_LAYOUT_MAPPED || rva < sizeOfHeaders) {
+            return rva;
+        }
+        for (size_t i = 0; i < sections.size(); i++) {
+            const PeSection& section = sections[i];
+            if (rva >= section.virtualAddress && rva - section.virtualAddress < section.rawSize) {
+                return section.rawOffset + (rva - section.virtualAddress);
+            }
+        }
+        return (size_t)-1;
+    }
+
+    uint16_t machine;
+    uint16_t magic;
+    uint32_t timeDateStamp;
+    uint32_t sizeOfCode;
+    uint32_t entryPoint;
+    uint32_t baseOfCode;
+    uint64_t imageBase;
+    uint32_t sizeOfImage;
+    uint32_t sizeOfHeaders;
+
+private:
+    void Reset() {
+        valid = false;
+        machine = magic = 0;
+        timeDateStamp = sizeOfCode = entryPoint = baseOfCode = sizeOfImage = sizeOfHeaders = 0;
+        imageBase = 0;
+        memset(directoryRva, 0, sizeof(directoryRva));
+        memset(directorySize, 0, sizeof(directorySize));
+        sections.clear();
+    }
+
+    const uint8_t* data;
+    size_t size;
+    PeLayout layout;
+    bool valid;
+    uint32_t directoryRva[PE_DIRECTORY_COUNT];
+    uint32_t directorySize[PE_DIRECTORY_COUNT];
+    std::vector<PeSection> sections;
+};
+
+} // namespace HookLib
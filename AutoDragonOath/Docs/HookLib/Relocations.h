@@ -0,0 +1,215 @@
+// Relocations.h - Base relocations, and matching that ignores relocated bytes
+//
+// Absolute operands (push offset aChatFormat, mov eax, [__security_cookie])
+// are listed in the image's base relocation directory. When the module is
+// rebased, or a patch relinks it and moves its data, those four bytes change
+// while the code around them stays the same, and a signature copied from IDA
+// with the operand as literal bytes stops matching.
+//
+// RelocationTable reads the directory into a sorted list of relocated DWORD
+// offsets. RelocAwareMatchAt treats every signature byte that lands on one
+// of them as a wildcard. The prefilters in front of it (anchors, multi-scan
+// keys) must not depend on those bytes either, so RelocPrefilter wildcards
+// the DWORDs of a signature that hold an address inside the image. A
+// reloc-aware match is a match of that prefilter, fully, plus
+// RelocAwareMatchAt for the rest: only the address operands may differ, and
+// only where the image has a relocation. (Without the first part, a jump
+// table in .text, all relocated slots, would match any signature.)
+//
+// An image linked with /FIXED has no relocations; the table is then empty
+// and everything behaves like the exact scanners.
+
+#pragma once
+
+#include <algorithm>
+
+#include "PatternScan.h"
+#include "PeImage.h"
+
+namespace HookLib {
+
+// Relocation types (IMAGE_REL_BASED_*); the rest do not occur in x86 / x64 images
+static const unsigned PE_REL_BASED_ABSOLUTE = 0;    // Padding
+static const unsigned PE_REL_BASED_HIGHLOW  = 3;    // 32-bit VA
+static const unsigned PE_REL_BASED_DIR64    = 10;   // 64-bit VA
+
+static const size_t RELOC_SLOT_BYTES = 4;
+
+// Preferred base of a 32-bit MSVC executable; signatures are taken from
+// images loaded there, so their address operands fall in this range
+static const uint32_t RELOC_DEFAULT_IMAGE_BASE = 0x00400000;
+
+class RelocationTable {
+public:
+    RelocationTable() : preferredBase(0), loadedBase(0), imageSpan(0) {}
+
+    // Reads the base relocation directory of `pe`. Returns false if there is
+    // none or it is damaged; slots read before the damage are kept.
+    bool Load(const PeImage& pe) {
+        slots.clear();
+        preferredBase = loadedBase = imageSpan = 0;
+        if (!pe.IsValid()) {
+            return false;
+        }
+
+        // A loaded module's header holds the base it was rebased to. PE32+
+        // addresses are compared by their low DWORD.
+        loadedBase = (uint32_t)pe.imageBase;
+        preferredBase = pe.Is64Bit() ? loadedBase : RELOC_DEFAULT_IMAGE_BASE;
+        imageSpan = pe.sizeOfImage;
+
+        uint32_t directoryRva = 0, directoryBytes = 0;
+        if (!pe.Directory(PE_DIRECTORY_BASERELOC, &directoryRva, &directoryBytes)) {
+            return false;
+        }
+        size_t directory = pe.RvaToOffset(directoryRva);
+        if (directory == (size_t)-1 || directory > pe.Size() || pe.Size() - directory < directoryBytes) {
+            return false;
+        }
+
+        // Blocks of { PageRVA, SizeOfBlock, WORD entries[] }, entry = type << 12 | page offset
+        const uint8_t* data = pe.Data();
+        bool intact = true;
+        size_t at = directory;
+        size_t end = directory + directoryBytes;
+        while (end - at >= 8) {
+            uint32_t pageRva = ReadLe32(data + at);
+            uint32_t blockBytes = ReadLe32(data + at + 4);
+            if (blockBytes < 8 || blockBytes > end - at) {
+                intact = false;
+                break;
+            }
+
+            for (size_t e = at + 8; e + 2 <= at + blockBytes; e += 2) {
+                uint16_t entry = ReadLe16(data + e);
+                unsigned type = entry >> 12;
+                if (type == PE_REL_BASED_ABSOLUTE) {
+                    continue;
+                }
+                if (type != PE_REL_BASED_HIGHLOW && type != PE_REL_BASED_DIR64) {
+                    intact = false;
+                    continue;
+                }
+
+                size_t offset = pe.RvaToOffset(pageRva + (entry & 0xFFF));
+                if (offset == (size_t)-1) {
+                    continue;   // In .bss or cut off by the dump
+                }
+                slots.push_back(offset);
+                if (type == PE_REL_BASED_DIR64) {
+                    slots.push_back(offset + RELOC_SLOT_BYTES);
+                }
+            }
+            at += blockBytes;
+        }
+
+        // Blocks come in page order, but nothing requires it
+        std::sort(slots.begin(), slots.end());
+        slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+        return intact;
+    }
+
+    bool Empty() const { return slots.empty(); }
+
+    // Relocated 4-byte slots, as ascending buffer offsets
+    size_t Count() const { return slots.size(); }
+    size_t Slot(size_t index) const { return slots[index]; }
+
+    // True if the byte at buffer offset `offset` belongs to a relocated slot
+    bool Covers(size_t offset) const {
+        std::vector<size_t>::const_iterator next = std::upper_bound(slots.begin(), slots.end(), offset);
+        return next != slots.begin() && offset - *(next - 1) < RELOC_SLOT_BYTES;
+    }
+
+    // True if a 32-bit operand with this value could be an address in the
+    // image, at its preferred base or where it is loaded now
+    bool LooksLikeAddress(uint32_t value) const {
+        return (uint32_t)(value - preferredBase) < imageSpan || (uint32_t)(value - loadedBase) < imageSpan;
+    }
+
+    // Same for a DWORD of which only the top `bytes` bytes are known, as
+    // when a signature starts in the middle of an operand
+    bool LooksLikeAddressTop(const uint8_t* top, size_t bytes) const {
+        uint64_t low = 0;
+        for (size_t k = 0; k < bytes; k++) low |= (uint64_t)top[k] << (8 * (RELOC_SLOT_BYTES - bytes + k));
+        uint64_t high = low + ((uint64_t)1 << (8 * (RELOC_SLOT_BYTES - bytes)));
+        return Overlaps(low, high, preferredBase) || Overlaps(low, high, loadedBase);
+    }
+
+private:
+    bool Overlaps(uint64_t low, uint64_t high, uint64_t base) const {
+        return imageSpan != 0 && low < base + imageSpan && high > base;
+    }
+
+    std::vector<size_t> slots;
+    uint32_t preferredBase;
+    uint32_t loadedBase;
+    uint32_t imageSpan;
+};
+
+// ============================================================================
+// MATCHING
+// ============================================================================
+
+// Like MatchAt(data + offset, pattern), except that bytes on relocated slots
+// may differ.
+inline bool RelocAwareMatchAt(const uint8_t* data, size_t offset, const PatternView& pattern,
+                              const RelocationTable& relocations) {
+    const uint8_t* p = data + offset;
+    for (size_t j = 0; j < pattern.length; j++) {
+        if ((p[j] & pattern.mask[j]) != pattern.value[j] && !relocations.Covers(offset + j)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Copy of `pattern` with every exact DWORD that looks like an address in the
+// image wildcarded, so it can drive the SIMD and multi-pattern prefilters.
+// The tail of an operand cut by the signature start is recognised too; a
+// DWORD cut by the signature end is not, so end signatures after an operand.
+inline Pattern RelocPrefilter(const PatternView& pattern, const RelocationTable& relocations) {
+    std::vector<uint8_t> mask(pattern.mask, pattern.mask + pattern.length);
+    for (size_t bytes = RELOC_SLOT_BYTES - 1; bytes > 0; bytes--) {
+        if (bytes < pattern.length && memchr(pattern.mask, MASK_WILDCARD, bytes) == nullptr &&
+            relocations.LooksLikeAddressTop(pattern.value, bytes)) {
+            memset(mask.data(), MASK_WILDCARD, bytes);
+            break;
+        }
+    }
+    for (size_t j = 0; j + RELOC_SLOT_BYTES <= pattern.length; j++) {
+        bool exact = true;
+        for (size_t k = j; k < j + RELOC_SLOT_BYTES; k++) {
+            if (pattern.mask[k] != MASK_EXACT) exact = false;
+        }
+        if (exact && relocations.LooksLikeAddress(ReadLe32(pattern.value + j))) {
+            memset(mask.data() + j, MASK_WILDCARD, RELOC_SLOT_BYTES);
+        }
+    }
+    return Pattern(pattern.value, mask.data(), pattern.length);
+}
+
+// Lowest reloc-aware match of `pattern` in data[0, size), or NPOS.
+inline size_t FindPatternRelocAware(const uint8_t* data, size_t size, const PatternView& pattern,
+                                    const RelocationTable& relocations) {
+    if (pattern.length == 0 || pattern.length > size) {
+        return NPOS;
+    }
+    if (relocations.Empty()) {
+        return FindPattern(data, size, pattern);
+    }
+
+    Pattern prefilter = RelocPrefilter(pattern, relocations);
+    SimdLevel level = GetSimdLevel();
+    size_t last = size - pattern.length;
+    for (size_t at = 0; at <= last; at++) {
+        at = FindPatternRangeWith(level, data, at, last, prefilter.View());
+        if (at == NPOS) break;
+        if (RelocAwareMatchAt(data, at, pattern, relocations)) {
+            return at;
+        }
+    }
+    return NPOS;
+}
+
+} // namespace HookLib
@@ -0,0 +1,117 @@
+// SectionScan.h - Restrict scans to the PE sections a signature can live in
+//
+// A code signature can only match inside executable sections, and a data
+// signature (string, vtable, constant table) only inside .data / .rdata.
+// Scanning just those ranges skips resources, relocations and padding, and
+// cannot produce a false hit in them.
+//
+// Every function takes a PeImage. If the buffer is not a valid PE (a raw
+// memory region, a damaged dump), or has no section of the wanted kind, the
+// whole buffer is scanned instead, so callers never lose a match by going
+// through this API. Offsets are buffer offsets, like the plain scanners;
+// use PeImage::OffsetToRva for file-layout images.
+
+#pragma once
+
+#include "ParallelScan.h"
+#include "PeImage.h"
+
+namespace HookLib {
+
+enum SignatureKind {
+    SIGNATURE_CODE = 0,     // Executable sections
+    SIGNATURE_DATA,         // .data and .rdata
+    SIGNATURE_KIND_COUNT
+};
+
+struct ScanRegion {
+    size_t begin;
+    size_t end;
+};
+
+inline bool SectionHoldsKind(const PeSection& section, SignatureKind kind) {
+    if (kind == SIGNATURE_CODE) {
+        return section.IsExecutable();
+    }
+    return section.HasName(".data") || section.HasName(".rdata");
+}
+
+// Fills *regions with the ranges to scan for `kind`, ascending. Adjacent
+// sections are merged so a match may still run from one into the next.
+inline void CollectScanRegions(const PeImage& pe, SignatureKind kind, std::vector<ScanRegion>* regions) {
+    regions->clear();
+
+    if (pe.IsValid()) {
+        for (size_t i = 0; i < pe.SectionCount(); i++) {
+            ScanRegion region;
+            if (!SectionHoldsKind(pe.Section(i), kind) || !pe.SectionRange(i, &region.begin, &region.end)) {
+                continue;
+            }
+            regions->push_back(region);
+        }
+
+        // Section tables are normally sorted, but do not rely on it
+        for (size_t i = 1; i < regions->size(); i++) {
+            for (size_t j = i; j > 0 && (*regions)[j].begin < (*regions)[j - 1].begin; j--) {
+                ScanRegion swap = (*regions)[j];
+                (*regions)[j] = (*regions)[j - 1];
+                (*regions)[j - 1] = swap;
+            }
+        }
+
+        size_t merged = 0;
+        for (size_t i = 0; i < regions->size(); i++) {
+            if (merged > 0 && (*regions)[i].begin <= (*regions)[merged - 1].end) {
+                if ((*regions)[i].end > (*regions)[merged - 1].end) {
+                    (*regions)[merged - 1].end = (*regions)[i].end;
+                }
+                continue;
+            }
+            (*regions)[merged++] = (*regions)[i];
+        }
+        regions->resize(merged);
+    }
+
+    if (regions->empty()) {
+        ScanRegion whole = { 0, pe.Size() };
+        regions->push_back(whole);
+    }
+}
+
+// Lowest match of `pattern` inside the sections for `kind`, or NPOS.
+inline size_t FindPatternInSections(const PeImage& pe, const PatternView& pattern,
+                                    SignatureKind kind = SIGNATURE_CODE, unsigned threads = 1) {
+    std::vector<ScanRegion> regions;
+    CollectScanRegions(pe, kind, &regions);
+
+    for (size_t r = 0; r < regions.size(); r++) {
+        const ScanRegion& region = regions[r];
+        size_t found = FindPatternParallel(pe.Data() + region.begin, region.end - region.begin, pattern, threads);
+        if (found != NPOS) {
+            return region.begin + found;
+        }
+    }
+    return NPOS;
+}
+
+// MultiPatternScanner::Scan limited to matches that start in the sections
+// for `kind`. Every pattern in the scanner is treated as that kind. Lists
+// stay ascending.
+inline void ScanSections(const MultiPatternScanner& scanner, const PeImage& pe, MultiScanMatches* matches,
+                         SignatureKind kind = SIGNATURE_CODE, unsigned threads = 1) {
+    std::vector<ScanRegion> regions;
+    CollectScanRegions(pe, kind, &regions);
+
+    // Verifiers see the whole image, so only the start positions are limited
+    matches->assign(scanner.Count(), std::vector<size_t>());
+    MultiScanMatches local;
+    for (size_t r = 0; r < regions.size(); r++) {
+        const ScanRegion& region = regions[r];
+        ScanRangeParallel(scanner, pe.Data(), pe.Size(), region.begin, region.end, &local, threads);
+        for (size_t i = 0; i < local.size(); i++) {
+            (*matches)[i].insert((*matches)[i].end(), local[i].begin(), local[i].end());
+        }
+    }
+}
+
+} // namespace HookLib
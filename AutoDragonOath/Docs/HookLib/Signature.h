@@ -0,0 +1,192 @@
+// Signature.h - Compile-time signatures from IDA-style strings
+//
+//     static constexpr auto kSig = HOOKLIB_SIGNATURE("55 8B EC 81 EC ?? 01 00 00 A1 ?? ?? ?? ?? 53");
+//
+// The string is parsed and validated by the compiler. The value bytes, the
+// mask and the two SIMD filter bytes (PatternScan.h) all end up as constants
+// in the binary, so there is no "xx?x" mask string left to drift out of sync
+// with the byte array, and no strlen() per call.
+//
+// Token syntax (separated by spaces):
+//     8B        exact byte
+//     ?? or ?   any byte
+//     ?F / E?   nibble wildcard (only the given nibble must match)
+//
+// Malformed signatures break the build: ParseSignature throws during
+// constant evaluation, which the compiler reports as an error.
+//
+// FindSignature<kSig>() is a matcher specialized for that one signature. The
+// compiler sees the length, the anchors and every value/mask byte as
+// constants and unrolls the compare. ParsePattern() accepts the same syntax
+// at runtime, for tools that read signatures from the command line.
+//
+// Requires C++17 (cl /std:c++17, g++ -std=c++17).
+
+#pragma once
+
+#include <type_traits>
+
+#include "PatternScan.h"
+
+namespace HookLib {
+
+// ============================================================================
+// PARSER (shared by the compile-time and runtime paths)
+// ============================================================================
+
+constexpr int SignatureHexDigit(char c) {
+    return (c >= '0' && c <= '9') ? c - '0'
+         : (c >= 'A' && c <= 'F') ? c - 'A' + 10
+         : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+         : -1;
+}
+
+constexpr bool IsSignatureSpace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Parses `text`, writing at most `capacity` bytes into value/mask. Returns the
+// number of bytes, or NPOS if the text is malformed. Pass capacity 0 (and
+// null buffers) to only count and validate.
+constexpr size_t ParseSignatureText(const char* text, uint8_t* value, uint8_t* mask, size_t capacity) {
+    size_t count = 0;
+    size_t i = 0;
+
+    for (;;) {
+        while (IsSignatureSpace(text[i])) i++;
+        if (text[i] == '\0') break;
+
+        char high = text[i];
+        char low = text[i + 1];
+        bool single = (high == '?') && (low == '\0' || IsSignatureSpace(low));
+        if (!single && (low == '\0' || IsSignatureSpace(low))) return NPOS;   // Lone hex digit
+        size_t tokenLength = single ? 1 : 2;
+        char after = text[i + tokenLength];
+        if (after != '\0' && !IsSignatureSpace(after)) return NPOS;           // Token too long
+
+        uint8_t byteValue = 0, byteMask = 0;
+        if (!single) {
+            int h = SignatureHexDigit(high);
+            int l = SignatureHexDigit(low);
+            if ((h < 0 && high != '?') || (l < 0 && low != '?')) return NPOS;
+            if (h >= 0) { byteValue |= (uint8_t)(h << 4); byteMask |= 0xF0; }
+            if (l >= 0) { byteValue |= (uint8_t)l; byteMask |= 0x0F; }
+        }
+
+        if (count < capacity) {
+            value[count] = byteValue;
+            mask[count] = byteMask;
+        }
+        count++;
+        i += tokenLength;
+    }
+
+    return count;
+}
+
+// ============================================================================
+// COMPILE-TIME SIGNATURE
+// ============================================================================
+
+template <size_t N>
+struct Signature {
+    uint8_t value[N] = {};
+    uint8_t mask[N] = {};
+    size_t anchor = NPOS;
+    size_t anchor2 = NPOS;
+
+    static constexpr size_t length = N;
+
+    constexpr PatternView View() const {
+        return PatternView{ value, mask, N, anchor, anchor2 };
+    }
+};
+
+// Byte count of a signature string; only meant for constant evaluation.
+constexpr size_t CountSignatureBytes(const char* text) {
+    size_t count = ParseSignatureText(text, nullptr, nullptr, 0);
+    if (count == NPOS) throw "HOOKLIB_SIGNATURE: malformed signature text";
+    if (count == 0) throw "HOOKLIB_SIGNATURE: empty signature";
+    return count;
+}
+
+template <size_t N>
+constexpr Signature<N> ParseSignature(const char* text) {
+    Signature<N> signature;
+    if (ParseSignatureText(text, signature.value, signature.mask, N) != N) {
+        throw "HOOKLIB_SIGNATURE: malformed signature text";
+    }
+    bool hasExact = false;
+    for (size_t i = 0; i < N; i++) {
+        if (signature.mask[i] == MASK_EXACT) hasExact = true;
+    }
+    if (!hasExact) throw "HOOKLIB_SIGNATURE: signature needs at least one exact byte";
+
+    SelectAnchors(signature.mask, signature.value, N, &signature.anchor, &signature.anchor2);
+    return signature;
+}
+
+// Use with `static constexpr auto` so a bad string fails the build.
+#define HOOKLIB_SIGNATURE(text) \
+    ::HookLib::ParseSignature<::HookLib::CountSignatureBytes(text)>(text)
+
+// ============================================================================
+// SPECIALIZED MATCHER
+// ============================================================================
+
+// Sig must be a namespace-scope (or static) constexpr Signature<N>.
+template <const auto& Sig>
+struct SignatureMatcher {
+    static constexpr size_t N = std::remove_reference<decltype(Sig)>::type::length;
+
+    constexpr size_t Length() const { return N; }
+    constexpr size_t Anchor() const { return Sig.anchor; }
+    constexpr size_t Anchor2() const { return Sig.anchor2; }
+    constexpr uint8_t ValueAt(size_t i) const { return Sig.value[i]; }
+
+    bool Match(const uint8_t* p) const {
+        for (size_t j = 0; j < N; j++) {
+            if ((p[j] & Sig.mask[j]) != Sig.value[j]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Same contract as FindPatternRangeWith, specialized for Sig
+template <const auto& Sig>
+inline size_t FindSignatureRange(SimdLevel level, const uint8_t* data, size_t first, size_t last) {
+    return ScanRangeWith(level, data, first, last, SignatureMatcher<Sig>());
+}
+
+template <const auto& Sig>
+inline size_t FindSignature(const uint8_t* data, size_t size) {
+    const size_t length = SignatureMatcher<Sig>::N;
+    if (length > size) {
+        return NPOS;
+    }
+    return FindSignatureRange<Sig>(GetSimdLevel(), data, 0, size - length);
+}
+
+// Pointer type for storing specialized matchers in tables
+typedef size_t (*SignatureRangeFinder)(SimdLevel level, const uint8_t* data, size_t first, size_t last);
+
+// ============================================================================
+// RUNTIME PARSING
+// ============================================================================
+
+// Parses the same syntax at runtime. Returns false on malformed text.
+inline bool ParsePattern(const char* text, Pattern* out) {
+    size_t count = ParseSignatureText(text, nullptr, nullptr, 0);
+    if (count == NPOS || count == 0) {
+        return false;
+    }
+
+    std::vector<uint8_t> value(count), mask(count);
+    ParseSignatureText(text, value.data(), mask.data(), count);
+    *out = Pattern(value.data(), mask.data(), count);
+    return true;
+}
+
+} // namespace HookLib
@@ -0,0 +1,98 @@
+// ThreadDone.h - How HookLib's background threads are stopped from DLL_PROCESS_DETACH
+//
+// AsyncLog, ChatArchiveWriter, ChatWorker and TimerWheel each own a
+// BackgroundThread, stopped from DllMain under the loader lock. DllMain's
+// lpReserved tells the two cases apart:
+//
+//   - FreeLibrary (lpReserved == NULL): the thread is alive, and the DLL is
+//     unmapped once DllMain returns, so the thread must be out of our code
+//     by then. Stop waits, with no bound, for the thread's last step: a
+//     ThreadDone it signals after its loop. That is not a join or a
+//     WaitForSingleObject on the thread handle: a returning thread takes
+//     the loader lock to send DLL_THREAD_DETACH, and the unloading thread
+//     holds it. What runs on the thread (log writes, chat handlers, timer
+//     actions) must therefore return, and must not wait for the loader
+//     lock (LoadLibrary, FreeLibrary), or FreeLibrary hangs.
+//   - Process exit (lpReserved != NULL): every other thread has already
+//     been killed, wherever it was, possibly holding one of our mutexes.
+//     Close / Stop are passed processExiting = true and then neither wait
+//     nor take a lock that a dead thread could hold.
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace HookLib {
+
+class ThreadDone {
+public:
+    ThreadDone() : done(false) {}
+
+    // Before starting the thread
+    void Reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = false;
+    }
+
+    // The thread's last step
+    void Signal() {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        changed.notify_all();
+    }
+
+    void Wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() { return done; });
+    }
+
+private:
+    ThreadDone(const ThreadDone&);
+    ThreadDone& operator=(const ThreadDone&);
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool done;
+};
+
+// One background thread, stopped as described above. The owner asks its
+// loop to return (a flag and a wake-up of its own), then calls Stop.
+class BackgroundThread {
+public:
+    BackgroundThread() {}
+
+    // Runs body() on a new thread, then signals that it is done
+    template <class Body>
+    void Start(Body body) {
+        done.Reset();
+        thread = std::thread([this, body]() {
+            body();
+            done.Signal();      // Nothing of the owner is touched after this
+        });
+    }
+
+    bool Started() const { return thread.joinable(); }
+
+    // Waits for the body to return, unless the process is exiting, and
+    // lets go of the thread
+    void Stop(bool processExiting) {
+        if (!thread.joinable()) {
+            return;
+        }
+        if (!processExiting) {
+            done.Wait();
+        }
+        thread.detach();
+    }
+
+private:
+    BackgroundThread(const BackgroundThread&);
+    BackgroundThread& operator=(const BackgroundThread&);
+
+    ThreadDone done;
+    std::thread thread;
+};
+
+} // namespace HookLib
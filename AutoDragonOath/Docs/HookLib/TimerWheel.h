@@ -0,0 +1,397 @@
+// TimerWheel.h - Hierarchical timer wheel for delayed and periodic actions
+//
+// Delays used to be Sleep calls in the handlers, and the bot's cooldowns
+// were GetTickCount deltas looked at only when a chat message came in. A
+// TimerWheel runs actions at their time from one driver thread:
+//
+//   level 0   256 slots of 1 ms        (due within 256 ms)
+//   level 1   256 slots of 256 ms      (within 65 s)
+//   level 2   256 slots of 65 s        (within 4.6 h)
+//   level 3   256 slots of 4.6 h       (within 49 days)
+//
+// A timer goes into the slot of the coarsest level it needs, by its due
+// time. When level 0 wraps, the level 1 slot that has come up is spread
+// out over level 0, and so on up the levels (a "cascade"). Schedule and
+// Cancel are a list insert / unlink on a preallocated node: O(1), no
+// allocation. Advance steps over empty stretches of level 0 with a slot
+// bitmap instead of tick by tick.
+//
+// The clock is a function pointer: steady_clock milliseconds by default, a
+// counter in a check on Linux. Advance(now) can also be called directly,
+// without Start, which makes the wheel fully deterministic (see README).
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "ThreadDone.h"
+
+namespace HookLib {
+
+typedef uint64_t TimerId;                                       // 0: no timer
+
+static const size_t TIMER_SLOTS = 256;                          // Timers pending at once
+static const size_t TIMER_ACTION_BYTES = 64;                    // Captures of one action
+static const unsigned TIMER_IDLE_WAIT_MS = 1000;                // Driver wake-up with nothing pending
+static const unsigned TIMER_LEVELS = 4;
+static const unsigned TIMER_LEVEL_BITS = 8;
+static const unsigned TIMER_LEVEL_SLOTS = 1u << TIMER_LEVEL_BITS;
+
+// Milliseconds of std::chrono::steady_clock
+inline uint64_t TimerSteadyMilliseconds() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+class TimerWheel {
+public:
+    typedef uint64_t (*Clock)();
+
+    explicit TimerWheel(size_t timerCount = TIMER_SLOTS, Clock timerClock = TimerSteadyMilliseconds)
+        : clock(timerClock), nodes(timerCount), current(timerClock()), advanceTo(current), pending(0), dropped(0),
+          running(false), stopping(false), driverWakeAt(0) {
+        memset(heads, 0, sizeof(heads));
+        memset(occupied, 0, sizeof(occupied));
+        freeList = 0;
+        for (size_t i = timerCount; i > 0; i--) {
+            nodes[i - 1].next = freeList;
+            nodes[i - 1].generation = 0;
+            nodes[i - 1].state = NODE_FREE;
+            freeList = (uint32_t)i;
+        }
+    }
+
+    ~TimerWheel() { Stop(); }
+
+    // Runs `action` (a copy, with its captures) `delayMs` from now, then
+    // every `periodMs` if that is not 0. A late periodic timer runs once
+    // and keeps its phase. Any thread, including an action. Returns 0 if
+    // all timers are in use (counted).
+    template <class F>
+    TimerId Schedule(uint32_t delayMs, const F& action, uint32_t periodMs = 0) {
+        static_assert(std::is_trivially_copyable<F>::value, "capture plain values only");
+        static_assert(sizeof(F) <= TIMER_ACTION_BYTES && alignof(F) <= 8, "captures larger than TIMER_ACTION_BYTES");
+        std::lock_guard<std::mutex> lock(mutex);
+        if (freeList == 0) {
+            dropped++;
+            return 0;
+        }
+        uint32_t index = freeList;
+        Node& node = nodes[index - 1];
+        freeList = node.next;
+        node.run = [](const void* storage) { (*static_cast<const F*>(storage))(); };
+        new (node.storage) F(action);
+        node.expiry = clock() + delayMs;
+        if (node.expiry <= current) node.expiry = current + 1;
+        node.period = periodMs;
+        node.cancelled = false;
+        node.generation++;
+        Insert(index);
+        if (running && node.expiry < driverWakeAt) wake.notify_one();
+        return (uint64_t)node.generation << 32 | index;
+    }
+
+    // Removes a pending timer. An action already running is not waited for
+    // (Cancel may be called from it), but a periodic one is not run again.
+    // False if the timer has already run or been cancelled.
+    bool Cancel(TimerId id) {
+        uint32_t index = (uint32_t)id;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (index == 0 || index > nodes.size()) {
+            return false;
+        }
+        Node& node = nodes[index - 1];
+        if (node.generation != (uint32_t)(id >> 32) || node.state == NODE_FREE || node.cancelled) {
+            return false;
+        }
+        if (node.state == NODE_PENDING) {
+            Unlink(index);
+            Free(index);
+        } else {
+            node.cancelled = true;   // Due or running: Advance frees it
+        }
+        return true;
+    }
+
+    // Runs every action due at or before `now`, in due order, on the
+    // calling thread. One thread drives the wheel: the driver once Start
+    // has been called, otherwise the owner. Not from inside an action.
+    // Returns how many actions ran.
+    size_t Advance(uint64_t now) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return AdvanceLocked(now, lock);
+    }
+
+    // The wheel's time: inside an action, the time it was due
+    uint64_t Now() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return current;
+    }
+
+    // When Advance next has something to do (a due slot or a cascade), or
+    // UINT64_MAX if no timer is pending
+    uint64_t NextDue() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return NextDueLocked();
+    }
+
+    size_t Pending() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pending;
+    }
+
+    // Schedules refused because every timer was in use
+    uint64_t Dropped() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return dropped;
+    }
+
+    // Starts the driver thread, which sleeps until the next due time
+    bool Start() {
+        Stop();
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = false;
+        running = true;
+        driver.Start([this]() { DriverLoop(); });
+        return true;
+    }
+
+    // Pending timers stay pending. From DLL_PROCESS_DETACH pass
+    // processExiting = (lpReserved != NULL), as described in ThreadDone.h:
+    // on FreeLibrary Stop waits for a running action to return. At process
+    // exit the driver is already gone, possibly holding the mutex: Stop
+    // only lets go of the thread. Start and Stop are called by the owner
+    // only.
+    void Stop(bool processExiting = false) {
+        if (!driver.Started()) {
+            return;
+        }
+        if (processExiting) {
+            driver.Stop(true);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            wake.notify_one();
+        }
+        driver.Stop(false);
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+
+private:
+    TimerWheel(const TimerWheel&);
+    TimerWheel& operator=(const TimerWheel&);
+
+    enum NodeState : uint8_t {
+        NODE_FREE,
+        NODE_PENDING,   // In a slot list
+        NODE_DUE,       // Taken off the wheel by Advance, not run yet
+        NODE_RUNNING,
+    };
+
+    // Lists link by index + 1; 0 ends them
+    struct Node {
+        uint64_t expiry;
+        uint32_t period;
+        uint32_t generation;
+        uint32_t prev;
+        uint32_t next;
+        uint16_t slot;          // Level * TIMER_LEVEL_SLOTS + slot, while pending
+        NodeState state;
+        bool cancelled;
+        void (*run)(const void* storage);
+        alignas(8) unsigned char storage[TIMER_ACTION_BYTES];
+    };
+
+    // Into the slot of the coarsest level the time left needs
+    void Insert(uint32_t index) {
+        Node& node = nodes[index - 1];
+        uint64_t left = node.expiry > current ? node.expiry - current : 0;
+        // Past level 3's reach (a clock far ahead of the wheel): parked in
+        // the last slot it reaches, then placed again from there
+        uint64_t placed = left < (1ull << 32) ? node.expiry : current + 0xFFFFFFFFull;
+        unsigned level = 0;
+        while (level + 1 < TIMER_LEVELS && left >= (1ull << (TIMER_LEVEL_BITS * (level + 1)))) level++;
+        unsigned slot = (unsigned)(placed >> (TIMER_LEVEL_BITS * level)) & (TIMER_LEVEL_SLOTS - 1);
+        uint16_t list = (uint16_t)(level * TIMER_LEVEL_SLOTS + slot);
+
+        node.slot = list;
+        node.state = NODE_PENDING;
+        node.prev = 0;
+        node.next = heads[list];
+        if (heads[list] != 0) nodes[heads[list] - 1].prev = index;
+        heads[list] = index;
+        if (level == 0) occupied[slot >> 6] |= 1ull << (slot & 63);
+        pending++;
+    }
+
+    void Unlink(uint32_t index) {
+        Node& node = nodes[index - 1];
+        if (node.prev != 0) {
+            nodes[node.prev - 1].next = node.next;
+        } else {
+            heads[node.slot] = node.next;
+        }
+        if (node.next != 0) nodes[node.next - 1].prev = node.prev;
+        if (node.slot < TIMER_LEVEL_SLOTS && heads[node.slot] == 0) {
+            occupied[node.slot >> 6] &= ~(1ull << (node.slot & 63));
+        }
+        pending--;
+    }
+
+    void Free(uint32_t index) {
+        Node& node = nodes[index - 1];
+        node.state = NODE_FREE;
+        node.next = freeList;
+        freeList = index;
+    }
+
+    // Takes a whole slot list off the wheel
+    uint32_t Detach(unsigned list) {
+        uint32_t first = heads[list];
+        heads[list] = 0;
+        if (list < TIMER_LEVEL_SLOTS) occupied[list >> 6] &= ~(1ull << (list & 63));
+        for (uint32_t i = first; i != 0; i = nodes[i - 1].next) pending--;
+        return first;
+    }
+
+    // At a level 0 wrap: the slots of the higher levels that have come up,
+    // highest first, so each one lands in a slot still to be processed
+    void Cascade() {
+        unsigned top = 1;
+        while (top + 1 < TIMER_LEVELS && ((current >> (TIMER_LEVEL_BITS * top)) & (TIMER_LEVEL_SLOTS - 1)) == 0) {
+            top++;
+        }
+        for (unsigned level = top; level >= 1; level--) {
+            unsigned slot = (unsigned)(current >> (TIMER_LEVEL_BITS * level)) & (TIMER_LEVEL_SLOTS - 1);
+            uint32_t i = Detach(level * TIMER_LEVEL_SLOTS + slot);
+            while (i != 0) {
+                uint32_t next = nodes[i - 1].next;
+                Insert(i);
+                i = next;
+            }
+        }
+    }
+
+    // First occupied level 0 slot at or after `from`, or TIMER_LEVEL_SLOTS
+    unsigned NextOccupied(unsigned from) const {
+        for (unsigned word = from >> 6; word < TIMER_LEVEL_SLOTS / 64; word++) {
+            uint64_t bits = occupied[word];
+            if (word == (from >> 6)) bits &= ~0ull << (from & 63);
+            if (bits != 0) {
+                unsigned bit = 0;
+                while (((bits >> bit) & 1) == 0) bit++;
+                return word * 64 + bit;
+            }
+        }
+        return TIMER_LEVEL_SLOTS;
+    }
+
+    uint64_t NextDueLocked() const {
+        if (pending == 0) {
+            return UINT64_MAX;
+        }
+        uint64_t window = current & ~(uint64_t)(TIMER_LEVEL_SLOTS - 1);
+        unsigned slot = (unsigned)(current & (TIMER_LEVEL_SLOTS - 1)) + 1;
+        unsigned next = slot < TIMER_LEVEL_SLOTS ? NextOccupied(slot) : TIMER_LEVEL_SLOTS;
+        return window + next;   // TIMER_LEVEL_SLOTS: the next wrap
+    }
+
+    size_t AdvanceLocked(uint64_t now, std::unique_lock<std::mutex>& lock) {
+        size_t ran = 0;
+        if (now > advanceTo) advanceTo = now;
+        while (current < now) {
+            uint64_t due = NextDueLocked();
+            if (due > now) {
+                current = now;   // Nothing due and no wrap before `now`
+                break;
+            }
+            current = due;
+            if ((current & (TIMER_LEVEL_SLOTS - 1)) == 0) Cascade();
+            ran += RunSlot((unsigned)(current & (TIMER_LEVEL_SLOTS - 1)), lock);
+        }
+        return ran;
+    }
+
+    // Runs the level 0 slot `current` has reached. The lock is released
+    // around each action, so actions may Schedule and Cancel.
+    size_t RunSlot(unsigned slot, std::unique_lock<std::mutex>& lock) {
+        uint32_t first = Detach(slot);
+        for (uint32_t i = first; i != 0; i = nodes[i - 1].next) nodes[i - 1].state = NODE_DUE;
+
+        size_t ran = 0;
+        uint32_t i = first;
+        while (i != 0) {
+            Node& node = nodes[i - 1];
+            uint32_t next = node.next;
+            if (node.cancelled) {
+                Free(i);
+            } else if (node.expiry > current) {
+                Insert(i);   // Parked past level 3's reach, not due yet
+            } else {
+                node.state = NODE_RUNNING;
+                lock.unlock();
+                node.run(node.storage);
+                lock.lock();
+                ran++;
+                if (node.cancelled || node.period == 0) {
+                    Free(i);
+                } else {
+                    node.expiry += node.period;
+                    if (node.expiry <= advanceTo) {
+                        node.expiry += (advanceTo - node.expiry) / node.period * node.period + node.period;
+                    }
+                    Insert(i);
+                }
+            }
+            i = next;
+        }
+        return ran;
+    }
+
+    void DriverLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            uint64_t now = clock();
+            AdvanceLocked(now, lock);
+            if (stopping) break;
+            uint64_t due = NextDueLocked();
+            uint64_t wait = TIMER_IDLE_WAIT_MS;
+            if (due != UINT64_MAX) wait = due > now ? due - now : 0;
+            if (wait > TIMER_IDLE_WAIT_MS) wait = TIMER_IDLE_WAIT_MS;
+            // Schedule wakes the driver for a timer due before driverWakeAt
+            driverWakeAt = now + wait;
+            if (wait > 0) wake.wait_for(lock, std::chrono::milliseconds(wait));
+        }
+    }
+
+    Clock clock;
+    std::vector<Node> nodes;
+    uint32_t heads[TIMER_LEVELS * TIMER_LEVEL_SLOTS];
+    uint64_t occupied[TIMER_LEVEL_SLOTS / 64];     // Non-empty level 0 slots
+    uint32_t freeList;
+    uint64_t current;                               // Wheel time: everything before it has run
+    uint64_t advanceTo;                             // Latest `now` passed to Advance
+    size_t pending;
+    uint64_t dropped;
+    bool running;
+    bool stopping;
+    uint64_t driverWakeAt;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    BackgroundThread driver;
+};
+
+} // namespace HookLib
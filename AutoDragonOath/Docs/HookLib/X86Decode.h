@@ -0,0 +1,266 @@
+// X86Decode.h - x86 / x64 instruction length decoder
+//
+// Not a disassembler: it finds where an instruction ends and where its
+// displacement and immediate operands sit, which is all the signature tools
+// need. An operand is "unstable" when a relink can change it without the
+// code changing: branch displacements (E8/E9/Jcc rel32, rel8), RIP-relative
+// displacements, and absolute addresses (see Relocations.h).
+//
+// Table-driven over the one-byte and 0F two-byte opcode maps, with legacy
+// prefixes, operand/address size overrides, REX (64-bit mode) and the
+// 0F 38 / 0F 3A three-byte maps. VEX/EVEX encodings are not decoded; they
+// do not occur in Game.exe, which is built for plain IA-32.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace HookLib {
+
+// Longest valid x86 instruction
+static const size_t X86_MAX_LENGTH = 15;
+
+enum X86Mode {
+    X86_MODE_32 = 0,
+    X86_MODE_64
+};
+
+// Operand flags per opcode
+static const uint8_t X86_MODRM  = 0x01;    // ModRM (+ SIB + displacement)
+static const uint8_t X86_IMM8   = 0x02;
+static const uint8_t X86_IMM16  = 0x04;
+static const uint8_t X86_IMMZ   = 0x08;    // 16 or 32 bits (operand size)
+static const uint8_t X86_REL    = 0x10;    // Immediate is a branch displacement
+static const uint8_t X86_MOFFS  = 0x20;    // Absolute address (address size)
+static const uint8_t X86_GROUP3 = 0x40;    // F6/F7: immediate only for /0 and /1
+static const uint8_t X86_BAD    = 0x80;    // Prefix, escape or not decodable here
+
+static const uint8_t X86_M  = X86_MODRM;
+static const uint8_t X86_MB = X86_MODRM | X86_IMM8;
+static const uint8_t X86_MZ = X86_MODRM | X86_IMMZ;
+static const uint8_t X86_B  = X86_IMM8;
+static const uint8_t X86_W  = X86_IMM16;
+static const uint8_t X86_Z  = X86_IMMZ;
+static const uint8_t X86_R8 = X86_IMM8 | X86_REL;
+static const uint8_t X86_RZ = X86_IMMZ | X86_REL;
+static const uint8_t X86_WB = X86_IMM16 | X86_IMM8;    // enter
+static const uint8_t X86_ZW = X86_IMMZ | X86_IMM16;    // far call / jmp ptr16:32
+static const uint8_t X86_X  = X86_BAD;
+
+static const uint8_t kX86OneByte[256] = {
+    //  0      1      2      3      4      5      6      7      8      9      A      B      C      D      E      F
+    X86_M, X86_M, X86_M, X86_M, X86_B, X86_Z, 0,     0,     X86_M, X86_M, X86_M, X86_M, X86_B, X86_Z, 0,     X86_X,  // 0
+    X86_M, X86_M, X86_M, X86_M, X86_B, X86_Z, 0,     0,     X86_M, X86_M, X86_M, X86_M, X86_B, X86_Z, 0,     0,      // 1
+    X86_M, X86_M, X86_M, X86_M, X86_B, X86_Z, X86_X, 0,     X86_M, X86_M, X86_M, X86_M, X86_B, X86_Z, X86_X, 0,      // 2
+    X86_M, X86_M, X86_M, X86_M, X86_B, X86_Z, X86_X, 0,     X86_M, X86_M, X86_M, X86_M, X86_B, X86_Z, X86_X, 0,      // 3
+    0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,      // 4
+    0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     0,      // 5
+    0,     0,     X86_M, X86_M, X86_X, X86_X, X86_X, X86_X, X86_Z, X86_MZ,X86_B, X86_MB,0,     0,     0,     0,      // 6
+    X86_R8,X86_R8,X86_R8,X86_R8,X86_R8,X86_R8,X86_R8,X86_R8,X86_R8,X86_R8,X86_R8,X86_R8,X86_R8,X86_R8,X86_R8,X86_R8, // 7
+    X86_MB,X86_MZ,X86_MB,X86_MB,X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M,  // 8
+    0,     0,     0,     0,     0,     0,     0,     0,     0,     0,     X86_ZW,0,     0,     0,     0,     0,      // 9
+    X86_MOFFS,X86_MOFFS,X86_MOFFS,X86_MOFFS,0,0,   0,     0,     X86_B, X86_Z, 0,     0,     0,     0,     0,     0,      // A
+    X86_B, X86_B, X86_B, X86_B, X86_B, X86_B, X86_B, X86_B, X86_Z, X86_Z, X86_Z, X86_Z, X86_Z, X86_Z, X86_Z, X86_Z,  // B
+    X86_MB,X86_MB,X86_W, 0,     X86_M, X86_M, X86_MB,X86_MZ,X86_WB,0,     X86_W, 0,     0,     X86_B, 0,     0,      // C
+    X86_M, X86_M, X86_M, X86_M, X86_B, X86_B, 0,     0,     X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M,  // D
+    X86_R8,X86_R8,X86_R8,X86_R8,X86_B, X86_B, X86_B, X86_B, X86_RZ,X86_RZ,X86_ZW,X86_R8,0,     0,     0,     0,      // E
+    X86_X, 0,     X86_X, X86_X, 0,     0,     X86_M | X86_GROUP3, X86_M | X86_GROUP3, 0, 0, 0, 0,  0,     0,     X86_M, X86_M,  // F
+};
+
+static const uint8_t kX86TwoByte[256] = {
+    //  0      1      2      3      4      5      6      7      8      9      A      B      C      D      E      F
+    X86_M, X86_M, X86_M, X86_M, X86_X, 0,     0,     0,     0,     0,     X86_X, 0,     X86_X, X86_M, 0,     X86_MB, // 0
+    X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M,  // 1
+    X86_M, X86_M, X86_M, X86_M, X86_X, X86_X, X86_X, X86_X, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M,  // 2
+    0,     0,     0,     0,     0,     0,     X86_X, 0,     X86_X, X86_X, X86_X, X86_X, X86_X, X86_X, X86_X, X86_X,  // 3
+    X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M,  // 4
+    X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M,  // 5
+    X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M,  // 6
+    X86_MB,X86_MB,X86_MB,X86_MB,X86_M, X86_M, X86_M, 0,     X86_M, X86_M, X86_X, X86_X, X86_M, X86_M, X86_M, X86_M,  // 7
+    X86_RZ,X86_RZ,X86_RZ,X86_RZ,X86_RZ,X86_RZ,X86_RZ,X86_RZ,X86_RZ,X86_RZ,X86_RZ,X86_RZ,X86_RZ,X86_RZ,X86_RZ,X86_RZ, // 8
+    X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M,  // 9
+    0,     0,     0,     X86_M, X86_MB,X86_M, X86_X, X86_X, 0,     0,     0,     X86_M, X86_MB,X86_M, X86_M, X86_M,  // A
+    X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_X, X86_MB,X86_M, X86_M, X86_M, X86_M, X86_M,  // B
+    X86_M, X86_M, X86_MB,X86_M, X86_MB,X86_MB,X86_MB,X86_M, 0,     0,     0,     0,     0,     0,     0,     0,      // C
+    X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M,  // D
+    X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M,  // E
+    X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_M, X86_X,  // F
+};
+
+// Sign-extended little-endian operand of 1, 2 or 4 bytes
+inline int64_t ReadLeSigned(const uint8_t* p, size_t bytes) {
+    switch (bytes) {
+        case 1: return (int8_t)p[0];
+        case 2: return (int16_t)(p[0] | (p[1] << 8));
+        case 4: return (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+                                 ((uint32_t)p[3] << 24));
+        default: return 0;
+    }
+}
+
+// One decoded instruction. Offsets are relative to its first byte; a size
+// of 0 means the operand is absent.
+struct X86Instruction {
+    uint8_t length;
+    uint8_t opcodeOffset;       // First opcode byte, after the prefixes
+    uint8_t opcode;             // Last opcode byte (0F xx -> xx)
+    uint8_t opcodeMap;          // 1 = one-byte, 2 = 0F, 3 = 0F 38 / 0F 3A
+    uint8_t modrm;              // Valid if hasModrm
+    bool hasModrm;
+    uint8_t dispOffset;
+    uint8_t dispSize;
+    bool ripRelative;           // disp32 is relative to the next instruction (x64)
+    uint8_t immOffset;
+    uint8_t immSize;
+    bool relative;              // Immediate is a branch displacement
+    bool absoluteAddress;       // Immediate is a memory address (A0-A3 moffs)
+
+    // Branch / RIP-relative target as an offset into `code`, for the
+    // instruction at code + at. (size_t)-1 if it has neither.
+    size_t Target(const uint8_t* code, size_t at) const {
+        if (relative) {
+            return at + length + (size_t)ReadLeSigned(code + at + immOffset, immSize);
+        }
+        if (ripRelative) {
+            return at + length + (size_t)ReadLeSigned(code + at + dispOffset, dispSize);
+        }
+        return (size_t)-1;
+    }
+};
+
+// Decodes the instruction at code[0, available). Returns false for bytes
+// this decoder does not handle or an instruction cut off by `available`.
+inline bool DecodeX86(const uint8_t* code, size_t available, X86Mode mode, X86Instruction* out) {
+    X86Instruction ins = {};
+    size_t limit = (available < X86_MAX_LENGTH) ? available : X86_MAX_LENGTH;
+    size_t at = 0;
+    bool operandSize16 = false;
+    bool addressSize16 = false;
+    bool rexW = false;
+
+    // Legacy prefixes, then at most one REX right before the opcode
+    for (;; at++) {
+        if (at >= limit) return false;
+        uint8_t b = code[at];
+        if (b == 0x66) {
+            operandSize16 = true;
+        } else if (b == 0x67) {
+            addressSize16 = true;
+        } else if (b == 0xF0 || b == 0xF2 || b == 0xF3 || b == 0x2E || b == 0x36 || b == 0x3E ||
+                   b == 0x26 || b == 0x64 || b == 0x65) {
+            // lock / rep / segment
+        } else {
+            break;
+        }
+    }
+    if (mode == X86_MODE_64 && (code[at] & 0xF0) == 0x40) {
+        rexW = (code[at] & 0x08) != 0;
+        if (++at >= limit) return false;
+    }
+
+    ins.opcodeOffset = (uint8_t)at;
+    uint8_t flags;
+    uint8_t opcode = code[at++];
+    if (opcode == 0x0F) {
+        if (at >= limit) return false;
+        opcode = code[at++];
+        if (opcode == 0x38 || opcode == 0x3A) {
+            if (at >= limit) return false;
+            flags = (opcode == 0x3A) ? X86_MB : X86_M;
+            opcode = code[at++];
+            ins.opcodeMap = 3;
+        } else {
+            flags = kX86TwoByte[opcode];
+            ins.opcodeMap = 2;
+        }
+    } else {
+        flags = kX86OneByte[opcode];
+        ins.opcodeMap = 1;
+
+        if (mode == X86_MODE_64) {
+            // Invalid in 64-bit mode (push/pop seg, BCD, pusha, bound, far ptr, les/lds = VEX)
+            switch (opcode) {
+                case 0x06: case 0x07: case 0x0E: case 0x16: case 0x17: case 0x1E: case 0x1F:
+                case 0x27: case 0x2F: case 0x37: case 0x3F: case 0x60: case 0x61: case 0x62:
+                case 0x9A: case 0xC4: case 0xC5: case 0xD4: case 0xD5: case 0xEA:
+                    return false;
+                default:
+                    break;
+            }
+        }
+    }
+    ins.opcode = opcode;
+    if (flags & X86_BAD) {
+        return false;
+    }
+
+    if (flags & X86_MODRM) {
+        if (at >= limit) return false;
+        uint8_t modrm = code[at++];
+        ins.modrm = modrm;
+        ins.hasModrm = true;
+        uint8_t mod = modrm >> 6;
+        uint8_t rm = modrm & 7;
+
+        size_t disp = 0;
+        if (mod != 3) {
+            if (addressSize16 && mode == X86_MODE_32) {
+                disp = (mod == 1) ? 1 : (mod == 2 || (mod == 0 && rm == 6)) ? 2 : 0;
+            } else {
+                if (rm == 4) {
+                    if (at >= limit) return false;
+                    uint8_t sib = code[at++];
+                    if (mod == 0 && (sib & 7) == 5) disp = 4;
+                }
+                if (mod == 1) disp = 1;
+                if (mod == 2) disp = 4;
+                if (mod == 0 && rm == 5) {
+                    disp = 4;
+                    ins.ripRelative = (mode == X86_MODE_64);
+                }
+            }
+        }
+        if (disp != 0) {
+            ins.dispOffset = (uint8_t)at;
+            ins.dispSize = (uint8_t)disp;
+            at += disp;
+        }
+
+        if ((flags & X86_GROUP3) && ((modrm >> 3) & 7) < 2) {
+            flags |= (opcode == 0xF6) ? X86_IMM8 : X86_IMMZ;
+        }
+    }
+
+    size_t imm = 0;
+    if (flags & X86_IMM8) imm += 1;
+    if (flags & X86_IMM16) imm += 2;
+    if (flags & X86_IMMZ) {
+        if (ins.opcodeMap == 1 && opcode >= 0xB8 && opcode <= 0xBF && rexW) {
+            imm += 8;                       // mov r64, imm64
+        } else if (operandSize16 && !rexW && !(mode == X86_MODE_64 && (flags & X86_REL))) {
+            imm += 2;
+        } else {
+            imm += 4;
+        }
+    }
+    if (flags & X86_MOFFS) {
+        imm += (mode == X86_MODE_64) ? (addressSize16 ? 4 : 8) : (addressSize16 ? 2 : 4);
+        ins.absoluteAddress = true;
+    }
+    if (imm != 0) {
+        ins.immOffset = (uint8_t)at;
+        ins.immSize = (uint8_t)imm;
+        ins.relative = (flags & X86_REL) != 0;
+        at += imm;
+    }
+
+    if (at > limit) {
+        return false;
+    }
+    ins.length = (uint8_t)at;
+    *out = ins;
+    return true;
+}
+
+} // namespace HookLib
@@ -0,0 +1,358 @@
+// XrefIndex.h - Call / jump / string cross-references of a module, indexed once
+//
+// A generic prologue matches hundreds of functions, but the one we want is
+// often the only one that pushes a certain string (the TDAssert in
+// GCChatHandler::Execute pushes its own name) or that is called from a
+// function we already found. XrefIndex decodes the executable sections once
+// and records
+//
+//   XREF_CALL   call rel32 (E8)
+//   XREF_JUMP   jmp rel32 (E9)
+//   XREF_DATA   push imm32 (68) of an address in the image, the usual
+//               string argument in 32-bit code; on x64, RIP-relative
+//               operands (lea rcx, [aText])
+//
+// as two sorted tables, by target and by source, so "who references this
+// string" and "what does this function call" are binary searches. A
+// function runs from one function start to the next (at most
+// XREF_MAX_FUNCTION_BYTES). Starts come from FunctionStarts.h, the same
+// rules tools/FunctionIndex.h uses; the code pointers in the data sections
+// matter for virtual functions such as GCChatHandler::Execute.
+//
+// GameSignatures.h builds one index per resolve, and only if some signature
+// with XrefRules has candidates; every such signature is then filtered
+// against the same index.
+
+#pragma once
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "FunctionStarts.h"
+#include "ParallelScan.h"
+#include "SectionScan.h"
+#include "X86Decode.h"
+
+namespace HookLib {
+
+enum XrefKind {
+    XREF_CALL = 0,
+    XREF_JUMP,
+    XREF_DATA,
+    XREF_KIND_COUNT
+};
+
+// Code is decoded in chunks of this size, one per worker at a time. Each
+// chunk starts decoding XREF_SYNC_BYTES early; x86 decoding falls back in
+// step with the real instruction stream within a few instructions.
+static const size_t XREF_CHUNK_BYTES = 1 << 20;
+static const size_t XREF_SYNC_BYTES = 64;
+
+// Upper bound on a function's extent when no later start bounds it
+static const size_t XREF_MAX_FUNCTION_BYTES = 0x2000;
+
+// One reference, as buffer offsets: the instruction and what it points at
+struct Xref {
+    uint32_t from;
+    uint32_t to;
+};
+
+struct XrefRange {
+    const Xref* begin;
+    const Xref* end;
+
+    size_t Size() const { return (size_t)(end - begin); }
+    bool Empty() const { return begin == end; }
+};
+
+class XrefIndex {
+public:
+    // Decodes the executable sections of `pe` on `threads` workers
+    void Build(const PeImage& pe, unsigned threads = 1) {
+        for (int kind = 0; kind < XREF_KIND_COUNT; kind++) {
+            bySource[kind].clear();
+            byTarget[kind].clear();
+        }
+        functionStarts.clear();
+
+        std::vector<ScanRegion> regions;
+        CollectScanRegions(pe, SIGNATURE_CODE, &regions);
+        std::vector<ScanRegion> chunks;
+        for (size_t r = 0; r < regions.size(); r++) {
+            for (size_t begin = regions[r].begin; begin < regions[r].end; begin += XREF_CHUNK_BYTES) {
+                size_t end = (regions[r].end - begin < XREF_CHUNK_BYTES) ? regions[r].end : begin + XREF_CHUNK_BYTES;
+                chunks.push_back(ScanRegion{ begin, end });
+            }
+        }
+
+        // Per chunk and kind; concatenated in chunk order they are sorted by source
+        std::vector<std::vector<Xref> > found(chunks.size() * XREF_KIND_COUNT);
+        std::vector<std::vector<uint32_t> > padded(chunks.size());
+        std::vector<uint8_t> instructionStart(pe.Size(), 0);   // Chunks write disjoint bytes
+        std::atomic<size_t> next(0);
+        auto work = [&](unsigned) {
+            for (;;) {
+                size_t c = next.fetch_add(1);
+                if (c >= chunks.size()) return;
+                DecodeChunk(pe, regions, chunks[c], &found[c * XREF_KIND_COUNT], &padded[c], instructionStart.data());
+            }
+        };
+        RunScanWorkers(threads, work);
+
+        for (int kind = 0; kind < XREF_KIND_COUNT; kind++) {
+            for (size_t c = 0; c < chunks.size(); c++) {
+                const std::vector<Xref>& part = found[c * XREF_KIND_COUNT + kind];
+                bySource[kind].insert(bySource[kind].end(), part.begin(), part.end());
+            }
+            byTarget[kind] = bySource[kind];
+            std::sort(byTarget[kind].begin(), byTarget[kind].end(), [](const Xref& a, const Xref& b) {
+                return a.to < b.to || (a.to == b.to && a.from < b.from);
+            });
+        }
+
+        const std::vector<Xref>& calls = byTarget[XREF_CALL];
+        for (size_t i = 0; i < calls.size(); i++) functionStarts.push_back(calls[i].to);
+        for (size_t c = 0; c < padded.size(); c++) {
+            functionStarts.insert(functionStarts.end(), padded[c].begin(), padded[c].end());
+        }
+        FinishFunctionStarts(pe, instructionStart.data(), &functionStarts);
+    }
+
+    size_t Count(XrefKind kind) const { return bySource[kind].size(); }
+
+    // References of `kind` to `target`, by ascending source
+    XrefRange To(XrefKind kind, size_t target) const {
+        const std::vector<Xref>& table = byTarget[kind];
+        const Xref* first = table.data();
+        const Xref* last = table.data() + table.size();
+        const Xref* begin = std::lower_bound(first, last, target, [](const Xref& x, size_t value) {
+            return x.to < value;
+        });
+        const Xref* end = std::upper_bound(begin, last, target, [](size_t value, const Xref& x) {
+            return value < x.to;
+        });
+        return XrefRange{ begin, end };
+    }
+
+    // References of `kind` made by instructions starting in [begin, end)
+    XrefRange From(XrefKind kind, size_t begin, size_t end) const {
+        const std::vector<Xref>& table = bySource[kind];
+        const Xref* first = table.data();
+        const Xref* last = table.data() + table.size();
+        auto before = [](const Xref& x, size_t value) { return x.from < value; };
+        return XrefRange{ std::lower_bound(first, last, begin, before), std::lower_bound(first, last, end, before) };
+    }
+
+    // Start of the function holding `offset`: the nearest function start at
+    // or below it. NPOS if there is none within XREF_MAX_FUNCTION_BYTES.
+    size_t FunctionStart(size_t offset) const {
+        std::vector<uint32_t>::const_iterator next =
+            std::upper_bound(functionStarts.begin(), functionStarts.end(), offset);
+        if (next == functionStarts.begin() || offset - *(next - 1) >= XREF_MAX_FUNCTION_BYTES) {
+            return NPOS;
+        }
+        return *(next - 1);
+    }
+
+    // End of the function starting at `start`: the next function start
+    // above it, at most XREF_MAX_FUNCTION_BYTES away
+    size_t FunctionEnd(size_t start) const {
+        std::vector<uint32_t>::const_iterator next =
+            std::upper_bound(functionStarts.begin(), functionStarts.end(), start);
+        if (next == functionStarts.end() || *next - start > XREF_MAX_FUNCTION_BYTES) {
+            return start + XREF_MAX_FUNCTION_BYTES;
+        }
+        return *next;
+    }
+
+    // Distinct starts of the functions that call `function`
+    void Callers(size_t function, std::vector<size_t>* functions) const {
+        CollectFunctions(To(XREF_CALL, function), functions);
+    }
+
+    // Distinct starts of the functions that reference `data` (a string...)
+    void FunctionsReferencing(size_t data, std::vector<size_t>* functions) const {
+        CollectFunctions(To(XREF_DATA, data), functions);
+    }
+
+private:
+    void CollectFunctions(XrefRange sites, std::vector<size_t>* functions) const {
+        functions->clear();
+        for (const Xref* x = sites.begin; x != sites.end; x++) {
+            size_t start = FunctionStart(x->from);
+            if (start != NPOS) functions->push_back(start);
+        }
+        std::sort(functions->begin(), functions->end());
+        functions->erase(std::unique(functions->begin(), functions->end()), functions->end());
+    }
+
+    static bool InRegions(const std::vector<ScanRegion>& regions, size_t offset) {
+        for (size_t r = 0; r < regions.size(); r++) {
+            if (offset >= regions[r].begin && offset < regions[r].end) return true;
+        }
+        return false;
+    }
+
+    // Decodes one chunk: references into `out`, the first aligned
+    // instruction after CC padding into `padded`, and a mark in
+    // instructionStart for every instruction
+    static void DecodeChunk(const PeImage& pe, const std::vector<ScanRegion>& regions, const ScanRegion& chunk,
+                            std::vector<Xref>* out, std::vector<uint32_t>* padded, uint8_t* instructionStart) {
+        size_t regionEnd = chunk.end;
+        size_t regionBegin = chunk.begin;
+        for (size_t r = 0; r < regions.size(); r++) {
+            if (chunk.begin >= regions[r].begin && chunk.begin < regions[r].end) {
+                regionBegin = regions[r].begin;
+                regionEnd = regions[r].end;
+            }
+        }
+
+        size_t from = (chunk.begin - regionBegin > XREF_SYNC_BYTES) ? chunk.begin - XREF_SYNC_BYTES : regionBegin;
+        SweepFunctionCode(pe, from, chunk.begin, chunk.end, regionEnd, instructionStart, padded,
+                          [&](size_t at, const X86Instruction& ins) { Record(pe, regions, ins, at, out); });
+    }
+
+    static void Record(const PeImage& pe, const std::vector<ScanRegion>& regions, const X86Instruction& ins,
+                       size_t at, std::vector<Xref>* out) {
+        const uint8_t* data = pe.Data();
+        if (ins.opcodeMap == 1 && ins.relative && ins.immSize == 4 && (ins.opcode == 0xE8 || ins.opcode == 0xE9)) {
+            size_t target = CodeTarget(pe, ins, at);
+            if (InRegions(regions, target)) {
+                out[(ins.opcode == 0xE8) ? XREF_CALL : XREF_JUMP].push_back(Xref{ (uint32_t)at, (uint32_t)target });
+            }
+            return;
+        }
+
+        size_t target = NPOS;
+        if (ins.ripRelative) {
+            target = CodeTarget(pe, ins, at);
+        } else if (!pe.Is64Bit() && ins.opcodeMap == 1 && ins.opcode == 0x68 && ins.immSize == 4) {
+            uint32_t value = ReadLe32(data + at + ins.immOffset);
+            if (value >= pe.imageBase && value - pe.imageBase < pe.sizeOfImage) {
+                target = pe.RvaToOffset((size_t)(value - pe.imageBase));
+            }
+        }
+        if (target != NPOS && target < pe.Size()) {
+            out[XREF_DATA].push_back(Xref{ (uint32_t)at, (uint32_t)target });
+        }
+    }
+
+    std::vector<Xref> bySource[XREF_KIND_COUNT];
+    std::vector<Xref> byTarget[XREF_KIND_COUNT];
+    std::vector<uint32_t> functionStarts;   // Distinct, ascending
+};
+
+// ============================================================================
+// STRINGS
+// ============================================================================
+
+// Every occurrence of `text` (without its terminator, so it also finds
+// longer strings starting with it) in the data sections of `pe`
+inline void FindDataStrings(const PeImage& pe, const char* text, std::vector<size_t>* offsets) {
+    offsets->clear();
+    size_t length = strlen(text);
+    if (length == 0) {
+        return;
+    }
+
+    std::vector<ScanRegion> regions;
+    CollectScanRegions(pe, SIGNATURE_DATA, &regions);
+    const uint8_t* data = pe.Data();
+    for (size_t r = 0; r < regions.size(); r++) {
+        for (size_t at = regions[r].begin; at + length <= regions[r].end; at++) {
+            const void* hit = memchr(data + at, text[0], regions[r].end - length + 1 - at);
+            if (hit == nullptr) break;
+            at = (const uint8_t*)hit - data;
+            if (memcmp(data + at, text, length) == 0) offsets->push_back(at);
+        }
+    }
+}
+
+// Distinct starts of the functions that reference a string starting with `text`
+inline void FunctionsReferencingString(const XrefIndex& xrefs, const PeImage& pe, const char* text,
+                                       std::vector<size_t>* functions) {
+    std::vector<size_t> strings;
+    FindDataStrings(pe, text, &strings);
+    functions->clear();
+    std::vector<size_t> local;
+    for (size_t i = 0; i < strings.size(); i++) {
+        xrefs.FunctionsReferencing(strings[i], &local);
+        functions->insert(functions->end(), local.begin(), local.end());
+    }
+    std::sort(functions->begin(), functions->end());
+    functions->erase(std::unique(functions->begin(), functions->end()), functions->end());
+}
+
+// ============================================================================
+// CANDIDATE RULES
+// ============================================================================
+
+enum XrefRuleKind {
+    XREF_RULE_STRING = 0,   // The candidate references a string starting with `text`
+    XREF_RULE_CALLED_BY     // A match of signature `signature` calls the candidate
+};
+
+struct XrefRule {
+    XrefRuleKind kind;
+    const char* text;
+    int signature;          // Index into the same signature table
+};
+
+constexpr XrefRule XrefReferencesString(const char* text) {
+    return XrefRule{ XREF_RULE_STRING, text, 0 };
+}
+
+// Only the callers' matches in the same table scan count, so the caller's
+// entry must come earlier in the table if it has rules of its own.
+constexpr XrefRule XrefCalledBy(int signature) {
+    return XrefRule{ XREF_RULE_CALLED_BY, nullptr, signature };
+}
+
+// Drops the candidates (function starts) that fail any of rules[]. `matches`
+// holds the other signatures' candidates, for XREF_RULE_CALLED_BY.
+inline void FilterByXrefRules(const XrefIndex& xrefs, const PeImage& pe, const XrefRule* rules, size_t count,
+                              const std::vector<std::vector<size_t> >& matches, std::vector<size_t>* candidates) {
+    for (size_t i = 0; i < count && !candidates->empty(); i++) {
+        const XrefRule& rule = rules[i];
+        std::vector<size_t> kept;
+        if (rule.kind == XREF_RULE_STRING) {
+            std::vector<size_t> strings;
+            FindDataStrings(pe, rule.text, &strings);
+            // A candidate is a function start too, found by the index or
+            // not: the one before it ends there
+            std::vector<size_t> starts(*candidates);
+            std::sort(starts.begin(), starts.end());
+            for (size_t c = 0; c < candidates->size(); c++) {
+                size_t start = (*candidates)[c];
+                size_t end = xrefs.FunctionEnd(start);
+                std::vector<size_t>::const_iterator after = std::upper_bound(starts.begin(), starts.end(), start);
+                if (after != starts.end() && *after < end) end = *after;
+                XrefRange sites = xrefs.From(XREF_DATA, start, end);
+                for (const Xref* x = sites.begin; x != sites.end; x++) {
+                    if (std::binary_search(strings.begin(), strings.end(), (size_t)x->to)) {
+                        kept.push_back(start);
+                        break;
+                    }
+                }
+            }
+        } else {
+            std::vector<size_t> callees;
+            const std::vector<size_t>& callers = matches[rule.signature];
+            for (size_t m = 0; m < callers.size(); m++) {
+                XrefRange calls = xrefs.From(XREF_CALL, callers[m], xrefs.FunctionEnd(callers[m]));
+                for (const Xref* x = calls.begin; x != calls.end; x++) callees.push_back(x->to);
+            }
+            std::sort(callees.begin(), callees.end());
+            for (size_t c = 0; c < candidates->size(); c++) {
+                if (std::binary_search(callees.begin(), callees.end(), (*candidates)[c])) {
+                    kept.push_back((*candidates)[c]);
+                }
+            }
+        }
+        candidates->swap(kept);
+    }
+}
+
+} // namespace HookLib
@@ -4,12 +4,13 @@
 // Pattern: 55-8B-EC-81-EC-18-01-00-00-A1-04-49-64-00-53-8B-1D-84-A3-5E-00...
 //
 // Compile with:
-// cl /LD /MT /O2 ChatHookDLL_Pattern1.cpp /I"C:\Detours\include" /link /LIBPATH:"C:\Detours\lib.X86" detours.lib /OUT:ChatHookDLL_Pattern1.dll
+// cl /LD /MT /O2 /std:c++17 /EHsc ChatHookDLL_Pattern1.cpp /I"C:\Detours\include" /link /LIBPATH:"C:\Detours\lib.X86" detours.lib /OUT:ChatHookDLL_Pattern1.dll
 
 #include <Windows.h>
 #include <stdio.h>
 #include <detours.h>  // Microsoft Detours library
 #include <Psapi.h>    // For GetModuleInformation
+#include "../HookLib/GameSignatures.h"  // Shared signature table + scanner
 
 // ============================================================================
 // PACKET STRUCTURE DEFINITIONS (from source code analysis)
@@ -49,6 +50,7 @@ GCChatHandler_Execute_t Original_GCChatHandler_Execute = NULL;
 
 #define ENABLE_FILE_LOGGING    1
 #define ENABLE_CONSOLE_OUTPUT  0
+#define ADDRESS_CACHE_PATH     "C:\\DragonOath_AddressCache.txt"
 #define LOG_FILE_PATH          "C:\\DragonOath_ChatLog_Pattern1.txt"
 
 // ============================================================================
@@ -171,25 +173,6 @@ unsigned int __fastcall Hooked_GCChatHandler_Execute(void* thisPtr, void* edx, G
 // PATTERN SCANNING (to find function addresses dynamically)
 // ============================================================================
 
-DWORD FindPattern(BYTE* pattern, const char* mask, DWORD startAddress, DWORD searchSize) {
-    DWORD patternLength = strlen(mask);
-
-    for (DWORD i = 0; i < searchSize - patternLength; i++) {
-        bool found = true;
-        for (DWORD j = 0; j < patternLength; j++) {
-            if (mask[j] != '?' && pattern[j] != *(BYTE*)(startAddress + i + j)) {
-                found = false;
-                break;
-            }
-        }
-        if (found) {
-            return startAddress + i;
-        }
-    }
-
-    return 0;
-}
-
 DWORD FindGCChatHandlerExecute() {
     // Get Game.exe module base
     HMODULE gameModule = GetModuleHandleA("Game.exe");
@@ -206,31 +189,46 @@ DWORD FindGCChatHandlerExecute() {
     DWORD moduleSize = modInfo.SizeOfImage;
 
     // ========================================================================
-    // PATTERN FROM MEMORY SCANNER - VERIFIED ADDRESS: 0x0048D6F0
-    // Scanner output: 55-8B-EC-81-EC-18-01-00-00-A1-04-49-64-00-53-8B-1D-84-A3-5E-00...
-    // Using first 20 bytes for uniqueness
+    // SIGNATURES FROM MEMORY SCANNER - see HookLib/GameSignatures.h
+    // Pattern 1: 55-8B-EC-81-EC-18-01-00-00-A1-04-49-64-00-53-8B-1D-84-A3-5E (0x0048D6F0)
+    // Pattern 2: 55-8B-EC-81-EC-1C-01-00-00-A1-04-49-64-00-53-8B-1D-84-A3-5E (0x0048D790)
+    // Both are resolved in the same pass; Pattern 1 is preferred, Pattern 2 is the fallback
     // ========================================================================
-    BYTE pattern[] = {
-        0x55, 0x8B, 0xEC, 0x81, 0xEC, 0x18, 0x01, 0x00,  // push ebp; mov ebp, esp; sub esp, 118h
-        0x00, 0xA1, 0x04, 0x49, 0x64, 0x00, 0x53, 0x8B,  // mov eax, [security cookie]; push ebx; mov ebx
-        0x1D, 0x84, 0xA3, 0x5E                            // continuing...
-    };
-    const char* mask = "xxxxxxxxxxxxxxxxxxxx";  // All exact matches
+    static const int preference[] = { HookLib::SIG_HANDLE_RECV_TALK_PACKET_1, HookLib::SIG_HANDLE_RECV_TALK_PACKET_2 };
 
     LogToFile("=== Pattern 1 Scanner ===");
     LogToFile("Searching for HandleRecvTalkPacket (Pattern 1: 0x0048D6F0)...");
     LogToFile("  Base: 0x%08X, Size: 0x%08X", baseAddress, moduleSize);
     LogToFile("  Expected offset: +0x8D6F0");
 
-    DWORD address = FindPattern(pattern, mask, baseAddress, moduleSize);
+    // Cached RVA for this exact Game.exe build -> expected offset -> one full scan -> closest match
+    HookLib::ResolveResult result;
+    HookLib::ResolveGameSignature((const uint8_t*)baseAddress, moduleSize, preference, 2,
+                                  ADDRESS_CACHE_PATH, HookLib::DefaultScanThreads(), &result);
 
-    if (address) {
-        LogToFile("  Found at: 0x%08X", address);
-        LogToFile("  Offset from base: +0x%X", address - baseAddress);
-    } else {
+    LogToFile("  Resolved via: %s", HookLib::ResolveMethodName(result.method));
+    if (result.method == HookLib::RESOLVE_APPROXIMATE) {
+        LogToFile("  WARNING: %u byte(s) differ from the signature - update it in HookLib/GameSignatures.h",
+                  result.mismatches);
+    }
+    if (!result.matches.empty()) {
+        for (int i = 0; i < HookLib::SIG_COUNT; i++) {
+            LogToFile("  %s: %d match(es)", HookLib::kGameSignatures[i].name, (int)result.matches[i].size());
+        }
+    }
+
+    size_t offset = result.offset;
+    int chosen = result.signature;
+
+    if (offset == HookLib::NPOS) {
         LogToFile("  NOT FOUND - Pattern mismatch or game updated!");
+        return 0;
     }
 
+    DWORD address = baseAddress + (DWORD)offset;
+    LogToFile("  Found %s at: 0x%08X", HookLib::kGameSignatures[chosen].name, address);
+    LogToFile("  Offset from base: +0x%X", address - baseAddress);
+
     return address;
 }
 
@@ -247,8 +245,8 @@ bool InstallHook() {
         LogToFile("ERROR: Could not find HandleRecvTalkPacket");
         MessageBoxA(NULL,
             "Failed to find chat handler function!\n"
-            "Pattern 1 did not match.\n"
-            "Try Pattern 2 or check if game was updated.",
+            "Neither Pattern 1 nor Pattern 2 matched.\n"
+            "Check if game was updated.",
             "Chat Hook Error - Pattern 1",
             MB_OK | MB_ICONERROR);
         return false;
@@ -289,6 +287,12 @@ void UninstallHook() {
     }
 }
 
+// Installs the hook off the loader lock (see HookInitThread in ChatHookDLL.cpp)
+DWORD WINAPI HookInitThread(LPVOID) {
+    InstallHook();
+    return 0;
+}
+
 // ============================================================================
 // DLL ENTRY POINT
 // ============================================================================
@@ -299,8 +303,11 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD reason, LPVOID lpReserved) {
             // Disable DLL_THREAD_ATTACH/DETACH notifications for performance
             DisableThreadLibraryCalls(hModule);
 
-            // Install the hook
-            InstallHook();
+            // Install the hook (off the loader lock, see HookInitThread)
+            {
+                HANDLE initThread = CreateThread(NULL, 0, HookInitThread, NULL, 0, NULL);
+                if (initThread) CloseHandle(initThread);
+            }
             break;
 
         case DLL_PROCESS_DETACH:
@@ -322,7 +329,7 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD reason, LPVOID lpReserved) {
  *    cd G:\microauto-6.9\AutoDragonOath\Docs\test-dll
  *
  * 3. Compile the DLL:
- *    cl /LD /MT /O2 ChatHookDLL_Pattern1.cpp ^
+ *    cl /LD /MT /O2 /std:c++17 /EHsc ChatHookDLL_Pattern1.cpp ^
  *       /I"C:\Detours\include" ^
  *       /link /LIBPATH:"C:\Detours\lib.X86" detours.lib Psapi.lib ^
  *       /OUT:ChatHookDLL_Pattern1.dll
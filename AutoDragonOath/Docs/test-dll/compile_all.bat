@@ -28,7 +28,7 @@ if not exist "C:\Detours\include\detours.h" (
 )
 
 echo [1/3] Compiling Pattern 1...
-cl /LD /MT /O2 ChatHookDLL_Pattern1.cpp ^
+cl /LD /MT /O2 /std:c++17 /EHsc ChatHookDLL_Pattern1.cpp ^
    /I"C:\Detours\include" ^
    /link /LIBPATH:"C:\Detours\lib.X86" detours.lib Psapi.lib ^
    /OUT:ChatHookDLL_Pattern1.dll
@@ -41,7 +41,7 @@ if errorlevel 1 (
 
 echo.
 echo [2/3] Compiling Pattern 2...
-cl /LD /MT /O2 ChatHookDLL_Pattern2.cpp ^
+cl /LD /MT /O2 /std:c++17 /EHsc ChatHookDLL_Pattern2.cpp ^
    /I"C:\Detours\include" ^
    /link /LIBPATH:"C:\Detours\lib.X86" detours.lib Psapi.lib ^
    /OUT:ChatHookDLL_Pattern2.dll
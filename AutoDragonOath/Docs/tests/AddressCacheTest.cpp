@@ -0,0 +1,193 @@
+// AddressCacheTest.cpp - Fingerprints, cache lookups and stale-entry invalidation
+//
+// Builds a mapped image with TestPe.h and checks:
+//   - the fingerprint follows the timestamp, SizeOfImage, headers and the
+//     sampled code pages, and ignores data (which changes at run time)
+//   - Store / Lookup / Forget, replacement, and the oldest entries dropped
+//     past ADDRESS_CACHE_MAX_ENTRIES
+//   - Save / Load round trip; malformed lines are skipped
+//   - ResolveGameSignature: a full scan fills the cache, the next start is
+//     a cache hit, and an entry whose signature moved is dropped and
+//     replaced by the new offset
+//
+// The cache files are written to the working directory.
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "../HookLib/GameSignatures.h"
+#include "TestCheck.h"
+#include "TestPe.h"
+
+using namespace HookLib;
+
+static const uint32_t CODE_BYTES = 0x20000;
+static const char* CACHE_PATH = "AddressCacheTest.cache.txt";
+
+static ModuleFingerprint Fingerprint(const std::vector<uint8_t>& image) {
+    ModuleFingerprint fingerprint;
+    memset(&fingerprint, 0, sizeof(fingerprint));
+    CHECK(ComputeModuleFingerprint(image.data(), image.size(), &fingerprint));
+    return fingerprint;
+}
+
+static void CheckFingerprint(const TestPe& builder, uint32_t codeRva, uint32_t dataRva,
+                             std::vector<uint32_t>* unsampledPages) {
+    std::vector<uint8_t> image = builder.Build(PE_LAYOUT_MAPPED);
+    ModuleFingerprint base = Fingerprint(image);
+    CHECK(base.timeDateStamp == builder.timeDateStamp);
+    CHECK(base.sizeOfImage == builder.SizeOfImage());
+    CHECK(Fingerprint(image) == base);
+
+    std::vector<uint8_t> changed = image;
+    changed[dataRva + 0x10] ^= 0xFF;
+    CHECK(Fingerprint(changed) == base);
+
+    changed = image;
+    changed[TEST_PE_NT_OFFSET + 8] ^= 1;        // TimeDateStamp
+    CHECK(!(Fingerprint(changed) == base));
+
+    changed = image;
+    changed[0x300] ^= 1;                        // Header page, past the section table
+    CHECK(!(Fingerprint(changed) == base));
+
+    // Every code page is either sampled (a change shows) or not; the first
+    // and the last always are, and FINGERPRINT_SAMPLE_PAGES of them at most
+    size_t sampled = 0;
+    for (uint32_t page = codeRva; page < codeRva + CODE_BYTES; page += FINGERPRINT_PAGE_SIZE) {
+        changed = image;
+        changed[page + 0x123] ^= 0x5A;
+        if (Fingerprint(changed) == base) {
+            unsampledPages->push_back(page);
+        } else {
+            sampled++;
+        }
+    }
+    CHECK(sampled >= 2 && sampled <= FINGERPRINT_SAMPLE_PAGES);
+    CHECK(unsampledPages->empty() || unsampledPages->front() != codeRva);
+    CHECK(unsampledPages->empty() || unsampledPages->back() != codeRva + CODE_BYTES - FINGERPRINT_PAGE_SIZE);
+
+    uint8_t notPe[0x100] = { 0 };
+    ModuleFingerprint ignored;
+    CHECK(!ComputeModuleFingerprint(notPe, sizeof(notPe), &ignored));
+}
+
+static void CheckEntries() {
+    ModuleFingerprint a = { 0x11111111, 0x1000, 0xAAAAull };
+    ModuleFingerprint b = { 0x11111111, 0x1000, 0xBBBBull };
+    AddressCache cache;
+    size_t rva = 0;
+
+    CHECK(!cache.Lookup(a, "Target", &rva));
+    cache.Store(a, "Target", 0x1234);
+    CHECK(cache.Lookup(a, "Target", &rva) && rva == 0x1234);
+    CHECK(!cache.Lookup(b, "Target", &rva));    // Another build of the module
+    CHECK(!cache.Lookup(a, "Other", &rva));
+
+    cache.Store(a, "Target", 0x5678);           // Replaces, not appends
+    CHECK(cache.Count() == 1);
+    CHECK(cache.Lookup(a, "Target", &rva) && rva == 0x5678);
+
+    cache.Store(b, "Target", 0x9ABC);
+    cache.Forget(a, "Target");
+    CHECK(!cache.Lookup(a, "Target", &rva));
+    CHECK(cache.Lookup(b, "Target", &rva) && rva == 0x9ABC);
+
+    // Past the limit the oldest entries go
+    AddressCache full;
+    char name[32];
+    for (size_t i = 0; i < ADDRESS_CACHE_MAX_ENTRIES + 10; i++) {
+        snprintf(name, sizeof(name), "Sig%u", (unsigned)i);
+        full.Store(a, name, i);
+    }
+    CHECK(full.Count() == ADDRESS_CACHE_MAX_ENTRIES);
+    CHECK(!full.Lookup(a, "Sig9", &rva));
+    CHECK(full.Lookup(a, "Sig10", &rva) && rva == 10);
+
+    // Round trip, plus lines a hand edit could leave behind
+    remove(CACHE_PATH);
+    CHECK(!cache.Load(CACHE_PATH) && cache.Count() == 0);
+    cache.Store(a, "Target", 0x00401000);
+    cache.Store(b, "Target", 0x0008D6F0);
+    CHECK(cache.Save(CACHE_PATH));
+    FILE* file = fopen(CACHE_PATH, "a");
+    CHECK(file != nullptr);
+    if (file) {
+        fprintf(file, "\nnot an entry\n5F3A1B2C-01A3C000 MissingHash 0x1000\n");
+        fclose(file);
+    }
+    AddressCache loaded;
+    CHECK(loaded.Load(CACHE_PATH));
+    CHECK(loaded.Count() == 2);
+    CHECK(loaded.Lookup(a, "Target", &rva) && rva == 0x00401000);
+    CHECK(loaded.Lookup(b, "Target", &rva) && rva == 0x0008D6F0);
+    remove(CACHE_PATH);
+}
+
+static void PutSignature(std::vector<uint8_t>* image, size_t at) {
+    const PatternView& pattern = kGameSignatures[SIG_HANDLE_RECV_TALK_PACKET_1].pattern;
+    memcpy(&(*image)[at], pattern.value, pattern.length);
+}
+
+static void CheckResolve(const TestPe& builder, const std::vector<uint32_t>& unsampledPages) {
+    if (unsampledPages.size() < 2) {
+        CHECK(!"two unsampled code pages");
+        return;
+    }
+    const int preference[] = { SIG_HANDLE_RECV_TALK_PACKET_1 };
+    const size_t first = unsampledPages[0] + 0x40;
+    const size_t moved = unsampledPages[1] + 0x80;
+    std::vector<uint8_t> image = builder.Build(PE_LAYOUT_MAPPED);
+    PutSignature(&image, first);
+    remove(CACHE_PATH);
+
+    ResolveResult result;
+    ResolveGameSignature(image.data(), image.size(), preference, 1, CACHE_PATH, 1, &result);
+    CHECK(result.method == RESOLVE_FULL_SCAN && result.offset == first);
+
+    ResolveGameSignature(image.data(), image.size(), preference, 1, CACHE_PATH, 1, &result);
+    CHECK(result.method == RESOLVE_CACHE && result.offset == first);
+
+    // A patch moves the function within pages the fingerprint does not
+    // sample: the fingerprint still matches, the cached RVA does not
+    std::vector<uint8_t> patched = builder.Build(PE_LAYOUT_MAPPED);
+    PutSignature(&patched, moved);
+    CHECK(Fingerprint(patched) == Fingerprint(image));
+    ResolveGameSignature(patched.data(), patched.size(), preference, 1, CACHE_PATH, 1, &result);
+    CHECK(result.method == RESOLVE_FULL_SCAN && result.offset == moved);
+
+    AddressCache cache;
+    size_t rva = 0;
+    CHECK(cache.Load(CACHE_PATH) && cache.Count() == 1);
+    CHECK(cache.Lookup(Fingerprint(patched), kGameSignatures[SIG_HANDLE_RECV_TALK_PACKET_1].name, &rva) &&
+          rva == moved);
+
+    ResolveGameSignature(patched.data(), patched.size(), preference, 1, CACHE_PATH, 1, &result);
+    CHECK(result.method == RESOLVE_CACHE && result.offset == moved);
+
+    // Gone altogether: nothing found, and the file is not rewritten
+    std::vector<uint8_t> removed = builder.Build(PE_LAYOUT_MAPPED);
+    ResolveGameSignature(removed.data(), removed.size(), preference, 1, CACHE_PATH, 1, &result);
+    CHECK(result.method == RESOLVE_NONE && result.offset == NPOS);
+    CHECK(cache.Load(CACHE_PATH) && cache.Count() == 1);
+    remove(CACHE_PATH);
+}
+
+int main() {
+    TestPe builder;
+    TestRandom random(5);
+    std::vector<uint8_t> code(CODE_BYTES, 0xCC);
+    for (size_t i = 0; i < code.size(); i += 1 + random.Below(64)) code[i] = (uint8_t)random.Next();
+    std::vector<uint8_t> data(0x800, 0);
+    size_t text = builder.AddSection(".text", PE_SCN_CNT_CODE | PE_SCN_MEM_EXECUTE | PE_SCN_MEM_READ, code);
+    size_t rdata = builder.AddSection(".data", PE_SCN_CNT_INITIALIZED_DATA | PE_SCN_MEM_READ | PE_SCN_MEM_WRITE,
+                                      data);
+
+    std::vector<uint32_t> unsampledPages;
+    CheckFingerprint(builder, builder.sections[text].virtualAddress, builder.sections[rdata].virtualAddress,
+                     &unsampledPages);
+    CheckEntries();
+    CheckResolve(builder, unsampledPages);
+    return TestResult("AddressCacheTest");
+}
@@ -0,0 +1,160 @@
+// ApproxScanTest.cpp - FindApproxPatterns against a brute-force Hamming search
+//
+// Checks, for k = 0..3 and random result limits:
+//   - signatures of 1 to 100 bytes (past the 64-byte Shift-And word, so
+//     the directly counted tail is covered) with exact, partially masked
+//     and wildcard bytes, over buffers of a small alphabet where near
+//     matches are common: the results are exactly the brute force's
+//     candidates with at most k differing bytes, sorted by mismatch count
+//     then offset and cut at the limit
+//   - copies planted with 0..k differences at offset 0 and at the last
+//     start, and buffers exactly as long as the signature
+//   - k at or above the number of non-wildcard bytes is lowered to one
+//     less; an all-wildcard signature, an empty one and one longer than
+//     the buffer find nothing
+//   - IsUniqueBestMatch against the brute-force list
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#include "../HookLib/ApproxScan.h"
+#include "TestCheck.h"
+
+using namespace HookLib;
+
+// Every start with at most maxMismatches differing bytes, best first, cut at maxResults
+static std::vector<ApproxMatch> ReferenceApprox(const std::vector<uint8_t>& data, const PatternView& pattern,
+                                                unsigned maxMismatches, size_t maxResults) {
+    std::vector<ApproxMatch> all;
+    if (pattern.length == 0 || pattern.length > data.size() || maxResults == 0) return all;
+    size_t exactBytes = 0;
+    for (size_t j = 0; j < pattern.length; j++) {
+        if (pattern.mask[j] != MASK_WILDCARD) exactBytes++;
+    }
+    if (exactBytes == 0) return all;
+    if (maxMismatches >= exactBytes) maxMismatches = (unsigned)exactBytes - 1;
+
+    for (size_t start = 0; start + pattern.length <= data.size(); start++) {
+        unsigned mismatches = 0;
+        for (size_t j = 0; j < pattern.length; j++) {
+            if ((data[start + j] & pattern.mask[j]) != pattern.value[j]) mismatches++;
+        }
+        if (mismatches <= maxMismatches) all.push_back(ApproxMatch{ start, mismatches });
+    }
+    std::stable_sort(all.begin(), all.end(), [](const ApproxMatch& a, const ApproxMatch& b) {
+        return a.mismatches < b.mismatches;
+    });
+    if (all.size() > maxResults) all.resize(maxResults);
+    return all;
+}
+
+static bool Same(const std::vector<ApproxMatch>& a, const std::vector<ApproxMatch>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].offset != b[i].offset || a[i].mismatches != b[i].mismatches) return false;
+    }
+    return true;
+}
+
+static Pattern RandomPattern(TestRandom* random, size_t length, uint32_t alphabet) {
+    std::vector<uint8_t> value(length), mask(length);
+    uint32_t wildcards = random->Below(4);      // 0, 1/8, 2/8 or 3/8 of the bytes
+    for (size_t j = 0; j < length; j++) {
+        value[j] = (uint8_t)(0x40 + random->Below(alphabet));
+        uint32_t kind = random->Below(8);
+        if (kind < wildcards) {
+            mask[j] = MASK_WILDCARD;
+        } else if (kind == 7) {
+            mask[j] = 0xF0;                     // Partially masked: only the high nibble counts
+        } else {
+            mask[j] = MASK_EXACT;
+        }
+    }
+    return Pattern(value.data(), mask.data(), length);
+}
+
+// The pattern's bytes at data[at], then `changes` of its non-wildcard bytes made to differ
+static void Plant(TestRandom* random, std::vector<uint8_t>* data, size_t at, const PatternView& pattern,
+                  unsigned changes) {
+    for (size_t j = 0; j < pattern.length; j++) {
+        (*data)[at + j] = (uint8_t)(pattern.value[j] | (~pattern.mask[j] & (uint8_t)random->Below(256)));
+    }
+    for (unsigned c = 0; c < changes; c++) {
+        size_t j = random->Below((uint32_t)pattern.length);
+        if (pattern.mask[j] != MASK_WILDCARD) (*data)[at + j] = (uint8_t)(pattern.value[j] ^ 0x80);
+    }
+}
+
+static void CheckAgainstReference(TestRandom* random) {
+    size_t compared = 0, found = 0, tails = 0;
+    for (int round = 0; round < 3000; round++) {
+        size_t length = 1 + random->Below(random->Below(4) == 0 ? 100 : 24);
+        uint32_t alphabet = 1 + random->Below(random->Below(2) == 0 ? 3 : 16);
+        Pattern pattern = RandomPattern(random, length, alphabet);
+        PatternView view = pattern.View();
+
+        size_t size = (random->Below(10) == 0) ? length : length + random->Below(2000);
+        std::vector<uint8_t> data(size);
+        for (size_t i = 0; i < size; i++) data[i] = (uint8_t)(0x40 + random->Below(alphabet));
+        unsigned k = random->Below(4);
+        if (random->Below(2) == 0) Plant(random, &data, 0, view, random->Below(k + 1));
+        if (random->Below(2) == 0) Plant(random, &data, size - length, view, random->Below(k + 1));
+
+        size_t maxResults = (random->Below(3) == 0) ? 1 + random->Below(3) : 1 + random->Below(5000);
+        std::vector<ApproxMatch> best;
+        FindApproxPatterns(data.data(), data.size(), view, k, maxResults, &best);
+        std::vector<ApproxMatch> expected = ReferenceApprox(data, view, k, maxResults);
+        CHECK(Same(best, expected));
+        CHECK(IsUniqueBestMatch(best) ==
+              (!expected.empty() && (expected.size() == 1 || expected[1].mismatches > expected[0].mismatches)));
+        compared++;
+        found += best.size();
+        if (length > APPROX_WORD_BITS) tails++;
+    }
+    printf("%zu scans (%zu with a counted tail) give the brute force's %zu candidates\n", compared, tails, found);
+}
+
+static void CheckEdges() {
+    std::vector<ApproxMatch> best;
+    std::vector<uint8_t> data(64, 0x41);
+
+    // Both ends: an exact copy at the last start, one with a difference at offset 0
+    uint8_t bytes[] = { 0x10, 0x20, 0x30, 0x40, 0x50 };
+    Pattern pattern(bytes, "xxxxx");
+    std::vector<uint8_t> edges(data);
+    for (size_t j = 0; j < 5; j++) edges[edges.size() - 5 + j] = bytes[j];
+    for (size_t j = 0; j < 5; j++) edges[j] = bytes[j];
+    edges[4] ^= 0x01;
+    for (unsigned k = 0; k <= 3; k++) {
+        FindApproxPatterns(edges.data(), edges.size(), pattern.View(), k, 10, &best);
+        CHECK(Same(best, ReferenceApprox(edges, pattern.View(), k, 10)));
+        CHECK(!best.empty() && best[0].offset == edges.size() - 5 && best[0].mismatches == 0);
+        CHECK(best.size() == ((k == 0) ? 1u : 2u) && IsUniqueBestMatch(best));
+        if (k != 0 && best.size() == 2) CHECK(best[1].offset == 0 && best[1].mismatches == 1);
+    }
+
+    // k lowered below the exact byte count; all-wildcard, empty and too long find nothing
+    Pattern twoExact(bytes, "x??x?");
+    FindApproxPatterns(data.data(), data.size(), twoExact.View(), 3, 100, &best);
+    CHECK(best.empty());
+    data[10] = 0x10;
+    FindApproxPatterns(data.data(), data.size(), twoExact.View(), 3, 100, &best);
+    CHECK(best.size() == 1 && best[0].offset == 10 && best[0].mismatches == 1);
+    Pattern wild(bytes, "?????");
+    FindApproxPatterns(data.data(), data.size(), wild.View(), 2, 100, &best);
+    CHECK(best.empty());
+    FindApproxPatterns(data.data(), data.size(), Pattern(bytes, "").View(), 2, 100, &best);
+    CHECK(best.empty());
+    FindApproxPatterns(data.data(), 4, pattern.View(), 2, 100, &best);
+    CHECK(best.empty());
+    FindApproxPatterns(data.data(), data.size(), pattern.View(), 2, 0, &best);
+    CHECK(best.empty());
+}
+
+int main() {
+    TestRandom random(11);
+    CheckAgainstReference(&random);
+    CheckEdges();
+    return TestResult("ApproxScanTest");
+}
@@ -0,0 +1,139 @@
+// AsyncLogTest.cpp - The log ring, its drop counter, and Close writing out the rest
+//
+// Checks, reading the file back after Close:
+//   - one producer, a ring large enough: every line, in order, nothing
+//     dropped, though Close comes right after the last Write
+//   - eight producers on a 64-slot ring: each producer's lines stay in its
+//     order, some are dropped, and the "(log ring full, N line(s)
+//     dropped)" notes add up to Dropped() and to the lines that are missing
+//   - a line longer than a slot is cut and marked; Write after Close and a
+//     second Close do nothing
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../HookLib/AsyncLog.h"
+#include "TestCheck.h"
+
+using namespace HookLib;
+
+static const char* LOG_PATH = "AsyncLogTest.log";
+
+// The lines of the log without their "[HH:MM:SS] " prefix
+static std::vector<std::string> ReadLines(bool* prefixed) {
+    std::vector<std::string> lines;
+    *prefixed = true;
+    FILE* file = fopen(LOG_PATH, "r");
+    if (!file) return lines;
+    static char line[4096];
+    while (fgets(line, sizeof(line), file)) {
+        size_t length = strlen(line);
+        if (length > 0 && line[length - 1] == '\n') line[--length] = '\0';
+        if (length < 11 || line[0] != '[' || line[9] != ']' || line[10] != ' ') {
+            *prefixed = false;
+            continue;
+        }
+        lines.push_back(line + 11);
+    }
+    fclose(file);
+    return lines;
+}
+
+static void CheckInOrder() {
+    remove(LOG_PATH);
+    AsyncLog log;
+    CHECK(log.Open(LOG_PATH, 4096));
+    for (int i = 0; i < 3000; i++) log.Write("line %d", i);
+    log.Close();
+    CHECK(log.Dropped() == 0 && !log.IsOpen());
+
+    bool prefixed;
+    std::vector<std::string> lines = ReadLines(&prefixed);
+    CHECK(prefixed && lines.size() == 3000);
+    for (size_t i = 0; i < lines.size(); i++) {
+        CHECK(lines[i] == "line " + std::to_string(i));
+    }
+}
+
+static void CheckProducers() {
+    const int producers = 8;
+    const int perProducer = 20000;
+    remove(LOG_PATH);
+    AsyncLog log;
+    CHECK(log.Open(LOG_PATH, 64));
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.push_back(std::thread([&log, p]() {
+            for (int i = 0; i < perProducer; i++) {
+                log.Write("P%d %d", p, i);
+                // A flood first, which must overflow; then bursts the writer keeps up with
+                if (i >= 1000 && i % 16 == 15) std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+    log.Close();
+
+    bool prefixed;
+    std::vector<std::string> lines = ReadLines(&prefixed);
+    CHECK(prefixed);
+    std::vector<int> last(producers, -1);
+    size_t written = 0;
+    unsigned long long noted = 0;
+    bool ordered = true;
+    for (size_t i = 0; i < lines.size(); i++) {
+        int p, n;
+        unsigned long long count;
+        if (sscanf(lines[i].c_str(), "P%d %d", &p, &n) == 2 && p >= 0 && p < producers) {
+            if (n <= last[p]) ordered = false;
+            last[p] = n;
+            written++;
+        } else if (sscanf(lines[i].c_str(), "(log ring full, %llu line(s) dropped)", &count) == 1) {
+            noted += count;
+        } else {
+            CHECK(!"unexpected line");
+        }
+    }
+    CHECK(ordered);
+    CHECK(log.Dropped() > 0 && noted == log.Dropped());
+    CHECK(written + noted == (size_t)producers * perProducer);
+    printf("8 producers, 64 slots: %zu lines written, %llu dropped and noted\n", written, noted);
+}
+
+static void CheckEdges() {
+    remove(LOG_PATH);
+    AsyncLog log;
+    CHECK(log.Open(LOG_PATH));
+    std::string longLine(LOG_SLOT_BYTES * 2, 'x');
+    log.Write("%s", longLine.c_str());
+    log.Write("after");
+    log.Close();
+    log.Write("closed");
+    log.Close();
+
+    bool prefixed;
+    std::vector<std::string> lines = ReadLines(&prefixed);
+    CHECK(prefixed && lines.size() == 2);
+    if (lines.size() == 2) {
+        const std::string& cut = lines[0];
+        size_t mark = strlen(LOG_TRUNCATED_MARK);
+        CHECK(cut.size() > mark && cut.size() < LOG_SLOT_BYTES + mark);
+        CHECK(cut.compare(cut.size() - mark, mark, LOG_TRUNCATED_MARK) == 0);
+        CHECK(cut.find_first_not_of('x') == cut.size() - mark);
+        CHECK(lines[1] == "after");
+    }
+    remove(LOG_PATH);
+}
+
+int main() {
+    CheckInOrder();
+    CheckProducers();
+    CheckEdges();
+    return TestResult("AsyncLogTest");
+}
@@ -0,0 +1,477 @@
+// ChatArchiveTest.cpp - LzBlock.h round trips and rejects, archive segments written and read back
+//
+// Checks:
+//   - LzCompress / LzDecompress on random, repetitive and run-length blocks
+//     from 0 bytes to 64 KB, with no dictionary, a small one and one longer
+//     than a match can reach; some matches start in the dictionary and end
+//     in the block, and a hand-built block has one for sure
+//   - every cut-off prefix of a block, a wrong raw size, bad offsets and
+//     20000 mutated blocks are rejected or at least stay inside the buffers
+//   - 30000 records written through ChatArchiveWriter with small blocks and
+//     segments, rotating by size and by time, read back with
+//     ChatArchiveReader in order, block by block, against what was appended
+//   - a segment closed by Close(true) (SaveAtExit: no index, no trailer)
+//     read by walking its block headers; the same segment cut mid-block,
+//     a damaged index, and a flipped byte in each block failing its CRC
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../HookLib/ChatArchive.h"
+#include "TestCheck.h"
+
+using namespace HookLib;
+
+// ============================================================================
+// LZ BLOCKS
+// ============================================================================
+
+// Walks the sequences of a block the way LzDecompress does and counts the
+// matches that start in the dictionary and run on into the block. False if
+// the block does not parse.
+static bool CountBoundaryMatches(const std::vector<uint8_t>& block, size_t dictionarySize, size_t* count) {
+    if (dictionarySize > LZ_MAX_OFFSET) dictionarySize = LZ_MAX_OFFSET;
+    size_t at = 0, produced = 0;
+    *count = 0;
+    for (;;) {
+        if (at >= block.size()) return false;
+        uint8_t token = block[at++];
+        size_t literals = token >> 4;
+        if (literals == 15) {
+            do {
+                if (at >= block.size()) return false;
+                literals += block[at];
+            } while (block[at++] == 255);
+        }
+        at += literals;
+        produced += literals;
+        if (at == block.size()) return true;
+        if (at + 2 > block.size()) return false;
+        size_t offset = (size_t)block[at] | (size_t)block[at + 1] << 8;
+        at += 2;
+        size_t length = (token & 15) + LZ_MIN_MATCH;
+        if ((token & 15) == 15) {
+            do {
+                if (at >= block.size()) return false;
+                length += block[at];
+            } while (block[at++] == 255);
+        }
+        if (offset > produced && offset <= produced + dictionarySize && length > offset - produced) (*count)++;
+        produced += length;
+    }
+}
+
+// Compresses and decompresses `raw` with the input and the output buffers
+// exactly as large as they must be. Returns the compressed block.
+static std::vector<uint8_t> RoundTrip(const std::vector<uint8_t>& raw, const std::vector<uint8_t>& dictionary,
+                                      LzWork* work) {
+    std::vector<uint8_t> compressed(LzBound(raw.size()));
+    size_t size = LzCompress(raw.data(), raw.size(), dictionary.data(), dictionary.size(), compressed.data(), work);
+    CHECK(size <= compressed.size());
+    compressed.resize(size);
+
+    std::vector<uint8_t> block(compressed);
+    std::vector<uint8_t> out(raw.size());
+    CHECK(LzDecompress(block.data(), block.size(), dictionary.data(), dictionary.size(), out.data(), out.size()));
+    CHECK(out == raw);
+    return compressed;
+}
+
+static std::vector<uint8_t> RandomBytes(TestRandom* random, size_t size) {
+    std::vector<uint8_t> bytes(size);
+    for (size_t i = 0; i < size; i++) bytes[i] = (uint8_t)random->Next();
+    return bytes;
+}
+
+// Pieces of the dictionary, of itself, runs and noise, so the block has
+// matches of every kind: far, near, overlapping, crossing into the block
+static std::vector<uint8_t> MixedBlock(TestRandom* random, size_t size, const std::vector<uint8_t>& dictionary) {
+    std::vector<uint8_t> raw;
+    while (raw.size() < size) {
+        size_t length = 1 + random->Below(random->Below(8) == 0 ? 600 : 40);
+        uint32_t kind = random->Below(5);
+        if (kind == 4 && !dictionary.empty() && !raw.empty()) {
+            // The dictionary's end, then the block's start: together one
+            // match from the dictionary into the block
+            size_t count = std::min(length, dictionary.size());
+            raw.insert(raw.end(), dictionary.end() - count, dictionary.end());
+            raw.insert(raw.end(), raw.begin(), raw.begin() + std::min<size_t>(raw.size(), 8));
+        } else if (kind == 0 && !dictionary.empty()) {
+            size_t from = random->Below((uint32_t)dictionary.size());
+            size_t count = std::min(length, dictionary.size() - from);
+            raw.insert(raw.end(), dictionary.begin() + from, dictionary.begin() + from + count);
+        } else if (kind == 1 && !raw.empty()) {
+            size_t from = raw.size() - 1 - random->Below((uint32_t)std::min<size_t>(raw.size(), 70000));
+            for (size_t i = 0; i < length; i++) raw.push_back(raw[from + i]);   // May overlap its own output
+        } else if (kind == 2) {
+            raw.insert(raw.end(), length, (uint8_t)random->Next());
+        } else {
+            std::vector<uint8_t> noise = RandomBytes(random, length);
+            raw.insert(raw.end(), noise.begin(), noise.end());
+        }
+    }
+    raw.resize(size);
+    return raw;
+}
+
+static void CheckLzRoundTrip(TestRandom* random) {
+    static const size_t SIZES[] = { 0, 1, 4, 5, 6, 9, 13, 16, 17, 31, 100, 255, 270, 1000, 4096, 65536 };
+    std::vector<uint8_t> none;
+    std::vector<uint8_t> small = RandomBytes(random, 1000);
+    std::vector<uint8_t> large = MixedBlock(random, 100000, none);     // Only the last 64 KB are reachable
+    const std::vector<uint8_t>* dictionaries[] = { &none, &small, &large };
+    LzWork work;
+
+    size_t blocks = 0, crossing = 0;
+    for (size_t d = 0; d < 3; d++) {
+        const std::vector<uint8_t>& dictionary = *dictionaries[d];
+        for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+            for (int repeat = 0; repeat < 8; repeat++) {
+                std::vector<uint8_t> raw = (repeat == 0) ? RandomBytes(random, SIZES[s])
+                                         : (repeat == 1) ? std::vector<uint8_t>(SIZES[s], 'a')
+                                         : MixedBlock(random, SIZES[s], dictionary);
+                std::vector<uint8_t> compressed = RoundTrip(raw, dictionary, &work);
+                size_t count;
+                CHECK(CountBoundaryMatches(compressed, dictionary.size(), &count));
+                crossing += count;
+                blocks++;
+            }
+        }
+    }
+    CHECK(crossing > 0);
+
+    // By hand: the block starts with 10 new bytes, then repeats the last 100
+    // bytes of the dictionary and those 10, so the match can only start in
+    // the dictionary and end in the block
+    std::vector<uint8_t> head = RandomBytes(random, 10);
+    std::vector<uint8_t> raw(head);
+    raw.insert(raw.end(), small.end() - 100, small.end());
+    raw.insert(raw.end(), head.begin(), head.end());
+    std::vector<uint8_t> tail = RandomBytes(random, 20);
+    raw.insert(raw.end(), tail.begin(), tail.end());
+    std::vector<uint8_t> compressed = RoundTrip(raw, small, &work);
+    size_t count;
+    CHECK(CountBoundaryMatches(compressed, small.size(), &count) && count == 1);
+    CHECK(compressed.size() < raw.size() - 90);
+
+    // A dictionary longer than LZ_MAX_OFFSET: both sides drop its start, so
+    // a copy of its first bytes does not compress
+    std::vector<uint8_t> noise = RandomBytes(random, 100000);
+    raw.assign(noise.begin(), noise.begin() + 1000);
+    compressed = RoundTrip(raw, noise, &work);
+    CHECK(compressed.size() > raw.size());
+
+    printf("%zu blocks round trip, %zu matches cross from the dictionary into the block\n", blocks + 2, crossing);
+}
+
+static void CheckLzRejects(TestRandom* random) {
+    std::vector<uint8_t> dictionary = RandomBytes(random, 2000);
+    std::vector<uint8_t> raw = MixedBlock(random, 3000, dictionary);
+    LzWork work;
+    std::vector<uint8_t> compressed = RoundTrip(raw, dictionary, &work);
+
+    // Every strict prefix, in a buffer of its own size
+    bool prefixesRejected = true;
+    for (size_t cut = 0; cut < compressed.size(); cut++) {
+        std::vector<uint8_t> prefix(compressed.begin(), compressed.begin() + cut);
+        std::vector<uint8_t> out(raw.size());
+        if (LzDecompress(prefix.data(), prefix.size(), dictionary.data(), dictionary.size(), out.data(), out.size())) {
+            prefixesRejected = false;
+        }
+    }
+    CHECK(prefixesRejected);
+
+    // The raw size must be exact
+    std::vector<uint8_t> shorter(raw.size() - 1), longer(raw.size() + 1);
+    CHECK(!LzDecompress(compressed.data(), compressed.size(), dictionary.data(), dictionary.size(), shorter.data(),
+                        shorter.size()));
+    CHECK(!LzDecompress(compressed.data(), compressed.size(), dictionary.data(), dictionary.size(), longer.data(),
+                        longer.size()));
+
+    // Offsets of 0, past the output with no dictionary, past the dictionary
+    // ("x", then 4 bytes from 0 or 2 back, then nothing)
+    std::vector<uint8_t> out(5);
+    const uint8_t offsetZero[] = { 0x10, 'x', 0x00, 0x00, 0x00 };
+    const uint8_t offsetPast[] = { 0x10, 'x', 0x02, 0x00, 0x00 };
+    CHECK(!LzDecompress(offsetZero, sizeof(offsetZero), nullptr, 0, out.data(), out.size()));
+    CHECK(!LzDecompress(offsetPast, sizeof(offsetPast), nullptr, 0, out.data(), out.size()));
+    CHECK(LzDecompress(offsetPast, sizeof(offsetPast), dictionary.data(), 1, out.data(), out.size()));
+    CHECK(out[0] == 'x' && out[1] == dictionary[0] && out[2] == 'x' && out[3] == dictionary[0] && out[4] == 'x');
+
+    // Damaged blocks: one to four bytes changed, or cut. Either rejected or
+    // decoded within the buffers (ASan watches); the archive's CRC catches
+    // the rest.
+    size_t rejected = 0;
+    const int mutations = 20000;
+    for (int m = 0; m < mutations; m++) {
+        std::vector<uint8_t> block(compressed);
+        for (uint32_t i = 0, n = 1 + random->Below(4); i < n; i++) {
+            block[random->Below((uint32_t)block.size())] = (uint8_t)random->Next();
+        }
+        if (random->Below(4) == 0) block.resize(random->Below((uint32_t)block.size()));
+        std::vector<uint8_t> decoded(raw.size());
+        if (!LzDecompress(block.data(), block.size(), dictionary.data(), dictionary.size(), decoded.data(),
+                          decoded.size())) {
+            rejected++;
+        }
+    }
+    CHECK(rejected > 0);
+    printf("%d damaged blocks: %zu rejected, the rest decoded within bounds\n", mutations, rejected);
+}
+
+// ============================================================================
+// SEGMENTS
+// ============================================================================
+
+struct Record {
+    int64_t time;
+    uint8_t channel;
+    uint8_t camp;
+    std::string sender;
+    std::string text;
+};
+
+static const int64_t BASE_TIME = 1767225600ll * 1000000;     // 2026-01-01 00:00:00 UTC
+
+static Record RandomRecord(TestRandom* random, int64_t time) {
+    static const char* WORDS[] = { "boss", "team", "\xB0\xEF\xD6\xFA", "\xCB\xA2\xD0\xC2", "lf", "dungeon",
+                                   "need", "heal", "1", "@", "\xB9\xAB\xBB\xE1" };
+    Record record;
+    record.time = time;
+    record.channel = (uint8_t)random->Below(8);
+    record.camp = (uint8_t)random->Below(3);
+    record.sender = "player" + std::to_string(random->Below(40));
+    for (uint32_t i = 0, n = random->Below(12); i < n; i++) {
+        if (i != 0) record.text += ' ';
+        record.text += WORDS[random->Below(sizeof(WORDS) / sizeof(WORDS[0]))];
+    }
+    if (random->Below(100) == 0) record.text = std::string(random->Below(3000), 'z');
+    return record;
+}
+
+static std::vector<uint8_t> ReadFile(const std::string& path) {
+    std::vector<uint8_t> data;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) return data;
+    fseek(file, 0, SEEK_END);
+    data.resize((size_t)ftell(file));
+    fseek(file, 0, SEEK_SET);
+    if (fread(data.data(), 1, data.size(), file) != data.size()) data.clear();
+    fclose(file);
+    return data;
+}
+
+// "<prefix>-....hca" in the working directory, in name (= time) order
+static std::vector<std::string> Segments(const std::string& prefix) {
+    std::vector<std::string> paths;
+    for (const auto& entry : std::filesystem::directory_iterator(".")) {
+        std::string name = entry.path().filename().string();
+        if (name.compare(0, prefix.size() + 1, prefix + "-") == 0 && name.size() > 4 &&
+            name.compare(name.size() - 4, 4, ".hca") == 0) {
+            paths.push_back(name);
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+static void RemoveSegments(const std::string& prefix) {
+    std::vector<std::string> paths = Segments(prefix);
+    for (size_t i = 0; i < paths.size(); i++) {
+        remove(paths[i].c_str());
+        remove(ChatIndexPath(paths[i]).c_str());
+    }
+}
+
+// Reads every block of a segment and compares its records with
+// expected[*next...]. False if a block does not read.
+static bool ReadSegment(const ChatArchiveReader& reader, const std::vector<Record>& expected, size_t* next) {
+    std::vector<uint8_t> raw;
+    for (size_t b = 0; b < reader.BlockCount(); b++) {
+        const ChatArchiveBlock& block = reader.Block(b);
+        if (!reader.ReadBlock(b, &raw)) return false;
+        CHECK(block.rawSize == raw.size());
+        ChatBlockCursor cursor;
+        cursor.Reset(raw.data(), raw.size(), block.firstTime);
+        ChatEvent event;
+        uint32_t records = 0;
+        int64_t last = block.firstTime;
+        while (cursor.Next(&event)) {
+            CHECK(*next < expected.size());
+            if (*next >= expected.size()) return true;
+            const Record& record = expected[(*next)++];
+            CHECK(event.time == record.time && event.channel == record.channel && event.camp == record.camp);
+            CHECK(std::string(event.sender, event.senderLength) == record.sender);
+            CHECK(std::string(event.text, event.textLength) == record.text);
+            last = event.time;
+            records++;
+        }
+        if (reader.Indexed()) {
+            CHECK(block.records == records && block.lastTime == last);
+            size_t found = reader.FindBlock(block.firstTime);
+            CHECK(found <= b && reader.Block(found).lastTime >= block.firstTime);
+        }
+    }
+    return true;
+}
+
+static void CheckRotation(TestRandom* random) {
+    const std::string prefix = "ChatArchiveTest-rotate";
+    RemoveSegments(prefix);
+
+    // A dictionary from sample records, as tools/ChatArchivePack trains it
+    std::vector<uint8_t> samples;
+    for (int i = 0; i < 500; i++) {
+        Record record = RandomRecord(random, 0);
+        size_t at = samples.size();
+        samples.resize(at + ChatRecordBound(record.sender.size(), record.text.size()));
+        uint8_t* end = EncodeChatRecord(&samples[at], 0, record.channel, record.camp, record.sender.data(),
+                                        record.sender.size(), record.text.data(), record.text.size());
+        samples.resize((size_t)(end - samples.data()));
+    }
+    ChatArchiveOptions options;
+    options.pathPrefix = prefix;
+    options.segmentBytes = 48 * 1024;
+    options.segmentSeconds = 600;
+    options.blockBytes = 4096;
+    options.flushMilliseconds = 600000;
+    options.writeIndex = false;
+    TrainChatDictionary(samples.data(), samples.size(), 8192, &options.dictionary);
+    CHECK(!options.dictionary.empty() && options.dictionary.size() <= 8192);
+
+    ChatArchiveWriter writer;
+    CHECK(writer.Open(options));
+    std::vector<Record> expected;
+    int64_t time = BASE_TIME;
+    uint64_t refused = 0;
+    for (int i = 0; i < 30000; i++) {
+        // Mostly forward, now and then the same time or a millisecond back
+        uint32_t step = random->Below(100);
+        time += (step == 0) ? 0 : (step == 1) ? -1000 : (int64_t)random->Below(200000);
+        Record record = RandomRecord(random, time);
+        if (i == 100) record.text.assign(CHATLOG_MAX_FIELD + 10, 'm');    // One block on its own, cut
+        if (writer.AppendAt(record.time, record.channel, record.camp, record.sender.data(), record.sender.size(),
+                            record.text.data(), record.text.size())) {
+            if (record.text.size() > CHATLOG_MAX_FIELD) record.text.resize(CHATLOG_MAX_FIELD);
+            expected.push_back(record);
+        } else {
+            refused++;
+        }
+        if (i % 1000 == 999) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    writer.Close();
+    CHECK(writer.Dropped() == refused && !writer.IsOpen());
+
+    std::vector<std::string> paths = Segments(prefix);
+    CHECK(paths.size() >= 3 && paths.size() == writer.SegmentsWritten());
+    size_t next = 0, blocks = 0;
+    for (size_t s = 0; s < paths.size(); s++) {
+        std::vector<uint8_t> data = ReadFile(paths[s]);
+        ChatArchiveReader reader;
+        CHECK(reader.Open(data.data(), data.size()) && reader.Indexed() && reader.BlockCount() > 0);
+        CHECK(next < expected.size() && reader.StartTime() == expected[next].time);
+        uint32_t dictionarySize;
+        memcpy(&dictionarySize, data.data() + 16, 4);
+        CHECK(dictionarySize == options.dictionary.size());
+        CHECK(ReadSegment(reader, expected, &next));
+        blocks += reader.BlockCount();
+    }
+    CHECK(next == expected.size());
+    printf("%zu records in %zu segments of %zu blocks read back, %llu refused by a full queue\n", next,
+           paths.size(), blocks, (unsigned long long)refused);
+
+    // A damaged index: the reader falls back to the block headers, which
+    // end where the trailer says the index starts
+    std::vector<uint8_t> data = ReadFile(paths[0]);
+    ChatArchiveReader indexed, scanned;
+    CHECK(indexed.Open(data.data(), data.size()));
+    data[data.size() - CHATARCHIVE_TRAILER_BYTES - 3] ^= 0x40;
+    CHECK(scanned.Open(data.data(), data.size()) && !scanned.Indexed());
+    CHECK(scanned.BlockCount() == indexed.BlockCount());
+    for (size_t b = 0; b < scanned.BlockCount() && b < indexed.BlockCount(); b++) {
+        CHECK(scanned.Block(b).offset == indexed.Block(b).offset);
+    }
+    RemoveSegments(prefix);
+}
+
+static void CheckSaveAtExit(TestRandom* random) {
+    const std::string prefix = "ChatArchiveTest-exit";
+    RemoveSegments(prefix);
+    ChatArchiveOptions options;
+    options.pathPrefix = prefix;
+    options.blockBytes = 4096;
+    options.flushMilliseconds = 600000;
+    options.writeIndex = false;
+
+    // The writer is left running by Close(true), as a killed thread would
+    // be; it is deleted once it has seen `stopping` and returned
+    ChatArchiveWriter* writer = new ChatArchiveWriter();
+    CHECK(writer->Open(options));
+    std::vector<Record> expected;
+    int64_t time = BASE_TIME;
+    for (int i = 0; i < 800; i++) {
+        time += random->Below(100000);
+        expected.push_back(RandomRecord(random, time));
+    }
+    for (size_t i = 0; i < expected.size(); i++) {
+        const Record& record = expected[i];
+        CHECK(writer->AppendAt(record.time, record.channel, record.camp, record.sender.data(), record.sender.size(),
+                               record.text.data(), record.text.size()));
+        // The writer takes the first part and writes its full blocks; it is
+        // asleep again when the rest is queued and Close(true) comes
+        if (i == 600) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    writer->Close(true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2 * CHATARCHIVE_POLL_MS));
+    delete writer;
+
+    std::vector<std::string> paths = Segments(prefix);
+    CHECK(paths.size() == 1);
+    if (paths.size() != 1) return;
+    std::vector<uint8_t> data = ReadFile(paths[0]);
+    ChatArchiveReader reader;
+    CHECK(reader.Open(data.data(), data.size()) && !reader.Indexed() && reader.BlockCount() >= 3);
+    size_t next = 0;
+    CHECK(ReadSegment(reader, expected, &next) && next == expected.size());
+    size_t blocks = reader.BlockCount();
+    for (size_t b = 0; b < blocks; b++) {
+        CHECK(reader.Block(b).records == 0);
+        CHECK(reader.Block(b).lastTime == ((b + 1 < blocks) ? reader.Block(b + 1).firstTime : INT64_MAX));
+    }
+    CHECK(ChatIndexPath(paths[0]) != paths[0] && ReadFile(ChatIndexPath(paths[0])).empty());
+
+    // Cut inside the last block, as a crash would: the blocks before it remain
+    ChatArchiveReader cut;
+    CHECK(cut.Open(data.data(), data.size() - 7) && cut.BlockCount() == blocks - 1);
+
+    // One flipped byte in each block's data fails that block only
+    for (size_t b = 0; b < blocks; b++) {
+        std::vector<uint8_t> damaged(data);
+        const ChatArchiveBlock& block = reader.Block(b);
+        uint32_t compressedSize;
+        memcpy(&compressedSize, data.data() + block.offset, 4);
+        damaged[block.offset + CHATARCHIVE_BLOCK_HEADER_BYTES + random->Below(compressedSize)] ^= 0x01;
+        ChatArchiveReader broken;
+        std::vector<uint8_t> raw;
+        CHECK(broken.Open(damaged.data(), damaged.size()) && broken.BlockCount() == blocks);
+        CHECK(!broken.ReadBlock(b, &raw));
+        CHECK(broken.ReadBlock(b == 0 ? 1 : 0, &raw));
+    }
+    printf("Close(true): %zu records in %zu blocks without an index, all read back\n", next, blocks);
+    RemoveSegments(prefix);
+}
+
+int main() {
+    TestRandom random(19);
+    CheckLzRoundTrip(&random);
+    CheckLzRejects(&random);
+    CheckRotation(&random);
+    CheckSaveAtExit(&random);
+    return TestResult("ChatArchiveTest");
+}
@@ -0,0 +1,162 @@
+// ChatCommandsTest.cpp - Compile-time command table: lookups, dispatch, argument parsers
+//
+// A small table like the DLLs' (every parser, usage lines) is dispatched
+// against hand-written messages. A 200-command table must find each of its
+// names, and agree with a linear search over random tokens: prefixes,
+// extensions, one-byte changes and GBK text. A table with the same name
+// twice must not compile; run_tests.sh checks that with the switch below.
+//
+// COMPILE_FAIL: TEST_DUPLICATE_COMMANDS ChatCommandTableHasDuplicates
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "../HookLib/ChatCommands.h"
+#include "TestCheck.h"
+
+using namespace HookLib;
+
+static int g_ran[8];
+static ChatCommandCall g_last;
+
+static void Record(int index, const ChatCommandCall& call) {
+    g_ran[index]++;
+    g_last.sender = call.sender;
+    g_last.message = call.message;
+    g_last.channel = call.channel;
+    g_last.argCount = call.argCount;
+    memcpy(g_last.buffer, call.buffer, sizeof(g_last.buffer));
+    for (size_t i = 0; i < call.argCount; i++) g_last.args[i] = g_last.buffer + (call.args[i] - call.buffer);
+}
+
+static void HandleHelp(const ChatCommandCall& call) { Record(0, call); }
+static void HandleStatus(const ChatCommandCall& call) { Record(1, call); }
+static void HandleFollow(const ChatCommandCall& call) { Record(2, call); }
+static void HandleBuy(const ChatCommandCall& call) { Record(3, call); }
+static void HandleSay(const ChatCommandCall& call) { Record(4, call); }
+static void HandleAny(const ChatCommandCall& call) { Record(5, call); }
+
+static constexpr ChatCommand kCommands[] = {
+    { "!help", HandleHelp, ChatNoArgs, nullptr },
+    { "!status", HandleStatus, nullptr, nullptr },
+    { "!follow", HandleFollow, ChatWords<0, 1>, "Usage: !follow [player]" },
+    { "!buy", HandleBuy, ChatWords<1, 2>, "Usage: !buy item [price]" },
+    { "!say", HandleSay, ChatRestOfLine, nullptr },
+    { "\xB0\xEF\xD6\xFA", HandleAny, ChatNoArgs, nullptr },     // "帮助"
+};
+static constexpr auto kTable = MakeChatCommandTable(kCommands);
+
+static ChatCommandResult Send(const char* message, const ChatCommand** command = nullptr) {
+    memset(g_ran, 0, sizeof(g_ran));
+    memset(&g_last, 0, sizeof(g_last));
+    return kTable.Dispatch("Hero", message, 3, command);
+}
+
+static void CheckDispatch() {
+    const ChatCommand* command = nullptr;
+    CHECK(Send("!help", &command) == CHAT_COMMAND_RAN && g_ran[0] == 1 && command == &kTable.Command(0));
+    CHECK(strcmp(g_last.sender, "Hero") == 0 && g_last.channel == 3 && strcmp(g_last.message, "!help") == 0);
+    CHECK(Send("!help me please") == CHAT_COMMAND_RAN && g_ran[0] == 1 && g_last.argCount == 0);
+    CHECK(Send("!status    ") == CHAT_COMMAND_RAN && g_ran[1] == 1);
+
+    CHECK(Send("!follow") == CHAT_COMMAND_RAN && g_ran[2] == 1 && g_last.argCount == 0);
+    CHECK(Send("!follow   Bob  ") == CHAT_COMMAND_RAN && g_last.argCount == 1 && strcmp(g_last.args[0], "Bob") == 0);
+    CHECK(Send("!follow Bob Alice", &command) == CHAT_COMMAND_BAD_ARGS && g_ran[2] == 0);
+    CHECK(command != nullptr && strcmp(command->usage, "Usage: !follow [player]") == 0);
+
+    CHECK(Send("!buy") == CHAT_COMMAND_BAD_ARGS && g_ran[3] == 0);
+    CHECK(Send("!buy sword 100") == CHAT_COMMAND_RAN && g_last.argCount == 2);
+    CHECK(strcmp(g_last.args[0], "sword") == 0 && strcmp(g_last.args[1], "100") == 0);
+    CHECK(Send("!buy a b c") == CHAT_COMMAND_BAD_ARGS);
+
+    CHECK(Send("!say  hello  there ") == CHAT_COMMAND_RAN && g_last.argCount == 1);
+    CHECK(strcmp(g_last.args[0], "hello  there ") == 0);
+    CHECK(Send("!say") == CHAT_COMMAND_RAN && g_last.argCount == 0);
+    CHECK(Send("\xB0\xEF\xD6\xFA") == CHAT_COMMAND_RAN && g_ran[5] == 1);
+
+    // Not commands: prefixes, extensions, case, position, empty
+    const char* misses[] = { "!hel", "!helpme", "!HELP", " !help", "help", "", "!", "!status!", "hello there",
+                             "\xB0\xEF", "\xB0\xEF\xD6\xFA\xD6\xFA", "!followers of Bob" };
+    for (size_t i = 0; i < sizeof(misses) / sizeof(misses[0]); i++) {
+        command = &kTable.Command(0);
+        CHECK(Send(misses[i], &command) == CHAT_COMMAND_NONE && command == nullptr);
+        int total = 0;
+        for (int k = 0; k < 8; k++) total += g_ran[k];
+        CHECK(total == 0);
+    }
+
+    // A first word far longer than any command; arguments longer than the buffer
+    std::string longWord(5000, 'x');
+    CHECK(Send(longWord.c_str()) == CHAT_COMMAND_NONE);
+    std::string longSay = "!say " + std::string(3 * CHAT_TEXT_CAPACITY, 'y');
+    CHECK(Send(longSay.c_str()) == CHAT_COMMAND_RAN && strlen(g_last.args[0]) == CHAT_TEXT_CAPACITY - 1);
+    std::string longFollow = "!follow " + std::string(2 * CHAT_TEXT_CAPACITY, 'z');
+    CHECK(Send(longFollow.c_str()) == CHAT_COMMAND_RAN && strlen(g_last.args[0]) == CHAT_TEXT_CAPACITY - 1);
+}
+
+// 200 commands, "!cmd10" to "!cmd209"
+#define TEST_COMMAND(n) { "!cmd" #n, HandleAny, nullptr, nullptr },
+#define TEST_COMMANDS_10(n) TEST_COMMAND(n##0) TEST_COMMAND(n##1) TEST_COMMAND(n##2) TEST_COMMAND(n##3) \
+    TEST_COMMAND(n##4) TEST_COMMAND(n##5) TEST_COMMAND(n##6) TEST_COMMAND(n##7) TEST_COMMAND(n##8) TEST_COMMAND(n##9)
+static constexpr ChatCommand kManyCommands[] = {
+    TEST_COMMANDS_10(1) TEST_COMMANDS_10(2) TEST_COMMANDS_10(3) TEST_COMMANDS_10(4) TEST_COMMANDS_10(5)
+    TEST_COMMANDS_10(6) TEST_COMMANDS_10(7) TEST_COMMANDS_10(8) TEST_COMMANDS_10(9) TEST_COMMANDS_10(10)
+    TEST_COMMANDS_10(11) TEST_COMMANDS_10(12) TEST_COMMANDS_10(13) TEST_COMMANDS_10(14) TEST_COMMANDS_10(15)
+    TEST_COMMANDS_10(16) TEST_COMMANDS_10(17) TEST_COMMANDS_10(18) TEST_COMMANDS_10(19) TEST_COMMANDS_10(20)
+};
+static constexpr auto kManyTable = MakeChatCommandTable(kManyCommands);
+
+static const ChatCommand* LinearFind(const char* token, size_t length) {
+    for (size_t i = 0; i < kManyTable.Count(); i++) {
+        const char* name = kManyTable.Command(i).name;
+        if (strlen(name) == length && memcmp(name, token, length) == 0) return &kManyTable.Command(i);
+    }
+    return nullptr;
+}
+
+static void CheckManyCommands(TestRandom* random) {
+    CHECK(kManyTable.Count() == 200);
+    for (size_t i = 0; i < kManyTable.Count(); i++) {
+        const char* name = kManyTable.Command(i).name;
+        CHECK(kManyTable.Find(name, strlen(name)) == &kManyTable.Command(i));
+    }
+
+    size_t hits = 0;
+    for (int round = 0; round < 200000; round++) {
+        std::string token;
+        const char* name = kManyTable.Command(random->Below(200)).name;
+        switch (random->Below(5)) {
+            case 0: token = name; break;
+            case 1: token = std::string(name, 1 + random->Below((uint32_t)strlen(name))); break;   // Prefix
+            case 2: token = std::string(name) + (char)('0' + random->Below(10)); break;           // Extension
+            case 3:
+                token = name;
+                token[random->Below((uint32_t)token.size())] ^= (char)(1 << random->Below(8));
+                break;
+            default:
+                for (uint32_t k = 0, n = 1 + random->Below(10); k < n; k++) token += (char)(0x21 + random->Below(0xDE));
+                break;
+        }
+        const ChatCommand* expected = LinearFind(token.data(), token.size());
+        CHECK(kManyTable.Find(token.data(), token.size()) == expected);
+        hits += expected != nullptr;
+    }
+    printf("200 commands: every name found, %zu of 200000 random tokens were commands\n", hits);
+}
+
+#ifdef TEST_DUPLICATE_COMMANDS
+static constexpr ChatCommand kDuplicateCommands[] = {
+    { "!a", HandleAny, nullptr, nullptr },
+    { "!b", HandleAny, nullptr, nullptr },
+    { "!a", HandleAny, nullptr, nullptr },
+};
+static constexpr auto kDuplicateTable = MakeChatCommandTable(kDuplicateCommands);
+#endif
+
+int main() {
+    TestRandom random(24);
+    CheckDispatch();
+    CheckManyCommands(&random);
+    return TestResult("ChatCommandsTest");
+}
@@ -0,0 +1,195 @@
+// ChatIndexTest.cpp - Segment indexes written by ChatArchiveWriter against the blocks themselves
+//
+// Checks, on 20000 records from 300 senders written with small blocks and
+// segments that rotate by size and by time:
+//   - each .hcx opens, names its segment's size, block count and time range
+//   - FindSender gives, for every sender of the segment, exactly the blocks
+//     a brute-force decode of every block finds it in, in order; senders of
+//     other segments and unknown names give nothing
+//   - ChannelBlocks matches the decoded blocks for all 256 channels
+//   - rotation by time happened, so blocks that were being filled when a
+//     segment was finished were carried into the next segment's index
+//   - a flipped byte anywhere in an index, or a cut index, fails Open
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../HookLib/ChatArchive.h"
+#include "TestCheck.h"
+
+using namespace HookLib;
+
+static const char* PREFIX = "ChatIndexTest";
+static const int64_t BASE_TIME = 1767225600ll * 1000000;     // 2026-01-01 00:00:00 UTC
+static const uint64_t SEGMENT_BYTES = 40 * 1024;
+
+static std::vector<uint8_t> ReadFile(const std::string& path) {
+    std::vector<uint8_t> data;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) return data;
+    fseek(file, 0, SEEK_END);
+    data.resize((size_t)ftell(file));
+    fseek(file, 0, SEEK_SET);
+    if (fread(data.data(), 1, data.size(), file) != data.size()) data.clear();
+    fclose(file);
+    return data;
+}
+
+// "<PREFIX>-....hca" in the working directory, in name (= time) order
+static std::vector<std::string> Segments() {
+    std::string prefix = std::string(PREFIX) + "-";
+    std::vector<std::string> paths;
+    for (const auto& entry : std::filesystem::directory_iterator(".")) {
+        std::string name = entry.path().filename().string();
+        if (name.compare(0, prefix.size(), prefix) == 0 && name.size() > 4 &&
+            name.compare(name.size() - 4, 4, ".hca") == 0) {
+            paths.push_back(name);
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+static void RemoveSegments() {
+    std::vector<std::string> paths = Segments();
+    for (size_t i = 0; i < paths.size(); i++) {
+        remove(paths[i].c_str());
+        remove(ChatIndexPath(paths[i]).c_str());
+    }
+}
+
+static std::string SenderName(uint32_t n) {
+    // Some GBK names, some ASCII, some sharing a prefix
+    if (n % 3 == 0) return "\xCD\xE6\xBC\xD2" + std::to_string(n);     // "玩家"
+    return "player" + std::to_string(n);
+}
+
+static void WriteArchive(TestRandom* random) {
+    static const uint8_t CHANNELS[] = { 0, 1, 3, 7, 63, 64, 128, 200, 255 };
+    ChatArchiveOptions options;
+    options.pathPrefix = PREFIX;
+    options.segmentBytes = SEGMENT_BYTES;
+    options.segmentSeconds = 300;
+    options.blockBytes = 2048;
+    options.flushMilliseconds = 600000;
+    options.writeIndex = true;
+
+    ChatArchiveWriter writer;
+    CHECK(writer.Open(options));
+    int64_t time = BASE_TIME;
+    for (int i = 0; i < 20000; i++) {
+        // Quiet stretches now and then, so some segments end by time
+        time += (random->Below(2500) == 0) ? 400000000 : (int64_t)random->Below(20000);
+        std::string sender = SenderName(random->Below(300));
+        std::string text = "msg " + std::to_string(random->Next() % 1000000007) + " " +
+                           std::to_string(random->Next());
+        uint8_t channel = CHANNELS[random->Below(sizeof(CHANNELS))];
+        CHECK(writer.AppendAt(time, channel, 0, sender.data(), sender.size(), text.data(), text.size()));
+        if (i % 1000 == 999) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    writer.Close();
+    CHECK(writer.SegmentsWritten() == Segments().size());
+}
+
+// Decodes every block: which blocks each sender and each channel appear in
+static void BruteForce(const ChatArchiveReader& segment, std::map<std::string, std::vector<uint32_t> >* senders,
+                       std::vector<std::set<uint32_t> >* channels) {
+    channels->assign(256, std::set<uint32_t>());
+    std::vector<uint8_t> raw;
+    for (size_t b = 0; b < segment.BlockCount(); b++) {
+        CHECK(segment.ReadBlock(b, &raw));
+        ChatBlockCursor cursor;
+        cursor.Reset(raw.data(), raw.size(), segment.Block(b).firstTime);
+        ChatEvent event;
+        while (cursor.Next(&event)) {
+            std::vector<uint32_t>& blocks = (*senders)[std::string(event.sender, event.senderLength)];
+            if (blocks.empty() || blocks.back() != b) blocks.push_back((uint32_t)b);
+            (*channels)[event.channel].insert((uint32_t)b);
+        }
+    }
+}
+
+static std::vector<uint32_t> Postings(const ChatIndexReader& index, const std::string& sender) {
+    ChatPostings postings = index.FindSender(sender.data(), sender.size());
+    std::vector<uint32_t> blocks;
+    uint32_t block;
+    size_t count = postings.Count();
+    while (postings.Next(&block)) blocks.push_back(block);
+    CHECK(blocks.size() == count);
+    return blocks;
+}
+
+static void CheckIndexes(TestRandom* random) {
+    std::vector<std::string> paths = Segments();
+    CHECK(paths.size() >= 4);
+    size_t byTime = 0, bySize = 0, postings = 0;
+    for (size_t s = 0; s < paths.size(); s++) {
+        std::vector<uint8_t> data = ReadFile(paths[s]);
+        std::vector<uint8_t> indexData = ReadFile(ChatIndexPath(paths[s]));
+        ChatArchiveReader segment;
+        ChatIndexReader index;
+        CHECK(segment.Open(data.data(), data.size()) && segment.Indexed() && segment.BlockCount() > 0);
+        CHECK(index.Open(indexData.data(), indexData.size()));
+        if (segment.BlockCount() == 0 || !index.Open(indexData.data(), indexData.size())) continue;
+        CHECK(index.SegmentSize() == data.size() && index.BlockCount() == segment.BlockCount());
+        CHECK(index.FirstTime() == segment.Block(0).firstTime);
+        CHECK(index.LastTime() == segment.Block(segment.BlockCount() - 1).lastTime);
+        // Short of the size limit and not the last: the segment ended by time,
+        // with a block being filled that went on into the next one
+        if (s + 1 < paths.size()) (data.size() < SEGMENT_BYTES ? byTime : bySize)++;
+
+        std::map<std::string, std::vector<uint32_t> > senders;
+        std::vector<std::set<uint32_t> > channels;
+        BruteForce(segment, &senders, &channels);
+        CHECK(index.SenderCount() == senders.size());
+        for (auto it = senders.begin(); it != senders.end(); ++it) {
+            CHECK(Postings(index, it->first) == it->second);
+            postings += it->second.size();
+        }
+        for (uint32_t n = 0; n < 320; n++) {
+            std::string name = SenderName(n);
+            if (senders.count(name) == 0) CHECK(Postings(index, name).empty());
+        }
+        CHECK(Postings(index, "").empty() && Postings(index, "player").empty());
+
+        for (int c = 0; c < 256; c++) {
+            const uint8_t* bitmap = index.ChannelBlocks((uint8_t)c);
+            CHECK((bitmap == nullptr) == channels[c].empty());
+            if (bitmap == nullptr) continue;
+            for (uint32_t b = 0; b < segment.BlockCount(); b++) {
+                CHECK(((bitmap[b / 8] >> (b % 8)) & 1) == channels[c].count(b));
+            }
+        }
+
+        // Every byte is covered by the crc; a cut file has no crc at its end
+        for (int flip = 0; flip < 64; flip++) {
+            std::vector<uint8_t> damaged(indexData);
+            damaged[random->Below((uint32_t)damaged.size())] ^= (uint8_t)(1 + random->Below(255));
+            ChatIndexReader broken;
+            CHECK(!broken.Open(damaged.data(), damaged.size()));
+        }
+        ChatIndexReader cut;
+        CHECK(!cut.Open(indexData.data(), indexData.size() - 1));
+        CHECK(!cut.Open(indexData.data(), CHATINDEX_HEADER_BYTES));
+    }
+    CHECK(byTime > 0 && bySize > 0);
+    printf("%zu segments (%zu ended by size, %zu by time carrying a block), %zu postings as the blocks say\n",
+           paths.size(), bySize, byTime, postings);
+}
+
+int main() {
+    TestRandom random(20);
+    RemoveSegments();
+    WriteArchive(&random);
+    CheckIndexes(&random);
+    RemoveSegments();
+    return TestResult("ChatIndexTest");
+}
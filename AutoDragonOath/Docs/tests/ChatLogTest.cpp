@@ -0,0 +1,233 @@
+// ChatLogTest.cpp - Binary chat log: write and read back, recovery after a cut or a damaged record
+//
+// Checks:
+//   - 70000 records (GBK, empty, cut at CHATLOG_MAX_FIELD, some 64 KB ones
+//     around the 4 MB window edges) read back by ChatLogReader in order,
+//     with nondecreasing times; a second Open adds a session after them
+//   - the file cut inside a record, with the header's end hint past the
+//     new end: Open carries on right after the last whole record, and the
+//     reader sees the records before the cut, then the new session
+//   - a crash tail (the end hint behind the last records, zeros after
+//     them) is read past the hint up to the zeros
+//   - a flipped text byte: the reader stops with CHATLOG_CORRUPT at that
+//     record, and Open, with no end hint to trust, carries on in front of it
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "../HookLib/ChatLog.h"
+#include "TestCheck.h"
+
+using namespace HookLib;
+
+static const char* LOG_PATH = "ChatLogTest.hcl";
+
+struct Record {
+    uint8_t channel;
+    uint8_t camp;
+    std::string sender;
+    std::string text;
+};
+
+static std::vector<uint8_t> ReadFile(const char* path) {
+    std::vector<uint8_t> data;
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) return data;
+    fseek(file, 0, SEEK_END);
+    data.resize((size_t)ftell(file));
+    fseek(file, 0, SEEK_SET);
+    if (fread(data.data(), 1, data.size(), file) != data.size()) data.clear();
+    fclose(file);
+    return data;
+}
+
+static void WriteFile(const char* path, const std::vector<uint8_t>& data) {
+    FILE* file = fopen(path, "wb");
+    CHECK(file != nullptr);
+    if (file == nullptr) return;
+    CHECK(fwrite(data.data(), 1, data.size(), file) == data.size());
+    fclose(file);
+}
+
+static Record RandomRecord(TestRandom* random, size_t at) {
+    static const char* WORDS[] = { "boss", "\xB0\xEF\xD6\xFA", "team up", "\xCB\xA2\xD0\xC2", "@", "1", "lf heal" };
+    Record record;
+    record.channel = (uint8_t)random->Below(256);
+    record.camp = (uint8_t)random->Below(3);
+    record.sender = (random->Below(50) == 0) ? "" : "player" + std::to_string(random->Below(500));
+    for (uint32_t i = 0, n = random->Below(10); i < n; i++) record.text += WORDS[random->Below(7)];
+    // 64 KB texts (some cut) now and then, more of them near the first window edge
+    bool nearEdge = at > 50000 && at < 53000;
+    if (random->Below(nearEdge ? 20 : 5000) == 0) {
+        record.text.assign(CHATLOG_MAX_FIELD - 2 + random->Below(5), (char)('a' + random->Below(26)));
+    }
+    return record;
+}
+
+static void Append(ChatLogWriter* writer, const Record& record) {
+    CHECK(writer->Append(record.channel, record.camp, record.sender.data(), record.sender.size(),
+                         record.text.data(), record.text.size()));
+}
+
+// Reads the whole log: each record's end offset in *ends, the session
+// count, the status it stopped with and where
+struct ReadBack {
+    std::vector<Record> records;
+    std::vector<size_t> ends;
+    std::vector<unsigned> sessions;     // Sessions seen when each record was read
+    ChatLogStatus status;
+    size_t stoppedAt;
+};
+
+static ReadBack ReadLog(const std::vector<uint8_t>& data) {
+    ReadBack read;
+    ChatLogReader reader;
+    CHECK(reader.Open(data.data(), data.size()));
+    ChatEvent event;
+    int64_t previous = INT64_MIN;
+    unsigned session = 0;
+    while ((read.status = reader.Next(&event)) == CHATLOG_OK) {
+        Record record;
+        record.channel = event.channel;
+        record.camp = event.camp;
+        record.sender.assign(event.sender, event.senderLength);
+        record.text.assign(event.text, event.textLength);
+        read.records.push_back(record);
+        read.ends.push_back(reader.Offset());
+        if (reader.Sessions() != session) previous = INT64_MIN;    // A new session: a new clock
+        session = reader.Sessions();
+        CHECK(event.time >= previous);
+        previous = event.time;
+        read.sessions.push_back(session);
+    }
+    read.stoppedAt = reader.Offset();
+    return read;
+}
+
+static bool Same(const Record& a, const Record& b) {
+    size_t textLength = (b.text.size() < CHATLOG_MAX_FIELD) ? b.text.size() : CHATLOG_MAX_FIELD;
+    return a.channel == b.channel && a.camp == b.camp && a.sender == b.sender &&
+           a.text.size() == textLength && a.text.compare(0, textLength, b.text, 0, textLength) == 0;
+}
+
+// The first `count` records read back are `expected`'s, in order
+static bool Matches(const ReadBack& read, const std::vector<Record>& expected, size_t count) {
+    if (read.records.size() < count || expected.size() < count) return false;
+    for (size_t i = 0; i < count; i++) {
+        if (!Same(read.records[i], expected[i])) return false;
+    }
+    return true;
+}
+
+static void CheckRoundTrip(TestRandom* random, std::vector<Record>* expected) {
+    remove(LOG_PATH);
+    ChatLogWriter writer;
+    CHECK(writer.Open(LOG_PATH) && writer.IsOpen());
+    for (size_t i = 0; i < 70000; i++) {
+        expected->push_back(RandomRecord(random, i));
+        Append(&writer, expected->back());
+    }
+    uint64_t size = writer.Size();
+    writer.Close();
+    CHECK(!writer.IsOpen() && !writer.Append(0, 0, "x", 1, "y", 1));
+
+    std::vector<uint8_t> data = ReadFile(LOG_PATH);
+    CHECK(data.size() == size && size > 2 * CHATLOG_WINDOW_BYTES);
+    ReadBack read = ReadLog(data);
+    CHECK(read.status == CHATLOG_DONE && read.stoppedAt == data.size());
+    CHECK(read.records.size() == expected->size() && Matches(read, *expected, expected->size()));
+    CHECK(read.sessions.back() == 1);
+
+    // A second session after the first
+    Record more = RandomRecord(random, 0);
+    CHECK(writer.Open(LOG_PATH));
+    Append(&writer, more);
+    writer.Close();
+    expected->push_back(more);
+    read = ReadLog(ReadFile(LOG_PATH));
+    CHECK(read.status == CHATLOG_DONE && read.records.size() == expected->size());
+    CHECK(Matches(read, *expected, expected->size()) && read.sessions.back() == 2);
+    printf("%zu records over %u sessions, %.1f MB, read back\n", read.records.size(), read.sessions.back(),
+           (double)ReadFile(LOG_PATH).size() / (1024 * 1024));
+}
+
+// Opens the damaged file, adds `after`, and checks that the log now holds
+// expected[0, kept), a new session, then `after`
+static void CheckCarriesOn(const std::vector<Record>& expected, size_t kept, const Record& after) {
+    ChatLogWriter writer;
+    CHECK(writer.Open(LOG_PATH));
+    Append(&writer, after);
+    writer.Close();
+    ReadBack read = ReadLog(ReadFile(LOG_PATH));
+    CHECK(read.status == CHATLOG_DONE);
+    CHECK(read.records.size() == kept + 1 && Matches(read, expected, kept));
+    if (read.records.size() == kept + 1) {
+        CHECK(Same(read.records[kept], after));
+        CHECK(read.sessions[kept] == ((kept == 0) ? 1 : read.sessions[kept - 1] + 1));
+    }
+}
+
+static void CheckCut(TestRandom* random, const std::vector<Record>& expected) {
+    std::vector<uint8_t> whole = ReadFile(LOG_PATH);
+    ReadBack read = ReadLog(whole);
+    CHECK(read.records.size() == expected.size());
+
+    // Inside records spread over the file, among them ones across a window
+    // edge; the end hint in the header now points past the end
+    for (int trial = 0; trial < 6; trial++) {
+        size_t r = 1 + random->Below((uint32_t)read.ends.size() - 1);
+        if (trial == 0) {
+            r = 1;      // The record across the first window's end
+            while (read.ends[r] <= CHATLOG_WINDOW_BYTES) r++;
+        }
+        size_t start = read.ends[r - 1];
+        size_t cutAt = start + 1 + random->Below((uint32_t)(read.ends[r] - start - 1));
+        std::vector<uint8_t> cut(whole.begin(), whole.begin() + cutAt);
+        ReadBack partial = ReadLog(cut);
+        CHECK(partial.status == CHATLOG_CORRUPT && partial.stoppedAt == start && partial.records.size() == r);
+        WriteFile(LOG_PATH, cut);
+        CheckCarriesOn(expected, r, RandomRecord(random, 0));
+    }
+
+    // A crash: the hint behind the last records, the rest of the window zero
+    size_t r = read.ends.size() - 100;
+    std::vector<uint8_t> crashed(whole);
+    crashed.resize(whole.size() + 300000, 0);
+    PutLe64(&crashed[8], read.ends[r]);
+    WriteFile(LOG_PATH, crashed);
+    CheckCarriesOn(expected, expected.size(), RandomRecord(random, 0));
+    WriteFile(LOG_PATH, whole);
+}
+
+static void CheckDamaged(TestRandom* random, const std::vector<Record>& expected) {
+    std::vector<uint8_t> whole = ReadFile(LOG_PATH);
+    ReadBack read = ReadLog(whole);
+    size_t r = 0;
+    while (r == 0 || expected[r].text.empty()) r = 1 + random->Below((uint32_t)expected.size() - 2);
+
+    // The text is last in the record, right before the crc
+    std::vector<uint8_t> damaged(whole);
+    size_t textLength = (expected[r].text.size() < CHATLOG_MAX_FIELD) ? expected[r].text.size() : CHATLOG_MAX_FIELD;
+    damaged[read.ends[r] - 4 - textLength + random->Below((uint32_t)textLength)] ^= 0x20;
+    ReadBack partial = ReadLog(damaged);
+    CHECK(partial.status == CHATLOG_CORRUPT && partial.stoppedAt == read.ends[r - 1]);
+    CHECK(partial.records.size() == r && Matches(partial, expected, r));
+
+    // Open trusts the records before the end hint; with no hint (a crash
+    // before the first window moved) it checks them all and stops there
+    PutLe64(&damaged[8], CHATLOG_HEADER_BYTES);
+    WriteFile(LOG_PATH, damaged);
+    CheckCarriesOn(expected, r, RandomRecord(random, 0));
+    remove(LOG_PATH);
+}
+
+int main() {
+    TestRandom random(18);
+    std::vector<Record> expected;
+    CheckRoundTrip(&random, &expected);
+    CheckCut(&random, expected);
+    CheckDamaged(&random, expected);
+    return TestResult("ChatLogTest");
+}
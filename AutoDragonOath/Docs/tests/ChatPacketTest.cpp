@@ -0,0 +1,266 @@
+// ChatPacketTest.cpp - Lazy packet view, subscriber filter and message pool, with a mock GCChat
+//
+// The mock counts calls per getter, the way the hook would pay for virtual
+// calls into Game.exe. Checks:
+//   - a packet nobody wants costs GetChatType + GetSourCamp and nothing else
+//   - accepted packets are copied whole, cut at the slot capacity, and
+//     null or negative fields come out empty
+//   - a packet type without GetSourCamp has camp 0
+//   - ChatSubscribers::Match against a plain reference, random filters
+//   - the pool: exhaustion is counted, every slot comes back, and eight
+//     threads acquiring and releasing never share a slot
+
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../HookLib/ChatPacket.h"
+#include "TestCheck.h"
+
+using namespace HookLib;
+
+// Size the mock reports for a field: its string's, unless set
+static const int STRING_SIZE = 0x7FFFFFFF;
+
+// The getters of the game's GCChat, virtual like the real ones
+class MockChat {
+public:
+    MockChat() : type(0), camp(0), nullName(false), nameSize(STRING_SIZE), textSize(STRING_SIZE) {
+        memset(calls, 0, sizeof(calls));
+    }
+    virtual ~MockChat() {}
+
+    virtual char* GetSourName() { calls[0]++; return nullName ? nullptr : &name[0]; }
+    virtual int GetSourNameSize() { calls[1]++; return nameSize != STRING_SIZE ? nameSize : (int)name.size(); }
+    virtual char* GetContex() { calls[2]++; return &text[0]; }
+    virtual int GetContexSize() { calls[3]++; return textSize != STRING_SIZE ? textSize : (int)text.size(); }
+    virtual unsigned char GetChatType() { calls[4]++; return type; }
+    virtual unsigned char GetSourCamp() { calls[5]++; return camp; }
+
+    int StringCalls() const { return calls[0] + calls[1] + calls[2] + calls[3]; }
+    int FilterCalls() const { return calls[4] + calls[5]; }
+    void ResetCalls() { memset(calls, 0, sizeof(calls)); }
+
+    std::string name;
+    std::string text;
+    uint8_t type;
+    uint8_t camp;
+    bool nullName;
+    int nameSize;
+    int textSize;
+    int calls[6];
+};
+
+// An older GCChat declaration, without GetSourCamp
+struct MockChatNoCamp {
+    char* GetSourName() { return (char*)"Hero"; }
+    int GetSourNameSize() { return 4; }
+    char* GetContex() { return nullptr; }
+    int GetContexSize() { return 5; }
+    unsigned char GetChatType() { return 7; }
+};
+
+static bool OnlyCamp(uint8_t, uint8_t camp, void* context) {
+    return camp == *(uint8_t*)context;
+}
+
+static void CheckView() {
+    ChatSubscribers subscribers;
+    ChatMessagePool pool(4);
+    int team = subscribers.Add(ChatSubscription().Channels({ 3 }));
+    uint8_t wantedCamp = 1;
+    int campOne = subscribers.Add(ChatSubscription(OnlyCamp, &wantedCamp));
+    int high = subscribers.Add(ChatSubscription().Channels({ 200 }).Camps({ 0, 130 }));
+
+    MockChat packet;
+    packet.name = "Hero";
+    packet.text = "hello";
+    packet.type = 2;
+    ChatMessage* message = (ChatMessage*)&packet;     // Must be reset
+
+    // Nobody wants channel 2 from camp 0: two getters, no copy, no slot
+    {
+        ChatPacketView<MockChat> view(&packet);
+        CHECK(!TakeChatMessage(view, subscribers, &pool, &message) && message == nullptr);
+    }
+    CHECK(packet.FilterCalls() == 2 && packet.StringCalls() == 0);
+
+    packet.type = 3;
+    packet.ResetCalls();
+    {
+        ChatPacketView<MockChat> view(&packet);
+        CHECK(TakeChatMessage(view, subscribers, &pool, &message) && message != nullptr);
+    }
+    CHECK(packet.FilterCalls() == 2 && packet.StringCalls() == 4);
+    if (message) {
+        CHECK(message->channel == 3 && message->camp == 0);
+        CHECK(message->subscribers == (1u << team));
+        CHECK(message->senderLength == 4 && strcmp(message->sender, "Hero") == 0);
+        CHECK(message->textLength == 5 && strcmp(message->text, "hello") == 0);
+        pool.Release(message);
+    }
+
+    // Two subscribers at once; a text longer than the slot is cut
+    packet.camp = 1;
+    packet.text = std::string(5000, 'x');
+    {
+        ChatPacketView<MockChat> view(&packet);
+        CHECK(TakeChatMessage(view, subscribers, &pool, &message));
+    }
+    if (message) {
+        CHECK(message->subscribers == ((1u << team) | (1u << campOne)));
+        CHECK(message->textLength == CHAT_TEXT_CAPACITY - 1 && message->text[CHAT_TEXT_CAPACITY - 1] == '\0');
+        pool.Release(message);
+    }
+
+    // Exactly full, a size smaller than the string, negative and null
+    packet.text = std::string(CHAT_TEXT_CAPACITY - 1, 'y');
+    packet.name = "Someone";
+    packet.nameSize = 4;
+    ChatMessage slot;
+    ChatPacketView<MockChat>(&packet).CopyTo(&slot, 1);
+    CHECK(slot.textLength == CHAT_TEXT_CAPACITY - 1 && slot.text[CHAT_TEXT_CAPACITY - 2] == 'y');
+    CHECK(slot.senderLength == 4 && strcmp(slot.sender, "Some") == 0);
+    packet.nameSize = -5;
+    packet.textSize = 0;
+    packet.name = std::string(CHAT_SENDER_CAPACITY * 2, 'n');
+    packet.nullName = true;
+    ChatPacketView<MockChat>(&packet).CopyTo(&slot, 1);
+    CHECK(slot.senderLength == 0 && slot.sender[0] == '\0');
+    CHECK(slot.textLength == 0 && slot.text[0] == '\0');
+    packet.nullName = false;
+    ChatPacketView<MockChat>(&packet).CopyTo(&slot, 1);
+    CHECK(slot.senderLength == 0);                  // Negative size
+    packet.nameSize = STRING_SIZE;
+    ChatPacketView<MockChat>(&packet).CopyTo(&slot, 1);
+    CHECK(slot.senderLength == CHAT_SENDER_CAPACITY - 1);
+
+    // Channels past 63 and camps past 127 use the upper mask words
+    packet.type = 200;
+    packet.camp = 130;
+    CHECK(subscribers.Match(200, 130) == (1u << high));
+    CHECK(subscribers.Match(200, 131) == 0);
+
+    // No GetSourCamp: camp 0, and the text pointer is null
+    MockChatNoCamp old;
+    ChatPacketView<MockChatNoCamp> oldView(&old);
+    CHECK(oldView.Channel() == 7 && oldView.Camp() == 0);
+    oldView.CopyTo(&slot, 1);
+    CHECK(slot.senderLength == 4 && slot.textLength == 0 && slot.text[0] == '\0');
+
+    // Pool empty: nothing copied, nothing leaked
+    packet.type = 3;
+    ChatMessage* taken[4];
+    for (int i = 0; i < 4; i++) taken[i] = pool.Acquire();
+    packet.ResetCalls();
+    {
+        ChatPacketView<MockChat> view(&packet);
+        CHECK(!TakeChatMessage(view, subscribers, &pool, &message) && message == nullptr);
+    }
+    CHECK(packet.StringCalls() == 0 && pool.Dropped() == 1);
+    for (int i = 0; i < 4; i++) {
+        if (taken[i]) pool.Release(taken[i]);
+    }
+}
+
+struct ReferenceSubscription {
+    std::vector<bool> channels;
+    std::vector<bool> camps;
+    bool rejectOdd;
+};
+
+static bool RejectOddChannels(uint8_t channel, uint8_t, void*) {
+    return (channel & 1) == 0;
+}
+
+static void CheckMatchAgainstReference(TestRandom* random) {
+    for (int round = 0; round < 50; round++) {
+        ChatSubscribers subscribers;
+        std::vector<ReferenceSubscription> reference;
+        size_t count = 1 + random->Below(CHAT_MAX_SUBSCRIBERS);
+        for (size_t i = 0; i < count; i++) {
+            ReferenceSubscription expected;
+            expected.channels.assign(256, true);
+            expected.camps.assign(256, true);
+            expected.rejectOdd = random->Below(4) == 0;
+            ChatSubscription subscription(expected.rejectOdd ? RejectOddChannels : nullptr);
+            if (random->Below(3) != 0) {
+                uint8_t a = (uint8_t)random->Below(256), b = (uint8_t)random->Below(8);
+                subscription.Channels({ a, b });
+                expected.channels.assign(256, false);
+                expected.channels[a] = expected.channels[b] = true;
+            }
+            if (random->Below(3) == 0) {
+                uint8_t a = (uint8_t)random->Below(4), b = (uint8_t)random->Below(256);
+                subscription.Camps({ a, b });
+                expected.camps.assign(256, false);
+                expected.camps[a] = expected.camps[b] = true;
+            }
+            CHECK(subscribers.Add(subscription) == (int)i);
+            reference.push_back(expected);
+        }
+        if (count == CHAT_MAX_SUBSCRIBERS) CHECK(subscribers.Add(ChatSubscription()) == -1);
+
+        for (int channel = 0; channel < 256; channel++) {
+            for (int camp = 0; camp < 256; camp += 1 + (int)random->Below(40)) {
+                uint32_t expected = 0;
+                for (size_t i = 0; i < reference.size(); i++) {
+                    if (reference[i].channels[channel] && reference[i].camps[camp] &&
+                        !(reference[i].rejectOdd && (channel & 1))) {
+                        expected |= 1u << i;
+                    }
+                }
+                CHECK(subscribers.Match((uint8_t)channel, (uint8_t)camp) == expected);
+            }
+        }
+    }
+}
+
+static void CheckPool() {
+    const size_t slots = 64;
+    ChatMessagePool pool(slots);
+    std::vector<ChatMessage*> taken;
+    for (size_t i = 0; i < slots; i++) taken.push_back(pool.Acquire());
+    for (size_t i = 0; i < slots; i++) {
+        CHECK(taken[i] != nullptr);
+        for (size_t j = 0; j < i; j++) CHECK(taken[i] != taken[j]);
+    }
+    CHECK(pool.Acquire() == nullptr && pool.Acquire() == nullptr && pool.Dropped() == 2);
+    for (size_t i = 0; i < slots; i++) pool.Release(taken[slots - 1 - i]);
+
+    // Each thread stamps the slot it holds; another thread holding the
+    // same slot would change the stamp
+    std::atomic<int> shared(0);
+    std::vector<std::thread> threads;
+    for (int id = 0; id < 8; id++) {
+        threads.push_back(std::thread([&pool, &shared, id]() {
+            for (int i = 0; i < 100000; i++) {
+                ChatMessage* message = pool.Acquire();
+                if (message == nullptr) continue;
+                message->senderLength = (uint16_t)id;
+                message->textLength = (uint16_t)i;
+                if (message->senderLength != id || message->textLength != (uint16_t)i) shared++;
+                pool.Release(message);
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+    CHECK(shared.load() == 0);
+
+    size_t free = 0;
+    while (pool.Acquire() != nullptr) free++;
+    CHECK(free == slots);
+
+    ChatMessagePool empty(0);
+    CHECK(empty.Acquire() == nullptr && empty.Dropped() == 1);
+}
+
+int main() {
+    TestRandom random(21);
+    CheckView();
+    CheckMatchAgainstReference(&random);
+    CheckPool();
+    return TestResult("ChatPacketTest");
+}
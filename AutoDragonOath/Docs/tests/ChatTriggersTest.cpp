@@ -0,0 +1,191 @@
+// ChatTriggersTest.cpp - Keyword triggers: GBK character boundaries, filters, differential
+//
+// Checks:
+//   - the README example: "帮助" spelled across characters (C4B0 EFD6 FA41)
+//     fires nothing, while the real characters fire once at their offset
+//   - Add refuses empty, too long and cut keywords; rules share keywords;
+//     Or, Channels and From; the ChatMessage overload of Scan
+//   - 3000 random rules over 3000 random messages against a brute force
+//     (find every occurrence, keep those starting on a character), with
+//     text built from bytes that spell keywords across characters. Every
+//     rule must fire exactly when the brute force says, and at most once.
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "../HookLib/ChatTriggers.h"
+#include "TestCheck.h"
+
+using namespace HookLib;
+
+static const char* HELP = "\xB0\xEF\xD6\xFA";      // "帮助"
+
+static size_t ScanText(const ChatTriggers& triggers, const std::string& text, uint8_t channel, const char* sender,
+                       ChatTriggerHits* hits) {
+    return triggers.Scan(text.data(), text.size(), channel, sender, strlen(sender), hits);
+}
+
+static void CheckBoundaries() {
+    ChatTriggers triggers;
+    int help = triggers.Add(ChatTriggerRule(HELP));
+    int ascii = triggers.Add(ChatTriggerRule("ab"));
+    triggers.Build();
+    ChatTriggerHits hits;
+
+    std::string across = "\xC4\xB0\xEF\xD6\xFA\x41";
+    CHECK(across.find(HELP) == 1);
+    CHECK(ScanText(triggers, across, 1, "x", &hits) == 0 && hits.Count() == 0 && !hits.Fired(help));
+
+    CHECK(ScanText(triggers, std::string("ab") + HELP, 1, "x", &hits) == 2);
+    CHECK(hits.Fired(help) && hits.Fired(ascii));
+    CHECK(hits[0].rule == ascii && hits[0].offset == 0 && hits[1].rule == help && hits[1].offset == 2);
+
+    // The same keyword twice, and once more after an odd number of ASCII bytes
+    std::string twice = std::string(HELP) + "a" + HELP + HELP;
+    CHECK(ScanText(triggers, twice, 1, "x", &hits) == 1 && hits[0].offset == 0);
+
+    // A trail byte that looks like ASCII: "a" inside D6 61 is not a character
+    CHECK(ScanText(triggers, "\xD6\x61\x62", 1, "x", &hits) == 0);
+    CHECK(ScanText(triggers, "\xD6\x61\x61\x62", 1, "x", &hits) == 1 && hits[0].offset == 2);
+
+    // A lead byte at the very end of the text
+    CHECK(ScanText(triggers, std::string("ab") + "\xB0", 1, "x", &hits) == 1);
+
+    // Hits are fresh on every scan
+    CHECK(ScanText(triggers, "nothing", 1, "x", &hits) == 0 && !hits.Fired(help) && !hits.Fired(ascii));
+    CHECK(!hits.Fired(-1) && !hits.Fired(2));
+}
+
+static void CheckRules() {
+    ChatTriggers triggers;
+    CHECK(triggers.Add(ChatTriggerRule("")) == -1);
+    CHECK(triggers.Add(ChatTriggerRule(std::string(CHAT_TRIGGER_MAX_KEYWORD + 1, 'k').c_str())) == -1);
+    CHECK(triggers.Add(ChatTriggerRule("ok\xB0")) == -1);
+    CHECK(triggers.Add(ChatTriggerRule("ok").Or("")) == -1);
+    CHECK(triggers.RuleCount() == 0);
+
+    CHECK(triggers.Add(ChatTriggerRule(std::string(CHAT_TRIGGER_MAX_KEYWORD, 'k').c_str())) == 0);
+    int boss = triggers.Add(ChatTriggerRule("BOSS\xCB\xA2\xD0\xC2").Or("Boss spawned"));    // "BOSS刷新"
+    int gather = triggers.Add(ChatTriggerRule("\xB9\xAB\xBB\xE1\xBC\xAF\xBA\xCF")              // "公会集合"
+                                  .Channels({ 3, 200 }).From(HELP));
+    int alsoBoss = triggers.Add(ChatTriggerRule("Boss spawned").Channels({ 5 }));
+    CHECK(boss == 1 && gather == 2 && alsoBoss == 3);
+    std::string cut(CHAT_TRIGGER_MAX_KEYWORD - 1, 'k');
+    CHECK(triggers.Add(ChatTriggerRule((cut + "\xB0\xEF").c_str())) == -1);    // 256 bytes: a character past the limit
+    CHECK(triggers.KeywordCount() == 4);                            // "Boss spawned" once
+
+    // Not built yet: nothing fires
+    ChatTriggerHits hits;
+    CHECK(ScanText(triggers, "Boss spawned", 5, "x", &hits) == 0);
+    triggers.Build();
+    CHECK(triggers.MemoryBytes() > 0);
+
+    CHECK(ScanText(triggers, "Boss spawned", 5, "x", &hits) == 2 && hits.Fired(boss) && hits.Fired(alsoBoss));
+    CHECK(ScanText(triggers, "Boss spawned", 4, "x", &hits) == 1 && hits.Fired(boss));
+    CHECK(ScanText(triggers, "BOSS\xCB\xA2\xD0\xC2 Boss spawned", 4, "x", &hits) == 1 && hits[0].offset == 0);
+    CHECK(ScanText(triggers, std::string(CHAT_TRIGGER_MAX_KEYWORD, 'k'), 0, "x", &hits) == 1 && hits.Fired(0));
+
+    std::string gatherText = "!! \xB9\xAB\xBB\xE1\xBC\xAF\xBA\xCF";
+    CHECK(ScanText(triggers, gatherText, 3, HELP, &hits) == 1 && hits.Fired(gather) && hits[0].offset == 3);
+    CHECK(ScanText(triggers, gatherText, 200, HELP, &hits) == 1);
+    CHECK(ScanText(triggers, gatherText, 4, HELP, &hits) == 0);               // Other channel
+    CHECK(ScanText(triggers, gatherText, 3, "\xB0\xEF", &hits) == 0);         // Sender is a prefix
+    CHECK(ScanText(triggers, gatherText, 3, "\xB0\xEF\xD6\xFA!", &hits) == 0);
+
+    // The ChatMessage overload reads the same fields
+    ChatMessage message;
+    memset(&message, 0, sizeof(message));
+    message.channel = 3;
+    message.senderLength = (uint16_t)strlen(HELP);
+    memcpy(message.sender, HELP, message.senderLength);
+    message.textLength = (uint16_t)gatherText.size();
+    memcpy(message.text, gatherText.data(), gatherText.size());
+    CHECK(triggers.Scan(message, &hits) == 1 && hits.Fired(gather));
+    message.channel = 5;
+    CHECK(triggers.Scan(message, &hits) == 0);
+}
+
+// One character: ASCII, or a lead byte and a trail byte. The lead bytes
+// double as trail bytes, so keywords get spelled across characters.
+static std::string RandomCharacter(TestRandom* random) {
+    static const uint8_t LEADS[] = { 0xB0, 0xC4, 0xD6, 0xEF, 0xFA };
+    static const uint8_t TRAILS[] = { 0xEF, 0xB0, 0xFA, 0xD6, 0x41 };
+    uint32_t k = random->Below(24);
+    if (k < 4) return std::string(1, "ab !"[k]);
+    std::string character;
+    character += (char)LEADS[k % 5];
+    character += (char)TRAILS[(k / 5) % 5];
+    return character;
+}
+
+struct ReferenceRule {
+    std::string keyword;
+    int channel;        // -1: any
+    int sender;         // -1: anyone
+};
+
+static void CheckAgainstBruteForce(TestRandom* random) {
+    static const char* SENDERS[] = { "s0", "s1", "s2" };
+    ChatTriggers triggers;
+    std::vector<ReferenceRule> reference;
+    for (int r = 0; r < 3000; r++) {
+        ReferenceRule expected;
+        for (uint32_t i = 0, n = 1 + random->Below(4); i < n; i++) expected.keyword += RandomCharacter(random);
+        expected.channel = random->Below(3) == 0 ? (int)random->Below(4) : -1;
+        expected.sender = random->Below(4) == 0 ? (int)random->Below(3) : -1;
+
+        ChatTriggerRule rule(expected.keyword.c_str());
+        if (expected.channel >= 0) rule.Channels({ (uint8_t)expected.channel });
+        if (expected.sender >= 0) rule.From(SENDERS[expected.sender]);
+        CHECK(triggers.Add(rule) == r);
+        reference.push_back(expected);
+    }
+    triggers.Build();
+
+    ChatTriggerHits hits;
+    size_t fired = 0;
+    for (int m = 0; m < 3000; m++) {
+        std::string text;
+        for (uint32_t i = 0, n = random->Below(60); i < n; i++) text += RandomCharacter(random);
+        uint8_t channel = (uint8_t)random->Below(4);
+        int sender = (int)random->Below(3);
+
+        std::vector<bool> starts(text.size() + 1, false);
+        for (size_t i = 0; i < text.size(); i += GbkLeadByte((uint8_t)text[i]) ? 2 : 1) starts[i] = true;
+
+        size_t count = ScanText(triggers, text, channel, SENDERS[sender], &hits);
+        CHECK(count == hits.Count());
+        std::vector<int> times(reference.size(), 0);
+        for (size_t i = 0; i < hits.Count(); i++) {
+            const ChatTriggerHit& hit = hits[i];
+            CHECK(hit.rule >= 0 && (size_t)hit.rule < reference.size());
+            if (hit.rule < 0 || (size_t)hit.rule >= reference.size()) continue;
+            times[hit.rule]++;
+            const std::string& keyword = reference[hit.rule].keyword;
+            CHECK(starts[hit.offset] && text.compare(hit.offset, keyword.size(), keyword) == 0);
+        }
+
+        for (size_t r = 0; r < reference.size(); r++) {
+            const ReferenceRule& rule = reference[r];
+            bool expected = false;
+            if ((rule.channel < 0 || rule.channel == channel) && (rule.sender < 0 || rule.sender == sender)) {
+                for (size_t p = text.find(rule.keyword); p != std::string::npos && !expected;
+                     p = text.find(rule.keyword, p + 1)) {
+                    expected = starts[p];
+                }
+            }
+            CHECK(times[r] == (expected ? 1 : 0) && hits.Fired((int)r) == expected);
+        }
+        fired += count;
+    }
+    printf("3000 rules over 3000 messages: %zu fired, all as the brute force\n", fired);
+}
+
+int main() {
+    TestRandom random(25);
+    CheckBoundaries();
+    CheckRules();
+    CheckAgainstBruteForce(&random);
+    return TestResult("ChatTriggersTest");
+}
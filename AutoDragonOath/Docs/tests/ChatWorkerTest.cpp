@@ -0,0 +1,263 @@
+// ChatWorkerTest.cpp - The bounded queue, the chat worker and the game-thread queue
+//
+// Checks:
+//   - BoundedQueue: the capacity rounded up to a power of two, a full
+//     queue refusing exactly the items past it, FIFO order, and wrapping
+//     many times around a small ring
+//   - four producers against a consumer on a 16-cell ring: every item
+//     either refused (and counted by its producer) or popped once, each
+//     producer's items popped in the order it pushed them
+//   - ChatWorker with its handler held up: the queue fills, the messages
+//     past it are dropped, counted and their slots released at once;
+//     Stop with messages still queued waits until all are handled, in
+//     order, and every slot is back in the pool; Publish after Stop drops
+//   - GameThreadQueue: calls posted from several threads run on the
+//     draining thread, oldest first, at most `limit` per RunPending, with
+//     their captures copied; a full queue drops and counts
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../HookLib/ChatWorker.h"
+#include "TestCheck.h"
+
+using namespace HookLib;
+
+// ============================================================================
+// BOUNDED QUEUE
+// ============================================================================
+
+static void CheckQueueSingle(TestRandom* random) {
+    BoundedQueue<uint32_t> queue(5);    // 8 cells
+    for (uint32_t i = 0; i < 8; i++) CHECK(queue.Push(i));
+    CHECK(!queue.Push(8) && !queue.Push(9));
+    uint32_t item;
+    for (uint32_t i = 0; i < 8; i++) CHECK(queue.Pop(&item) && item == i);
+    CHECK(!queue.Pop(&item));
+
+    // Random pushes and pops against a counter: many times around the ring
+    uint32_t pushed = 0, popped = 0;
+    uint64_t refused = 0;
+    for (int step = 0; step < 100000; step++) {
+        if (random->Below(2) == 0) {
+            if (queue.Push(pushed)) {
+                CHECK(pushed - popped < 8);
+                pushed++;
+            } else {
+                CHECK(pushed - popped == 8);
+                refused++;
+            }
+        } else if (queue.Pop(&item)) {
+            CHECK(item == popped);
+            popped++;
+        } else {
+            CHECK(pushed == popped);
+        }
+    }
+    CHECK(refused > 0 && pushed > 40000);
+}
+
+static void CheckQueueProducers() {
+    const uint32_t producers = 4;
+    const uint32_t perProducer = 50000;
+    BoundedQueue<uint32_t> queue(16);
+    std::vector<std::vector<uint32_t> > accepted(producers);
+    std::vector<uint64_t> refused(producers, 0);
+    std::atomic<uint32_t> finished(0);
+
+    std::vector<std::thread> threads;
+    for (uint32_t p = 0; p < producers; p++) {
+        threads.push_back(std::thread([&, p]() {
+            for (uint32_t i = 0; i < perProducer; i++) {
+                if (queue.Push(p << 24 | i)) {
+                    accepted[p].push_back(i);
+                } else {
+                    refused[p]++;
+                }
+                // A flood first, which must overflow; then bursts the consumer keeps up with
+                if (i >= 1000 && i % 8 == 7) std::this_thread::sleep_for(std::chrono::microseconds(20));
+            }
+            finished.fetch_add(1);
+        }));
+    }
+
+    std::vector<std::vector<uint32_t> > popped(producers);
+    uint32_t item;
+    for (;;) {
+        bool done = finished.load() == producers;   // Read before the last Pop: nothing can follow it
+        if (queue.Pop(&item)) {
+            CHECK((item >> 24) < producers);
+            if ((item >> 24) < producers) popped[item >> 24].push_back(item & 0xFFFFFF);
+        } else if (done) {
+            break;
+        }
+    }
+    for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+
+    uint64_t totalPopped = 0, totalRefused = 0;
+    for (uint32_t p = 0; p < producers; p++) {
+        CHECK(popped[p] == accepted[p]);    // Each producer's items, once each, in its order
+        CHECK(accepted[p].size() + refused[p] == perProducer);
+        totalPopped += popped[p].size();
+        totalRefused += refused[p];
+    }
+    CHECK(totalRefused > 0);
+    printf("4 producers, 16 cells: %llu items popped in order, %llu refused and counted\n",
+           (unsigned long long)totalPopped, (unsigned long long)totalRefused);
+}
+
+// ============================================================================
+// CHAT WORKER
+// ============================================================================
+
+static std::atomic<bool> g_holdHandler(false);
+static std::atomic<bool> g_inHandler(false);
+static std::vector<int> g_handled;     // Worker thread only until Stop returns
+
+static void HoldingHandler(const ChatMessage& message) {
+    g_inHandler.store(true);
+    while (g_holdHandler.load()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    int n;
+    memcpy(&n, message.text, sizeof(n));
+    g_handled.push_back(n);
+}
+
+static bool Publish(ChatWorker* worker, ChatMessagePool* pool, int n) {
+    ChatMessage* message = pool->Acquire();
+    CHECK(message != nullptr);
+    if (message == nullptr) return false;
+    memcpy(message->text, &n, sizeof(n));
+    return worker->Publish(message);
+}
+
+// Slots free in the pool, taken and given back
+static size_t FreeSlots(ChatMessagePool* pool) {
+    std::vector<ChatMessage*> taken;
+    while (ChatMessage* message = pool->Acquire()) taken.push_back(message);
+    for (size_t i = 0; i < taken.size(); i++) pool->Release(taken[i]);
+    return taken.size();
+}
+
+static void CheckWorker() {
+    const size_t slots = 400;
+    ChatMessagePool pool(slots);
+    ChatWorker worker(&pool);
+    g_handled.clear();
+    g_holdHandler.store(true);
+    g_inHandler.store(false);
+    CHECK(worker.Start(HoldingHandler));
+
+    // The first message holds the worker; the queue then fills behind it
+    CHECK(Publish(&worker, &pool, 0));
+    while (!g_inHandler.load()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    const int published = 300;
+    int accepted = 1;
+    for (int n = 1; n < published; n++) {
+        if (Publish(&worker, &pool, n)) accepted++;
+    }
+    CHECK((size_t)accepted == 1 + CHAT_WORKER_CAPACITY);
+    CHECK(worker.Dropped() == (uint64_t)(published - accepted));
+    CHECK(FreeSlots(&pool) == slots - accepted);    // Dropped slots came back at once
+
+    // Stop while all of them are still queued: it waits until they are handled
+    std::thread release([]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        g_holdHandler.store(false);
+    });
+    worker.Stop();
+    release.join();
+    CHECK(g_handled.size() == (size_t)accepted);
+    for (size_t i = 0; i < g_handled.size(); i++) CHECK(g_handled[i] == (int)i);
+    CHECK(FreeSlots(&pool) == slots);
+
+    CHECK(!Publish(&worker, &pool, published));
+    CHECK(worker.Dropped() == (uint64_t)(published - accepted) + 1);
+    CHECK(FreeSlots(&pool) == slots && g_handled.size() == (size_t)accepted);
+    printf("worker held: %d queued, %llu dropped; Stop handled all queued in order\n", accepted,
+           (unsigned long long)worker.Dropped());
+}
+
+// ============================================================================
+// GAME THREAD QUEUE
+// ============================================================================
+
+static std::vector<int> g_ran;
+static std::thread::id g_gameThread;
+
+static void CheckGameQueue() {
+    GameThreadQueue calls(32);
+    g_ran.clear();
+    g_gameThread = std::this_thread::get_id();
+
+    // Captures are copied: changing the source after Post does not matter
+    struct { char text[200]; } reply;
+    strcpy(reply.text, "first");
+    CHECK(calls.Post([reply]() { g_ran.push_back(strcmp(reply.text, "first") == 0 ? -1 : -2); }));
+    strcpy(reply.text, "changed");
+    for (int n = 0; n < 31; n++) {
+        CHECK(calls.Post([n]() { g_ran.push_back(n); }));
+    }
+    CHECK(!calls.Post([]() { g_ran.push_back(999); }) && calls.Dropped() == 1);
+
+    // A limit: the oldest first, the rest stays for the next call
+    CHECK(calls.RunPending(10) == 10 && g_ran.size() == 10 && g_ran[0] == -1);
+    for (size_t i = 1; i < g_ran.size(); i++) CHECK(g_ran[i] == (int)i - 1);
+    CHECK(calls.RunPending() == 22 && g_ran.size() == 32 && g_ran.back() == 30);
+    CHECK(calls.RunPending() == 0);
+
+    // Posted from four threads while the game thread drains; each
+    // thread's calls run in its order, all on the draining thread
+    const int threads = 4, perThread = 50000;
+    std::vector<std::vector<int> > posted(threads);
+    std::atomic<int> finished(0);
+    std::atomic<bool> wrongThread(false);
+    std::vector<int> ranBy;
+    std::vector<std::thread> posters;
+    for (int t = 0; t < threads; t++) {
+        posters.push_back(std::thread([&, t]() {
+            for (int i = 0; i < perThread; i++) {
+                int value = t << 24 | i;
+                std::vector<int>* out = &ranBy;
+                std::atomic<bool>* wrong = &wrongThread;
+                if (calls.Post([value, out, wrong]() {
+                        if (std::this_thread::get_id() != g_gameThread) wrong->store(true);
+                        out->push_back(value);
+                    })) {
+                    posted[t].push_back(i);
+                }
+                if (i >= 1000 && i % 8 == 7) std::this_thread::sleep_for(std::chrono::microseconds(20));
+            }
+            finished.fetch_add(1);
+        }));
+    }
+    for (;;) {
+        bool done = finished.load() == threads;
+        if (calls.RunPending() == 0 && done) break;
+    }
+    for (size_t i = 0; i < posters.size(); i++) posters[i].join();
+
+    std::vector<std::vector<int> > ran(threads);
+    for (size_t i = 0; i < ranBy.size(); i++) ran[ranBy[i] >> 24].push_back(ranBy[i] & 0xFFFFFF);
+    uint64_t postedTotal = 0;
+    for (int t = 0; t < threads; t++) {
+        CHECK(ran[t] == posted[t]);
+        postedTotal += posted[t].size();
+    }
+    CHECK(!wrongThread.load());
+    CHECK(postedTotal + calls.Dropped() == 1 + (uint64_t)threads * perThread);
+    printf("game queue: %llu calls from 4 threads run in order on one thread, %llu dropped\n",
+           (unsigned long long)postedTotal, (unsigned long long)calls.Dropped() - 1);
+}
+
+int main() {
+    TestRandom random(22);
+    CheckQueueSingle(&random);
+    CheckQueueProducers();
+    CheckWorker();
+    CheckGameQueue();
+    return TestResult("ChatWorkerTest");
+}
@@ -0,0 +1,261 @@
+// LogFormatTest.cpp - Log format checks and FormatLogRecord against snprintf
+//
+// Checks:
+//   - LogFormatMatches accepts each conversion with the argument kinds it
+//     takes (integers by size, %ld either size, %hd / %hhd a 4-byte one)
+//     and rejects wrong kinds, wrong counts, %n, %ls, %lc, %hc, '*' and
+//     unknown or cut-off conversions; the same table as static_asserts
+//   - for every supported conversion, with random flags, width, precision
+//     and values (INT_MIN, values %hd / %hhd must cut, inf, nan, strings
+//     and results longer than the scratch buffer), packing the arguments
+//     and formatting them gives exactly what snprintf gives
+//   - a cut record prints "?" for the arguments it lost
+// A mismatched HOOKLIB_LOG must not compile; run_tests.sh checks that with
+// the switch below.
+//
+// COMPILE_FAIL: TEST_LOG_MISMATCH log format does not match its arguments
+
+#include <limits.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+#include "../HookLib/LogFormat.h"
+#include "TestCheck.h"
+
+#ifdef TEST_LOG_MISMATCH
+#include "../HookLib/AsyncLog.h"
+#endif
+
+using namespace HookLib;
+
+enum Channel { CHANNEL_WORLD = 3 };
+
+template <class... T>
+constexpr bool Takes(const char* format) {
+    return LogFormatMatches(MakeLogFormat<T...>(LOG_INFO, format, "", 0));
+}
+
+// ============================================================================
+// ACCEPTED AND REJECTED ARGUMENT KINDS
+// ============================================================================
+
+static_assert(Takes<int, const char*>("[Channel %d] %s"), "");
+static_assert(Takes<short>("%hd") && Takes<int>("%hhd") && Takes<unsigned short>("%hu"), "");
+static_assert(Takes<long long>("%lld") && Takes<int64_t>("%I64d") && Takes<long>("%ld") && Takes<int>("%ld"), "");
+static_assert(Takes<size_t>("%zu") && Takes<intmax_t>("%jd") && Takes<ptrdiff_t>("%td"), "");
+static_assert(Takes<double>("%.3f") && Takes<float>("%g") && Takes<void*>("%p") && Takes<>("100%%"), "");
+static_assert(!Takes<long long>("%d") && !Takes<int>("%lld") && !Takes<double>("%d") && !Takes<int>("%f"), "");
+static_assert(!Takes<const char*>("%p") && !Takes<void*>("%s") && !Takes<int>("%s") && !Takes<const char*>("%d"), "");
+static_assert(!Takes<int>("%hc") && !Takes<int>("%lc") && !Takes<const char*>("%ls") && !Takes<int*>("%n"), "");
+static_assert(!Takes<int, int>("%*d") && !Takes<>("%d") && !Takes<int>("%d %d") && !Takes<int, int>("%d"), "");
+
+static void CheckMatches() {
+    // Same as the static_asserts, plus the kinds that are easier to list
+    CHECK((Takes<int, const char*, double>("%d %s %f")));
+    CHECK(Takes<char>("%c") && Takes<unsigned char>("%hhu") && Takes<Channel>("%d") && Takes<bool>("%d"));
+    CHECK(Takes<uint32_t>("%x") && Takes<uint64_t>("%llX") && Takes<unsigned long>("%lu") && Takes<uint32_t>("%lu"));
+    CHECK(Takes<double>("%e") && Takes<double>("%E") && Takes<double>("%G") && Takes<double>("%a"));
+    CHECK(Takes<double>("%-+#012.4F") && Takes<double>("%A") && Takes<long double>("%Lf"));
+    CHECK(Takes<char*>("%s") && Takes<const char*>("%-20.5s") && Takes<const int*>("%p") && Takes<>("plain"));
+    CHECK(Takes<int>("%%%d%%"));
+
+    CHECK(!Takes<int64_t>("%d") && !Takes<int64_t>("%hd") && !Takes<int32_t>("%I64d") && !Takes<int32_t>("%jd"));
+    CHECK(!Takes<double>("%hf") && !Takes<double>("%llf") && !Takes<double>("%zf") && !Takes<double>("%Ld"));
+    CHECK(!Takes<const char*>("%zs") && !Takes<void*>("%lp") && !Takes<char*>("%c"));
+    CHECK(!Takes<double>("%.*f") && !Takes<int>("%q") && !Takes<int>("%5") && !Takes<int>("%"));
+    CHECK(!Takes<int>("%d %"));
+    CHECK((!Takes<int, int, int, int, int, int, int, int, int, int, int, int, int>(
+        "%d %d %d %d %d %d %d %d %d %d %d %d %d")));
+    CHECK((Takes<int, int, int, int, int, int, int, int, int, int, int, int>("%d %d %d %d %d %d %d %d %d %d %d %d")));
+}
+
+// ============================================================================
+// FORMATTING AGAINST SNPRINTF
+// ============================================================================
+
+static size_t g_Formats = 0;
+
+template <class... T>
+static std::string Printf(const char* format, T... values) {
+    int length = snprintf(nullptr, 0, format, values...);
+    if (length < 0) return "(error)";
+    std::string text((size_t)length + 1, '\0');
+    snprintf(&text[0], text.size(), format, values...);
+    text.resize((size_t)length);
+    return text;
+}
+
+// Packs the values as a call site would and formats them back
+template <class... T>
+static std::string FormatPacked(const char* format, T... values) {
+    LogFormat site = MakeLogFormat<T...>(LOG_INFO, format, "", 0);
+    CHECK(LogFormatMatches(site));
+    static uint8_t buffer[8192];
+    LogArgWriter writer = { buffer, buffer + sizeof(buffer), false };
+    PackLogArgs(&writer, values...);
+    CHECK(!writer.truncated);
+    std::string text;
+    FormatLogRecord(format, site.args, site.argCount, buffer, (size_t)(writer.at - buffer), &text);
+    return text;
+}
+
+template <class... T>
+static void CheckSame(const std::string& format, T... values) {
+    std::string packed = FormatPacked(format.c_str(), values...);
+    std::string expected = Printf(format.c_str(), values...);
+    if (packed != expected) fprintf(stderr, "\"%s\": \"%s\", snprintf \"%s\"\n", format.c_str(), packed.c_str(),
+                                    expected.c_str());
+    CHECK(packed == expected);
+    g_Formats++;
+}
+
+// "%<flags><width>.<precision><length><conversion>", flags from `flags`;
+// now and then a field wider than FormatLogRecord's scratch buffer
+static std::string RandomSpec(TestRandom* random, const char* flags, bool precision, const char* length,
+                              char conversion) {
+    std::string spec = "%";
+    for (const char* f = flags; *f != '\0'; f++) {
+        if (random->Below(4) == 0) spec += *f;
+    }
+    if (random->Below(2) == 0) spec += std::to_string(random->Below(random->Below(40) == 0 ? 700 : 25));
+    if (precision && random->Below(2) == 0) {
+        spec += ".";
+        if (random->Below(5) != 0) spec += std::to_string(random->Below(random->Below(40) == 0 ? 600 : 20));
+    }
+    return spec + length + conversion;
+}
+
+static int32_t RandomInt32(TestRandom* random) {
+    static const int32_t EDGES[] = { 0, -1, 1, INT_MIN, INT_MAX, 127, 128, -129, 255, 256, 32767, 32768, -32769,
+                                     65535, 65536, 300, -300 };
+    if (random->Below(3) == 0) return EDGES[random->Below(sizeof(EDGES) / sizeof(EDGES[0]))];
+    return (int32_t)(uint32_t)(random->Next() >> random->Below(32));
+}
+
+static int64_t RandomInt64(TestRandom* random) {
+    if (random->Below(4) == 0) return (random->Below(2) == 0) ? INT64_MIN : INT64_MAX;
+    return (int64_t)(random->Next() >> random->Below(64));
+}
+
+static double RandomDouble(TestRandom* random) {
+    static const double EDGES[] = { 0.0, -0.0, 1.0, -1.5, 0.1, 1e300, -1e-300, 5e-324, 123456789.125, 2.5, 0.5 };
+    switch (random->Below(6)) {
+        case 0: return EDGES[random->Below(sizeof(EDGES) / sizeof(EDGES[0]))];
+        case 1: return (random->Below(2) == 0) ? INFINITY : -INFINITY;
+        case 2: return NAN;
+        default: return ldexp((double)(int64_t)random->Next(), (int)random->Below(200) - 160);
+    }
+}
+
+static std::string RandomText(TestRandom* random) {
+    static const char* WORDS[] = { "boss", "\xB0\xEF\xD6\xFA", " ", "team up", "%d", "" };
+    std::string text;
+    if (random->Below(30) == 0) return std::string(600 + random->Below(2000), 'x');
+    for (uint32_t i = 0, n = random->Below(6); i < n; i++) text += WORDS[random->Below(6)];
+    return text;
+}
+
+static void CheckIntegers(TestRandom* random) {
+    static const char INT_CONVERSIONS[] = "diuxXo";
+    for (int round = 0; round < 3000; round++) {
+        char c = INT_CONVERSIONS[random->Below(6)];
+        const char* flags = (c == 'd' || c == 'i') ? "-+ 0" : "-#0";
+        switch (random->Below(9)) {
+            case 0: CheckSame(RandomSpec(random, flags, true, "", c), RandomInt32(random)); break;
+            case 1: CheckSame(RandomSpec(random, flags, true, "", c), (uint32_t)RandomInt32(random)); break;
+            case 2: CheckSame(RandomSpec(random, flags, true, "h", c), RandomInt32(random)); break;
+            case 3: CheckSame(RandomSpec(random, flags, true, "hh", c), RandomInt32(random)); break;
+            case 4: CheckSame(RandomSpec(random, flags, true, "l", c), (long)RandomInt64(random)); break;
+            case 5: CheckSame(RandomSpec(random, flags, true, "ll", c), (long long)RandomInt64(random)); break;
+            case 6: CheckSame(RandomSpec(random, flags, true, "z", c), (size_t)RandomInt64(random)); break;
+            case 7: CheckSame(RandomSpec(random, flags, true, "j", c), (intmax_t)RandomInt64(random)); break;
+            default: CheckSame(RandomSpec(random, flags, true, "t", c), (ptrdiff_t)RandomInt64(random)); break;
+        }
+    }
+    // %hd and %hhd cut, by name
+    CHECK(FormatPacked("%hd %hhd %hu %hhx", 70000, 300, -1, 0x1FF) == "4464 44 65535 ff");
+    CHECK(FormatPacked("%I64d %I64x", (int64_t)-5, (uint64_t)0xFFFFFFFFFFull) == "-5 ffffffffff");
+    for (int round = 0; round < 300; round++) {
+        CheckSame(RandomSpec(random, "-", false, "", 'c'), (int)(32 + random->Below(224)));
+    }
+}
+
+static void CheckDoubles(TestRandom* random) {
+    static const char DOUBLE_CONVERSIONS[] = "fFeEgGaA";
+    for (int round = 0; round < 3000; round++) {
+        char c = DOUBLE_CONVERSIONS[random->Below(8)];
+        CheckSame(RandomSpec(random, "-+ #0", true, "", c), RandomDouble(random));
+    }
+    CheckSame("%f %g", 2.5f, -0.25f);
+}
+
+static void CheckStringsAndPointers(TestRandom* random) {
+    for (int round = 0; round < 2000; round++) {
+        std::string text = RandomText(random);
+        CheckSame(RandomSpec(random, "-", true, "", 's'), text.c_str());
+    }
+    for (int round = 0; round < 300; round++) {
+        void* pointer = (void*)(uintptr_t)(random->Next() >> random->Below(64));
+        CheckSame(RandomSpec(random, "-", false, "", 'p'), pointer);
+    }
+    char name[] = "player";
+    CheckSame("%s", name);
+    CheckSame("%p", (void*)nullptr);
+}
+
+static void CheckMixed(TestRandom* random) {
+    for (int round = 0; round < 1000; round++) {
+        std::string text = RandomText(random);
+        std::string format = "[" + RandomSpec(random, "-0", true, "", 'd') + "] " +
+                             RandomSpec(random, "-", true, "", 's') + " 100%% " +
+                             RandomSpec(random, "-+", true, "ll", 'x') + RandomSpec(random, "#", true, "", 'g') +
+                             RandomSpec(random, "", true, "hh", 'u');
+        CheckSame(format, RandomInt32(random), text.c_str(), (long long)RandomInt64(random), RandomDouble(random),
+                  RandomInt32(random));
+    }
+}
+
+// A record cut short (the ring slot was full): what is left prints, the rest is "?"
+static void CheckCut() {
+    LogFormat site = MakeLogFormat<int, const char*, long long>(LOG_INFO, "%d [%s] %lld!", "", 0);
+    uint8_t buffer[64];
+    LogArgWriter writer = { buffer, buffer + sizeof(buffer), false };
+    PackLogArgs(&writer, 7, "text", 9ll);
+    size_t whole = (size_t)(writer.at - buffer);
+    std::string text;
+    FormatLogRecord(site.format, site.args, site.argCount, buffer, whole, &text);
+    CHECK(text == "7 [text] 9!");
+    text.clear();
+    FormatLogRecord(site.format, site.args, site.argCount, buffer, whole - 8, &text);
+    CHECK(text == "7 [text] ?!");
+    text.clear();
+    FormatLogRecord(site.format, site.args, site.argCount, buffer, 8, &text);
+    CHECK(text == "7 [te] ?!");
+    text.clear();
+    FormatLogRecord(site.format, site.args, site.argCount, buffer, 5, &text);
+    CHECK(text == "7 [?] ?!");
+    text.clear();
+    FormatLogRecord(site.format, site.args, site.argCount, buffer, 0, &text);
+    CHECK(text == "? [?] ?!");
+}
+
+#ifdef TEST_LOG_MISMATCH
+static void LogMismatch(AsyncLog& log) {
+    HOOKLIB_LOG(log, LOG_ERROR, "%d players", "three");
+}
+#endif
+
+int main() {
+    TestRandom random(17);
+    CheckMatches();
+    CheckIntegers(&random);
+    CheckDoubles(&random);
+    CheckStringsAndPointers(&random);
+    CheckMixed(&random);
+    CheckCut();
+    printf("%zu formats packed and formatted as snprintf formats them\n", g_Formats);
+    return TestResult("LogFormatTest");
+}
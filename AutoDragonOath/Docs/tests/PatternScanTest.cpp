@@ -0,0 +1,527 @@
+// PatternScanTest.cpp - The SIMD scanners against a plain reference loop
+//
+// Random buffers over a small alphabet (so anchors hit often and most hits
+// are near misses), random patterns with exact, wildcard and partial mask
+// bytes. Every match, found by restarting after the previous one, must be
+// the same for the reference loop and for each engine the CPU has (scalar,
+// SSE2, AVX2). Buffers are allocated at their exact size, so a load past
+// the end is an ASan error; lengths cover the 16 / 32 byte tails.
+//
+// MultiPatternScanner is checked against FindAllPatterns for each of its
+// signatures: overlapping ones, shared prefixes, identical keys, wildcards,
+// keys past MULTI_SCAN_MAX_KEY, unkeyed ones, and copies ending on the
+// last byte.
+//
+// FindAllPatterns with a hit limit and verifiers must keep exactly the
+// first `limit` accepted matches and report the one past it as truncated;
+// a verifier that rejects a candidate drops only that one, in
+// FindAllPatterns and in MultiPatternScanner alike.
+//
+// FindPatternNear (FindNearWith) must return the match nearest to the
+// hint within the radius, the lower one on a tie, with the hint clamped to
+// the last start and the windows clamped at both buffer ends.
+//
+// The parallel scanners (ParallelScan.h) are checked against the
+// single-threaded ones, with matches planted across every chunk boundary.
+//
+// Build (Linux):
+//   g++ -std=c++17 -O1 -g -fsanitize=address,undefined PatternScanTest.cpp -o PatternScanTest
+// or run_tests.sh, which builds and runs every test.
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "../HookLib/CandidateScan.h"
+#include "../HookLib/ParallelScan.h"
+#include "../HookLib/PatternScan.h"
+#include "TestCheck.h"
+
+using namespace HookLib;
+
+static size_t ReferenceFind(const uint8_t* data, size_t size, size_t first, const PatternView& pattern) {
+    for (size_t i = first; i + pattern.length <= size; i++) {
+        bool match = true;
+        for (size_t j = 0; j < pattern.length && match; j++) {
+            match = (data[i + j] & pattern.mask[j]) == pattern.value[j];
+        }
+        if (match) return i;
+    }
+    return NPOS;
+}
+
+// Every match, each search starting after the last one
+static std::vector<size_t> AllMatches(SimdLevel level, const uint8_t* data, size_t size, const PatternView& pattern) {
+    std::vector<size_t> matches;
+    if (pattern.length == 0 || pattern.length > size) return matches;
+    size_t at = 0;
+    while (at + pattern.length <= size) {
+        size_t found = FindPatternRangeWith(level, data, at, size - pattern.length, pattern);
+        if (found == NPOS) break;
+        matches.push_back(found);
+        at = found + 1;
+    }
+    return matches;
+}
+
+static std::vector<size_t> AllReferenceMatches(const uint8_t* data, size_t size, const PatternView& pattern) {
+    std::vector<size_t> matches;
+    for (size_t at = 0;;) {
+        size_t found = ReferenceFind(data, size, at, pattern);
+        if (found == NPOS) break;
+        matches.push_back(found);
+        at = found + 1;
+    }
+    return matches;
+}
+
+static void CheckEngines() {
+    std::vector<SimdLevel> levels;
+    levels.push_back(SIMD_SCALAR);
+    if (GetSimdLevel() >= SIMD_SSE2) levels.push_back(SIMD_SSE2);
+    if (GetSimdLevel() >= SIMD_AVX2) levels.push_back(SIMD_AVX2);
+    printf("engines: %u (CPU level %d)\n", (unsigned)levels.size(), (int)GetSimdLevel());
+
+    TestRandom random(1);
+    size_t compared = 0;
+    for (int round = 0; round < 4000; round++) {
+        uint32_t alphabet = 2 + random.Below(6);
+        size_t size = (round < 200) ? (size_t)round : 1 + random.Below(600);
+        uint8_t* data = new uint8_t[size ? size : 1];
+        for (size_t i = 0; i < size; i++) data[i] = (uint8_t)(0x80 + random.Below(alphabet));
+
+        size_t length = 1 + random.Below(24);
+        std::vector<uint8_t> bytes(length), mask(length);
+        // Mostly a piece of the buffer, so there is something to find
+        size_t from = (size > length) ? random.Below((uint32_t)(size - length)) : 0;
+        for (size_t j = 0; j < length; j++) {
+            bytes[j] = (from + j < size) ? data[from + j] : (uint8_t)(0x80 + random.Below(alphabet));
+            uint32_t kind = random.Below(10);
+            mask[j] = (kind < 6) ? MASK_EXACT : (kind < 9) ? MASK_WILDCARD : (uint8_t)0xF0;
+        }
+        if (round % 7 == 0) std::fill(mask.begin(), mask.end(), MASK_WILDCARD);   // No anchor at all
+        Pattern pattern(bytes.data(), mask.data(), length);
+
+        std::vector<size_t> expected = AllReferenceMatches(data, size, pattern.View());
+        for (size_t l = 0; l < levels.size(); l++) {
+            std::vector<size_t> got = AllMatches(levels[l], data, size, pattern.View());
+            CHECK(got == expected);
+            CHECK(FindPatternWith(levels[l], data, size, pattern.View()) ==
+                  (expected.empty() ? NPOS : expected[0]));
+            compared += got.size();
+        }
+        delete[] data;
+    }
+
+    // Legacy "xx?x" masks, as the DLLs write them
+    const uint8_t code[] = { 0x55, 0x8B, 0xEC, 0x6A, 0xFF, 0x68, 0x10, 0x20, 0x40, 0x00, 0x64, 0xA1, 0x00, 0x00 };
+    const uint8_t legacy[] = { 0x6A, 0xFF, 0x68, 0x00, 0x00, 0x00, 0x00, 0x64, 0xA1 };
+    Pattern prologue(legacy, "xxx????xx");
+    for (size_t l = 0; l < levels.size(); l++) {
+        CHECK(FindPatternWith(levels[l], code, sizeof(code), prologue.View()) == 3);
+    }
+
+    printf("%zu matches compared\n", compared);
+}
+
+// Random pattern of `length` bytes from `low` + alphabet, some wildcards
+static Pattern RandomPattern(TestRandom* random, size_t length, uint8_t low, uint32_t alphabet) {
+    std::vector<uint8_t> bytes(length), mask(length);
+    for (size_t j = 0; j < length; j++) {
+        bytes[j] = (uint8_t)(low + random->Below(alphabet));
+        mask[j] = (random->Below(5) == 0) ? MASK_WILDCARD : MASK_EXACT;
+    }
+    mask[random->Below((uint32_t)length)] = MASK_EXACT;      // Keyed, most of the time
+    return Pattern(bytes.data(), mask.data(), length);
+}
+
+// A signature related to one already in the table: a piece of it (they
+// overlap wherever it matches), the same start with a different end, the
+// same bytes with other wildcards, or an exact copy (identical keys)
+static Pattern RelatedPattern(TestRandom* random, const Pattern& base) {
+    PatternView view = base.View();
+    std::vector<uint8_t> bytes(view.value, view.value + view.length);
+    std::vector<uint8_t> mask(view.mask, view.mask + view.length);
+    switch (random->Below(4)) {
+        case 0: {
+            size_t from = random->Below((uint32_t)view.length);
+            size_t length = 1 + random->Below((uint32_t)(view.length - from));
+            return Pattern(bytes.data() + from, mask.data() + from, length);
+        }
+        case 1: {
+            size_t keep = 1 + random->Below((uint32_t)view.length);
+            bytes.resize(keep + random->Below(8));
+            mask.resize(bytes.size(), MASK_EXACT);
+            for (size_t j = keep; j < bytes.size(); j++) bytes[j] = (uint8_t)(0x80 + random->Below(4));
+            break;
+        }
+        case 2:
+            for (size_t j = 0; j < mask.size(); j++) {
+                if (random->Below(4) == 0) mask[j] = (mask[j] == MASK_EXACT) ? MASK_WILDCARD : MASK_EXACT;
+            }
+            break;
+        default:
+            break;
+    }
+    for (size_t j = 0; j < mask.size(); j++) bytes[j] &= mask[j];
+    return Pattern(bytes.data(), mask.data(), bytes.size());
+}
+
+// Every signature's Scan / ScanRange list is what FindAllPatterns finds
+// for it alone
+static void CheckMultiPattern() {
+    TestRandom random(2);
+    size_t compared = 0, lastByte = 0;
+    for (int round = 0; round < 1500; round++) {
+        size_t size = 1 + random.Below(round < 100 ? 40 : 2000);
+        uint8_t* data = new uint8_t[size];
+        for (size_t i = 0; i < size; i++) data[i] = (uint8_t)(0x80 + random.Below(4));
+
+        std::vector<Pattern> patterns;
+        for (uint32_t p = 0, count = 1 + random.Below(12); p < count; p++) {
+            if (!patterns.empty() && random.Below(2) == 0) {
+                patterns.push_back(RelatedPattern(&random, patterns[random.Below((uint32_t)patterns.size())]));
+                continue;
+            }
+            // Mostly short; some with exact runs longer than the key cap
+            size_t length = 1 + random.Below(random.Below(5) == 0 ? 40 : 10);
+            Pattern pattern = RandomPattern(&random, length, 0x80, 4);
+            if (random.Below(10) == 0) {
+                std::vector<uint8_t> mask(length, MASK_WILDCARD);   // Unkeyed: the FindPattern fallback
+                if (random.Below(2) == 0) mask[random.Below((uint32_t)length)] = 0xF0;
+                std::vector<uint8_t> bytes(pattern.View().value, pattern.View().value + length);
+                for (size_t j = 0; j < length; j++) bytes[j] &= mask[j];
+                pattern = Pattern(bytes.data(), mask.data(), length);
+            }
+            patterns.push_back(pattern);
+        }
+
+        // Copies in the buffer, one of them ending on its last byte
+        for (uint32_t plant = 0, count = 1 + random.Below(6); plant < count; plant++) {
+            PatternView view = patterns[random.Below((uint32_t)patterns.size())].View();
+            if (view.length > size) continue;
+            size_t start = (plant == 0) ? size - view.length : random.Below((uint32_t)(size - view.length + 1));
+            for (size_t j = 0; j < view.length; j++) {
+                data[start + j] = (uint8_t)(view.value[j] | (data[start + j] & ~view.mask[j]));
+            }
+        }
+
+        MultiPatternScanner scanner;
+        for (size_t p = 0; p < patterns.size(); p++) CHECK(scanner.Add(patterns[p].View()) == p);
+        scanner.Build();
+        MultiScanMatches got;
+        scanner.Scan(data, size, &got);
+        size_t first = random.Below((uint32_t)size + 1), last = random.Below((uint32_t)size + 1);
+        if (first > last) std::swap(first, last);
+        MultiScanMatches gotRange(scanner.Count());
+        scanner.ScanRange(data, size, first, last, &gotRange);
+
+        CHECK(got.size() == patterns.size());
+        for (size_t p = 0; p < patterns.size() && p < got.size(); p++) {
+            FindAllResult expected;
+            FindAllPatterns(data, size, patterns[p].View(), DefaultFindAllOptions(), &expected);
+            CHECK(got[p] == expected.matches);
+            CHECK(expected.matches == AllReferenceMatches(data, size, patterns[p].View()));
+            std::vector<size_t> inRange;
+            for (size_t i = 0; i < expected.matches.size(); i++) {
+                if (expected.matches[i] >= first && expected.matches[i] < last) inRange.push_back(expected.matches[i]);
+            }
+            CHECK(gotRange[p] == inRange);
+            compared += expected.matches.size();
+            if (!expected.matches.empty() && expected.matches.back() + patterns[p].Length() == size) lastByte++;
+        }
+        delete[] data;
+    }
+    printf("multi-pattern: %zu matches compared with FindAllPatterns, %zu ending on the last byte\n", compared,
+           lastByte);
+}
+
+// Rejects candidates whose offset is `value` modulo `window`, counting calls
+static size_t g_verifierCalls = 0;
+
+static bool RejectResidue(const CandidateVerifier& self, const uint8_t*, size_t, size_t offset) {
+    g_verifierCalls++;
+    return offset % self.window != self.value;
+}
+
+static void CheckFindAll() {
+    TestRandom random(10);
+    size_t kept = 0, dropped = 0, truncated = 0;
+    for (int round = 0; round < 2000; round++) {
+        size_t size = 1 + random.Below(1500);
+        uint8_t* data = new uint8_t[size];
+        for (size_t i = 0; i < size; i++) data[i] = (uint8_t)(0x80 + random.Below(3));
+        Pattern pattern = RandomPattern(&random, 1 + random.Below(4), 0x80, 3);
+        PatternView view = pattern.View();
+
+        // Zero, one or two verifiers; each drops one residue class
+        CandidateVerifier verifiers[2];
+        size_t verifierCount = random.Below(3);
+        for (size_t v = 0; v < verifierCount; v++) {
+            size_t modulus = 2 + random.Below(5);
+            verifiers[v] = CandidateVerifier{ "residue", &RejectResidue, random.Below((uint32_t)modulus), modulus,
+                                              nullptr };
+        }
+        FindAllOptions options = DefaultFindAllOptions();
+        options.limit = (random.Below(4) == 0) ? 0 : random.Below(20);
+        options.verifiers = verifierCount ? verifiers : nullptr;
+        options.verifierCount = verifierCount;
+
+        // Reference: the hits in order, stopping at the first accepted one past the limit
+        std::vector<size_t> hits = AllReferenceMatches(data, size, view);
+        std::vector<size_t> accepted;
+        size_t candidates = 0, rejected = 0;
+        bool over = false;
+        for (size_t h = 0; h < hits.size(); h++) {
+            candidates++;
+            bool passes = true;
+            for (size_t v = 0; v < verifierCount; v++) {
+                if (hits[h] % verifiers[v].window == verifiers[v].value) passes = false;
+            }
+            if (!passes) {
+                rejected++;
+                continue;
+            }
+            if (options.limit != 0 && accepted.size() == options.limit) {
+                over = true;
+                break;
+            }
+            accepted.push_back(hits[h]);
+        }
+
+        FindAllResult result;
+        g_verifierCalls = 0;
+        FindAllPatterns(data, size, view, options, &result);
+        CHECK(result.matches == accepted);
+        CHECK(result.candidates == candidates && result.rejected == rejected && result.truncated == over);
+        CHECK(result.Uniqueness() == (over ? MATCH_AMBIGUOUS : ClassifyMatches(accepted.size())));
+        CHECK(options.limit == 0 || result.matches.size() <= options.limit);
+        if (verifierCount != 0) CHECK(g_verifierCalls >= candidates && g_verifierCalls <= candidates * verifierCount);
+
+        // The same verifiers in the one-pass scanner: rejected hits are
+        // dropped, the later ones still reported
+        MultiPatternScanner scanner;
+        scanner.Add(view, options.verifiers, verifierCount);
+        scanner.Add(view);
+        scanner.Build();
+        MultiScanMatches matches;
+        scanner.Scan(data, size, &matches);
+        FindAllResult all;
+        options.limit = 0;
+        FindAllPatterns(data, size, view, options, &all);
+        CHECK(matches[0] == all.matches && matches[1] == hits);
+
+        kept += all.matches.size();
+        dropped += all.rejected;
+        if (over) truncated++;
+        delete[] data;
+    }
+    CHECK(dropped > 0 && truncated > 0);
+    printf("find all: %zu matches kept, %zu dropped by a verifier, %zu scans cut at their limit\n", kept, dropped,
+           truncated);
+
+    // Built-in verifiers on a hand-made buffer: two look-alike prologues,
+    // only the second calls the target
+    uint8_t code[64] = {};
+    const uint8_t prologue[] = { 0x55, 0x8B, 0xEC };
+    memcpy(code + 4, prologue, 3);
+    memcpy(code + 24, prologue, 3);
+    code[30] = 0xE8;                                    // call rel32 to offset 60
+    int32_t rel = 60 - (30 + 5);
+    memcpy(code + 31, &rel, 4);
+    Pattern look(prologue, "xxx");
+    CandidateVerifier callsTarget = VerifyCallTo(60, 16);
+    FindAllOptions options = DefaultFindAllOptions();
+    options.verifiers = &callsTarget;
+    options.verifierCount = 1;
+    FindAllResult result;
+    FindAllPatterns(code, sizeof(code), look.View(), options, &result);
+    CHECK(result.matches == std::vector<size_t>({ 24 }) && result.candidates == 2 && result.rejected == 1);
+    CHECK(result.Uniqueness() == MATCH_UNIQUE);
+    options.limit = 1;
+    options.verifierCount = 0;
+    FindAllPatterns(code, sizeof(code), look.View(), options, &result);
+    CHECK(result.matches == std::vector<size_t>({ 4 }) && result.truncated && result.Uniqueness() == MATCH_AMBIGUOUS);
+}
+
+// Nearest match to the hint (clamped to the last start) within the radius,
+// the lower offset on a tie
+static size_t ReferenceNear(const uint8_t* data, size_t size, const PatternView& pattern, size_t hint,
+                            size_t radius) {
+    if (pattern.length == 0 || pattern.length > size) return NPOS;
+    if (hint > size - pattern.length) hint = size - pattern.length;
+    size_t best = NPOS, bestDistance = 0;
+    for (size_t at : AllReferenceMatches(data, size, pattern)) {
+        size_t distance = (at < hint) ? hint - at : at - hint;
+        if (distance <= radius && (best == NPOS || distance < bestDistance)) {
+            best = at;
+            bestDistance = distance;
+        }
+    }
+    return best;
+}
+
+static void Plant(uint8_t* data, size_t at, const PatternView& pattern) {
+    for (size_t j = 0; j < pattern.length; j++) {
+        if (pattern.mask[j] == MASK_EXACT) data[at + j] = pattern.value[j];
+    }
+}
+
+static void CheckNear() {
+    TestRandom random(4);
+    size_t found = 0;
+
+    // Random: few copies over buffers that take several windows, any hint and radius
+    for (int round = 0; round < 600; round++) {
+        size_t size = 1 + random.Below(random.Below(3) == 0 ? 70000 : 9000);
+        uint8_t* data = new uint8_t[size];
+        for (size_t i = 0; i < size; i++) data[i] = (uint8_t)(0x80 + random.Below(4));
+        Pattern pattern = RandomPattern(&random, 1 + random.Below(12), 0x10, 3);
+        PatternView view = pattern.View();
+        if (view.length <= size) {
+            for (uint32_t copies = random.Below(6); copies > 0; copies--) {
+                Plant(data, random.Below((uint32_t)(size - view.length + 1)), view);
+            }
+        }
+        static const size_t RADII[] = { 0, 1, 100, HINT_FIRST_WINDOW, HINT_FIRST_WINDOW + 1, 30000, (size_t)-1 };
+        for (int probe = 0; probe < 8; probe++) {
+            size_t hint = random.Below((uint32_t)size + 50);
+            size_t radius = (probe < 4) ? RADII[random.Below(sizeof(RADII) / sizeof(RADII[0]))]
+                                        : random.Below(2 * (uint32_t)size + 1);
+            size_t expected = ReferenceNear(data, size, view, hint, radius);
+            CHECK(FindPatternNear(data, size, view, hint, radius) == expected);
+            if (expected != NPOS) found++;
+        }
+        delete[] data;
+    }
+
+    // By hand: a copy before and one after the hint, at growing distances
+    const size_t size = 100000;
+    std::vector<uint8_t> data(size, 0x80);
+    const uint8_t bytes[] = { 0x11, 0x12, 0x13, 0x14 };
+    Pattern pattern(bytes, "xx?x");
+    PatternView view = pattern.View();
+    const size_t hint = 50000;
+    static const size_t DISTANCES[] = { 4, 100, HINT_FIRST_WINDOW - 1, HINT_FIRST_WINDOW, HINT_FIRST_WINDOW + 1,
+                                        3 * HINT_FIRST_WINDOW, 40000 };
+    for (size_t b = 0; b < sizeof(DISTANCES) / sizeof(DISTANCES[0]); b++) {
+        for (size_t a = 0; a < sizeof(DISTANCES) / sizeof(DISTANCES[0]); a++) {
+            std::fill(data.begin(), data.end(), 0x80);
+            size_t before = hint - DISTANCES[b], after = hint + DISTANCES[a];
+            Plant(data.data(), before, view);
+            Plant(data.data(), after, view);
+            // The nearer one; equidistant goes to the lower offset
+            size_t nearer = (DISTANCES[b] <= DISTANCES[a]) ? before : after;
+            CHECK(FindPatternNear(data.data(), size, view, hint, size) == nearer);
+            // A radius that reaches only the farther one's side misses it
+            size_t closer = (DISTANCES[b] < DISTANCES[a]) ? DISTANCES[b] : DISTANCES[a];
+            size_t farther = (DISTANCES[b] < DISTANCES[a]) ? DISTANCES[a] : DISTANCES[b];
+            CHECK(FindPatternNear(data.data(), size, view, hint, closer - 1) == NPOS);
+            CHECK(FindPatternNear(data.data(), size, view, hint, closer) == nearer);
+            if (closer != farther) {
+                data[nearer] = 0x80;
+                CHECK(FindPatternNear(data.data(), size, view, hint, farther - 1) == NPOS);
+                CHECK(FindPatternNear(data.data(), size, view, hint, farther) == (nearer == before ? after : before));
+            }
+        }
+    }
+
+    // On the hint itself, and nothing at all
+    std::fill(data.begin(), data.end(), 0x80);
+    Plant(data.data(), hint, view);
+    Plant(data.data(), hint + 5, view);
+    CHECK(FindPatternNear(data.data(), size, view, hint, 0) == hint);
+    CHECK(FindPatternNear(data.data(), size, view, hint + 6, 0) == NPOS);
+    CHECK(FindPatternNear(data.data(), size, view, hint + 6, 1) == hint + 5);
+    std::fill(data.begin(), data.end(), 0x80);
+    CHECK(FindPatternNear(data.data(), size, view, hint, size) == NPOS);
+
+    // Windows clamped at the ends: copies at offset 0 and at the last start,
+    // hints at both ends and past the end (clamped to the last start)
+    size_t lastStart = size - view.length;
+    Plant(data.data(), 0, view);
+    Plant(data.data(), lastStart, view);
+    CHECK(FindPatternNear(data.data(), size, view, 10, HINT_FIRST_WINDOW) == 0);
+    CHECK(FindPatternNear(data.data(), size, view, lastStart - 10, HINT_FIRST_WINDOW) == lastStart);
+    CHECK(FindPatternNear(data.data(), size, view, size + 1000, 0) == lastStart);
+    CHECK(FindPatternNear(data.data(), size, view, (size_t)-1, (size_t)-1) == lastStart);
+    CHECK(FindPatternNear(data.data(), size, view, lastStart / 2, (size_t)-1) == 0);     // A tie
+    CHECK(FindPatternNear(data.data(), size, view, lastStart / 2 + 1, (size_t)-1) == lastStart);
+    CHECK(FindPatternNear(data.data(), size, view, lastStart / 2, lastStart / 2 - 1) == NPOS);
+    CHECK(FindPatternNear(data.data(), 3, view, 0, 10) == NPOS);       // Shorter than the pattern
+    printf("near: %zu random hints matched the nearest copy\n", found);
+}
+
+// FindPatternParallel and ScanParallel / ScanRangeParallel with tiny chunks
+// and 1, 2, 3 and 8 threads give what FindPattern and the scanner give on
+// one thread. Copies of the patterns are planted across every chunk
+// boundary: starting on it, one byte before, and ending on it. Half of the
+// rounds use pattern bytes the background never has and plant only from
+// some boundary on, so the lowest match lies in a late chunk.
+static void CheckParallel() {
+    static const unsigned THREADS[] = { 1, 2, 3, 8 };
+    static const size_t CHUNKS[] = { 1, 2, 3, 5, 16, 33, 100 };
+    TestRandom random(3);
+    size_t compared = 0;
+    for (int round = 0; round < 300; round++) {
+        size_t size = 1 + random.Below(3000);
+        size_t chunkSize = CHUNKS[random.Below(sizeof(CHUNKS) / sizeof(CHUNKS[0]))];
+        bool disjoint = round % 2 == 1;
+        uint8_t* data = new uint8_t[size];
+        for (size_t i = 0; i < size; i++) data[i] = (uint8_t)(0x80 + random.Below(4));
+
+        MultiPatternScanner scanner;
+        std::vector<Pattern> patterns;
+        for (int p = 0; p < 4; p++) {
+            size_t length = 1 + random.Below(12);
+            patterns.push_back(disjoint ? RandomPattern(&random, length, 0x10, 3)
+                                        : RandomPattern(&random, length, 0x80, 4));
+            scanner.Add(patterns.back().View());
+        }
+        scanner.Build();
+
+        size_t plantFrom = disjoint ? random.Below((uint32_t)size) / chunkSize * chunkSize : 0;
+        for (size_t boundary = plantFrom; boundary < size; boundary += chunkSize) {
+            const Pattern& pattern = patterns[random.Below((uint32_t)patterns.size())];
+            size_t length = pattern.View().length;
+            size_t starts[3] = { boundary, boundary - 1, boundary - length };
+            size_t start = starts[random.Below(3)];
+            if (length > size || start < plantFrom || start > size - length) continue;
+            for (size_t j = 0; j < length; j++) {
+                if (pattern.View().mask[j] == MASK_EXACT) data[start + j] = pattern.View().value[j];
+            }
+        }
+
+        MultiScanMatches expected;
+        scanner.Scan(data, size, &expected);
+        size_t first = random.Below((uint32_t)size + 1), last = random.Below((uint32_t)size + 1);
+        if (first > last) std::swap(first, last);
+        MultiScanMatches expectedRange(scanner.Count());
+        scanner.ScanRange(data, size, first, last, &expectedRange);
+
+        for (size_t t = 0; t < sizeof(THREADS) / sizeof(THREADS[0]); t++) {
+            for (size_t p = 0; p < patterns.size(); p++) {
+                CHECK(FindPatternParallel(data, size, patterns[p].View(), THREADS[t], chunkSize) ==
+                      FindPattern(data, size, patterns[p].View()));
+                CHECK(expected[p] == AllReferenceMatches(data, size, patterns[p].View()));
+            }
+            MultiScanMatches got;
+            ScanParallel(scanner, data, size, &got, THREADS[t], chunkSize);
+            CHECK(got == expected);
+            ScanRangeParallel(scanner, data, size, first, last, &got, THREADS[t], chunkSize);
+            CHECK(got == expectedRange);
+        }
+        for (size_t p = 0; p < expected.size(); p++) compared += expected[p].size();
+        delete[] data;
+    }
+    printf("parallel: %zu matches compared at 1, 2, 3 and 8 threads\n", compared);
+}
+
+int main() {
+    CheckEngines();
+    CheckMultiPattern();
+    CheckFindAll();
+    CheckNear();
+    CheckParallel();
+    return TestResult("PatternScanTest");
+}
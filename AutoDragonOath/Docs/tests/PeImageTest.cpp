@@ -0,0 +1,262 @@
+// PeImageTest.cpp - PE header and section table parser, and the section-limited scans
+//
+// Builds PE32 and PE32+ images with TestPe.h, in both layouts, and checks
+// the header fields, the section table, SectionRange, RVA <-> offset in
+// both directions, and that CollectScanRegions / FindPatternInSections
+// only look where a signature of each kind can be. Then:
+//   - every truncation of the headers, each copied to a buffer of exactly
+//     that size, so that reading past it is an ASan error
+//   - random damage to the headers: Parse may refuse or accept, but every
+//     range it reports must lie inside the buffer
+//   - real PE files given on the command line (file layout)
+//
+// Usage: PeImageTest [PE file...]
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "../HookLib/SectionScan.h"
+#include "TestCheck.h"
+#include "TestPe.h"
+
+using namespace HookLib;
+
+static const uint32_t CODE = PE_SCN_CNT_CODE | PE_SCN_MEM_EXECUTE | PE_SCN_MEM_READ;
+static const uint32_t READ_ONLY = PE_SCN_CNT_INITIALIZED_DATA | PE_SCN_MEM_READ;
+static const uint32_t READ_WRITE = PE_SCN_CNT_INITIALIZED_DATA | PE_SCN_MEM_READ | PE_SCN_MEM_WRITE;
+static const uint32_t BSS = PE_SCN_CNT_UNINITIALIZED_DATA | PE_SCN_MEM_READ | PE_SCN_MEM_WRITE;
+
+static const uint8_t CODE_MARK[] = { 0x55, 0x8B, 0xEC, 0x83, 0xEC, 0x40, 0x53, 0x56, 0x57 };
+static const uint8_t DATA_MARK[] = { 'G', 'C', 'C', 'h', 'a', 't', 'H', 'a', 'n', 'd', 'l', 'e', 'r' };
+static const size_t CODE_MARK_AT = 0x700;
+static const size_t DATA_MARK_AT = 0x120;
+
+static std::vector<uint8_t> Filled(size_t size, TestRandom* random) {
+    std::vector<uint8_t> bytes(size);
+    for (size_t i = 0; i < size; i++) bytes[i] = (uint8_t)(0x10 + random->Below(0x40));   // No marks by chance
+    return bytes;
+}
+
+static TestPe MakeImage(bool wide, TestRandom* random) {
+    TestPe builder(wide);
+    std::vector<uint8_t> text = Filled(0x1800, random);
+    memcpy(&text[CODE_MARK_AT], CODE_MARK, sizeof(CODE_MARK));
+    std::vector<uint8_t> rdata = Filled(0x600, random);
+    memcpy(&rdata[DATA_MARK_AT], DATA_MARK, sizeof(DATA_MARK));
+
+    builder.AddSection(".text", CODE, text);
+    builder.AddSection(".rdata", READ_ONLY, rdata);
+    builder.AddSection(".data", READ_WRITE, Filled(0x300, random), 0x2000);   // Zero-filled tail
+    builder.AddSection(".bss", BSS, std::vector<uint8_t>(), 0x1000);
+    builder.entryPoint = builder.sections[0].virtualAddress + 0x10;
+    builder.SetDirectory(1, builder.sections[1].virtualAddress, 0x28);       // Imports
+    return builder;
+}
+
+static void CheckHeaders(const TestPe& builder, PeLayout layout) {
+    std::vector<uint8_t> image = builder.Build(layout);
+    PeImage pe;
+    CHECK(pe.Parse(image.data(), image.size(), layout));
+    CHECK(pe.IsValid() && pe.Layout() == layout);
+    CHECK(pe.Is64Bit() == builder.wide);
+    CHECK(pe.machine == (builder.wide ? 0x8664 : 0x14C));
+    CHECK(pe.imageBase == builder.imageBase);
+    CHECK(pe.timeDateStamp == builder.timeDateStamp);
+    CHECK(pe.entryPoint == builder.entryPoint);
+    CHECK(pe.baseOfCode == builder.sections[0].virtualAddress);
+    CHECK(pe.sizeOfImage == builder.SizeOfImage());
+    CHECK(pe.sizeOfHeaders == TEST_PE_HEADER_BYTES);
+
+    uint32_t rva = 0, bytes = 0;
+    CHECK(pe.Directory(1, &rva, &bytes) && rva == builder.sections[1].virtualAddress && bytes == 0x28);
+    CHECK(!pe.Directory(PE_DIRECTORY_BASERELOC, &rva, &bytes));
+    CHECK(!pe.Directory(PE_DIRECTORY_COUNT, &rva, &bytes));
+
+    CHECK(pe.SectionCount() == builder.sections.size());
+    CHECK(pe.FindSection(".data") == 2 && pe.FindSection(".reloc") == -1 && pe.FindSection(".dat") == -1);
+    for (size_t i = 0; i < pe.SectionCount() && i < builder.sections.size(); i++) {
+        const PeSection& section = pe.Section(i);
+        const TestSection& expected = builder.sections[i];
+        CHECK(section.HasName(expected.name.c_str()));
+        CHECK(section.virtualAddress == expected.virtualAddress);
+        CHECK(section.virtualSize == expected.virtualSize);
+        CHECK(section.characteristics == expected.characteristics);
+        CHECK(section.IsExecutable() == (i == 0));
+        CHECK(section.IsWritable() == (i >= 2));
+
+        // Every raw byte is where the RVA says, both ways
+        for (size_t j = 0; j < expected.bytes.size(); j++) {
+            size_t offset = pe.RvaToOffset(expected.virtualAddress + j);
+            CHECK(offset < image.size() && image[offset] == expected.bytes[j]);
+            CHECK(pe.OffsetToRva(offset) == expected.virtualAddress + j);
+            if (g_TestFailures != 0) return;
+        }
+
+        size_t begin = 0, end = 0;
+        bool present = pe.SectionRange(i, &begin, &end);
+        if (layout == PE_LAYOUT_MAPPED) {
+            CHECK(present && begin == expected.virtualAddress && end == begin + expected.virtualSize);
+        } else if (expected.bytes.empty()) {
+            CHECK(!present);   // .bss has nothing in the file
+        } else {
+            size_t loaded = expected.virtualSize < TestPe::AlignUp((uint32_t)expected.bytes.size(),
+                                                                   TEST_PE_FILE_ALIGNMENT)
+                                ? expected.virtualSize
+                                : TestPe::AlignUp((uint32_t)expected.bytes.size(), TEST_PE_FILE_ALIGNMENT);
+            CHECK(present && begin == pe.RvaToOffset(expected.virtualAddress) && end == begin + loaded);
+        }
+    }
+
+    // In the file, the .bss and the zero-filled tail of .data have no bytes
+    const TestSection& data = builder.sections[2];
+    const TestSection& bss = builder.sections[3];
+    if (layout == PE_LAYOUT_FILE) {
+        CHECK(pe.RvaToOffset(bss.virtualAddress) == (size_t)-1);
+        CHECK(pe.RvaToOffset(data.virtualAddress + 0x1000) == (size_t)-1);
+        CHECK(pe.OffsetToRva(image.size()) == (size_t)-1);
+    } else {
+        CHECK(pe.RvaToOffset(bss.virtualAddress) == bss.virtualAddress);
+    }
+    CHECK(pe.RvaToOffset(0x40) == 0x40 && pe.OffsetToRva(0x40) == 0x40);   // Headers map to themselves
+}
+
+static void CheckSectionScan(const TestPe& builder, PeLayout layout) {
+    std::vector<uint8_t> image = builder.Build(layout);
+    PeImage pe;
+    pe.Parse(image.data(), image.size(), layout);
+
+    std::vector<ScanRegion> regions;
+    CollectScanRegions(pe, SIGNATURE_CODE, &regions);
+    size_t begin = 0, end = 0;
+    pe.SectionRange(0, &begin, &end);
+    CHECK(regions.size() == 1 && regions[0].begin == begin && regions[0].end == end);
+
+    // .rdata and .data: adjacent in the file, so merged there
+    CollectScanRegions(pe, SIGNATURE_DATA, &regions);
+    CHECK(regions.size() == (layout == PE_LAYOUT_FILE ? 1u : 2u));
+    for (size_t r = 0; r < regions.size(); r++) {
+        CHECK(regions[r].begin < regions[r].end && regions[r].end <= image.size());
+        CHECK(r == 0 || regions[r - 1].end < regions[r].begin);
+    }
+
+    Pattern code(CODE_MARK, "xxxxx?xxx");
+    Pattern data(DATA_MARK, "xxxxxxxxxxxxx");
+    size_t codeAt = pe.RvaToOffset(builder.sections[0].virtualAddress + CODE_MARK_AT);
+    size_t dataAt = pe.RvaToOffset(builder.sections[1].virtualAddress + DATA_MARK_AT);
+    CHECK(FindPatternInSections(pe, code.View(), SIGNATURE_CODE) == codeAt);
+    CHECK(FindPatternInSections(pe, code.View(), SIGNATURE_DATA) == NPOS);
+    CHECK(FindPatternInSections(pe, data.View(), SIGNATURE_DATA) == dataAt);
+    CHECK(FindPatternInSections(pe, data.View(), SIGNATURE_CODE) == NPOS);
+    CHECK(FindPatternInSections(pe, code.View(), SIGNATURE_CODE, 4) == codeAt);
+
+    // Not a PE: the whole buffer, so nothing is lost
+    std::vector<uint8_t> raw = image;
+    raw[0] = 'X';
+    PeImage notPe;
+    CHECK(!notPe.Parse(raw.data(), raw.size(), layout));
+    CollectScanRegions(notPe, SIGNATURE_CODE, &regions);
+    CHECK(regions.size() == 1 && regions[0].begin == 0 && regions[0].end == raw.size());
+    CHECK(FindPatternInSections(notPe, data.View(), SIGNATURE_CODE) == dataAt);
+}
+
+// Parse, then touch every range it reports
+static void CheckReportedRanges(const uint8_t* data, size_t size, PeLayout layout) {
+    PeImage pe;
+    if (!pe.Parse(data, size, layout)) {
+        CHECK(!pe.IsValid());
+        return;
+    }
+    unsigned sum = 0;
+    for (size_t i = 0; i < pe.SectionCount(); i++) {
+        size_t begin, end;
+        if (!pe.SectionRange(i, &begin, &end)) continue;
+        CHECK(begin < end && end <= size);
+        if (end > size) continue;
+        sum += data[begin] + data[end - 1];
+        size_t rva = pe.OffsetToRva(begin);
+        CHECK(rva == (size_t)-1 || pe.RvaToOffset(rva) != (size_t)-1);
+    }
+    (void)sum;
+}
+
+static void CheckDamagedHeaders(const TestPe& builder, PeLayout layout, TestRandom* random) {
+    std::vector<uint8_t> image = builder.Build(layout);
+    size_t tableEnd = TEST_PE_NT_OFFSET + 24 + (builder.wide ? 240 : 224) + 40 * builder.sections.size();
+
+    for (size_t size = 0; size <= TEST_PE_HEADER_BYTES + 0x40; size++) {
+        uint8_t* copy = new uint8_t[size ? size : 1];
+        memcpy(copy, image.data(), size);
+        PeImage pe;
+        bool parsed = pe.Parse(copy, size, layout);
+        CHECK(parsed == (size >= tableEnd));
+        CheckReportedRanges(copy, size, layout);
+        delete[] copy;
+    }
+
+    for (int round = 0; round < 3000; round++) {
+        std::vector<uint8_t> damaged(image.begin(), image.end());
+        unsigned flips = 1 + random->Below(8);
+        for (unsigned f = 0; f < flips; f++) {
+            size_t at = TEST_PE_NT_OFFSET + random->Below((uint32_t)(tableEnd - TEST_PE_NT_OFFSET));
+            damaged[at] = (random->Below(4) == 0) ? 0xFF : (uint8_t)random->Next();
+        }
+        if (round % 5 == 0) TestPe::Put32(&damaged, 0x3C, random->Below((uint32_t)damaged.size() + 64));
+        size_t size = damaged.size() - ((round % 3 == 0) ? random->Below(0x200) : 0);
+        uint8_t* copy = new uint8_t[size];
+        memcpy(copy, damaged.data(), size);
+        CheckReportedRanges(copy, size, layout);
+        delete[] copy;
+    }
+}
+
+static void CheckRealFile(const char* path) {
+    std::vector<uint8_t> file = ReadTestFile(path);
+    PeImage pe;
+    CHECK(!file.empty() && pe.Parse(file.data(), file.size(), PE_LAYOUT_FILE));
+    if (!pe.IsValid()) {
+        fprintf(stderr, "%s: not a PE file\n", path);
+        return;
+    }
+
+    bool entryInCode = false;
+    size_t sampled = 0;
+    for (size_t i = 0; i < pe.SectionCount(); i++) {
+        const PeSection& section = pe.Section(i);
+        size_t begin, end;
+        if (!pe.SectionRange(i, &begin, &end)) continue;
+        CHECK(begin < end && end <= file.size());
+        CHECK(begin == section.rawOffset);
+        for (size_t offset = begin; offset < end; offset += 97, sampled++) {
+            size_t rva = pe.OffsetToRva(offset);
+            CHECK(rva == section.virtualAddress + (offset - begin));
+            CHECK(pe.RvaToOffset(rva) == offset);
+        }
+        if (pe.entryPoint - section.virtualAddress < (section.virtualSize ? section.virtualSize : section.rawSize)) {
+            entryInCode = section.IsExecutable();
+        }
+    }
+    CHECK(pe.entryPoint == 0 || entryInCode);   // A resource-only DLL has none
+
+    std::vector<ScanRegion> regions;
+    CollectScanRegions(pe, SIGNATURE_CODE, &regions);
+    CHECK(!regions.empty());
+    printf("%s: %s, %u sections, %u code region(s), %zu offsets mapped\n", path, pe.Is64Bit() ? "PE32+" : "PE32",
+           (unsigned)pe.SectionCount(), (unsigned)regions.size(), sampled);
+}
+
+int main(int argc, char** argv) {
+    TestRandom random(7);
+    for (int wide = 0; wide < 2; wide++) {
+        TestPe builder = MakeImage(wide != 0, &random);
+        for (int layout = PE_LAYOUT_MAPPED; layout <= PE_LAYOUT_FILE; layout++) {
+            CheckHeaders(builder, (PeLayout)layout);
+            CheckSectionScan(builder, (PeLayout)layout);
+            CheckDamagedHeaders(builder, (PeLayout)layout, &random);
+        }
+    }
+    for (int i = 1; i < argc; i++) {
+        CheckRealFile(argv[i]);
+    }
+    return TestResult("PeImageTest");
+}
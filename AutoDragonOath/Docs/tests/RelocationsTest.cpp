@@ -0,0 +1,348 @@
+// RelocationsTest.cpp - .reloc parsing and reloc-aware matching
+//
+// Builds images with a .reloc section (TestPe.h) in both layouts and
+// checks the slots RelocationTable reads: HIGHLOW and DIR64 entries,
+// padding, blocks out of page order, slots in .bss, and damaged blocks.
+// Then the matching side: a signature taken from an image at its preferred
+// base still matches the rebased image, only where the image has
+// relocations; and FindPatternRelocAware against a plain loop on random
+// images. Real PE files given on the command line are loaded too; every
+// slot must hold an address inside the image.
+//
+// Usage: RelocationsTest [PE file...]
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "../HookLib/Relocations.h"
+#include "TestCheck.h"
+#include "TestPe.h"
+
+using namespace HookLib;
+
+static const uint32_t CODE = PE_SCN_CNT_CODE | PE_SCN_MEM_EXECUTE | PE_SCN_MEM_READ;
+static const uint32_t READ_ONLY = PE_SCN_CNT_INITIALIZED_DATA | PE_SCN_MEM_READ;
+static const uint32_t BSS = PE_SCN_CNT_UNINITIALIZED_DATA | PE_SCN_MEM_READ | PE_SCN_MEM_WRITE;
+
+static Pattern ExactPattern(const uint8_t* bytes, size_t length) {
+    std::vector<uint8_t> mask(length, MASK_EXACT);
+    return Pattern(bytes, mask.data(), length);
+}
+
+struct RelocEntry {
+    uint32_t rva;
+    unsigned type;
+};
+
+// One block per page, in the order given; odd entry counts padded with ABSOLUTE
+static std::vector<uint8_t> RelocBlocks(const std::vector<std::vector<RelocEntry> >& pages) {
+    std::vector<uint8_t> bytes;
+    for (size_t p = 0; p < pages.size(); p++) {
+        const std::vector<RelocEntry>& entries = pages[p];
+        size_t count = entries.size() + (entries.size() & 1);
+        size_t at = bytes.size();
+        bytes.resize(at + 8 + 2 * count, 0);
+        uint32_t page = entries.empty() ? 0 : (entries[0].rva & ~0xFFFu);
+        TestPe::Put32(&bytes, at, page);
+        TestPe::Put32(&bytes, at + 4, (uint32_t)(8 + 2 * count));
+        for (size_t e = 0; e < entries.size(); e++) {
+            TestPe::Put16(&bytes, at + 8 + 2 * e, (uint16_t)((entries[e].type << 12) | (entries[e].rva & 0xFFF)));
+        }
+    }
+    return bytes;
+}
+
+// .text with an absolute operand at each `operands` RVA, .rdata, a .bss,
+// then .reloc listing `operands` plus one slot in .bss
+struct RelocImage {
+    TestPe builder;
+    std::vector<uint32_t> operands;
+    uint32_t bssSlot;
+
+    explicit RelocImage(bool wide) : builder(wide), bssSlot(0) {}
+};
+
+static RelocImage MakeImage(bool wide, TestRandom* random) {
+    RelocImage made(wide);
+    TestPe& builder = made.builder;
+    std::vector<uint8_t> text(0x2400, 0x90);
+    uint32_t textRva = builder.NextRva();
+    size_t slotBytes = wide ? 8 : 4;
+    for (uint32_t at = 0x10; at + 16 < text.size(); at += 0x40 + random->Below(0x100)) {
+        made.operands.push_back(textRva + at);
+        uint64_t target = builder.imageBase + textRva + random->Below(0x2000);
+        for (size_t k = 0; k < slotBytes; k++) text[at + k] = (uint8_t)(target >> (8 * k));
+    }
+    builder.AddSection(".text", CODE, text);
+    builder.AddSection(".rdata", READ_ONLY, std::vector<uint8_t>(0x200, 0x11));
+    made.bssSlot = builder.NextRva() + 0x20;
+    builder.AddSection(".bss", BSS, std::vector<uint8_t>(), 0x1000);
+
+    // Pages in reverse order: the loader does not care, neither may Load
+    std::vector<std::vector<RelocEntry> > pages;
+    for (size_t i = 0; i < made.operands.size(); i++) {
+        RelocEntry entry = { made.operands[i], wide ? PE_REL_BASED_DIR64 : PE_REL_BASED_HIGHLOW };
+        if (pages.empty() || (pages.back()[0].rva >> 12) != (entry.rva >> 12)) {
+            pages.push_back(std::vector<RelocEntry>());
+        }
+        pages.back().push_back(entry);
+    }
+    RelocEntry bss = { made.bssSlot, wide ? PE_REL_BASED_DIR64 : PE_REL_BASED_HIGHLOW };
+    pages.push_back(std::vector<RelocEntry>(1, bss));
+    std::reverse(pages.begin(), pages.end());
+
+    std::vector<uint8_t> blocks = RelocBlocks(pages);
+    uint32_t relocRva = builder.NextRva();
+    builder.AddSection(".reloc", READ_ONLY, blocks);
+    builder.SetDirectory(PE_DIRECTORY_BASERELOC, relocRva, (uint32_t)blocks.size());
+    return made;
+}
+
+static void CheckLoad(const RelocImage& made, PeLayout layout) {
+    std::vector<uint8_t> image = made.builder.Build(layout);
+    PeImage pe;
+    CHECK(pe.Parse(image.data(), image.size(), layout));
+    RelocationTable relocations;
+    CHECK(relocations.Load(pe));
+
+    // Expected: each operand's buffer offset (and the high DWORD for DIR64);
+    // the .bss slot has no bytes in a file
+    std::vector<size_t> expected;
+    for (size_t i = 0; i < made.operands.size(); i++) {
+        expected.push_back(pe.RvaToOffset(made.operands[i]));
+        if (made.builder.wide) expected.push_back(pe.RvaToOffset(made.operands[i]) + RELOC_SLOT_BYTES);
+    }
+    if (layout == PE_LAYOUT_MAPPED) {
+        expected.push_back(made.bssSlot);
+        if (made.builder.wide) expected.push_back(made.bssSlot + RELOC_SLOT_BYTES);
+    }
+    std::sort(expected.begin(), expected.end());
+
+    CHECK(relocations.Count() == expected.size());
+    for (size_t i = 0; i < relocations.Count() && i < expected.size(); i++) {
+        CHECK(relocations.Slot(i) == expected[i]);
+    }
+    for (size_t offset = 0; offset < image.size(); offset++) {
+        bool covered = false;
+        for (size_t i = 0; i < expected.size() && !covered; i++) {
+            covered = offset - expected[i] < RELOC_SLOT_BYTES;
+        }
+        CHECK(relocations.Covers(offset) == covered);
+        if (g_TestFailures != 0) return;
+    }
+}
+
+static void CheckDamaged(bool wide) {
+    TestPe builder(wide);
+    builder.AddSection(".text", CODE, std::vector<uint8_t>(0x1000, 0x90));
+    uint32_t text = builder.sections[0].virtualAddress;
+    std::vector<std::vector<RelocEntry> > pages(1);
+    RelocEntry first = { text + 0x10, PE_REL_BASED_HIGHLOW };
+    RelocEntry second = { text + 0x20, PE_REL_BASED_HIGHLOW };
+    pages[0].push_back(first);
+    pages[0].push_back(second);
+    std::vector<uint8_t> blocks = RelocBlocks(pages);
+
+    // No directory at all: /FIXED
+    PeImage pe;
+    RelocationTable relocations;
+    std::vector<uint8_t> image = builder.Build(PE_LAYOUT_MAPPED);
+    pe.Parse(image.data(), image.size(), PE_LAYOUT_MAPPED);
+    CHECK(!relocations.Load(pe) && relocations.Empty());
+
+    // A good block, then one whose size is too small: the first is kept
+    std::vector<uint8_t> damaged = blocks;
+    damaged.resize(blocks.size() + 8, 0);
+    TestPe::Put32(&damaged, blocks.size(), text);
+    TestPe::Put32(&damaged, blocks.size() + 4, 4);
+    TestPe withBad = builder;
+    uint32_t relocRva = withBad.NextRva();
+    withBad.AddSection(".reloc", READ_ONLY, damaged);
+    withBad.SetDirectory(PE_DIRECTORY_BASERELOC, relocRva, (uint32_t)damaged.size());
+    image = withBad.Build(PE_LAYOUT_FILE);
+    pe.Parse(image.data(), image.size(), PE_LAYOUT_FILE);
+    CHECK(!relocations.Load(pe) && relocations.Count() == 2);
+
+    // An entry type x86 images never use (HIGHADJ): reported, rest kept
+    std::vector<uint8_t> odd = blocks;
+    TestPe::Put16(&odd, 8, (uint16_t)((4 << 12) | 0x10));
+    TestPe withOdd = builder;
+    withOdd.AddSection(".reloc", READ_ONLY, odd);
+    withOdd.SetDirectory(PE_DIRECTORY_BASERELOC, relocRva, (uint32_t)odd.size());
+    image = withOdd.Build(PE_LAYOUT_FILE);
+    pe.Parse(image.data(), image.size(), PE_LAYOUT_FILE);
+    CHECK(!relocations.Load(pe) && relocations.Count() == 1);
+
+    // Directory larger than the section: refused, no reads past the buffer
+    TestPe tooLong = builder;
+    tooLong.AddSection(".reloc", READ_ONLY, blocks);
+    tooLong.SetDirectory(PE_DIRECTORY_BASERELOC, relocRva, 0x100000);
+    image = tooLong.Build(PE_LAYOUT_FILE);
+    pe.Parse(image.data(), image.size(), PE_LAYOUT_FILE);
+    CHECK(!relocations.Load(pe) && relocations.Empty());
+}
+
+// A signature copied from the image at 0x00400000 against the image rebased
+// to 0x10000000 (the loaded header holds the new base)
+static void CheckRebasedMatch() {
+    TestPe builder;
+    std::vector<uint8_t> text(0x1000, 0xCC);
+    uint32_t textRva = builder.NextRva();
+    // push ebp; mov ebp, esp; mov eax, [cookie]; push offset aFormat; call ...
+    const uint8_t function[] = { 0x55, 0x8B, 0xEC, 0xA1, 0x04, 0x29, 0x40, 0x00, 0x68, 0x30, 0x21, 0x40, 0x00,
+                                 0xE8, 0x10, 0x00, 0x00, 0x00 };
+    const size_t relocatedAt = 0x100, copyAt = 0x800;
+    memcpy(&text[relocatedAt], function, sizeof(function));
+    memcpy(&text[copyAt], function, sizeof(function));     // Same bytes, no relocations
+    builder.AddSection(".text", CODE, text);
+    builder.AddSection(".rdata", READ_ONLY, std::vector<uint8_t>(0x200, 0));
+
+    std::vector<std::vector<RelocEntry> > pages(1);
+    RelocEntry cookie = { textRva + (uint32_t)relocatedAt + 4, PE_REL_BASED_HIGHLOW };
+    RelocEntry format = { textRva + (uint32_t)relocatedAt + 9, PE_REL_BASED_HIGHLOW };
+    pages[0].push_back(cookie);
+    pages[0].push_back(format);
+    std::vector<uint8_t> blocks = RelocBlocks(pages);
+    uint32_t relocRva = builder.NextRva();
+    builder.AddSection(".reloc", READ_ONLY, blocks);
+    builder.SetDirectory(PE_DIRECTORY_BASERELOC, relocRva, (uint32_t)blocks.size());
+
+    builder.imageBase = 0x10000000;
+    std::vector<uint8_t> image = builder.Build(PE_LAYOUT_MAPPED);
+    const uint32_t delta = 0x10000000 - RELOC_DEFAULT_IMAGE_BASE;
+    for (size_t k = 0; k < 2; k++) {
+        size_t at = textRva + relocatedAt + (k == 0 ? 4 : 9);
+        TestPe::Put32(&image, at, ReadLe32(&image[at]) + delta);
+        at = textRva + copyAt + (k == 0 ? 4 : 9);
+        TestPe::Put32(&image, at, ReadLe32(&image[at]) + delta);
+    }
+
+    PeImage pe;
+    pe.Parse(image.data(), image.size(), PE_LAYOUT_MAPPED);
+    RelocationTable relocations;
+    CHECK(relocations.Load(pe) && relocations.Count() == 2);
+    Pattern signature = ExactPattern(function, sizeof(function));
+    CHECK(FindPattern(image.data(), image.size(), signature.View()) == NPOS);
+    CHECK(FindPatternRelocAware(image.data(), image.size(), signature.View(), relocations) ==
+          textRva + relocatedAt);
+
+    // Only address operands are wildcarded in the prefilter, not the call
+    Pattern prefilter = RelocPrefilter(signature.View(), relocations);
+    for (size_t j = 0; j < sizeof(function); j++) {
+        bool operand = (j >= 4 && j < 8) || (j >= 9 && j < 13);
+        CHECK((prefilter.View().mask[j] == MASK_WILDCARD) == operand);
+    }
+
+    // A different call target is not an address: no match
+    std::vector<uint8_t> otherCall = image;
+    otherCall[textRva + relocatedAt + 14] ^= 1;
+    CHECK(FindPatternRelocAware(otherCall.data(), otherCall.size(), signature.View(), relocations) == NPOS);
+
+    // Without a .reloc (/FIXED), the exact scanner's answer
+    RelocationTable none;
+    CHECK(FindPatternRelocAware(image.data(), image.size(), signature.View(), none) == NPOS);
+}
+
+// FindPatternRelocAware against "prefilter matches and RelocAwareMatchAt"
+// at every position
+static void CheckAgainstLoop(TestRandom* random) {
+    for (int round = 0; round < 300; round++) {
+        TestPe builder;
+        size_t textBytes = 0x400 + random->Below(0x800);
+        uint32_t textRva = builder.NextRva();
+        std::vector<uint8_t> text(textBytes);
+        for (size_t i = 0; i < text.size(); i++) {
+            text[i] = (uint8_t)(random->Below(4) == 0 ? 0x00 : 0x40 + random->Below(3));
+        }
+        std::vector<std::vector<RelocEntry> > pages(1);
+        for (uint32_t at = random->Below(16); at + 4 <= textBytes && at < 0x1000; at += 4 + random->Below(40)) {
+            RelocEntry entry = { textRva + at, PE_REL_BASED_HIGHLOW };
+            pages[0].push_back(entry);
+            TestPe::Put32(&text, at, 0x00400000 + textRva + random->Below(0x400));
+        }
+        builder.AddSection(".text", CODE, text);
+        std::vector<uint8_t> blocks = RelocBlocks(pages);
+        uint32_t relocRva = builder.NextRva();
+        builder.AddSection(".reloc", READ_ONLY, blocks);
+        builder.SetDirectory(PE_DIRECTORY_BASERELOC, relocRva, (uint32_t)blocks.size());
+        std::vector<uint8_t> image = builder.Build(PE_LAYOUT_MAPPED);
+
+        PeImage pe;
+        pe.Parse(image.data(), image.size(), PE_LAYOUT_MAPPED);
+        RelocationTable relocations;
+        relocations.Load(pe);
+
+        // A piece of the code, some operands changed as a rebase would
+        size_t length = 4 + random->Below(16);
+        size_t from = textRva + random->Below((uint32_t)(textBytes - length));
+        std::vector<uint8_t> bytes(image.begin() + from, image.begin() + from + length);
+        std::vector<uint8_t> probe = image;
+        for (size_t s = 0; s < relocations.Count(); s++) {
+            size_t slot = relocations.Slot(s);
+            if (random->Below(2)) TestPe::Put32(&probe, slot, ReadLe32(&probe[slot]) + 0x1000);
+        }
+        if (round % 4 == 0) bytes[random->Below((uint32_t)length)] ^= 0x40;
+        Pattern pattern = ExactPattern(bytes.data(), bytes.size());
+        Pattern prefilter = RelocPrefilter(pattern.View(), relocations);
+
+        size_t expected = NPOS;
+        for (size_t i = 0; i + length <= probe.size() && expected == NPOS; i++) {
+            if (MatchAt(&probe[i], prefilter.View()) &&
+                RelocAwareMatchAt(probe.data(), i, pattern.View(), relocations)) {
+                expected = i;
+            }
+        }
+        CHECK(FindPatternRelocAware(probe.data(), probe.size(), pattern.View(), relocations) == expected);
+    }
+}
+
+static void CheckRealFile(const char* path) {
+    std::vector<uint8_t> file = ReadTestFile(path);
+    PeImage pe;
+    if (file.empty() || !pe.Parse(file.data(), file.size(), PE_LAYOUT_FILE)) {
+        CHECK(!"readable PE file");
+        fprintf(stderr, "%s: not a PE file\n", path);
+        return;
+    }
+    RelocationTable relocations;
+    uint32_t rva, bytes;
+    bool hasDirectory = pe.Directory(PE_DIRECTORY_BASERELOC, &rva, &bytes);
+    CHECK(relocations.Load(pe) == hasDirectory);
+
+    // Ascending, inside the file, each holding an address in the image
+    size_t outside = 0;
+    for (size_t i = 0; i < relocations.Count(); i++) {
+        size_t slot = relocations.Slot(i);
+        CHECK(i == 0 || relocations.Slot(i - 1) < slot);
+        CHECK(slot + RELOC_SLOT_BYTES <= file.size());
+        if (pe.Is64Bit()) {
+            // DIR64 adds both halves; the low one starts the address
+            if (i + 1 < relocations.Count() && relocations.Slot(i + 1) == slot + RELOC_SLOT_BYTES) {
+                if (ReadLe64(&file[slot]) - pe.imageBase >= pe.sizeOfImage) outside++;
+                i++;
+            }
+        } else if (ReadLe32(&file[slot]) - (uint32_t)pe.imageBase >= pe.sizeOfImage) {
+            outside++;
+        }
+    }
+    CHECK(outside == 0);
+    printf("%s: %u relocated slots, %zu outside the image\n", path, (unsigned)relocations.Count(), outside);
+}
+
+int main(int argc, char** argv) {
+    TestRandom random(12);
+    for (int wide = 0; wide < 2; wide++) {
+        RelocImage made = MakeImage(wide != 0, &random);
+        CheckLoad(made, PE_LAYOUT_MAPPED);
+        CheckLoad(made, PE_LAYOUT_FILE);
+        CheckDamaged(wide != 0);
+    }
+    CheckRebasedMatch();
+    CheckAgainstLoop(&random);
+    for (int i = 1; i < argc; i++) {
+        CheckRealFile(argv[i]);
+    }
+    return TestResult("RelocationsTest");
+}
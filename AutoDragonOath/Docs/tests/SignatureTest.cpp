@@ -0,0 +1,174 @@
+// SignatureTest.cpp - IDA-style signature text: compile-time and runtime parsing
+//
+// Checks:
+//   - HOOKLIB_SIGNATURE gives, as constants, the bytes and mask the shared
+//     parser gives at run time (static_assert), and ParsePattern the same
+//     bytes, mask and anchors
+//   - accepted: "?" and "??", nibble wildcards, lower case, tabs, extra
+//     spaces, wildcards leading or trailing the signature
+//   - rejected by ParseSignatureText / ParsePattern: an odd nibble count
+//     (a lone digit anywhere), a bad hex digit, tokens of three or more
+//     characters, separators other than space and tab, empty and blank text
+//   - random signatures written out with random spacing parse back to the
+//     same bytes; the same text with one token broken is rejected
+//   - FindSignature<kSig> finds what FindPattern finds
+// The compile-time form must stop the build on malformed, empty and
+// all-wildcard text; run_tests.sh checks that with the switches below.
+//
+// COMPILE_FAIL: TEST_SIGNATURE_ODD_NIBBLES malformed signature text
+// COMPILE_FAIL: TEST_SIGNATURE_BAD_HEX malformed signature text
+// COMPILE_FAIL: TEST_SIGNATURE_EMPTY empty signature
+// COMPILE_FAIL: TEST_SIGNATURE_WILDCARDS_ONLY needs at least one exact byte
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "../HookLib/Signature.h"
+#include "TestCheck.h"
+
+using namespace HookLib;
+
+static constexpr auto kSig = HOOKLIB_SIGNATURE("?? 55 8b EC 8? ?C ? 00 A1 ??");
+
+#ifdef TEST_SIGNATURE_ODD_NIBBLES
+static constexpr auto kOddNibbles = HOOKLIB_SIGNATURE("55 8B E 81");
+#endif
+#ifdef TEST_SIGNATURE_BAD_HEX
+static constexpr auto kBadHex = HOOKLIB_SIGNATURE("55 8G EC");
+#endif
+#ifdef TEST_SIGNATURE_EMPTY
+static constexpr auto kEmpty = HOOKLIB_SIGNATURE("  ");
+#endif
+#ifdef TEST_SIGNATURE_WILDCARDS_ONLY
+static constexpr auto kWildcardsOnly = HOOKLIB_SIGNATURE("?? ? ??");
+#endif
+
+// The compiled signature holds what the shared parser writes at run time
+template <size_t N>
+constexpr bool SameAsParsed(const Signature<N>& signature, const char* text) {
+    uint8_t value[N] = {};
+    uint8_t mask[N] = {};
+    if (ParseSignatureText(text, value, mask, N) != N) return false;
+    for (size_t i = 0; i < N; i++) {
+        if (value[i] != signature.value[i] || mask[i] != signature.mask[i]) return false;
+    }
+    return true;
+}
+
+static_assert(kSig.length == 10 && SameAsParsed(kSig, "?? 55 8b EC 8? ?C ? 00 A1 ??"), "");
+static_assert(kSig.value[2] == 0x8B && kSig.mask[4] == 0xF0 && kSig.value[4] == 0x80 && kSig.value[5] == 0x0C &&
+              kSig.mask[5] == 0x0F && kSig.mask[0] == MASK_WILDCARD && kSig.mask[9] == MASK_WILDCARD, "");
+
+static bool Parses(const char* text, std::vector<uint8_t>* value = nullptr, std::vector<uint8_t>* mask = nullptr) {
+    Pattern pattern;
+    if (!ParsePattern(text, &pattern)) return false;
+    PatternView view = pattern.View();
+    if (value != nullptr) value->assign(view.value, view.value + view.length);
+    if (mask != nullptr) mask->assign(view.mask, view.mask + view.length);
+    return true;
+}
+
+static void CheckRuntimeMatchesCompiled() {
+    Pattern pattern;
+    CHECK(ParsePattern("?? 55 8b EC 8? ?C ? 00 A1 ??", &pattern));
+    PatternView view = pattern.View(), compiled = kSig.View();
+    CHECK(view.length == compiled.length);
+    for (size_t i = 0; i < view.length && i < compiled.length; i++) {
+        CHECK(view.value[i] == compiled.value[i] && view.mask[i] == compiled.mask[i]);
+    }
+    CHECK(view.anchor == compiled.anchor && view.anchor2 == compiled.anchor2);
+}
+
+static void CheckAcceptedAndRejected() {
+    std::vector<uint8_t> value, mask;
+    CHECK(Parses("?", &value, &mask) && mask.size() == 1 && mask[0] == MASK_WILDCARD);
+    CHECK(Parses("??  55", &value, &mask) && mask.size() == 2 && mask[0] == MASK_WILDCARD && value[1] == 0x55);
+    CHECK(Parses("55 ?", &value, &mask) && mask.size() == 2 && mask[1] == MASK_WILDCARD);
+    CHECK(Parses("\t a5\t?F  e? ", &value, &mask) && value.size() == 3);
+    CHECK(value == std::vector<uint8_t>({ 0xA5, 0x0F, 0xE0 }) && mask == std::vector<uint8_t>({ 0xFF, 0x0F, 0xF0 }));
+
+    static const char* MALFORMED[] = {
+        "",         "   ",        "\t",          "5",           "55 5",      "5 55",     "55 8B E",
+        "G5",       "5G",         "55 8B EG",    "55 x1",       "0x55",      "555",      "55 8BEC",
+        "???",      "?5?",        "55,8B",       "55\n8B",      "55 8B\r",   "-1",       "55 ?? ?5?",
+    };
+    for (size_t i = 0; i < sizeof(MALFORMED) / sizeof(MALFORMED[0]); i++) {
+        bool parsed = Parses(MALFORMED[i]);
+        if (parsed) fprintf(stderr, "accepted: \"%s\"\n", MALFORMED[i]);
+        CHECK(!parsed);
+    }
+    CHECK(ParseSignatureText("55 8", nullptr, nullptr, 0) == NPOS);
+    CHECK(ParseSignatureText("", nullptr, nullptr, 0) == 0);
+}
+
+// Random signatures as text, back through the parser; then one token broken
+static void CheckRandomText(TestRandom* random) {
+    static const char HEX[] = "0123456789ABCDEFabcdef";
+    static const char* BROKEN[] = { "5", "G", "123", "?G", "1?2", "x", "??5", "5,", "0x" };
+    size_t parsed = 0;
+    for (int round = 0; round < 3000; round++) {
+        size_t length = 1 + random->Below(40);
+        std::vector<std::string> tokens(length);
+        std::vector<uint8_t> value(length, 0), mask(length, 0);
+        for (size_t j = 0; j < length; j++) {
+            for (int nibble = 0; nibble < 2; nibble++) {
+                int shift = nibble == 0 ? 4 : 0;
+                if (random->Below(5) == 0) {
+                    tokens[j] += '?';
+                } else {
+                    char c = HEX[random->Below(sizeof(HEX) - 1)];
+                    tokens[j] += c;
+                    value[j] |= (uint8_t)(SignatureHexDigit(c) << shift);
+                    mask[j] |= (uint8_t)(0xF << shift);
+                }
+            }
+            if (tokens[j] == "??" && random->Below(2) == 0) tokens[j] = "?";
+        }
+        std::string text = (random->Below(3) == 0) ? " " : "";
+        for (size_t j = 0; j < length; j++) {
+            text += tokens[j];
+            if (j + 1 < length) text += (random->Below(4) == 0) ? "\t " : " ";
+        }
+        if (random->Below(3) == 0) text += "  ";
+
+        std::vector<uint8_t> gotValue, gotMask;
+        CHECK(Parses(text.c_str(), &gotValue, &gotMask) && gotValue == value && gotMask == mask);
+        CHECK(ParseSignatureText(text.c_str(), nullptr, nullptr, 0) == length);
+
+        tokens[random->Below((uint32_t)length)] = BROKEN[random->Below(sizeof(BROKEN) / sizeof(BROKEN[0]))];
+        std::string broken;
+        for (size_t j = 0; j < length; j++) broken += tokens[j] + (j + 1 < length ? " " : "");
+        CHECK(!Parses(broken.c_str()));
+        parsed++;
+    }
+    printf("%zu random signatures parsed back, and rejected with one token broken\n", parsed);
+}
+
+static void CheckCompiledMatcher(TestRandom* random) {
+    size_t found = 0;
+    for (int round = 0; round < 500; round++) {
+        size_t size = random->Below(3000);
+        std::vector<uint8_t> data(size);
+        for (size_t i = 0; i < size; i++) data[i] = (uint8_t)random->Below(256);
+        for (uint32_t plant = random->Below(4); plant > 0 && size >= kSig.length; plant--) {
+            size_t at = random->Below((uint32_t)(size - kSig.length + 1));
+            for (size_t j = 0; j < kSig.length; j++) {
+                data[at + j] = (uint8_t)(kSig.value[j] | (data[at + j] & ~kSig.mask[j]));
+            }
+        }
+        size_t expected = FindPattern(data.data(), size, kSig.View());
+        CHECK(FindSignature<kSig>(data.data(), size) == expected);
+        if (expected != NPOS) found++;
+    }
+    printf("compiled matcher: %zu of 500 buffers with a match, as FindPattern\n", found);
+}
+
+int main() {
+    TestRandom random(6);
+    CheckRuntimeMatchesCompiled();
+    CheckAcceptedAndRejected();
+    CheckRandomText(&random);
+    CheckCompiledMatcher(&random);
+    return TestResult("SignatureTest");
+}
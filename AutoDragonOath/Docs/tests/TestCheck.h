@@ -0,0 +1,46 @@
+// TestCheck.h - Check macro and seeded random numbers for the HookLib tests
+//
+// A failed CHECK prints where and what and is counted; the test carries on
+// and TestResult turns the count into the exit status.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+static int g_TestFailures = 0;
+
+#define CHECK(condition)                                                                 \
+    do {                                                                                 \
+        if (!(condition)) {                                                              \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            g_TestFailures++;                                                            \
+        }                                                                                \
+    } while (0)
+
+// splitmix64: the same sequence on every platform and compiler
+struct TestRandom {
+    uint64_t state;
+
+    explicit TestRandom(uint64_t seed) : state(seed) {}
+
+    uint64_t Next() {
+        uint64_t x = (state += 0x9E3779B97F4A7C15ull);
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    // 0 .. bound - 1
+    uint32_t Below(uint32_t bound) { return (uint32_t)(Next() % bound); }
+};
+
+// Prints "<name>: ok" or "<name>: N check(s) failed"; the exit status
+inline int TestResult(const char* name) {
+    if (g_TestFailures == 0) {
+        printf("%s: ok\n", name);
+        return 0;
+    }
+    printf("%s: %d check(s) failed\n", name, g_TestFailures);
+    return 1;
+}
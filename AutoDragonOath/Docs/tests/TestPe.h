@@ -0,0 +1,168 @@
+// TestPe.h - Builds small PE32 / PE32+ images for the HookLib tests
+//
+// The same sections come out in either layout: mapped (each section at its
+// RVA, SizeOfImage bytes) or file (raw data at FileAlignment offsets after
+// the headers), so a test can check that both give the same answers.
+// Section RVAs are placed in order, one SectionAlignment apart.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "../HookLib/PeImage.h"
+
+static const uint32_t TEST_PE_SECTION_ALIGNMENT = 0x1000;
+static const uint32_t TEST_PE_FILE_ALIGNMENT = 0x200;
+static const uint32_t TEST_PE_HEADER_BYTES = 0x400;
+static const uint32_t TEST_PE_NT_OFFSET = 0x80;
+
+struct TestSection {
+    std::string name;
+    uint32_t characteristics;
+    uint32_t virtualAddress;        // Set by TestPe::AddSection
+    uint32_t virtualSize;           // Loaded size; may exceed bytes (.bss tail)
+    std::vector<uint8_t> bytes;     // Raw data
+};
+
+class TestPe {
+public:
+    explicit TestPe(bool is64Bit = false)
+        : wide(is64Bit), timeDateStamp(0x5F3A1B2C), imageBase(is64Bit ? 0x140000000ull : 0x00400000), entryPoint(0) {
+        memset(directoryRva, 0, sizeof(directoryRva));
+        memset(directorySize, 0, sizeof(directorySize));
+    }
+
+    // Returns the index; the section's RVA is sections[index].virtualAddress
+    size_t AddSection(const char* name, uint32_t characteristics, const std::vector<uint8_t>& bytes,
+                      uint32_t virtualSize = 0) {
+        TestSection section;
+        section.name = name;
+        section.characteristics = characteristics;
+        section.virtualAddress = NextRva();
+        section.virtualSize = virtualSize ? virtualSize : (uint32_t)bytes.size();
+        section.bytes = bytes;
+        sections.push_back(section);
+        return sections.size() - 1;
+    }
+
+    // RVA the next AddSection will get
+    uint32_t NextRva() const {
+        if (sections.empty()) return TEST_PE_SECTION_ALIGNMENT;
+        const TestSection& last = sections.back();
+        return last.virtualAddress + AlignUp(last.virtualSize ? last.virtualSize : 1, TEST_PE_SECTION_ALIGNMENT);
+    }
+
+    void SetDirectory(size_t index, uint32_t rva, uint32_t bytes) {
+        directoryRva[index] = rva;
+        directorySize[index] = bytes;
+    }
+
+    uint32_t SizeOfImage() const { return NextRva(); }
+
+    std::vector<uint8_t> Build(HookLib::PeLayout layout) const {
+        std::vector<uint8_t> image(TEST_PE_HEADER_BYTES, 0);
+        std::vector<uint32_t> rawOffsets;
+        uint32_t rawAt = TEST_PE_HEADER_BYTES;
+        for (size_t i = 0; i < sections.size(); i++) {
+            rawOffsets.push_back(sections[i].bytes.empty() ? 0 : rawAt);
+            rawAt += AlignUp((uint32_t)sections[i].bytes.size(), TEST_PE_FILE_ALIGNMENT);
+        }
+        image.resize(layout == HookLib::PE_LAYOUT_MAPPED ? SizeOfImage() : rawAt, 0);
+
+        uint32_t codeBytes = 0, codeBase = 0;
+        for (size_t i = 0; i < sections.size(); i++) {
+            if (sections[i].characteristics & HookLib::PE_SCN_CNT_CODE) {
+                if (codeBytes == 0) codeBase = sections[i].virtualAddress;
+                codeBytes += AlignUp((uint32_t)sections[i].bytes.size(), TEST_PE_FILE_ALIGNMENT);
+            }
+        }
+
+        image[0] = 'M';
+        image[1] = 'Z';
+        Put32(&image, 0x3C, TEST_PE_NT_OFFSET);
+        memcpy(&image[TEST_PE_NT_OFFSET], "PE\0\0", 4);
+
+        uint32_t optionalBytes = wide ? 240 : 224;
+        size_t fileHeader = TEST_PE_NT_OFFSET + 4;
+        Put16(&image, fileHeader + 0, wide ? 0x8664 : 0x14C);
+        Put16(&image, fileHeader + 2, (uint16_t)sections.size());
+        Put32(&image, fileHeader + 4, timeDateStamp);
+        Put16(&image, fileHeader + 16, (uint16_t)optionalBytes);
+        Put16(&image, fileHeader + 18, wide ? 0x0022 : 0x0102);
+
+        size_t optional = fileHeader + 20;
+        Put16(&image, optional + 0, wide ? HookLib::PE_MAGIC_PE32PLUS : HookLib::PE_MAGIC_PE32);
+        Put32(&image, optional + 4, codeBytes);
+        Put32(&image, optional + 16, entryPoint);
+        Put32(&image, optional + 20, codeBase);
+        if (wide) {
+            Put32(&image, optional + 24, (uint32_t)imageBase);
+            Put32(&image, optional + 28, (uint32_t)(imageBase >> 32));
+        } else {
+            Put32(&image, optional + 28, (uint32_t)imageBase);
+        }
+        Put32(&image, optional + 32, TEST_PE_SECTION_ALIGNMENT);
+        Put32(&image, optional + 36, TEST_PE_FILE_ALIGNMENT);
+        Put32(&image, optional + 56, SizeOfImage());
+        Put32(&image, optional + 60, TEST_PE_HEADER_BYTES);
+        size_t directories = optional + (wide ? 112 : 96);
+        Put32(&image, directories - 4, (uint32_t)HookLib::PE_DIRECTORY_COUNT);
+        for (size_t i = 0; i < HookLib::PE_DIRECTORY_COUNT; i++) {
+            Put32(&image, directories + i * 8, directoryRva[i]);
+            Put32(&image, directories + i * 8 + 4, directorySize[i]);
+        }
+
+        size_t table = optional + optionalBytes;
+        for (size_t i = 0; i < sections.size(); i++) {
+            const TestSection& section = sections[i];
+            size_t header = table + i * 40;
+            memcpy(&image[header], section.name.data(), section.name.size() < 8 ? section.name.size() : 8);
+            Put32(&image, header + 8, section.virtualSize);
+            Put32(&image, header + 12, section.virtualAddress);
+            Put32(&image, header + 16, AlignUp((uint32_t)section.bytes.size(), TEST_PE_FILE_ALIGNMENT));
+            Put32(&image, header + 20, rawOffsets[i]);
+            Put32(&image, header + 36, section.characteristics);
+
+            size_t at = (layout == HookLib::PE_LAYOUT_MAPPED) ? section.virtualAddress : rawOffsets[i];
+            if (!section.bytes.empty()) memcpy(&image[at], section.bytes.data(), section.bytes.size());
+        }
+        return image;
+    }
+
+    static uint32_t AlignUp(uint32_t value, uint32_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    static void Put16(std::vector<uint8_t>* image, size_t at, uint16_t value) {
+        (*image)[at] = (uint8_t)value;
+        (*image)[at + 1] = (uint8_t)(value >> 8);
+    }
+
+    static void Put32(std::vector<uint8_t>* image, size_t at, uint32_t value) {
+        for (int k = 0; k < 4; k++) (*image)[at + k] = (uint8_t)(value >> (8 * k));
+    }
+
+    bool wide;
+    uint32_t timeDateStamp;
+    uint64_t imageBase;
+    uint32_t entryPoint;
+    std::vector<TestSection> sections;
+    uint32_t directoryRva[HookLib::PE_DIRECTORY_COUNT];
+    uint32_t directorySize[HookLib::PE_DIRECTORY_COUNT];
+};
+
+// Whole file into memory; empty if it cannot be read
+inline std::vector<uint8_t> ReadTestFile(const char* path) {
+    std::vector<uint8_t> bytes;
+    FILE* file = fopen(path, "rb");
+    if (!file) return bytes;
+    uint8_t buffer[65536];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0) bytes.insert(bytes.end(), buffer, buffer + got);
+    fclose(file);
+    return bytes;
+}
@@ -0,0 +1,245 @@
+// TimerWheelTest.cpp - Timer wheel on an injected clock, the driver thread, and the game tick
+//
+// Without Start, nothing runs until Advance(now), so most checks drive the
+// wheel from a counter:
+//   - random delays from 0 to 2^32 ms, some cancelled, advanced in random
+//     jumps: every timer that was not cancelled runs exactly once, with
+//     Now() equal to its due time
+//   - periodic timers (a late one runs once and keeps its phase), actions
+//     that cancel and schedule, all timers in use, stale ids
+// Then with the driver thread on the steady clock: how late actions run,
+// and that Stop returns at once. Last, the party-invite reply of
+// Example_CustomFunctionCall.cpp: a 500 ms timer posts a game call to a
+// GameThreadQueue, and a game thread that only has GameTick.h's window
+// tick (no chat at all) runs it on time.
+
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../HookLib/ChatWorker.h"
+#include "../HookLib/TimerWheel.h"
+#include "TestCheck.h"
+
+using namespace HookLib;
+
+// GAME_TICK_MS of GameTick.h, which needs <windows.h>: the game thread
+// runs the queue at least this often
+static const unsigned GAME_TICK_MS = 10;
+
+static uint64_t g_now = 1000;
+static uint64_t ManualClock() { return g_now; }
+
+static TimerWheel* g_wheel = nullptr;
+
+struct Fired {
+    uint64_t expected;
+    uint64_t at;
+    int count;
+    bool cancelled;
+};
+static std::vector<Fired> g_fired;
+
+static void CheckRandomDelays(TestRandom* random) {
+    TimerWheel wheel(4096, ManualClock);
+    g_wheel = &wheel;
+    g_fired.assign(8000, Fired());
+    size_t scheduled = 0;
+    for (int round = 0; round < 400 && scheduled < g_fired.size(); round++) {
+        for (int k = 0; k < 20 && scheduled < g_fired.size(); k++, scheduled++) {
+            uint32_t delay;
+            switch (random->Below(4)) {
+                case 0: delay = random->Below(300); break;          // Level 0
+                case 1: delay = random->Below(70000); break;        // Levels 1-2
+                case 2: delay = random->Below(20000000); break;
+                default: delay = (uint32_t)random->Next(); break;   // Up to level 3
+            }
+            size_t me = scheduled;
+            g_fired[me].expected = g_now + (delay ? delay : 1);
+            TimerId id = wheel.Schedule(delay, [me]() {
+                g_fired[me].count++;
+                g_fired[me].at = g_wheel->Now();
+            });
+            CHECK(id != 0);
+            if (random->Below(10) == 0) {
+                g_fired[me].cancelled = wheel.Cancel(id);
+                CHECK(g_fired[me].cancelled);
+                CHECK(!wheel.Cancel(id));
+            }
+        }
+        g_now += (random->Below(5) == 0) ? random->Below(100000000) : random->Below(2000);
+        wheel.Advance(g_now);
+    }
+    g_now += 5000000000ull;
+    wheel.Advance(g_now);
+    wheel.Advance(g_now);       // The ones parked past level 3's reach
+
+    size_t ran = 0;
+    for (size_t i = 0; i < scheduled; i++) {
+        const Fired& fired = g_fired[i];
+        if (fired.cancelled) {
+            CHECK(fired.count == 0);
+            continue;
+        }
+        CHECK(fired.count == 1 && fired.at == fired.expected);
+        ran++;
+    }
+    CHECK(wheel.Pending() == 0 && wheel.NextDue() == UINT64_MAX);
+    printf("%zu timers ran on time, %zu cancelled\n", ran, scheduled - ran);
+}
+
+static int g_periodic = 0;
+static int g_chain = 0;
+static TimerId g_self = 0;
+
+static void CheckPeriodicAndReentry() {
+    g_now = 5000;
+    TimerWheel wheel(16, ManualClock);
+    g_wheel = &wheel;
+
+    TimerId periodic = wheel.Schedule(10, []() { g_periodic++; }, 10);
+    for (int i = 0; i < 100; i++) wheel.Advance(++g_now);
+    CHECK(g_periodic == 10);
+    g_now += 1000;                  // The wheel missed 100 periods: one run
+    wheel.Advance(g_now);
+    CHECK(g_periodic == 11);
+    for (int i = 0; i < 10; i++) wheel.Advance(++g_now);
+    CHECK(g_periodic == 12);        // Same phase as before
+    CHECK(wheel.Cancel(periodic) && !wheel.Cancel(periodic));
+    g_now += 100;
+    wheel.Advance(g_now);
+    CHECK(g_periodic == 12);
+
+    // An action that cancels itself and schedules a follow-up
+    g_self = wheel.Schedule(5, []() {
+        g_chain++;
+        g_wheel->Cancel(g_self);
+        g_wheel->Schedule(1, []() { g_chain += 100; });
+    }, 5);
+    for (int i = 0; i < 50; i++) wheel.Advance(++g_now);
+    CHECK(g_chain == 101 && wheel.Pending() == 0);
+
+    // All timers in use; ids of freed timers stay dead
+    std::vector<TimerId> ids;
+    for (int i = 0; i < 16; i++) ids.push_back(wheel.Schedule(1000, []() {}));
+    CHECK(wheel.Schedule(1000, []() {}) == 0 && wheel.Dropped() == 1);
+    CHECK(wheel.Cancel(ids[3]));
+    TimerId reused = wheel.Schedule(1000, []() {});
+    CHECK(reused != 0 && (uint32_t)reused == (uint32_t)ids[3] && reused != ids[3]);
+    CHECK(!wheel.Cancel(ids[3]));
+    CHECK(!wheel.Cancel(0) && !wheel.Cancel(17));
+    CHECK(wheel.NextDue() == (g_now & ~(uint64_t)(TIMER_LEVEL_SLOTS - 1)) + TIMER_LEVEL_SLOTS);
+    g_now += 1000;
+    CHECK(wheel.Advance(g_now) == 16 && wheel.Pending() == 0);
+}
+
+static uint64_t SteadyMs() { return TimerSteadyMilliseconds(); }
+
+static std::atomic<uint64_t> g_ranAt[20];
+
+static void CheckDriver() {
+    TimerWheel wheel;
+    wheel.Start();
+    uint64_t start = SteadyMs();
+    for (size_t i = 0; i < 20; i++) {
+        g_ranAt[i] = 0;
+        wheel.Schedule((uint32_t)(10 * (i + 1)), [i]() { g_ranAt[i] = SteadyMs(); });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    uint64_t latest = 0;
+    for (size_t i = 0; i < 20; i++) {
+        uint64_t due = start + 10 * (i + 1);
+        CHECK(g_ranAt[i] >= due);
+        if (g_ranAt[i] >= due && g_ranAt[i] - due > latest) latest = g_ranAt[i] - due;
+    }
+    CHECK(latest <= 20);            // 1 ms normally; sanitizers and a busy machine
+    printf("driver: actions at most %llu ms late\n", (unsigned long long)latest);
+
+    // Far timers only: the driver sleeps, and Stop does not wait for them
+    wheel.Schedule(60000, []() {});
+    uint64_t stopping = SteadyMs();
+    wheel.Stop();
+    CHECK(SteadyMs() - stopping < 100);
+    CHECK(wheel.Pending() == 1);
+}
+
+// The reply of Example_CustomFunctionCall.cpp: the handler accepts the
+// invite, then a timer posts the thank-you 500 ms later. The game thread
+// runs the queue from its tick only; no chat packet arrives.
+static const uint32_t REPLY_DELAY_MS = 500;
+
+static void CheckReplyOnManualTick() {
+    g_now = 100003;                 // Not on a tick
+    TimerWheel wheel(16, ManualClock);
+    GameThreadQueue gameCalls;
+    static uint64_t sentAt;
+    static GameThreadQueue* queue;
+    sentAt = 0;
+    queue = &gameCalls;
+    uint64_t invitedAt = g_now;
+    wheel.Schedule(REPLY_DELAY_MS, []() { queue->Post([]() { sentAt = g_now; }); });
+
+    // Driver and game thread in one loop, a millisecond at a time
+    for (uint64_t end = g_now + 2 * REPLY_DELAY_MS; g_now < end; g_now++) {
+        wheel.Advance(g_now);
+        if (g_now % GAME_TICK_MS == 0) gameCalls.RunPending();
+    }
+    CHECK(sentAt >= invitedAt + REPLY_DELAY_MS && sentAt <= invitedAt + REPLY_DELAY_MS + GAME_TICK_MS);
+    printf("reply (manual clock): %llu ms after the invite\n", (unsigned long long)(sentAt - invitedAt));
+}
+
+static void CheckReplyOnGameThread() {
+    TimerWheel wheel;
+    GameThreadQueue gameCalls;
+    static std::atomic<uint64_t> sentAt;
+    static std::atomic<bool> onGameThread;
+    static GameThreadQueue* queue;
+    static std::thread::id gameThreadId;
+    sentAt = 0;
+    onGameThread = false;
+    queue = &gameCalls;
+
+    // The game's main thread with GameTick installed: WM_TIMER every
+    // GAME_TICK_MS runs the queue
+    std::atomic<bool> quit(false);
+    std::thread game([&]() {
+        while (!quit) {
+            gameCalls.RunPending();
+            std::this_thread::sleep_for(std::chrono::milliseconds(GAME_TICK_MS));
+        }
+    });
+    gameThreadId = game.get_id();
+    wheel.Start();
+
+    uint64_t invitedAt = SteadyMs();
+    wheel.Schedule(REPLY_DELAY_MS, []() {
+        queue->Post([]() {
+            sentAt = SteadyMs();
+            onGameThread = std::this_thread::get_id() == gameThreadId;
+        });
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(REPLY_DELAY_MS + 200));
+    quit = true;
+    game.join();
+    wheel.Stop();
+
+    uint64_t late = sentAt - invitedAt - REPLY_DELAY_MS;
+    CHECK(sentAt != 0 && onGameThread);
+    CHECK(sentAt >= invitedAt + REPLY_DELAY_MS);
+    CHECK(late <= GAME_TICK_MS + 30);   // A tick, the sleep's rounding, the sanitizers
+    printf("reply (game thread): %llu ms after the invite, %llu ms late\n",
+           (unsigned long long)(sentAt - invitedAt), (unsigned long long)late);
+}
+
+int main() {
+    TestRandom random(23);
+    CheckRandomDelays(&random);
+    CheckPeriodicAndReentry();
+    CheckDriver();
+    CheckReplyOnManualTick();
+    CheckReplyOnGameThread();
+    return TestResult("TimerWheelTest");
+}
@@ -0,0 +1,324 @@
+// XrefIndexTest.cpp - Xref tables and function starts against a brute-force search
+//
+// Builds PE32 and PE32+ images whose .text is over two XREF_CHUNK_BYTES of
+// generated functions, so chunks start mid-instruction and must fall back
+// in step. The generator knows where every instruction starts. Checks, in
+// both layouts and on 1 and 4 threads:
+//   - every byte is tried as call / jmp rel32, push imm32 (PE32) and
+//     lea rcx, [rip + disp32] (PE32+); the ones at an instruction start must
+//     be exactly the index's tables, by source and by target. Bytes inside
+//     immediates that look like references must not be in them.
+//   - function starts: after CC padding, call targets, pointers in a
+//     .rdata vtable and the entry point, and no others
+//   - Callers and FunctionsReferencing against the same brute force
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "../HookLib/XrefIndex.h"
+#include "TestCheck.h"
+#include "TestPe.h"
+
+using namespace HookLib;
+
+static const uint32_t CODE = PE_SCN_CNT_CODE | PE_SCN_MEM_EXECUTE | PE_SCN_MEM_READ;
+static const uint32_t READ_ONLY = PE_SCN_CNT_INITIALIZED_DATA | PE_SCN_MEM_READ;
+
+static const size_t FUNCTION_COUNT = 44000;         // About 2.4 MB of code
+static const size_t STRING_COUNT = 64;
+static const size_t STRING_BYTES = 16;
+
+enum StartKind {
+    START_PADDED = 0,   // Aligned, after CC padding
+    START_CALLED,       // Right after the previous function; some call targets it
+    START_VTABLE,       // Right after the previous function; a .rdata pointer to it
+    START_NONE          // Right after the previous function; part of it
+};
+
+struct Generated {
+    TestPe builder;
+    std::vector<uint32_t> instructionRvas;      // Ascending
+    std::vector<uint32_t> startRvas;            // The starts the index must find, ascending
+    size_t codeIndex;
+    size_t rdataIndex;
+
+    explicit Generated(bool wide) : builder(wide), codeIndex(0), rdataIndex(0) {}
+};
+
+static void Put32(std::vector<uint8_t>* bytes, uint32_t value) {
+    for (int k = 0; k < 4; k++) bytes->push_back((uint8_t)(value >> (8 * k)));
+}
+
+// A reference to patch once .rdata has its RVA
+struct Fixup {
+    size_t at;          // The rel32 / disp32 / imm32, as a .text offset
+    size_t next;        // End of the (real or decoy) instruction
+    size_t function;    // Target function, or
+    size_t string;      // target string (SIZE_MAX: a function)
+    bool absolute;      // imm32 address instead of a displacement
+    bool call;          // A real call: its target is a start
+};
+
+static Generated Generate(bool wide, TestRandom* random) {
+    Generated out(wide);
+    std::vector<StartKind> kinds(FUNCTION_COUNT);
+    for (size_t f = 0; f < FUNCTION_COUNT; f++) {
+        uint32_t pick = random->Below(10);
+        kinds[f] = (f == 0 || pick < 5) ? START_PADDED : pick < 7 ? START_CALLED : pick < 8 ? START_VTABLE : START_NONE;
+    }
+
+    // .text follows the headers; .rdata (strings, then the vtable) after it
+    uint32_t codeRva = out.builder.NextRva();
+    std::vector<uint8_t> code;
+    std::vector<size_t> functionAt(FUNCTION_COUNT);
+    std::vector<Fixup> fixups;
+    auto anyFunction = [&]() {
+        size_t target = random->Below((uint32_t)FUNCTION_COUNT);
+        return kinds[target] == START_NONE ? 0 : target;
+    };
+
+    for (size_t f = 0; f < FUNCTION_COUNT; f++) {
+        if (kinds[f] == START_PADDED) {
+            do code.push_back(0xCC); while ((codeRva + code.size()) % FUNCTION_ALIGNMENT != 0);
+        }
+        functionAt[f] = code.size();
+        out.instructionRvas.push_back((uint32_t)(codeRva + code.size()));
+        code.push_back(0x55);                                       // push ebp
+        for (uint32_t i = 0, n = 2 + random->Below(20); i < n; i++) {
+            out.instructionRvas.push_back((uint32_t)(codeRva + code.size()));
+            size_t at = code.size();
+            switch (random->Below(8)) {
+                case 0: code.push_back(0x90); break;                // nop
+                case 1: code.push_back(0x8B); code.push_back(0xEC); break;
+                case 2: {
+                    // mov dword [esp + disp32], imm32 with a reference spelled
+                    // in its operand bytes
+                    static const uint8_t MOV[] = { 0xC7, 0x84, 0x24 };
+                    code.insert(code.end(), MOV, MOV + 3);
+                    size_t decoy = code.size();
+                    for (int k = 0; k < 8; k++) code.push_back((uint8_t)random->Below(256));
+                    uint32_t pick = random->Below(3);
+                    if (pick < 2) {
+                        code[decoy] = pick ? 0xE8 : 0xE9;
+                        fixups.push_back(Fixup{ decoy + 1, decoy + 5, anyFunction(), SIZE_MAX, false, false });
+                    } else if (!wide) {
+                        code[decoy] = 0x68;
+                        fixups.push_back(Fixup{ decoy + 1, decoy + 5, 0, random->Below(STRING_COUNT), true, false });
+                    } else {
+                        code[decoy] = 0x48, code[decoy + 1] = 0x8D, code[decoy + 2] = 0x0D;
+                        fixups.push_back(Fixup{ decoy + 3, decoy + 7, 0, random->Below(STRING_COUNT), false, false });
+                    }
+                    break;
+                }
+                case 3:
+                case 4: {                                           // call / jmp rel32 to a function
+                    bool call = random->Below(3) != 0;
+                    code.push_back(call ? 0xE8 : 0xE9);
+                    Put32(&code, 0);
+                    fixups.push_back(Fixup{ at + 1, at + 5, anyFunction(), SIZE_MAX, false, call });
+                    break;
+                }
+                case 5: {                                           // A string reference
+                    size_t string = random->Below((uint32_t)STRING_COUNT);
+                    if (wide) {
+                        code.push_back(0x48); code.push_back(0x8D); code.push_back(0x0D);   // lea rcx, [rip + disp32]
+                        Put32(&code, 0);
+                        fixups.push_back(Fixup{ at + 3, at + 7, 0, string, false, false });
+                    } else {
+                        code.push_back(0x68);                                               // push imm32
+                        Put32(&code, 0);
+                        fixups.push_back(Fixup{ at + 1, at + 5, 0, string, true, false });
+                    }
+                    break;
+                }
+                case 6: code.push_back(0x68); Put32(&code, 0x12345678); break;   // push of a plain number
+                default: code.push_back(0x90); break;
+            }
+        }
+        out.instructionRvas.push_back((uint32_t)(codeRva + code.size()));
+        code.push_back(0xC3);                                       // ret
+    }
+
+    std::vector<uint8_t> rdata;
+    for (size_t s = 0; s < STRING_COUNT; s++) {
+        char text[STRING_BYTES];
+        snprintf(text, sizeof(text), "String %03zu", s);
+        rdata.insert(rdata.end(), text, text + STRING_BYTES);
+    }
+    uint32_t rdataRva = codeRva + TestPe::AlignUp((uint32_t)code.size(), TEST_PE_SECTION_ALIGNMENT);
+    size_t width = wide ? 8 : 4;
+    for (size_t f = 0; f < FUNCTION_COUNT; f++) {
+        if (kinds[f] != START_VTABLE) continue;
+        uint64_t address = out.builder.imageBase + codeRva + functionAt[f];
+        for (size_t k = 0; k < width; k++) rdata.push_back((uint8_t)(address >> (8 * k)));
+    }
+
+    // Patched through the RVAs, as the loader would see them
+    std::vector<bool> called(FUNCTION_COUNT, false);
+    for (size_t i = 0; i < fixups.size(); i++) {
+        const Fixup& fixup = fixups[i];
+        uint32_t target = (fixup.string == SIZE_MAX) ? codeRva + (uint32_t)functionAt[fixup.function]
+                                                     : rdataRva + (uint32_t)(fixup.string * STRING_BYTES);
+        uint32_t value = fixup.absolute ? (uint32_t)out.builder.imageBase + target
+                                        : target - (codeRva + (uint32_t)fixup.next);
+        for (int k = 0; k < 4; k++) code[fixup.at + k] = (uint8_t)(value >> (8 * k));
+        if (fixup.call) called[fixup.function] = true;
+    }
+
+    out.codeIndex = out.builder.AddSection(".text", CODE, code);
+    out.rdataIndex = out.builder.AddSection(".rdata", READ_ONLY, rdata);
+    CHECK(out.builder.sections[out.rdataIndex].virtualAddress == rdataRva);
+    size_t entry = FUNCTION_COUNT / 2;
+    while (kinds[entry] != START_NONE) entry++;
+    out.builder.entryPoint = (uint32_t)(codeRva + functionAt[entry]);
+
+    for (size_t f = 0; f < FUNCTION_COUNT; f++) {
+        if (kinds[f] == START_PADDED || kinds[f] == START_VTABLE || called[f] || f == entry) {
+            out.startRvas.push_back((uint32_t)(codeRva + functionAt[f]));
+        }
+    }
+    return out;
+}
+
+struct Reference {
+    std::vector<Xref> found[XREF_KIND_COUNT];   // By source
+    size_t decoys;                              // Byte patterns inside other instructions
+};
+
+// Every byte tried as each reference; kept if an instruction starts there
+static Reference BruteForce(const PeImage& pe, const Generated& generated) {
+    Reference reference;
+    reference.decoys = 0;
+    const uint8_t* data = pe.Data();
+    size_t begin, end;
+    pe.SectionRange(generated.codeIndex, &begin, &end);
+    uint32_t codeRva = generated.builder.sections[generated.codeIndex].virtualAddress;
+
+    for (size_t at = begin; at + 5 <= end; at++) {
+        uint32_t rva = codeRva + (uint32_t)(at - begin);
+        int kind = -1;
+        size_t target = NPOS;
+        if (data[at] == 0xE8 || data[at] == 0xE9) {
+            uint32_t targetRva = rva + 5 + ReadLe32(data + at + 1);
+            if (targetRva >= codeRva && targetRva - codeRva < end - begin) {
+                kind = (data[at] == 0xE8) ? XREF_CALL : XREF_JUMP;
+                target = pe.RvaToOffset(targetRva);
+            }
+        } else if (!pe.Is64Bit() && data[at] == 0x68) {
+            uint32_t value = ReadLe32(data + at + 1);
+            if (value >= pe.imageBase && value - pe.imageBase < pe.sizeOfImage) {
+                kind = XREF_DATA;
+                target = pe.RvaToOffset(value - (uint32_t)pe.imageBase);
+            }
+        } else if (pe.Is64Bit() && at + 7 <= end && data[at] == 0x48 && data[at + 1] == 0x8D && data[at + 2] == 0x0D) {
+            kind = XREF_DATA;
+            target = pe.RvaToOffset(rva + 7 + ReadLe32(data + at + 3));
+        }
+        if (kind < 0 || target >= pe.Size()) continue;
+        if (!std::binary_search(generated.instructionRvas.begin(), generated.instructionRvas.end(), rva)) {
+            reference.decoys++;
+            continue;
+        }
+        reference.found[kind].push_back(Xref{ (uint32_t)at, (uint32_t)target });
+    }
+    return reference;
+}
+
+static bool SameXrefs(XrefRange range, const std::vector<Xref>& expected) {
+    if (range.Size() != expected.size()) return false;
+    for (size_t i = 0; i < expected.size(); i++) {
+        if (range.begin[i].from != expected[i].from || range.begin[i].to != expected[i].to) return false;
+    }
+    return true;
+}
+
+// Nearest expected start at or below `offset`, as XrefIndex::FunctionStart
+static size_t ExpectedStart(const std::vector<size_t>& starts, size_t offset) {
+    std::vector<size_t>::const_iterator next = std::upper_bound(starts.begin(), starts.end(), offset);
+    if (next == starts.begin() || offset - *(next - 1) >= XREF_MAX_FUNCTION_BYTES) return NPOS;
+    return *(next - 1);
+}
+
+static void CheckImage(const Generated& generated, PeLayout layout, unsigned threads) {
+    std::vector<uint8_t> image = generated.builder.Build(layout);
+    PeImage pe;
+    CHECK(pe.Parse(image.data(), image.size(), layout));
+    XrefIndex xrefs;
+    xrefs.Build(pe, threads);
+    Reference reference = BruteForce(pe, generated);
+    CHECK(reference.decoys > 1000);
+
+    // By source: the whole table; by target: each target's range
+    for (int kind = 0; kind < XREF_KIND_COUNT; kind++) {
+        const std::vector<Xref>& expected = reference.found[kind];
+        CHECK(xrefs.Count((XrefKind)kind) == expected.size() && !expected.empty());
+        CHECK(SameXrefs(xrefs.From((XrefKind)kind, 0, pe.Size()), expected));
+
+        std::vector<Xref> byTarget(expected);
+        std::sort(byTarget.begin(), byTarget.end(), [](const Xref& a, const Xref& b) {
+            return a.to < b.to || (a.to == b.to && a.from < b.from);
+        });
+        for (size_t i = 0; i < byTarget.size();) {
+            size_t j = i;
+            while (j < byTarget.size() && byTarget[j].to == byTarget[i].to) j++;
+            std::vector<Xref> same(byTarget.begin() + i, byTarget.begin() + j);
+            CHECK(SameXrefs(xrefs.To((XrefKind)kind, byTarget[i].to), same));
+            i = j;
+        }
+    }
+
+    // Function starts: each found, nothing found between two of them
+    std::vector<size_t> starts;
+    for (size_t i = 0; i < generated.startRvas.size(); i++) starts.push_back(pe.RvaToOffset(generated.startRvas[i]));
+    size_t wrong = 0;
+    for (size_t i = 0; i < starts.size(); i++) {
+        size_t expectedEnd = (i + 1 < starts.size() && starts[i + 1] - starts[i] <= XREF_MAX_FUNCTION_BYTES)
+                                 ? starts[i + 1]
+                                 : starts[i] + XREF_MAX_FUNCTION_BYTES;
+        if (xrefs.FunctionStart(starts[i]) != starts[i] || xrefs.FunctionEnd(starts[i]) != expectedEnd) wrong++;
+    }
+    CHECK(wrong == 0);
+    CHECK(xrefs.FunctionStart(starts[0] - 1) == NPOS);
+
+    // Callers and FunctionsReferencing, mapped through the expected starts
+    std::vector<size_t> got;
+    static const XrefKind KINDS[] = { XREF_CALL, XREF_DATA };
+    for (XrefKind kind : KINDS) {
+        const std::vector<Xref>& all = reference.found[kind];
+        for (size_t i = 0; i < all.size(); i += 991) {
+            std::vector<size_t> expected;
+            for (size_t k = 0; k < all.size(); k++) {
+                if (all[k].to != all[i].to) continue;
+                size_t start = ExpectedStart(starts, all[k].from);
+                if (start != NPOS) expected.push_back(start);
+            }
+            std::sort(expected.begin(), expected.end());
+            expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+            if (kind == XREF_CALL) {
+                xrefs.Callers(all[i].to, &got);
+            } else {
+                xrefs.FunctionsReferencing(all[i].to, &got);
+            }
+            CHECK(got == expected);
+        }
+    }
+
+    printf("%s %s, %u thread(s): %zu calls, %zu jumps, %zu data refs, %zu starts, %zu decoys skipped\n",
+           pe.Is64Bit() ? "PE32+" : "PE32", layout == PE_LAYOUT_MAPPED ? "mapped" : "file", threads,
+           reference.found[XREF_CALL].size(), reference.found[XREF_JUMP].size(), reference.found[XREF_DATA].size(),
+           starts.size(), reference.decoys);
+}
+
+int main() {
+    TestRandom random(15);
+    for (int wide = 0; wide < 2; wide++) {
+        Generated generated = Generate(wide != 0, &random);
+        CHECK(generated.builder.sections[generated.codeIndex].bytes.size() > 2 * XREF_CHUNK_BYTES);
+        CheckImage(generated, PE_LAYOUT_MAPPED, 1);
+        CheckImage(generated, PE_LAYOUT_MAPPED, 4);
+        CheckImage(generated, PE_LAYOUT_FILE, 4);
+    }
+    return TestResult("XrefIndexTest");
+}
@@ -0,0 +1,53 @@
+#!/bin/bash
+# Builds every *Test.cpp here with g++ -std=c++17 under ASan and UBSan and
+# runs it. The binaries go to ${TMPDIR:-/tmp}/hooklib-tests, and the tests
+# run there.
+#
+# Usage: ./run_tests.sh [PE file...]
+#   PE files (Game.exe, any 32- or 64-bit exe / dll) are extra inputs for
+#   the tests that parse real images; without them those tests use the
+#   images they build themselves.
+#
+# Exit status: 0 if every test built and passed.
+
+cd "$(dirname "$0")" || exit 1
+BUILD_DIR=${TMPDIR:-/tmp}/hooklib-tests
+CXX=${CXX:-g++}
+FLAGS=(-std=c++17 -O1 -g -pthread -Wall -fsanitize=address,undefined -fno-sanitize-recover=undefined)
+mkdir -p "$BUILD_DIR" || exit 1
+
+PE_FILES=()
+for file in "$@"; do
+    PE_FILES+=("$(cd "$(dirname "$file")" && pwd)/$(basename "$file")")
+done
+
+failed=0
+for source in *Test.cpp; do
+    name=${source%.cpp}
+    if ! "$CXX" "${FLAGS[@]}" "$source" -o "$BUILD_DIR/$name"; then
+        echo "$name: build failed"
+        failed=1
+        continue
+    fi
+    (cd "$BUILD_DIR" && "./$name" "${PE_FILES[@]}") || failed=1
+done
+
+# Checks that must stop the build. Each source lists them on lines
+#   // COMPILE_FAIL: <DEFINE> [text the compiler's errors must contain]
+# and is compiled once with -D<DEFINE> for each.
+for source in *Test.cpp; do
+    while read -r define expected; do
+        [ -n "$define" ] || continue
+        if errors=$("$CXX" -std=c++17 -fsyntax-only "-D$define" "$source" 2>&1); then
+            echo "${source%.cpp} -D$define: compiled, but must not"
+            failed=1
+        elif [ -n "$expected" ] && ! grep -qF -- "$expected" <<< "$errors"; then
+            echo "${source%.cpp} -D$define: failed without \"$expected\""
+            failed=1
+        else
+            echo "${source%.cpp} -D$define: stops the build, as it must"
+        fi
+    done < <(sed -n 's|^// COMPILE_FAIL: *||p' "$source")
+done
+
+exit $failed
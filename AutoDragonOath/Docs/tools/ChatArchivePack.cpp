@@ -0,0 +1,144 @@
+// ChatArchivePack.cpp - Trains chat archive dictionaries, converts recorded chat
+//
+// train   builds a dictionary (HookLib/ChatArchive.h, TrainChatDictionary)
+//         from recorded chat. ChatHookDLL loads it from
+//         CHAT_ARCHIVE_DICTIONARY and stores it in every segment it writes.
+// pack    writes recorded chat (a ChatLog.h file, or segments) as archive
+//         segments, through the same ChatArchiveWriter the DLL uses. Prints
+//         the sizes, so dictionaries and block sizes can be compared.
+//
+// Build (Linux):
+//   g++ -O2 -std=c++17 -pthread ChatArchivePack.cpp -o ChatArchivePack
+// Build (Windows, VS Developer Command Prompt):
+//   cl /O2 /EHsc /std:c++17 ChatArchivePack.cpp
+//
+// Usage:
+//   ChatArchivePack train [-s bytes] -o <dictionary> <file>...
+//   ChatArchivePack pack [-d dictionary] [-b blockKB] [-S segmentMB] -o <prefix> <file>...
+//
+// Exit status: 0 on success, 1 if an input could not be read or an output
+// not written.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "ChatFiles.h"
+
+static void PrintUsage() {
+    printf("Usage: ChatArchivePack train [-s bytes] -o <dictionary> <file>...\n"
+           "       ChatArchivePack pack [-d dictionary] [-b blockKB] [-S segmentMB] -o <prefix> <file>...\n");
+}
+
+static const size_t TRAIN_SAMPLE_LIMIT = 64 * 1024 * 1024;   // More adds little and costs memory
+
+static int Train(const char* output, size_t capacity, const std::vector<const char*>& inputs) {
+    // Samples are records as they appear in a block, time deltas included
+    std::vector<uint8_t> samples;
+    int64_t last = 0;
+    bool ok = true;
+    for (size_t i = 0; i < inputs.size() && samples.size() < TRAIN_SAMPLE_LIMIT; i++) {
+        ok &= ForEachChatEvent(inputs[i], INT64_MIN, INT64_MAX, [&](const ChatEvent& event) {
+            if (samples.size() >= TRAIN_SAMPLE_LIMIT) return;
+            size_t at = samples.size();
+            samples.resize(at + ChatRecordBound(event.senderLength, event.textLength));
+            uint8_t* end = EncodeChatRecord(&samples[at], event.time - last, event.channel, event.camp, event.sender,
+                                            event.senderLength, event.text, event.textLength);
+            samples.resize((size_t)(end - samples.data()));
+            last = event.time;
+        });
+    }
+
+    std::vector<uint8_t> dictionary;
+    TrainChatDictionary(samples.data(), samples.size(), capacity, &dictionary);
+    FILE* file = fopen(output, "wb");
+    if (file == nullptr || fwrite(dictionary.data(), 1, dictionary.size(), file) != dictionary.size()) {
+        fprintf(stderr, "%s: cannot write\n", output);
+        if (file != nullptr) fclose(file);
+        return 1;
+    }
+    fclose(file);
+    printf("%s: %zu bytes from %.1f MB of records\n", output, dictionary.size(), samples.size() / 1048576.0);
+    return ok ? 0 : 1;
+}
+
+static int Pack(const char* prefix, const char* dictionaryPath, size_t blockBytes, uint64_t segmentBytes,
+                const std::vector<const char*>& inputs) {
+    ChatArchiveOptions options;
+    options.pathPrefix = prefix;
+    options.blockBytes = blockBytes;
+    options.segmentBytes = segmentBytes;
+    if (dictionaryPath != nullptr && !LoadChatDictionary(dictionaryPath, &options.dictionary)) {
+        fprintf(stderr, "%s: cannot read\n", dictionaryPath);
+        return 1;
+    }
+
+    ChatArchiveWriter writer;
+    writer.Open(options);
+    auto started = std::chrono::steady_clock::now();
+    uint64_t rawBytes = 0, records = 0;
+    bool ok = true;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        ok &= ForEachChatEvent(inputs[i], INT64_MIN, INT64_MAX, [&](const ChatEvent& event) {
+            // The queue is sized for a game, not a file: wait for the writer
+            while (!writer.AppendAt(event.time, event.channel, event.camp, event.sender, event.senderLength,
+                                    event.text, event.textLength)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            rawBytes += event.senderLength + event.textLength;
+            records++;
+        });
+    }
+    writer.Close();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    printf("%llu records (%.1f MB of sender + text) in %u segment(s), %.2f s\n", (unsigned long long)records,
+           rawBytes / 1048576.0, writer.SegmentsWritten(), seconds);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        PrintUsage();
+        return 1;
+    }
+    bool train = strcmp(argv[1], "train") == 0;
+    if (!train && strcmp(argv[1], "pack") != 0) {
+        PrintUsage();
+        return 1;
+    }
+
+    const char* output = nullptr;
+    const char* dictionary = nullptr;
+    size_t capacity = CHATARCHIVE_MAX_DICTIONARY;
+    size_t blockBytes = CHATARCHIVE_BLOCK_BYTES;
+    uint64_t segmentBytes = CHATARCHIVE_SEGMENT_BYTES;
+    std::vector<const char*> inputs;
+    for (int i = 2; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(arg, "-d") == 0 && i + 1 < argc && !train) {
+            dictionary = argv[++i];
+        } else if (strcmp(arg, "-s") == 0 && i + 1 < argc && train) {
+            capacity = (size_t)strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(arg, "-b") == 0 && i + 1 < argc && !train) {
+            blockBytes = (size_t)strtoul(argv[++i], nullptr, 10) * 1024;
+        } else if (strcmp(arg, "-S") == 0 && i + 1 < argc && !train) {
+            segmentBytes = strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+        } else if (arg[0] == '-') {
+            PrintUsage();
+            return 1;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    if (output == nullptr || inputs.empty()) {
+        PrintUsage();
+        return 1;
+    }
+    return train ? Train(output, capacity, inputs) : Pack(output, dictionary, blockBytes, segmentBytes, inputs);
+}
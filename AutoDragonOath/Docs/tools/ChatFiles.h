@@ -0,0 +1,260 @@
+// ChatFiles.h - Reads chat events from either recorded format, prints them
+//
+// ChatHookDLL writes chat either to one ChatLog.h file (.hcl) or to
+// rotating ChatArchive.h segments (.hca). The tools take both; the format
+// is told by the magic, not the extension. Output is shared as well: text
+// lines (GBK as recorded, or UTF-8) or JSON lines.
+
+#pragma once
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "../HookLib/ChatArchive.h"
+#include "../HookLib/ChatLog.h"
+#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <iconv.h>
+#endif
+
+using namespace HookLib;
+
+// ============================================================================
+// READING
+// ============================================================================
+
+// Calls visit(const ChatEvent&) for every event in `path` with a time in
+// [from, to), in file order. Segments seek to `from` through their block
+// index and stop after `to`. Returns false, after a message on stderr, if
+// the file cannot be read or is damaged; the events before the damage have
+// been visited.
+template <class Visit>
+bool ForEachChatEvent(const char* path, int64_t from, int64_t to, Visit visit) {
+    MappedFile mapped;
+    if (!mapped.Open(path)) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+    const uint8_t* data = mapped.Data();
+    size_t size = mapped.Size();
+    ChatEvent event;
+
+    if (size >= sizeof(CHATARCHIVE_MAGIC) && memcmp(data, CHATARCHIVE_MAGIC, sizeof(CHATARCHIVE_MAGIC)) == 0) {
+        ChatArchiveReader reader;
+        if (!reader.Open(data, size)) {
+            fprintf(stderr, "%s: damaged segment header\n", path);
+            return false;
+        }
+        std::vector<uint8_t> raw;
+        for (size_t b = reader.FindBlock(from); b < reader.BlockCount(); b++) {
+            if (reader.Block(b).firstTime >= to) break;
+            if (!reader.ReadBlock(b, &raw)) {
+                fprintf(stderr, "%s: block %zu at offset 0x%llX does not decompress\n", path, b,
+                        (unsigned long long)reader.Block(b).offset);
+                return false;
+            }
+            ChatBlockCursor cursor;
+            cursor.Reset(raw.data(), raw.size(), reader.Block(b).firstTime);
+            while (cursor.Next(&event)) {
+                if (event.time >= from && event.time < to) visit(event);
+            }
+        }
+        return true;
+    }
+
+    ChatLogReader reader;
+    if (!reader.Open(data, size)) {
+        fprintf(stderr, "%s: not a chat log or archive segment\n", path);
+        return false;
+    }
+    ChatLogStatus status;
+    while ((status = reader.Next(&event)) == CHATLOG_OK) {
+        if (event.time >= from && event.time < to) visit(event);
+    }
+    if (status == CHATLOG_CORRUPT) {
+        fprintf(stderr, "%s: bad record at offset 0x%zX, stopped there\n", path, reader.Offset());
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// GBK -> UTF-8
+// ============================================================================
+
+// Bytes that do not convert come out as U+FFFD
+class GbkConverter {
+public:
+#ifdef _WIN32
+    GbkConverter() {}
+
+    void Convert(const char* text, size_t length, std::string* out) {
+        out->clear();
+        if (length == 0) return;
+        wide.resize(length);
+        int count = MultiByteToWideChar(936, 0, text, (int)length, &wide[0], (int)length);
+        int bytes = WideCharToMultiByte(CP_UTF8, 0, wide.data(), count, NULL, 0, NULL, NULL);
+        out->resize(bytes);
+        WideCharToMultiByte(CP_UTF8, 0, wide.data(), count, &(*out)[0], bytes, NULL, NULL);
+    }
+
+private:
+    std::wstring wide;
+#else
+    GbkConverter() : handle(iconv_open("UTF-8", "GBK")) {}
+    ~GbkConverter() {
+        if (handle != (iconv_t)-1) iconv_close(handle);
+    }
+
+    void Convert(const char* text, size_t length, std::string* out) {
+        out->clear();
+        char buffer[1024];
+        char* in = (char*)text;
+        size_t left = length;
+        while (left > 0) {
+            char* to = buffer;
+            size_t room = sizeof(buffer);
+            size_t result = (handle == (iconv_t)-1) ? (size_t)-1 : iconv(handle, &in, &left, &to, &room);
+            out->append(buffer, (size_t)(to - buffer));
+            if (result == (size_t)-1 && errno != E2BIG) {
+                out->append("\xEF\xBF\xBD");   // U+FFFD for the byte that did not convert
+                in++;
+                left--;
+                if (handle != (iconv_t)-1) iconv(handle, nullptr, nullptr, nullptr, nullptr);
+            }
+        }
+    }
+
+private:
+    iconv_t handle;
+#endif
+};
+
+// ============================================================================
+// OUTPUT
+// ============================================================================
+
+// "2024-05-01 21:14:03.127". localtime is the slow part of a record, so the
+// date and time are kept for the last second seen.
+struct TimeFormatter {
+    bool utc;
+    time_t cachedSecond;
+    char cached[64];
+
+    void Format(int64_t microseconds, char* out, size_t size) {
+        time_t second = (time_t)(microseconds / 1000000);
+        if (second != cachedSecond) {
+            struct tm parts;
+#ifdef _WIN32
+            if (utc) gmtime_s(&parts, &second); else localtime_s(&parts, &second);
+#else
+            if (utc) gmtime_r(&second, &parts); else localtime_r(&second, &parts);
+#endif
+            snprintf(cached, sizeof(cached), "%04d-%02d-%02d %02d:%02d:%02d", parts.tm_year + 1900, parts.tm_mon + 1,
+                     parts.tm_mday, parts.tm_hour, parts.tm_min, parts.tm_sec);
+            cachedSecond = second;
+        }
+        snprintf(out, size, "%s.%03d", cached, (int)(microseconds / 1000 % 1000));
+    }
+};
+
+inline void AppendJsonString(const std::string& text, std::string* out) {
+    out->push_back('"');
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c == '"' || c == '\\') {
+            out->push_back('\\');
+            out->push_back((char)c);
+        } else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out->append(escaped);
+        } else {
+            out->push_back((char)c);
+        }
+    }
+    out->push_back('"');
+}
+
+// One event as a line of text or JSON
+struct ChatEventPrinter {
+    bool json;
+    bool utf8;              // Text output in UTF-8 instead of the raw GBK bytes
+    TimeFormatter clock;
+    GbkConverter converter;
+    std::string line;
+    std::string sender;
+    std::string text;
+
+    ChatEventPrinter(bool jsonOutput, bool utf8Output, bool utc) : json(jsonOutput), utf8(utf8Output) {
+        clock.utc = utc;
+        clock.cachedSecond = (time_t)-1;
+        clock.cached[0] = '\0';
+    }
+
+    void Print(const ChatEvent& event, FILE* out) {
+        char stamp[80];
+        char fields[192];
+        clock.Format(event.time, stamp, sizeof(stamp));
+        line.clear();
+        if (json || utf8) {
+            converter.Convert(event.sender, event.senderLength, &sender);
+            converter.Convert(event.text, event.textLength, &text);
+        } else {
+            sender.assign(event.sender, event.senderLength);
+            text.assign(event.text, event.textLength);
+        }
+        if (json) {
+            snprintf(fields, sizeof(fields), "{\"time\":\"%s\",\"us\":%lld,\"channel\":%u,\"camp\":%u,\"sender\":", stamp,
+                     (long long)event.time, event.channel, event.camp);
+            line.append(fields);
+            AppendJsonString(sender, &line);
+            line.append(",\"text\":");
+            AppendJsonString(text, &line);
+            line.append("}\n");
+        } else {
+            snprintf(fields, sizeof(fields), "%s [Channel %u|Camp %u] ", stamp, event.channel, event.camp);
+            line.append(fields);
+            line.append(sender);
+            line.append(": ");
+            line.append(text);
+            line.push_back('\n');
+        }
+        fwrite(line.data(), 1, line.size(), out);
+    }
+};
+
+// ============================================================================
+// TIME ARGUMENTS
+// ============================================================================
+
+// "2024-05-01", "2024-05-01 21:14" or "2024-05-01 21:14:03" (a 'T' works in
+// place of the space), local time or UTC, to microseconds since the epoch
+inline bool ParseChatTime(const char* text, bool utc, int64_t* microseconds) {
+    struct tm parts;
+    memset(&parts, 0, sizeof(parts));
+    int fields = sscanf(text, "%d-%d-%d%*[ T]%d:%d:%d", &parts.tm_year, &parts.tm_mon, &parts.tm_mday, &parts.tm_hour,
+                        &parts.tm_min, &parts.tm_sec);
+    if (fields != 3 && fields != 5 && fields != 6) {
+        return false;
+    }
+    parts.tm_year -= 1900;
+    parts.tm_mon -= 1;
+    parts.tm_isdst = -1;
+#ifdef _WIN32
+    time_t seconds = utc ? _mkgmtime(&parts) : mktime(&parts);
+#else
+    time_t seconds = utc ? timegm(&parts) : mktime(&parts);
+#endif
+    if (seconds == (time_t)-1) {
+        return false;
+    }
+    *microseconds = (int64_t)seconds * 1000000;
+    return true;
+}
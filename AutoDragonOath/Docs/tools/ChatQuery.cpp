@@ -0,0 +1,284 @@
+// ChatQuery.cpp - Finds chat by sender, channel and time in archive segments
+//
+// Uses the index file next to each segment (HookLib/ChatIndex.h) to skip
+// the segments outside the time range or without the sender, and inside a
+// segment decompresses only the blocks that hold the sender on one of the
+// channels asked for. A month of segments answers a sender query in
+// milliseconds. Segments without a current index (the one still being
+// written, or one cut short by a crash) are read in full; --build writes
+// the missing indexes. Chat log files (.hcl) are always read in full.
+//
+// Build (Linux):
+//   g++ -O2 -std=c++17 ChatQuery.cpp -o ChatQuery
+// Build (Windows, VS Developer Command Prompt):
+//   cl /O2 /EHsc /std:c++17 ChatQuery.cpp
+//
+// Usage: ChatQuery [options] <segment>...
+//   -s NAME    only messages from NAME (UTF-8 on Linux, the console code
+//              page on Windows; matched against the GBK bytes)
+//   -c N       only channel N (repeatable)
+//   --from T   only events at or after T ("2024-05-01 21:00", local time)
+//   --to T     only events before T
+//   -u         times in UTC instead of local time (output and --from/--to)
+//   --json     one JSON object per line (sender / text converted to UTF-8)
+//   --utf8     text output in UTF-8 instead of the raw GBK bytes
+//   --count    only count the matches; segments and blocks read go to stderr
+// Usage: ChatQuery --build <segment>...
+//   writes the index of each segment that has none or an outdated one
+//
+// Exit status: 0 if every file was read, 1 otherwise.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "ChatFiles.h"
+
+struct Query {
+    bool hasSender;
+    std::string sender;             // GBK
+    bool channels[256];
+    bool anyChannel;
+    int64_t from;
+    int64_t to;
+};
+
+struct QueryStats {
+    size_t segments;                // Opened
+    size_t scanned;                 // Read in full, without an index
+    size_t blocks;                  // Decompressed
+    size_t matches;
+};
+
+static void PrintUsage() {
+    printf("Usage: ChatQuery [-s sender] [-c channel]... [--from time] [--to time] [-u]\n"
+           "                 [--json | --utf8 | --count] <segment>...\n"
+           "       ChatQuery --build <segment>...\n");
+}
+
+// The name as the game sends it
+static bool SenderArgument(const char* text, std::string* out) {
+#ifdef _WIN32
+    out->assign(text);   // Already in the ANSI code page, GBK on a Chinese system
+    return true;
+#else
+    iconv_t handle = iconv_open("GBK", "UTF-8");
+    if (handle == (iconv_t)-1) return false;
+    char buffer[256];
+    char* in = (char*)text;
+    size_t left = strlen(text);
+    char* to = buffer;
+    size_t room = sizeof(buffer);
+    size_t result = iconv(handle, &in, &left, &to, &room);
+    iconv_close(handle);
+    out->assign(buffer, (size_t)(to - buffer));
+    return result != (size_t)-1;
+#endif
+}
+
+static bool Matches(const ChatEvent& event, const Query& query) {
+    if (event.time < query.from || event.time >= query.to) return false;
+    if (query.anyChannel && !query.channels[event.channel]) return false;
+    return !query.hasSender || (event.senderLength == query.sender.size() &&
+                                memcmp(event.sender, query.sender.data(), event.senderLength) == 0);
+}
+
+// Blocks of the segment that may hold matches, by the index
+static std::vector<uint32_t> CandidateBlocks(const ChatIndexReader& index, const ChatArchiveReader& segment,
+                                             const Query& query) {
+    std::vector<uint32_t> candidates;
+    if (query.hasSender) {
+        ChatPostings postings = index.FindSender(query.sender.data(), query.sender.size());
+        uint32_t block;
+        while (postings.Next(&block)) candidates.push_back(block);
+    } else {
+        for (uint32_t b = 0; b < index.BlockCount(); b++) candidates.push_back(b);
+    }
+
+    std::vector<const uint8_t*> bitmaps;
+    for (int c = 0; c < 256 && query.anyChannel; c++) {
+        const uint8_t* bitmap = query.channels[c] ? index.ChannelBlocks((uint8_t)c) : nullptr;
+        if (bitmap != nullptr) bitmaps.push_back(bitmap);
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        uint32_t b = candidates[i];
+        if (b >= segment.BlockCount()) break;
+        const ChatArchiveBlock& block = segment.Block(b);
+        if (block.lastTime < query.from || block.firstTime >= query.to) continue;
+        bool onChannel = !query.anyChannel;
+        for (size_t k = 0; k < bitmaps.size() && !onChannel; k++) onChannel = (bitmaps[k][b >> 3] >> (b & 7)) & 1;
+        if (onChannel) candidates[kept++] = b;
+    }
+    candidates.resize(kept);
+    return candidates;
+}
+
+static bool QuerySegment(const char* path, const Query& query, bool countOnly, ChatEventPrinter* printer,
+                         QueryStats* stats) {
+    auto visit = [&](const ChatEvent& event) {
+        if (!Matches(event, query)) return;
+        stats->matches++;
+        if (!countOnly) printer->Print(event, stdout);
+    };
+
+    MappedFile indexFile;
+    ChatIndexReader index;
+    bool indexed = indexFile.Open(ChatIndexPath(path).c_str()) && index.Open(indexFile.Data(), indexFile.Size());
+    if (indexed) {
+        // Decided from the index alone, without touching the segment
+        if (index.BlockCount() == 0 || index.LastTime() < query.from || index.FirstTime() >= query.to) return true;
+        if (query.hasSender && index.FindSender(query.sender.data(), query.sender.size()).Count() == 0) return true;
+    }
+
+    MappedFile mapped;
+    if (!mapped.Open(path)) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+    stats->segments++;
+    ChatArchiveReader segment;
+    bool isSegment = segment.Open(mapped.Data(), mapped.Size());
+    if (!isSegment || !indexed || index.SegmentSize() != mapped.Size() || index.BlockCount() != segment.BlockCount()) {
+        stats->scanned++;
+        return ForEachChatEvent(path, query.from, query.to, visit);
+    }
+
+    std::vector<uint32_t> blocks = CandidateBlocks(index, segment, query);
+    std::vector<uint8_t> raw;
+    ChatBlockCursor cursor;
+    ChatEvent event;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        stats->blocks++;
+        if (!segment.ReadBlock(blocks[i], &raw)) {
+            fprintf(stderr, "%s: block %u at offset 0x%llX does not decompress\n", path, blocks[i],
+                    (unsigned long long)segment.Block(blocks[i]).offset);
+            return false;
+        }
+        cursor.Reset(raw.data(), raw.size(), segment.Block(blocks[i]).firstTime);
+        while (cursor.Next(&event)) visit(event);
+    }
+    return true;
+}
+
+// Writes the index of `path` unless it already has a current one
+static bool BuildIndex(const char* path) {
+    MappedFile mapped;
+    ChatArchiveReader segment;
+    if (!mapped.Open(path) || !segment.Open(mapped.Data(), mapped.Size())) {
+        fprintf(stderr, "%s: not an archive segment\n", path);
+        return false;
+    }
+    std::string indexPath = ChatIndexPath(path);
+    MappedFile existing;
+    ChatIndexReader current;
+    if (existing.Open(indexPath.c_str()) && current.Open(existing.Data(), existing.Size()) &&
+        current.SegmentSize() == mapped.Size() && current.BlockCount() == segment.BlockCount()) {
+        printf("%s: up to date\n", indexPath.c_str());
+        return true;
+    }
+    existing.Close();
+
+    ChatIndexBuilder builder;
+    std::vector<uint8_t> raw;
+    ChatBlockCursor cursor;
+    ChatEvent event;
+    for (size_t b = 0; b < segment.BlockCount(); b++) {
+        if (!segment.ReadBlock(b, &raw)) {
+            // A segment cut off by a crash may end in a partly written block
+            fprintf(stderr, "%s: block %zu does not decompress, indexed up to it\n", path, b);
+            break;
+        }
+        cursor.Reset(raw.data(), raw.size(), segment.Block(b).firstTime);
+        while (cursor.Next(&event)) builder.AddRecord(event.time, event.channel, event.sender, event.senderLength);
+        builder.EndBlock();
+    }
+    if (!builder.Write(indexPath.c_str(), mapped.Size())) {
+        fprintf(stderr, "%s: cannot write\n", indexPath.c_str());
+        return false;
+    }
+    printf("%s: %u blocks%s\n", indexPath.c_str(), builder.BlockCount(),
+           segment.Indexed() ? "" : " (unfinished segment)");
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Query query;
+    query.hasSender = false;
+    memset(query.channels, 0, sizeof(query.channels));
+    query.anyChannel = false;
+    query.from = INT64_MIN;
+    query.to = INT64_MAX;
+    bool json = false, utf8 = false, countOnly = false, utc = false, build = false;
+
+    const char* fromText = nullptr;
+    const char* toText = nullptr;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--build") == 0) {
+            build = true;
+        } else if (strcmp(arg, "--json") == 0) {
+            json = true;
+        } else if (strcmp(arg, "--utf8") == 0) {
+            utf8 = true;
+        } else if (strcmp(arg, "--count") == 0) {
+            countOnly = true;
+        } else if (strcmp(arg, "-u") == 0) {
+            utc = true;
+        } else if (strcmp(arg, "-s") == 0 && i + 1 < argc) {
+            if (!SenderArgument(argv[++i], &query.sender)) {
+                fprintf(stderr, "%s: not convertible to GBK\n", argv[i]);
+                return 1;
+            }
+            query.hasSender = true;
+        } else if (strcmp(arg, "-c") == 0 && i + 1 < argc) {
+            query.channels[atoi(argv[++i]) & 0xFF] = true;
+            query.anyChannel = true;
+        } else if (strcmp(arg, "--from") == 0 && i + 1 < argc) {
+            fromText = argv[++i];
+        } else if (strcmp(arg, "--to") == 0 && i + 1 < argc) {
+            toText = argv[++i];
+        } else if (arg[0] == '-') {
+            PrintUsage();
+            return 1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.empty() || (fromText != nullptr && !ParseChatTime(fromText, utc, &query.from)) ||
+        (toText != nullptr && !ParseChatTime(toText, utc, &query.to))) {
+        PrintUsage();
+        return 1;
+    }
+
+    bool ok = true;
+    if (build) {
+        for (size_t i = 0; i < paths.size(); i++) ok &= BuildIndex(paths[i].c_str());
+        return ok ? 0 : 1;
+    }
+
+    // Segment names begin with the time of their first record: sorted by
+    // name, the output is in time order
+    std::sort(paths.begin(), paths.end());
+    static char output[1 << 20];
+    setvbuf(stdout, output, _IOFBF, sizeof(output));
+    ChatEventPrinter printer(json, utf8, utc);
+    QueryStats stats;
+    memset(&stats, 0, sizeof(stats));
+    auto started = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < paths.size(); i++) ok &= QuerySegment(paths[i].c_str(), query, countOnly, &printer, &stats);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    if (countOnly) {
+        printf("%zu matches\n", stats.matches);
+        fprintf(stderr, "%zu of %zu files opened (%zu without an index), %zu blocks decompressed, %.1f ms\n",
+                stats.segments, paths.size(), stats.scanned, stats.blocks, seconds * 1000.0);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,469 @@
+// FuncReloc.cpp - Carries known function addresses from one Game.exe to the next
+//
+// After a client patch every hook address and signature has to be found
+// again. Most functions did not change, they only moved; this tool maps them
+// in bulk instead of one signature at a time.
+//
+// Both images are split into functions and hashed (FunctionIndex.h: operand
+// bytes dropped, so moved code hashes the same). Each old function is then
+// matched in three steps:
+//
+//   exact      its hash occurs once in each image
+//   neighbour  its hash occurs several times in the new image (small
+//              thunks, duplicated helpers); the copy nearest to where the
+//              closest exact match below it predicts wins
+//   fuzzy      the code changed: new functions sharing a MinHash band
+//              (8 bands of 4 values) are candidates, the one with the most
+//              equal MinHash values wins
+//
+// Confidence = similarity x uniqueness, where uniqueness drops when the
+// runner-up is nearly as good. Mappings below the threshold are reported as
+// not found rather than guessed.
+//
+// Build (Linux):
+//   g++ -O2 -std=c++17 -pthread FuncReloc.cpp -o FuncReloc
+// Build (Windows, VS Developer Command Prompt):
+//   cl /O2 /EHsc /std:c++17 FuncReloc.cpp
+//
+// Usage: FuncReloc [options] <old image> <new image> [address]...
+//   -f FILE   addresses to map, one per line: "0x0048D6F0 [name]", # comments
+//   --all     map every function of the old image (summary only)
+//   --list    with --all, print every mapping
+//   -t X      minimum confidence (default 0.3)
+//   -j N      threads (default: all cores)
+// Addresses are VAs or RVAs of the old image, in hex. Both images use the
+// same layout detection as SigResolve (size == SizeOfImage is a dump).
+//
+// Exit status: 0 if every requested address was mapped, 1 otherwise.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "FunctionIndex.h"
+#include "MappedFile.h"
+
+static const size_t LSH_BANDS = 8;
+static const size_t LSH_ROWS = FUNCTION_MINHASH / LSH_BANDS;
+static const size_t LSH_MAX_BUCKET = 256;     // Larger buckets are tiny stubs; they say nothing
+static const double UNIQUE_MARGIN = 0.25;     // Lead over the runner-up that counts as unambiguous
+
+enum MatchKind {
+    MATCH_NONE = 0,
+    MATCH_EXACT,
+    MATCH_NEIGHBOUR,
+    MATCH_FUZZY
+};
+
+static const char* const kMatchNames[] = { "none", "exact", "neighbour", "fuzzy" };
+
+struct Target {
+    unsigned long long rva;
+    std::string name;
+};
+
+struct Mapping {
+    MatchKind kind;
+    size_t newFunction;
+    double similarity;
+    double confidence;
+};
+
+// One image and its function index
+struct Image {
+    MappedFile file;
+    PeImage pe;
+    bool isDump;
+    FunctionIndex functions;
+};
+
+// Everything the matching steps share, read-only once built
+struct Matcher {
+    const FunctionIndex* oldIndex;
+    const FunctionIndex* newIndex;
+    std::unordered_map<uint64_t, std::vector<size_t> > oldByHash;
+    std::unordered_map<uint64_t, std::vector<size_t> > newByHash;
+    std::unordered_map<uint64_t, std::vector<size_t> > bands;   // Band key -> new functions
+    std::vector<size_t> anchorOld;                              // Exact matches, ascending old RVA
+    std::vector<size_t> anchorNew;
+};
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static double NowSeconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void PrintUsage() {
+    printf("Usage: FuncReloc [-f file] [--all] [--list] [-t min] [-j threads] <old image> <new image> [address]...\n");
+}
+
+static bool OpenImage(const char* path, Image* image) {
+    if (!image->file.Open(path)) {
+        printf("%s: cannot open\n", path);
+        return false;
+    }
+    if (!image->pe.Parse(image->file.Data(), image->file.Size(), PE_LAYOUT_FILE)) {
+        printf("%s: not a PE image\n", path);
+        return false;
+    }
+    image->isDump = image->file.Size() == image->pe.sizeOfImage;
+    if (image->isDump) {
+        image->pe.Parse(image->file.Data(), image->file.Size(), PE_LAYOUT_MAPPED);
+    }
+    return true;
+}
+
+static bool ReadTargets(const char* path, std::vector<Target>* targets) {
+    FILE* in = fopen(path, "r");
+    if (in == nullptr) {
+        printf("%s: cannot open\n", path);
+        return false;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), in) != nullptr) {
+        char* text = line;
+        while (*text == ' ' || *text == '\t') text++;
+        if (*text == '#' || *text == '\r' || *text == '\n' || *text == '\0') continue;
+
+        Target target;
+        char* rest = nullptr;
+        target.rva = strtoull(text, &rest, 16);
+        while (*rest == ' ' || *rest == '\t') rest++;
+        size_t length = strcspn(rest, "\r\n");
+        target.name.assign(rest, length);
+        targets->push_back(target);
+    }
+    fclose(in);
+    return true;
+}
+
+static uint64_t BandKey(const FunctionInfo& function, size_t band) {
+    uint64_t key = band;
+    for (size_t r = 0; r < LSH_ROWS; r++) key = MixHash(key ^ function.minHash[band * LSH_ROWS + r]);
+    return key;
+}
+
+static size_t FunctionRva(const FunctionIndex& index, size_t function) {
+    return index.Image().OffsetToRva(index.Function(function).offset);
+}
+
+// 1 when the best candidate leads by UNIQUE_MARGIN or more, down to 0.5 for a tie
+static double Uniqueness(double margin) {
+    return (margin >= UNIQUE_MARGIN) ? 1.0 : 0.5 + 0.5 * margin / UNIQUE_MARGIN;
+}
+
+static uint64_t Distance(size_t a, size_t b) {
+    return (a > b) ? a - b : b - a;
+}
+
+// ============================================================================
+// MATCHING
+// ============================================================================
+
+static void BuildMatcher(const FunctionIndex& oldIndex, const FunctionIndex& newIndex, Matcher* matcher) {
+    matcher->oldIndex = &oldIndex;
+    matcher->newIndex = &newIndex;
+    for (size_t i = 0; i < oldIndex.Count(); i++) matcher->oldByHash[oldIndex.Function(i).hash].push_back(i);
+    for (size_t i = 0; i < newIndex.Count(); i++) {
+        const FunctionInfo& function = newIndex.Function(i);
+        matcher->newByHash[function.hash].push_back(i);
+        for (size_t b = 0; b < LSH_BANDS; b++) matcher->bands[BandKey(function, b)].push_back(i);
+    }
+
+    // Old functions are in address order, so the anchors come out sorted
+    for (size_t i = 0; i < oldIndex.Count(); i++) {
+        const FunctionInfo& function = oldIndex.Function(i);
+        std::unordered_map<uint64_t, std::vector<size_t> >::const_iterator found = matcher->newByHash.find(function.hash);
+        if (found != matcher->newByHash.end() && found->second.size() == 1 &&
+            matcher->oldByHash[function.hash].size() == 1) {
+            matcher->anchorOld.push_back(i);
+            matcher->anchorNew.push_back(found->second[0]);
+        }
+    }
+}
+
+// New RVA of old function `index`, going by the nearest exact match below it
+// (above it for functions before the first one). The old RVA if there is none.
+static size_t PredictRva(const Matcher& matcher, size_t index) {
+    size_t oldRva = FunctionRva(*matcher.oldIndex, index);
+    if (matcher.anchorOld.empty()) {
+        return oldRva;
+    }
+    size_t lo = 0, hi = matcher.anchorOld.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (matcher.anchorOld[mid] <= index) lo = mid + 1; else hi = mid;
+    }
+    size_t anchor = (lo == 0) ? 0 : lo - 1;
+    size_t anchorOldRva = FunctionRva(*matcher.oldIndex, matcher.anchorOld[anchor]);
+    size_t anchorNewRva = FunctionRva(*matcher.newIndex, matcher.anchorNew[anchor]);
+    return anchorNewRva + (oldRva - anchorOldRva);
+}
+
+// Of several identical copies, the one nearest the predicted RVA. Uniqueness
+// comes from how much nearer it is than the next one, and from the other old
+// copies: if one of them is predicted nearer to the same new function, that
+// one gets it and this one is not mapped.
+static void PickNearest(const Matcher& matcher, size_t index, const std::vector<size_t>& candidates, Mapping* mapping) {
+    size_t predicted = PredictRva(matcher, index);
+    uint64_t best = ~0ull, second = ~0ull;
+    for (size_t c = 0; c < candidates.size(); c++) {
+        uint64_t distance = Distance(FunctionRva(*matcher.newIndex, candidates[c]), predicted);
+        if (distance < best) {
+            second = best;
+            best = distance;
+            mapping->newFunction = candidates[c];
+        } else if (distance < second) {
+            second = distance;
+        }
+    }
+
+    size_t chosenRva = FunctionRva(*matcher.newIndex, mapping->newFunction);
+    const std::vector<size_t>& copies = matcher.oldByHash.find(matcher.oldIndex->Function(index).hash)->second;
+    uint64_t rival = ~0ull;
+    for (size_t c = 0; c < copies.size(); c++) {
+        if (copies[c] == index) continue;
+        uint64_t distance = Distance(chosenRva, PredictRva(matcher, copies[c]));
+        if (distance < rival) rival = distance;
+    }
+
+    mapping->kind = MATCH_NEIGHBOUR;
+    mapping->similarity = 1.0;
+    if (rival <= best) {
+        mapping->confidence = 0.0;
+        return;
+    }
+    if (rival < second) second = rival;
+    mapping->confidence = (second == 0) ? Uniqueness(0.0) : Uniqueness(1.0 - (double)best / (double)second);
+}
+
+static void MatchFunction(const Matcher& matcher, size_t index, std::vector<uint32_t>* seen, uint32_t stamp,
+                          Mapping* mapping) {
+    const FunctionInfo& function = matcher.oldIndex->Function(index);
+    mapping->kind = MATCH_NONE;
+    mapping->newFunction = (size_t)-1;
+    mapping->similarity = mapping->confidence = 0.0;
+
+    std::unordered_map<uint64_t, std::vector<size_t> >::const_iterator exact = matcher.newByHash.find(function.hash);
+    if (exact != matcher.newByHash.end()) {
+        if (exact->second.size() == 1 && matcher.oldByHash.find(function.hash)->second.size() == 1) {
+            mapping->kind = MATCH_EXACT;
+            mapping->newFunction = exact->second[0];
+            mapping->similarity = mapping->confidence = 1.0;
+        } else {
+            PickNearest(matcher, index, exact->second, mapping);
+        }
+        return;
+    }
+
+    // Fuzzy: every new function sharing a band, each compared once
+    size_t predicted = PredictRva(matcher, index);
+    double best = 0.0, second = 0.0;
+    for (size_t b = 0; b < LSH_BANDS; b++) {
+        std::unordered_map<uint64_t, std::vector<size_t> >::const_iterator bucket = matcher.bands.find(BandKey(function, b));
+        if (bucket == matcher.bands.end() || bucket->second.size() > LSH_MAX_BUCKET) continue;
+        for (size_t c = 0; c < bucket->second.size(); c++) {
+            size_t candidate = bucket->second[c];
+            if ((*seen)[candidate] == stamp) continue;
+            (*seen)[candidate] = stamp;
+
+            double similarity = MinHashSimilarity(function, matcher.newIndex->Function(candidate));
+            bool better = similarity > best;
+            if (similarity == best && mapping->newFunction != (size_t)-1) {
+                // Equal scores: the nearer one to the prediction, still counted as a tie
+                better = Distance(FunctionRva(*matcher.newIndex, candidate), predicted) <
+                         Distance(FunctionRva(*matcher.newIndex, mapping->newFunction), predicted);
+            }
+            if (better) {
+                second = best;
+                best = similarity;
+                mapping->newFunction = candidate;
+            } else if (similarity > second) {
+                second = similarity;
+            }
+        }
+    }
+    if (mapping->newFunction != (size_t)-1) {
+        mapping->kind = MATCH_FUZZY;
+        mapping->similarity = best;
+        mapping->confidence = best * Uniqueness(best - second);
+    }
+}
+
+// Where several old functions were mapped to the same new one, only the most
+// confident keeps it (all of them on a tie). Fuzzy matches are chosen one
+// function at a time, so this is the first place the conflict shows.
+static void ResolveConflicts(std::vector<Mapping>* mappings, double threshold) {
+    std::unordered_map<size_t, size_t> owner;   // New function -> best entry of mappings
+    for (size_t i = 0; i < mappings->size(); i++) {
+        const Mapping& mapping = (*mappings)[i];
+        if (mapping.kind == MATCH_NONE || mapping.confidence < threshold) continue;
+        std::unordered_map<size_t, size_t>::iterator found = owner.find(mapping.newFunction);
+        if (found == owner.end() || (*mappings)[found->second].confidence < mapping.confidence) {
+            owner[mapping.newFunction] = i;
+        }
+    }
+    for (size_t i = 0; i < mappings->size(); i++) {
+        Mapping& mapping = (*mappings)[i];
+        if (mapping.kind == MATCH_NONE || mapping.confidence < threshold) continue;
+        if ((*mappings)[owner[mapping.newFunction]].confidence > mapping.confidence) mapping.confidence = 0.0;
+    }
+}
+
+// Maps old functions `indices` on `threads` threads
+static void MatchAll(const Matcher& matcher, const std::vector<size_t>& indices, unsigned threads,
+                     std::vector<Mapping>* mappings) {
+    mappings->resize(indices.size());
+    std::atomic<size_t> next(0);
+    auto work = [&](unsigned) {
+        std::vector<uint32_t> seen(matcher.newIndex->Count(), 0);
+        uint32_t stamp = 0;
+        for (;;) {
+            size_t i = next.fetch_add(1);
+            if (i >= indices.size()) return;
+            MatchFunction(matcher, indices[i], &seen, ++stamp, &(*mappings)[i]);
+        }
+    };
+    RunScanWorkers(threads, work);
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+    const char* paths[2] = { nullptr, nullptr };
+    std::vector<Target> targets;
+    bool all = false;
+    bool list = false;
+    double threshold = 0.3;
+    unsigned threads = DefaultScanThreads();
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--all") == 0) {
+            all = true;
+        } else if (strcmp(arg, "--list") == 0) {
+            list = true;
+        } else if (strcmp(arg, "-f") == 0 && i + 1 < argc) {
+            if (!ReadTargets(argv[++i], &targets)) return 1;
+        } else if (strcmp(arg, "-t") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else if (strcmp(arg, "-j") == 0 && i + 1 < argc) {
+            int count = atoi(argv[++i]);
+            threads = (count < 1) ? 1 : (unsigned)count;
+        } else if (arg[0] == '-') {
+            PrintUsage();
+            return 1;
+        } else if (paths[0] == nullptr) {
+            paths[0] = arg;
+        } else if (paths[1] == nullptr) {
+            paths[1] = arg;
+        } else {
+            Target target;
+            target.rva = strtoull(arg, nullptr, 16);
+            targets.push_back(target);
+        }
+    }
+    if (paths[1] == nullptr || (targets.empty() && !all)) {
+        PrintUsage();
+        return 1;
+    }
+
+    Image images[2];
+    for (int i = 0; i < 2; i++) {
+        if (!OpenImage(paths[i], &images[i])) return 1;
+    }
+    Image& oldImage = images[0];
+    Image& newImage = images[1];
+    if (oldImage.pe.Is64Bit() != newImage.pe.Is64Bit()) {
+        printf("%s and %s: one is PE32, the other PE32+\n", paths[0], paths[1]);
+        return 1;
+    }
+
+    // Requested addresses become function starts even if nothing calls them
+    std::vector<size_t> extraStarts;
+    for (size_t i = 0; i < targets.size(); i++) {
+        if (targets[i].rva >= oldImage.pe.imageBase) targets[i].rva -= oldImage.pe.imageBase;
+        size_t offset = oldImage.pe.RvaToOffset((size_t)targets[i].rva);
+        if (offset != (size_t)-1) extraStarts.push_back(offset);
+    }
+
+    double start = NowSeconds();
+    oldImage.functions.Build(oldImage.pe, threads, &extraStarts);
+    newImage.functions.Build(newImage.pe, threads, nullptr);
+    double indexed = NowSeconds();
+    Matcher matcher;
+    BuildMatcher(oldImage.functions, newImage.functions, &matcher);
+
+    std::vector<size_t> indices;
+    std::vector<size_t> owners;   // Target per entry of indices; (size_t)-1 for --all
+    for (size_t i = 0; i < targets.size(); i++) {
+        size_t function = oldImage.functions.Find(oldImage.pe.RvaToOffset((size_t)targets[i].rva));
+        if (function == (size_t)-1) continue;
+        indices.push_back(function);
+        owners.push_back(i);
+    }
+    if (all) {
+        for (size_t i = 0; i < oldImage.functions.Count(); i++) {
+            indices.push_back(i);
+            owners.push_back((size_t)-1);
+        }
+    }
+
+    std::vector<Mapping> mappings;
+    MatchAll(matcher, indices, threads, &mappings);
+    ResolveConflicts(&mappings, threshold);
+    double matched = NowSeconds();
+
+    printf("%s: %u functions, %s: %u functions, indexed in %.2f s (%u threads)\n", paths[0],
+           (unsigned)oldImage.functions.Count(), paths[1], (unsigned)newImage.functions.Count(), indexed - start,
+           threads);
+
+    size_t counts[4] = { 0, 0, 0, 0 };
+    std::vector<bool> mapped(targets.size(), false);
+    for (size_t i = 0; i < indices.size(); i++) {
+        const Mapping& mapping = mappings[i];
+        MatchKind kind = (mapping.confidence >= threshold) ? mapping.kind : MATCH_NONE;
+        counts[kind]++;
+        if (owners[i] != (size_t)-1) mapped[owners[i]] = kind != MATCH_NONE;
+        if (owners[i] == (size_t)-1 && !list) continue;
+
+        unsigned long long oldVa = oldImage.pe.imageBase + FunctionRva(oldImage.functions, indices[i]);
+        printf("  0x%08llX -> ", oldVa);
+        if (kind == MATCH_NONE) {
+            printf("not found     ");
+        } else {
+            printf("0x%08llX    ", (unsigned long long)(newImage.pe.imageBase + FunctionRva(newImage.functions, mapping.newFunction)));
+        }
+        printf("%-9s  confidence %.2f  similarity %.2f", kMatchNames[mapping.kind], mapping.confidence,
+               mapping.similarity);
+        if (owners[i] != (size_t)-1 && !targets[owners[i]].name.empty()) {
+            printf("  %s", targets[owners[i]].name.c_str());
+        }
+        printf("\n");
+    }
+
+    bool allMapped = true;
+    for (size_t i = 0; i < targets.size(); i++) {
+        if (mapped[i]) continue;
+        allMapped = false;
+        if (oldImage.functions.Find(oldImage.pe.RvaToOffset((size_t)targets[i].rva)) == (size_t)-1) {
+            printf("  0x%08llX: not code in %s  %s\n", (unsigned long long)(oldImage.pe.imageBase + targets[i].rva), paths[0],
+                   targets[i].name.c_str());
+        }
+    }
+    printf("%u mapped (%u exact, %u neighbour, %u fuzzy), %u not found, matched in %.2f s\n",
+           (unsigned)(counts[MATCH_EXACT] + counts[MATCH_NEIGHBOUR] + counts[MATCH_FUZZY]),
+           (unsigned)counts[MATCH_EXACT], (unsigned)counts[MATCH_NEIGHBOUR], (unsigned)counts[MATCH_FUZZY],
+           (unsigned)counts[MATCH_NONE], matched - indexed);
+    return allMapped ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+// FunctionIndex.h - Function boundaries and position-independent function hashes
+//
+// Used by FuncReloc to carry known addresses from one Game.exe version to
+// the next. No symbols and no IDA database, only what the image gives:
+//
+//   starts   as in HookLib/FunctionStarts.h: the entry point, call rel32
+//            targets, code pointers in .data/.rdata and the first aligned
+//            instruction after CC padding, each only where the linear
+//            sweep of the code decoded an instruction.
+//   extent   up to the next start, minus trailing CC / NOP padding.
+//   hashes   every instruction is reduced to its prefixes, opcode and
+//            ModRM/SIB bytes; displacements and immediates (branch targets,
+//            addresses, stack frame sizes) are dropped. `hash` covers the
+//            whole normalized stream, so a function that only moved or had
+//            its constants changed keeps it. `minHash` samples the set of
+//            4-instruction shingles, so two functions that differ in a few
+//            instructions still agree on most of its entries.
+//
+// Hashing runs on several threads, one function at a time.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "../HookLib/FunctionStarts.h"
+#include "../HookLib/ParallelScan.h"
+#include "../HookLib/SectionScan.h"
+#include "../HookLib/X86Decode.h"
+
+using namespace HookLib;
+
+static const size_t FUNCTION_MINHASH = 32;
+static const size_t FUNCTION_SHINGLE = 4;          // Instructions per shingle
+static const size_t FUNCTION_MAX_SIZE = 0x10000;   // Longer extents are cut (data between functions)
+
+struct FunctionInfo {
+    size_t offset;              // Buffer offset of the first instruction
+    size_t size;
+    uint32_t instructions;
+    uint64_t hash;              // Whole normalized instruction stream
+    uint64_t minHash[FUNCTION_MINHASH];
+};
+
+// splitmix64 finalizer
+inline uint64_t MixHash(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// Estimated Jaccard similarity of the two functions' shingle sets
+inline double MinHashSimilarity(const FunctionInfo& a, const FunctionInfo& b) {
+    size_t equal = 0;
+    for (size_t m = 0; m < FUNCTION_MINHASH; m++) {
+        if (a.minHash[m] == b.minHash[m]) equal++;
+    }
+    return (double)equal / FUNCTION_MINHASH;
+}
+
+class FunctionIndex {
+public:
+    FunctionIndex() : pe(nullptr) {}
+
+    // Finds and hashes the functions of `pe`. `extraStarts` (buffer offsets,
+    // may be NULL) are added as starts even if nothing references them.
+    void Build(const PeImage& image, unsigned threads, const std::vector<size_t>* extraStarts) {
+        pe = &image;
+        mode = image.Is64Bit() ? X86_MODE_64 : X86_MODE_32;
+        functions.clear();
+
+        CollectScanRegions(image, SIGNATURE_CODE, &code);
+        std::vector<size_t> starts;
+        SweepCode(&starts);
+        FinishFunctionStarts(image, instructionStart.data(), &starts);
+        if (extraStarts != nullptr) {
+            for (size_t i = 0; i < extraStarts->size(); i++) {
+                if (InCode((*extraStarts)[i])) starts.push_back((*extraStarts)[i]);
+            }
+        }
+
+        std::sort(starts.begin(), starts.end());
+        starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+        functions.resize(starts.size());
+        for (size_t i = 0; i < starts.size(); i++) {
+            functions[i].offset = starts[i];
+            size_t end = RegionEnd(starts[i]);
+            if (i + 1 < starts.size() && starts[i + 1] < end) end = starts[i + 1];
+            if (end - starts[i] > FUNCTION_MAX_SIZE) end = starts[i] + FUNCTION_MAX_SIZE;
+            while (end > starts[i] + 1 && (image.Data()[end - 1] == 0xCC || image.Data()[end - 1] == 0x90)) end--;
+            functions[i].size = end - starts[i];
+        }
+
+        std::atomic<size_t> next(0);
+        auto work = [this, &next](unsigned) {
+            for (;;) {
+                size_t i = next.fetch_add(1);
+                if (i >= functions.size()) return;
+                HashFunction(&functions[i]);
+            }
+        };
+        RunScanWorkers(threads, work);
+        instructionStart.clear();
+        instructionStart.shrink_to_fit();
+    }
+
+    size_t Count() const { return functions.size(); }
+    const FunctionInfo& Function(size_t index) const { return functions[index]; }
+    const PeImage& Image() const { return *pe; }
+
+    // Index of the function starting exactly at `offset`, or (size_t)-1
+    size_t Find(size_t offset) const {
+        size_t index = LowerBound(offset);
+        return (index < functions.size() && functions[index].offset == offset) ? index : (size_t)-1;
+    }
+
+    // Index of the function whose extent holds `offset`, or (size_t)-1
+    size_t Containing(size_t offset) const {
+        size_t index = LowerBound(offset + 1);
+        if (index == 0) return (size_t)-1;
+        const FunctionInfo& function = functions[index - 1];
+        return (offset - function.offset < function.size) ? index - 1 : (size_t)-1;
+    }
+
+private:
+    size_t LowerBound(size_t offset) const {
+        size_t lo = 0, hi = functions.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (functions[mid].offset < offset) lo = mid + 1; else hi = mid;
+        }
+        return lo;
+    }
+
+    bool InCode(size_t offset) const {
+        return RegionEnd(offset) != 0;
+    }
+
+    // End of the code region holding `offset`, or 0
+    size_t RegionEnd(size_t offset) const {
+        for (size_t r = 0; r < code.size(); r++) {
+            if (offset >= code[r].begin && offset < code[r].end) return code[r].end;
+        }
+        return 0;
+    }
+
+    // Linear sweep: marks instruction starts, collects call targets and
+    // code after alignment padding as candidate starts
+    void SweepCode(std::vector<size_t>* starts) {
+        instructionStart.assign(pe->Size(), 0);
+        for (size_t r = 0; r < code.size(); r++) {
+            SweepFunctionCode(*pe, code[r].begin, code[r].begin, code[r].end, code[r].end, instructionStart.data(),
+                              starts, [&](size_t at, const X86Instruction& ins) {
+                                  if (IsCallRel32(ins)) starts->push_back(CodeTarget(*pe, ins, at));
+                              });
+        }
+    }
+
+    void HashFunction(FunctionInfo* function) const {
+        const uint8_t* data = pe->Data();
+        std::vector<uint64_t> stream;
+        size_t at = function->offset;
+        size_t end = function->offset + function->size;
+        while (at < end) {
+            X86Instruction ins;
+            if (!DecodeX86(data + at, end - at, mode, &ins)) {
+                stream.push_back(MixHash(0x100 | data[at]));   // Keep the byte, move on
+                at++;
+                continue;
+            }
+
+            // Prefixes, opcode, ModRM, SIB: everything but the operand bytes
+            uint64_t h = 0xCBF29CE484222325ull;
+            for (size_t j = 0; j < ins.length; j++) {
+                bool operand = (ins.dispSize != 0 && j >= ins.dispOffset && j < (size_t)ins.dispOffset + ins.dispSize) ||
+                               (ins.immSize != 0 && j >= ins.immOffset && j < (size_t)ins.immOffset + ins.immSize);
+                if (operand) continue;
+                h = (h ^ data[at + j]) * 0x100000001B3ull;
+            }
+            stream.push_back(MixHash(h ^ ((uint64_t)ins.dispSize << 56) ^ ((uint64_t)ins.immSize << 48)));
+            at += ins.length;
+        }
+
+        function->instructions = (uint32_t)stream.size();
+        uint64_t whole = 0;
+        for (size_t i = 0; i < stream.size(); i++) whole = MixHash(whole ^ stream[i]);
+        function->hash = whole;
+
+        for (size_t m = 0; m < FUNCTION_MINHASH; m++) function->minHash[m] = ~0ull;
+        size_t shingles = (stream.size() > FUNCTION_SHINGLE) ? stream.size() - FUNCTION_SHINGLE + 1 : 1;
+        for (size_t s = 0; s < shingles; s++) {
+            uint64_t shingle = 0;
+            for (size_t k = s; k < s + FUNCTION_SHINGLE && k < stream.size(); k++) shingle = MixHash(shingle ^ stream[k]);
+            for (size_t m = 0; m < FUNCTION_MINHASH; m++) {
+                uint64_t h = MixHash(shingle ^ (0x5851F42D4C957F2Dull * (m + 1)));
+                if (h < function->minHash[m]) function->minHash[m] = h;
+            }
+        }
+    }
+
+    const PeImage* pe;
+    X86Mode mode;
+    std::vector<ScanRegion> code;
+    std::vector<uint8_t> instructionStart;   // Per buffer byte, during Build only
+    std::vector<FunctionInfo> functions;     // Ascending offsets
+};
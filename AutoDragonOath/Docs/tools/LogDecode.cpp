@@ -0,0 +1,262 @@
+// LogDecode.cpp - Turns a binary HookLib log into text
+//
+// A DLL whose AsyncLog was opened with LOG_OUTPUT_BINARY writes each
+// HOOKLIB_LOG call as its packed arguments plus, once per call site, the
+// format (HookLib/LogFormat.h). This tool does the formatting the game
+// process skipped, with FormatLogRecord, so the output reads like the
+// text log, with the date, milliseconds and level added.
+//
+// Build (Linux):
+//   g++ -O2 -std=c++17 LogDecode.cpp -o LogDecode
+// Build (Windows, VS Developer Command Prompt):
+//   cl /O2 /EHsc /std:c++17 LogDecode.cpp
+//
+// Usage: LogDecode [options] <log>...
+//   -l LEVEL   only records at LEVEL or above (debug, info, warning, error)
+//   -s         add the call site (file:line) to each record
+//   -u         times in UTC instead of local time
+//
+// Exit status: 0 if every file decoded to the end, 1 otherwise.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "../HookLib/LogFormat.h"
+#include "MappedFile.h"
+
+using namespace HookLib;
+
+struct Options {
+    LogLevel minLevel;
+    bool showSource;
+    bool utc;
+};
+
+// A FORMAT entry
+struct DecodedFormat {
+    LogLevel level;
+    std::vector<LogArgKind> args;
+    uint32_t line;
+    std::string file;
+    std::string format;
+};
+
+// Bounds-checked little-endian reader over one file
+struct LogReader {
+    const uint8_t* data;
+    size_t size;
+    size_t at;
+    bool failed;
+
+    template <class T>
+    T Get() {
+        T value = T();
+        if (size - at < sizeof(T)) {
+            failed = true;
+            at = size;
+            return value;
+        }
+        memcpy(&value, data + at, sizeof(T));
+        at += sizeof(T);
+        return value;
+    }
+
+    // uint16 length + bytes; returns a pointer into the file
+    const uint8_t* GetBytes(size_t* length) {
+        *length = Get<uint16_t>();
+        if (failed || size - at < *length) {
+            failed = true;
+            at = size;
+            *length = 0;
+            return data;
+        }
+        const uint8_t* bytes = data + at;
+        at += *length;
+        return bytes;
+    }
+};
+
+static void PrintUsage() {
+    printf("Usage: LogDecode [-l debug|info|warning|error] [-s] [-u] <log>...\n");
+}
+
+static bool ParseLevel(const char* text, LogLevel* level) {
+    for (int l = LOG_DEBUG; l < LOG_DISABLED; l++) {
+        if (strcmp(text, LogLevelName((LogLevel)l)) == 0) {
+            *level = (LogLevel)l;
+            return true;
+        }
+    }
+    return false;
+}
+
+// "2024-05-01 21:14:03.127"
+static void FormatTime(int64_t microseconds, bool utc, char* out, size_t size) {
+    time_t second = (time_t)(microseconds / 1000000);
+    struct tm parts;
+#ifdef _WIN32
+    if (utc) gmtime_s(&parts, &second); else localtime_s(&parts, &second);
+#else
+    if (utc) gmtime_r(&second, &parts); else localtime_r(&second, &parts);
+#endif
+    snprintf(out, size, "%04d-%02d-%02d %02d:%02d:%02d.%03d", parts.tm_year + 1900, parts.tm_mon + 1, parts.tm_mday,
+             parts.tm_hour, parts.tm_min, parts.tm_sec, (int)(microseconds / 1000 % 1000));
+}
+
+static void PrintLine(int64_t time, LogLevel level, const char* text, size_t length, bool truncated,
+                      const DecodedFormat* source, const Options& options) {
+    char stamp[80];
+    FormatTime(time, options.utc, stamp, sizeof(stamp));
+    printf("%s %-7s ", stamp, LogLevelName(level));
+    fwrite(text, 1, length, stdout);
+    if (truncated) fputs(LOG_TRUNCATED_MARK, stdout);
+    if (source != nullptr && options.showSource) printf("  (%s:%u)", source->file.c_str(), source->line);
+    fputc('\n', stdout);
+}
+
+static bool DecodeFile(const char* path, const Options& options) {
+    MappedFile mapped;
+    if (!mapped.Open(path)) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+    LogReader reader = { mapped.Data(), mapped.Size(), 0, false };
+    if (reader.size < sizeof(LOG_FILE_MAGIC) + sizeof(uint16_t) ||
+        memcmp(reader.data, LOG_FILE_MAGIC, sizeof(LOG_FILE_MAGIC)) != 0) {
+        fprintf(stderr, "%s: not a binary HookLib log\n", path);
+        return false;
+    }
+    reader.at = sizeof(LOG_FILE_MAGIC);
+    uint16_t version = reader.Get<uint16_t>();
+    if (version != LOG_FILE_VERSION) {
+        fprintf(stderr, "%s: unsupported version %u\n", path, version);
+        return false;
+    }
+
+    std::vector<DecodedFormat> formats;
+    std::string text;
+    while (reader.at < reader.size && !reader.failed) {
+        size_t entry = reader.at;
+        uint8_t type = reader.Get<uint8_t>();
+        switch (type) {
+            case LOG_ENTRY_SESSION: {
+                int64_t time = reader.Get<int64_t>();
+                formats.clear();
+                if (!reader.failed) {
+                    static const char started[] = "--- log opened ---";
+                    PrintLine(time, LOG_INFO, started, sizeof(started) - 1, false, nullptr, options);
+                }
+                break;
+            }
+            case LOG_ENTRY_FORMAT: {
+                uint32_t id = reader.Get<uint32_t>();
+                DecodedFormat format;
+                format.level = (LogLevel)reader.Get<uint8_t>();
+                uint8_t count = reader.Get<uint8_t>();
+                for (uint8_t i = 0; i < count; i++) format.args.push_back((LogArgKind)reader.Get<uint8_t>());
+                format.line = reader.Get<uint32_t>();
+                size_t length;
+                const uint8_t* bytes = reader.GetBytes(&length);
+                format.file.assign((const char*)bytes, length);
+                bytes = reader.GetBytes(&length);
+                format.format.assign((const char*)bytes, length);
+                if (!reader.failed && id != formats.size()) {
+                    fprintf(stderr, "%s: format id %u out of order at offset 0x%zX\n", path, id, entry);
+                    return false;
+                }
+                formats.push_back(format);
+                break;
+            }
+            case LOG_ENTRY_RECORD: {
+                uint32_t id = reader.Get<uint32_t>();
+                int64_t time = reader.Get<int64_t>();
+                bool truncated = reader.Get<uint8_t>() != 0;
+                size_t length;
+                const uint8_t* args = reader.GetBytes(&length);
+                if (reader.failed) break;
+                if (id >= formats.size()) {
+                    fprintf(stderr, "%s: record with unknown format %u at offset 0x%zX\n", path, id, entry);
+                    return false;
+                }
+                const DecodedFormat& format = formats[id];
+                if (format.level < options.minLevel) break;
+                text.clear();
+                FormatLogRecord(format.format.c_str(), format.args.data(), format.args.size(), args, length, &text);
+                PrintLine(time, format.level, text.data(), text.size(), truncated, &format, options);
+                break;
+            }
+            case LOG_ENTRY_TEXT: {
+                int64_t time = reader.Get<int64_t>();
+                bool truncated = reader.Get<uint8_t>() != 0;
+                size_t length;
+                const uint8_t* bytes = reader.GetBytes(&length);
+                if (!reader.failed && options.minLevel <= LOG_INFO) {
+                    PrintLine(time, LOG_INFO, (const char*)bytes, length, truncated, nullptr, options);
+                }
+                break;
+            }
+            case LOG_ENTRY_DROPPED: {
+                int64_t time = reader.Get<int64_t>();
+                uint64_t count = reader.Get<uint64_t>();
+                if (!reader.failed) {
+                    char note[64];
+                    int length = snprintf(note, sizeof(note), "(log ring full, %llu line(s) dropped)",
+                                          (unsigned long long)count);
+                    PrintLine(time, LOG_WARNING, note, (size_t)length, false, nullptr, options);
+                }
+                break;
+            }
+            default:
+                fprintf(stderr, "%s: unknown entry type %u at offset 0x%zX\n", path, type, entry);
+                return false;
+        }
+    }
+
+    // The game may have been killed in the middle of a write
+    if (reader.failed) {
+        fprintf(stderr, "%s: cut off in the last entry\n", path);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    options.minLevel = LOG_DEBUG;
+    options.showSource = false;
+    options.utc = false;
+
+    std::vector<const char*> paths;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "-l") == 0 && i + 1 < argc) {
+            if (!ParseLevel(argv[++i], &options.minLevel)) {
+                PrintUsage();
+                return 1;
+            }
+        } else if (strcmp(arg, "-s") == 0) {
+            options.showSource = true;
+        } else if (strcmp(arg, "-u") == 0) {
+            options.utc = true;
+        } else if (arg[0] == '-') {
+            PrintUsage();
+            return 1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.empty()) {
+        PrintUsage();
+        return 1;
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!DecodeFile(paths[i], options)) ok = false;
+    }
+    return ok ? 0 : 1;
+}
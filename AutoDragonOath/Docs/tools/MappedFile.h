@@ -0,0 +1,113 @@
+// MappedFile.h - Read-only memory mapping of a whole file (Windows and POSIX)
+//
+// The tools scan Game.exe copies and dumps of 30+ MB each, often a whole
+// archive of them in one run. Mapping avoids copying every file into a
+// buffer first; pages are read in as the scanner touches them.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class MappedFile {
+public:
+    MappedFile() : data(0), size(0) {
+#ifdef _WIN32
+        file = INVALID_HANDLE_VALUE;
+        mapping = NULL;
+#endif
+    }
+
+    ~MappedFile() { Close(); }
+
+    // Maps `path` read-only. Returns false if the file cannot be opened or
+    // mapped. An empty file opens successfully with Size() == 0.
+    bool Open(const char* path) {
+        Close();
+#ifdef _WIN32
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) {
+            Close();
+            return false;
+        }
+        size = (size_t)fileSize.QuadPart;
+        if (size == 0) {
+            return true;
+        }
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping) {
+            Close();
+            return false;
+        }
+        data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            close(fd);
+            return false;
+        }
+        size = (size_t)info.st_size;
+        if (size == 0) {
+            close(fd);
+            return true;
+        }
+        void* view = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);   // The mapping keeps its own reference
+        data = (view == MAP_FAILED) ? 0 : (const uint8_t*)view;
+        if (data) {
+            madvise(view, size, MADV_SEQUENTIAL);
+        }
+#endif
+        if (!data) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close() {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data) munmap((void*)data, size);
+#endif
+        data = 0;
+        size = 0;
+    }
+
+    const uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const uint8_t* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
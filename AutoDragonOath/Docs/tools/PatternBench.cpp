@@ -0,0 +1,113 @@
+// PatternBench.cpp - Thread scaling benchmark for the HookLib pattern scanners
+//
+// Scans a seeded 32 MB random buffer at 1, 2, 4 and 8 threads. The scan is
+// done with a single signature (FindPatternParallel) and with the whole game
+// signature table (ScanParallel). The signature is planted near the end of
+// the buffer so every run covers the full range.
+//
+// Build (Linux):
+//   g++ -O2 -std=c++17 -pthread PatternBench.cpp -o PatternBench
+// Build (Windows, VS Developer Command Prompt):
+//   cl /O2 /EHsc /std:c++17 PatternBench.cpp
+//
+// Usage: PatternBench [sizeMB] [repeats]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+
+#include "../HookLib/GameSignatures.h"
+
+using namespace HookLib;
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static std::vector<uint8_t> MakeRandomImage(size_t size, uint32_t seed) {
+    std::vector<uint8_t> image(size);
+    uint32_t state = seed;
+    for (size_t i = 0; i < size; i++) {
+        state = state * 1664525u + 1013904223u;   // Numerical Recipes LCG
+        image[i] = (uint8_t)(state >> 24);
+    }
+    return image;
+}
+
+static double NowSeconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Best of `repeats` runs, in seconds
+template <typename Fn>
+static double TimeBest(int repeats, Fn fn) {
+    double best = 1e30;
+    for (int r = 0; r < repeats; r++) {
+        double start = NowSeconds();
+        fn();
+        double elapsed = NowSeconds() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+    size_t sizeMB = (argc > 1) ? (size_t)atoi(argv[1]) : 32;
+    int repeats = (argc > 2) ? atoi(argv[2]) : 5;
+    size_t size = sizeMB << 20;
+
+    std::vector<uint8_t> image = MakeRandomImage(size, 0x5EED);
+    size_t planted = size - 4096;
+    memcpy(&image[planted], kHandleRecvTalkPacket1.value, kHandleRecvTalkPacket1.length);
+
+    PatternView single = kGameSignatures[SIG_HANDLE_RECV_TALK_PACKET_1].pattern;
+    MultiPatternScanner table;
+    AddGameSignatures(&table);
+    table.Build();
+
+    printf("PatternBench: %u MB random image, best of %d, SIMD level %d, %u hardware threads\n\n",
+           (unsigned)sizeMB, repeats, (int)GetSimdLevel(), std::thread::hardware_concurrency());
+    printf("%-8s %14s %10s %9s   %14s %10s %9s\n",
+           "threads", "single (ms)", "GB/s", "speedup", "table (ms)", "GB/s", "speedup");
+
+    static const unsigned threadCounts[] = { 1, 2, 4, 8 };
+    double baseSingle = 0, baseTable = 0;
+
+    for (size_t t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); t++) {
+        unsigned threads = threadCounts[t];
+        size_t found = NPOS;
+        MultiScanMatches matches;
+
+        double singleTime = TimeBest(repeats, [&]() {
+            found = FindPatternParallel(image.data(), size, single, threads);
+        });
+        double tableTime = TimeBest(repeats, [&]() {
+            ScanParallel(table, image.data(), size, &matches, threads);
+        });
+
+        if (found != planted || matches[SIG_HANDLE_RECV_TALK_PACKET_1].size() != 1 ||
+            matches[SIG_HANDLE_RECV_TALK_PACKET_1][0] != planted) {
+            printf("ERROR: wrong result at %u threads\n", threads);
+            return 1;
+        }
+
+        if (t == 0) {
+            baseSingle = singleTime;
+            baseTable = tableTime;
+        }
+
+        double gb = (double)size / 1e9;
+        printf("%-8u %14.3f %10.2f %8.2fx   %14.3f %10.2f %8.2fx\n",
+               threads,
+               singleTime * 1000.0, gb / singleTime, baseSingle / singleTime,
+               tableTime * 1000.0, gb / tableTime, baseTable / tableTime);
+    }
+
+    return 0;
+}
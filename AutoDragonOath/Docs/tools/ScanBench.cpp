@@ -0,0 +1,484 @@
+// ScanBench.cpp - Pattern-scanning benchmark suite over reproducible corpora
+//
+// Runs every scanner engine over fixed corpora and prints GB/s, so a change
+// to the scanners shows up as numbers:
+//
+//   naive     the original byte-by-byte FindPattern loop from the DLLs
+//   scalar    anchor-byte prefilter, no SIMD
+//   sse2      16 positions per step
+//   avx2      32 positions per step (only if the CPU has it)
+//   parallel  FindPatternParallel on DefaultScanThreads() workers
+//   k=1..3    FindApproxPatterns (ApproxScan.h), up to k differing bytes
+//
+// Corpora (all seeded, so every run scans the same bytes):
+//   random    26 MB of LCG output
+//   x86       26 MB of synthetic 32-bit MSVC-style functions (prologues,
+//             mov/push/call with realistic immediates, CC padding)
+//   dump      a real Game.exe file or dump given with --dump (the largest
+//             executable section, or the whole file if it is not a PE)
+//
+// Each corpus gets a grid of signatures: length 8/16/32, wildcard density
+// 0/25/50 %, and common vs rare anchor bytes. Every signature is planted in
+// the last 4 KB so the scan covers the whole corpus; throughput counts the
+// bytes scanned up to the match. The multi-signature section resolves the
+// whole grid in one MultiPatternScanner pass versus one FindPattern each
+// (GB/s there is corpus size / total time, so the rows compare directly).
+// The approximate section runs the Shift-And scanner over the whole corpus
+// for the rare-anchor signatures. The latency section times each
+// GameSignatures.h entry with its compiled matcher (Signature.h) and with
+// the runtime PatternView.
+//
+// Build (Linux):
+//   g++ -O2 -std=c++17 -pthread ScanBench.cpp -o ScanBench
+// Build (Windows, VS Developer Command Prompt):
+//   cl /O2 /EHsc /std:c++17 ScanBench.cpp
+//
+// Usage: ScanBench [--dump Game.exe] [--size MB] [--repeats N] [--csv]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../HookLib/GameSignatures.h"
+#include "MappedFile.h"
+
+using namespace HookLib;
+
+static const uint32_t CORPUS_SEED = 0x5EED;
+static const uint32_t SIGNATURE_SEED = 0x51C0;
+static const size_t PLANT_AREA = 4096;   // Signatures go into the last 4 KB
+
+struct Options {
+    size_t sizeMB;
+    int repeats;
+    bool csv;
+    const char* dumpPath;
+};
+
+struct Corpus {
+    std::string name;
+    std::vector<uint8_t> bytes;
+};
+
+struct BenchSignature {
+    std::string label;      // e.g. "len16 w25 rare"
+    Pattern pattern;
+    std::string legacyMask; // "xx?x" form for the naive loop
+    size_t planted;
+};
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+struct Lcg {
+    explicit Lcg(uint32_t seed) : state(seed) {}
+    uint32_t Next() {
+        state = state * 1664525u + 1013904223u;   // Numerical Recipes LCG
+        return state >> 8;
+    }
+    uint32_t Below(uint32_t n) { return Next() % n; }
+    uint32_t state;
+};
+
+static double NowSeconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Best of `repeats` runs, in seconds
+template <typename Fn>
+static double TimeBest(int repeats, Fn fn) {
+    double best = 1e30;
+    for (int r = 0; r < repeats; r++) {
+        double start = NowSeconds();
+        fn();
+        double elapsed = NowSeconds() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+// The loop every DLL used before HookLib, kept as the baseline
+static size_t NaiveFindPattern(const uint8_t* data, size_t size, const uint8_t* pattern, const char* mask) {
+    size_t patternLength = strlen(mask);
+    for (size_t i = 0; i < size - patternLength; i++) {
+        bool found = true;
+        for (size_t j = 0; j < patternLength; j++) {
+            if (mask[j] != '?' && pattern[j] != data[i + j]) {
+                found = false;
+                break;
+            }
+        }
+        if (found) {
+            return i;
+        }
+    }
+    return NPOS;
+}
+
+static const char* SimdLevelName(SimdLevel level) {
+    switch (level) {
+        case SIMD_AVX2: return "avx2";
+        case SIMD_SSE2: return "sse2";
+        default:        return "scalar";
+    }
+}
+
+// ============================================================================
+// CORPORA
+// ============================================================================
+
+static Corpus MakeRandomCorpus(size_t size) {
+    Corpus corpus;
+    corpus.name = "random";
+    corpus.bytes.resize(size);
+    Lcg rng(CORPUS_SEED);
+    for (size_t i = 0; i < size; i++) {
+        corpus.bytes[i] = (uint8_t)rng.Next();
+    }
+    return corpus;
+}
+
+// Immediates in real code are mostly small, displacements mostly near 0
+static void EmitImm32(std::vector<uint8_t>& out, Lcg& rng) {
+    uint32_t value = (rng.Below(4) == 0) ? 0x00400000 + rng.Below(0x300000) : rng.Below(0x200);
+    for (int i = 0; i < 4; i++) out.push_back((uint8_t)(value >> (8 * i)));
+}
+
+static void EmitInstruction(std::vector<uint8_t>& out, Lcg& rng) {
+    static const uint8_t modrmEbp[] = { 0x45, 0x4D, 0x55, 0x5D, 0x75, 0x7D };
+    switch (rng.Below(12)) {
+        case 0: case 1: case 2:                               // mov r32, [ebp+disp8]
+            out.push_back(0x8B); out.push_back(modrmEbp[rng.Below(6)]);
+            out.push_back((uint8_t)(0x08 + 4 * rng.Below(8)));
+            break;
+        case 3:                                               // mov [ebp-disp8], r32
+            out.push_back(0x89); out.push_back(modrmEbp[rng.Below(6)]);
+            out.push_back((uint8_t)(0x100 - 4 * (1 + rng.Below(16))));
+            break;
+        case 4:                                               // push r32
+            out.push_back((uint8_t)(0x50 + rng.Below(8)));
+            break;
+        case 5: {                                             // call rel32
+            out.push_back(0xE8);
+            int32_t rel = (int32_t)rng.Below(0x100000) - 0x80000;
+            for (int i = 0; i < 4; i++) out.push_back((uint8_t)((uint32_t)rel >> (8 * i)));
+            break;
+        }
+        case 6:                                               // add esp, imm8
+            out.push_back(0x83); out.push_back(0xC4); out.push_back((uint8_t)(4 * (1 + rng.Below(6))));
+            break;
+        case 7:                                               // test eax, eax / jz short
+            out.push_back(0x85); out.push_back(0xC0);
+            out.push_back(0x74); out.push_back((uint8_t)rng.Below(0x40));
+            break;
+        case 8:                                               // mov eax, [abs32]
+            out.push_back(0xA1); EmitImm32(out, rng);
+            break;
+        case 9:                                               // push imm32
+            out.push_back(0x68); EmitImm32(out, rng);
+            break;
+        case 10:                                              // lea ecx, [ebp+disp8]
+            out.push_back(0x8D); out.push_back(0x4D); out.push_back((uint8_t)rng.Below(0x100));
+            break;
+        default:                                              // xor r32, r32
+            out.push_back(0x33); out.push_back((uint8_t)(0xC0 + 9 * rng.Below(8)));
+            break;
+    }
+}
+
+static Corpus MakeX86Corpus(size_t size) {
+    Corpus corpus;
+    corpus.name = "x86";
+    std::vector<uint8_t>& out = corpus.bytes;
+    out.reserve(size + 256);
+    Lcg rng(CORPUS_SEED);
+
+    while (out.size() < size) {
+        // push ebp; mov ebp, esp; sub esp, imm8; push ebx/esi/edi
+        static const uint8_t prologue[] = { 0x55, 0x8B, 0xEC, 0x83, 0xEC };
+        out.insert(out.end(), prologue, prologue + sizeof(prologue));
+        out.push_back((uint8_t)(4 * (1 + rng.Below(32))));
+        for (uint32_t i = rng.Below(4); i > 0; i--) out.push_back((uint8_t)(0x58 - i));
+
+        for (uint32_t i = 4 + rng.Below(60); i > 0; i--) EmitInstruction(out, rng);
+
+        // pop edi/esi/ebx; mov esp, ebp; pop ebp; ret
+        static const uint8_t epilogue[] = { 0x5F, 0x5E, 0x5B, 0x8B, 0xE5, 0x5D, 0xC3 };
+        out.insert(out.end(), epilogue, epilogue + sizeof(epilogue));
+        while (out.size() % 16) out.push_back(0xCC);
+    }
+    out.resize(size);
+    return corpus;
+}
+
+// Largest executable section of a PE file or dump, else the whole file
+static bool LoadDumpCorpus(const char* path, Corpus* corpus) {
+    MappedFile file;
+    if (!file.Open(path) || file.Size() < PLANT_AREA) {
+        return false;
+    }
+
+    PeImage pe;
+    if (!pe.Parse(file.Data(), file.Size(), PE_LAYOUT_FILE) || file.Size() == pe.sizeOfImage) {
+        pe.Parse(file.Data(), file.Size(), PE_LAYOUT_MAPPED);
+    }
+
+    size_t begin = 0, end = file.Size();
+    if (pe.IsValid()) {
+        size_t best = 0;
+        for (size_t i = 0; i < pe.SectionCount(); i++) {
+            size_t b, e;
+            if (pe.Section(i).IsExecutable() && pe.SectionRange(i, &b, &e) && e - b > best) {
+                best = e - b;
+                begin = b;
+                end = e;
+            }
+        }
+    }
+    if (end - begin < PLANT_AREA) {
+        return false;
+    }
+
+    corpus->name = "dump";
+    corpus->bytes.assign(file.Data() + begin, file.Data() + end);
+    return true;
+}
+
+// ============================================================================
+// SIGNATURE GRID
+// ============================================================================
+
+static uint8_t CommonByte(Lcg& rng) {
+    static const uint8_t common[] = { 0x00, 0xFF, 0x8B, 0xCC, 0x45, 0x4D, 0x55, 0x75, 0x89, 0x85,
+                                      0x24, 0xE8, 0x83, 0xC4, 0xEC, 0x50, 0x56, 0x57, 0x5D, 0xC3 };
+    return common[rng.Below(sizeof(common))];
+}
+
+// Bytes ByteCommonness() ranks lowest
+static uint8_t RareByte(Lcg& rng) {
+    static const uint8_t rare[] = { 0x9B, 0xA7, 0xB3, 0xD6, 0xDE, 0xE1, 0xF1, 0x97 };
+    return rare[rng.Below(sizeof(rare))];
+}
+
+// Plants every grid signature into the last PLANT_AREA bytes of the corpus
+static std::vector<BenchSignature> MakeSignatureGrid(Corpus* corpus) {
+    static const size_t lengths[] = { 8, 16, 32 };
+    static const int wildcardPercents[] = { 0, 25, 50 };
+
+    std::vector<BenchSignature> grid;
+    Lcg rng(SIGNATURE_SEED);
+    size_t plantAt = corpus->bytes.size() - PLANT_AREA;
+
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        for (size_t w = 0; w < sizeof(wildcardPercents) / sizeof(wildcardPercents[0]); w++) {
+            for (int rare = 0; rare <= 1; rare++) {
+                size_t length = lengths[l];
+                std::vector<uint8_t> value(length), mask(length, MASK_EXACT);
+                for (size_t i = 0; i < length; i++) value[i] = CommonByte(rng);
+                for (size_t i = 1; i + 1 < length; i++) {   // First and last byte stay exact
+                    if ((int)rng.Below(100) < wildcardPercents[w]) mask[i] = MASK_WILDCARD;
+                }
+                if (rare) value[length / 2] = RareByte(rng), mask[length / 2] = MASK_EXACT;
+
+                BenchSignature signature;
+                char label[64];
+                snprintf(label, sizeof(label), "len%u w%d %s", (unsigned)length, wildcardPercents[w],
+                         rare ? "rare" : "common");
+                signature.label = label;
+                signature.pattern = Pattern(value.data(), mask.data(), length);
+                for (size_t i = 0; i < length; i++) signature.legacyMask += (mask[i] ? 'x' : '?');
+
+                memcpy(&corpus->bytes[plantAt], value.data(), length);
+                signature.planted = plantAt;
+                plantAt += length + 8;
+                grid.push_back(signature);
+            }
+        }
+    }
+    return grid;
+}
+
+// ============================================================================
+// REPORTING
+// ============================================================================
+
+static void PrintHeader(const Options& options) {
+    if (options.csv) {
+        printf("corpus,section,signature,engine,ms,gbps,found\n");
+    }
+}
+
+static void Report(const Options& options, const Corpus& corpus, const char* section, const std::string& label,
+                   const char* engine, double seconds, size_t scannedBytes, size_t found) {
+    double gbps = seconds > 0 ? scannedBytes / seconds / 1e9 : 0.0;
+    if (options.csv) {
+        printf("%s,%s,%s,%s,%.4f,%.3f,%lld\n", corpus.name.c_str(), section, label.c_str(), engine,
+               seconds * 1000.0, gbps, found == NPOS ? -1LL : (long long)found);
+    } else {
+        printf("  %-24s %-9s %10.3f ms %8.2f GB/s%s\n", label.c_str(), engine, seconds * 1000.0, gbps,
+               found == NPOS ? "  (no match)" : "");
+    }
+}
+
+// ============================================================================
+// BENCHMARKS
+// ============================================================================
+
+static void BenchSingle(const Options& options, const Corpus& corpus, const std::vector<BenchSignature>& grid) {
+    const uint8_t* data = corpus.bytes.data();
+    size_t size = corpus.bytes.size();
+    unsigned threads = DefaultScanThreads();
+
+    if (!options.csv) printf("\n[%s] single signature, %.1f MB\n", corpus.name.c_str(), size / 1048576.0);
+
+    for (size_t s = 0; s < grid.size(); s++) {
+        const BenchSignature& signature = grid[s];
+        PatternView view = signature.pattern.View();
+        size_t found = NPOS;
+
+        double t = TimeBest(options.repeats, [&]() {
+            found = NaiveFindPattern(data, size, view.value, signature.legacyMask.c_str());
+        });
+        Report(options, corpus, "single", signature.label, "naive", t, found == NPOS ? size : found, found);
+
+        for (int level = SIMD_SCALAR; level <= (int)GetSimdLevel(); level++) {
+            t = TimeBest(options.repeats, [&]() { found = FindPatternWith((SimdLevel)level, data, size, view); });
+            Report(options, corpus, "single", signature.label, SimdLevelName((SimdLevel)level), t,
+                   found == NPOS ? size : found, found);
+        }
+
+        t = TimeBest(options.repeats, [&]() { found = FindPatternParallel(data, size, view, threads); });
+        Report(options, corpus, "single", signature.label, "parallel", t, found == NPOS ? size : found, found);
+    }
+}
+
+static void BenchMulti(const Options& options, const Corpus& corpus, const std::vector<BenchSignature>& grid) {
+    const uint8_t* data = corpus.bytes.data();
+    size_t size = corpus.bytes.size();
+    char label[64];
+    snprintf(label, sizeof(label), "%u signatures", (unsigned)grid.size());
+
+    if (!options.csv) printf("\n[%s] whole grid at once\n", corpus.name.c_str());
+
+    size_t lastFound = 0;   // Keeps the calls from being optimized away
+    double t = TimeBest(options.repeats, [&]() {
+        for (size_t s = 0; s < grid.size(); s++) lastFound = FindPattern(data, size, grid[s].pattern.View());
+    });
+    Report(options, corpus, "multi", label, "separate", t, size, lastFound);
+
+    MultiPatternScanner scanner;
+    for (size_t s = 0; s < grid.size(); s++) scanner.Add(grid[s].pattern.View());
+    scanner.Build();
+
+    MultiScanMatches matches;
+    t = TimeBest(options.repeats, [&]() { scanner.Scan(data, size, &matches); });
+    Report(options, corpus, "multi", label, "onepass", t, size, matches.back().empty() ? NPOS : matches.back()[0]);
+
+    t = TimeBest(options.repeats, [&]() { ScanParallel(scanner, data, size, &matches, DefaultScanThreads()); });
+    Report(options, corpus, "multi", label, "parallel", t, size, matches.back().empty() ? NPOS : matches.back()[0]);
+}
+
+// FindApproxPatterns as ResolveGameSignature uses it, for k = 1..3. It
+// never stops early, so every row scans the whole corpus.
+static void BenchApprox(const Options& options, const Corpus& corpus, const std::vector<BenchSignature>& grid) {
+    const uint8_t* data = corpus.bytes.data();
+    size_t size = corpus.bytes.size();
+
+    if (!options.csv) printf("\n[%s] approximate, up to k differing bytes\n", corpus.name.c_str());
+
+    std::vector<ApproxMatch> best;
+    for (size_t s = 0; s < grid.size(); s++) {
+        if (grid[s].label.find("rare") == std::string::npos) continue;
+        for (unsigned k = 1; k <= 3; k++) {
+            char engine[16];
+            snprintf(engine, sizeof(engine), "k=%u", k);
+            double t = TimeBest(options.repeats, [&]() {
+                FindApproxPatterns(data, size, grid[s].pattern.View(), k, 5, &best);
+            });
+            Report(options, corpus, "approx", grid[s].label, engine, t, size, best.empty() ? NPOS : best[0].offset);
+        }
+    }
+}
+
+// Time to resolve each game signature over the corpus (usually a miss,
+// i.e. the worst case the DLL sees)
+static void BenchGameLatency(const Options& options, const Corpus& corpus) {
+    const uint8_t* data = corpus.bytes.data();
+    size_t size = corpus.bytes.size();
+    SimdLevel level = GetSimdLevel();
+
+    if (!options.csv) printf("\n[%s] GameSignatures.h latency\n", corpus.name.c_str());
+
+    for (int i = 0; i < SIG_COUNT; i++) {
+        const GameSignature& signature = kGameSignatures[i];
+        size_t last = size - signature.pattern.length;
+        size_t found = NPOS;
+
+        double t = TimeBest(options.repeats, [&]() { found = signature.find(level, data, 0, last); });
+        Report(options, corpus, "latency", signature.name, "compiled", t, found == NPOS ? size : found, found);
+
+        t = TimeBest(options.repeats, [&]() { found = FindPattern(data, size, signature.pattern); });
+        Report(options, corpus, "latency", signature.name, "runtime", t, found == NPOS ? size : found, found);
+    }
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+    Options options;
+    options.sizeMB = 26;
+    options.repeats = 3;
+    options.csv = false;
+    options.dumpPath = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--csv") == 0) {
+            options.csv = true;
+        } else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+            options.dumpPath = argv[++i];
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            options.sizeMB = (size_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--repeats") == 0 && i + 1 < argc) {
+            options.repeats = atoi(argv[++i]);
+        } else {
+            printf("Usage: ScanBench [--dump Game.exe] [--size MB] [--repeats N] [--csv]\n");
+            return 1;
+        }
+    }
+    if (options.sizeMB == 0) options.sizeMB = 1;
+    if (options.repeats < 1) options.repeats = 1;
+
+    std::vector<Corpus> corpora;
+    corpora.push_back(MakeRandomCorpus(options.sizeMB << 20));
+    corpora.push_back(MakeX86Corpus(options.sizeMB << 20));
+    if (options.dumpPath) {
+        Corpus dump;
+        if (!LoadDumpCorpus(options.dumpPath, &dump)) {
+            printf("Cannot use %s as a corpus\n", options.dumpPath);
+            return 1;
+        }
+        corpora.push_back(dump);
+    }
+
+    if (!options.csv) {
+        printf("ScanBench: best of %d, SIMD level %s, %u scan threads\n", options.repeats,
+               SimdLevelName(GetSimdLevel()), DefaultScanThreads());
+    }
+    PrintHeader(options);
+
+    for (size_t c = 0; c < corpora.size(); c++) {
+        BenchGameLatency(options, corpora[c]);   // Before planting, so misses stay misses
+        std::vector<BenchSignature> grid = MakeSignatureGrid(&corpora[c]);
+        BenchSingle(options, corpora[c], grid);
+        BenchMulti(options, corpora[c], grid);
+        BenchApprox(options, corpora[c], grid);
+    }
+    return 0;
+}
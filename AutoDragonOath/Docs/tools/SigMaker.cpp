@@ -0,0 +1,447 @@
+// SigMaker.cpp - Shortest unique signature for a function in Game.exe
+//
+// Replaces the hand conversion in MEMORY_SCANNER_TO_HOOK_WORKFLOW.md ("take
+// the first 16 bytes, add 0x, write a mask"). Given an image and one or more
+// addresses, it prints for each the shortest signature starting there that
+// matches nowhere else in the executable sections, ready to paste into
+// GameSignatures.h.
+//
+// Operands that a relink changes without the code changing are wildcarded:
+// rel32 branch displacements (call / jmp / jcc), RIP-relative displacements,
+// bytes on relocated DWORDs (.reloc), and 32-bit operands that look like an
+// address in the image (for images without .reloc). With -i every immediate
+// and displacement is wildcarded as well (stack frame sizes, structure
+// offsets), which survives more patches at the cost of longer signatures.
+//
+// All executable sections go into one suffix array (SuffixArray.h), built
+// once. Per address, the leading run of exact bytes selects the other
+// positions that share it with two binary searches; only those are compared
+// further, so each signature costs microseconds instead of a scan.
+//
+// Build (Linux):
+//   g++ -O2 -std=c++17 -pthread SigMaker.cpp -o SigMaker
+// Build (Windows, VS Developer Command Prompt):
+//   cl /O2 /EHsc /std:c++17 SigMaker.cpp
+//
+// Usage: SigMaker [options] <image> <address>...
+//   --file / --dump  layout of <image> (default: size == SizeOfImage is a dump)
+//   -i               also wildcard every immediate and displacement
+//   -m N             at least N bytes (default 8)
+//   -n N             give up after N bytes (default 64)
+//   --verify         rescan the image with the results (SectionScan.h)
+// Addresses are VAs (0x0048D6F0) or RVAs (0x8D6F0), in hex.
+//
+// Exit status: 0 if every address got a unique signature, 1 otherwise.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../HookLib/Relocations.h"
+#include "../HookLib/SectionScan.h"
+#include "../HookLib/X86Decode.h"
+#include "MappedFile.h"
+#include "SuffixArray.h"
+
+using namespace HookLib;
+
+struct Options {
+    bool forceFile;
+    bool forceDump;
+    bool wildcardOperands;
+    size_t minLength;
+    size_t maxLength;
+    bool verify;
+};
+
+// A piece of the suffix array text: one scan region, followed by enough of
+// the image after it that a signature starting at its end is complete
+struct TextSegment {
+    size_t textBegin;
+    size_t imageBegin;
+    size_t starts;      // Positions that may start a match (the region size)
+};
+
+enum SigStatus {
+    SIG_UNIQUE = 0,
+    SIG_NOT_UNIQUE,     // Another position matches all maxLength bytes
+    SIG_NOT_CODE,       // Address outside the executable sections
+    SIG_UNDECODABLE     // First instruction could not be decoded
+};
+
+struct SigResult {
+    SigStatus status;
+    std::vector<uint8_t> value;
+    std::vector<uint8_t> mask;
+    size_t instructions;
+    size_t duplicates;
+};
+
+struct CodeIndex {
+    const PeImage* pe;
+    const RelocationTable* relocations;
+    std::vector<TextSegment> segments;
+    std::vector<uint8_t> text;
+    SuffixArray suffixes;
+};
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static double NowSeconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void PrintUsage() {
+    printf("Usage: SigMaker [--file | --dump] [-i] [-m min] [-n max] [--verify] <image> <address>...\n");
+}
+
+static std::string FormatSignature(const std::vector<uint8_t>& value, const std::vector<uint8_t>& mask) {
+    std::string text;
+    char byte[4];
+    for (size_t j = 0; j < value.size(); j++) {
+        if (j > 0) text += ' ';
+        if (mask[j] == MASK_WILDCARD) {
+            text += "??";
+        } else {
+            snprintf(byte, sizeof(byte), "%02X", value[j]);
+            text += byte;
+        }
+    }
+    return text;
+}
+
+// Image offset of a suffix array position
+static size_t TextToImage(const CodeIndex& index, size_t position) {
+    size_t lo = 0, hi = index.segments.size();
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (index.segments[mid].textBegin <= position) lo = mid; else hi = mid;
+    }
+    return index.segments[lo].imageBegin + (position - index.segments[lo].textBegin);
+}
+
+static bool InCode(const CodeIndex& index, size_t offset) {
+    for (size_t s = 0; s < index.segments.size(); s++) {
+        const TextSegment& segment = index.segments[s];
+        if (offset >= segment.imageBegin && offset - segment.imageBegin < segment.starts) return true;
+    }
+    return false;
+}
+
+// ============================================================================
+// INDEX
+// ============================================================================
+
+static void BuildIndex(const PeImage& pe, const RelocationTable& relocations, size_t maxLength,
+                       CodeIndex* index) {
+    index->pe = &pe;
+    index->relocations = &relocations;
+
+    std::vector<ScanRegion> regions;
+    CollectScanRegions(pe, SIGNATURE_CODE, &regions);
+    for (size_t r = 0; r < regions.size(); r++) {
+        size_t end = (pe.Size() - regions[r].end < maxLength) ? pe.Size() : regions[r].end + maxLength;
+        TextSegment segment = { index->text.size(), regions[r].begin, regions[r].end - regions[r].begin };
+        index->segments.push_back(segment);
+        index->text.insert(index->text.end(), pe.Data() + regions[r].begin, pe.Data() + end);
+    }
+    index->suffixes.Build(index->text.data(), index->text.size());
+}
+
+// ============================================================================
+// SIGNATURE
+// ============================================================================
+
+// Bytes of the instructions from `offset`, unstable operands wildcarded.
+// *ends receives the end of each instruction, relative to offset.
+static void MaskInstructions(const CodeIndex& index, size_t offset, const Options& options,
+                             std::vector<uint8_t>* value, std::vector<uint8_t>* mask, std::vector<size_t>* ends) {
+    const PeImage& pe = *index.pe;
+    X86Mode mode = pe.Is64Bit() ? X86_MODE_64 : X86_MODE_32;
+
+    size_t at = offset;
+    while (at - offset < options.maxLength) {
+        X86Instruction ins;
+        if (!DecodeX86(pe.Data() + at, pe.Size() - at, mode, &ins)) {
+            break;
+        }
+
+        const uint8_t* p = pe.Data() + at;
+        for (size_t j = 0; j < ins.length; j++) {
+            bool unstable = index.relocations->Covers(at + j);
+            bool inDisp = ins.dispSize != 0 && j >= ins.dispOffset && j < (size_t)ins.dispOffset + ins.dispSize;
+            bool inImm = ins.immSize != 0 && j >= ins.immOffset && j < (size_t)ins.immOffset + ins.immSize;
+
+            if (inImm && ins.relative && ins.immSize >= 4) unstable = true;
+            if (inDisp && ins.ripRelative) unstable = true;
+            if ((inDisp || inImm) && options.wildcardOperands) unstable = true;
+            if (inDisp && ins.dispSize == 4 && index.relocations->LooksLikeAddress(ReadLe32(p + ins.dispOffset))) {
+                unstable = true;
+            }
+            if (inImm && ins.immSize == 4 && index.relocations->LooksLikeAddress(ReadLe32(p + ins.immOffset))) {
+                unstable = true;
+            }
+
+            value->push_back(unstable ? 0 : p[j]);
+            mask->push_back(unstable ? MASK_WILDCARD : MASK_EXACT);
+        }
+        at += ins.length;
+        ends->push_back(at - offset);
+    }
+}
+
+// First byte where the signature does not match at `candidate`, or
+// value.size() if it matches throughout. Like the resolver, bytes that are
+// wildcards in the reloc prefilter may differ on relocated slots.
+static size_t FirstMismatch(const CodeIndex& index, size_t candidate, const std::vector<uint8_t>& value,
+                            const std::vector<uint8_t>& mask, const PatternView& prefilter) {
+    const PeImage& pe = *index.pe;
+    for (size_t j = 0; j < value.size(); j++) {
+        if (candidate + j >= pe.Size()) {
+            return j;
+        }
+        if ((pe.Data()[candidate + j] & mask[j]) != value[j] &&
+            !(prefilter.mask[j] == MASK_WILDCARD && index.relocations->Covers(candidate + j))) {
+            return j;
+        }
+    }
+    return value.size();
+}
+
+// Code positions other than `target` whose bytes at +lead are key[0, length)
+static size_t CountOthers(const CodeIndex& index, size_t target, const uint8_t* key, size_t length, size_t lead) {
+    size_t first, last, others = 0;
+    index.suffixes.Range(key, length, &first, &last);
+    for (size_t rank = first; rank < last; rank++) {
+        size_t candidate = TextToImage(index, index.suffixes.At(rank)) - lead;
+        if (candidate != target && InCode(index, candidate)) others++;
+    }
+    return others;
+}
+
+static void MakeSignature(const CodeIndex& index, size_t target, const Options& options, SigResult* result) {
+    result->value.clear();
+    result->mask.clear();
+    result->instructions = 0;
+    result->duplicates = 0;
+
+    if (!InCode(index, target)) {
+        result->status = SIG_NOT_CODE;
+        return;
+    }
+
+    std::vector<uint8_t> value, mask;
+    std::vector<size_t> ends;
+    MaskInstructions(index, target, options, &value, &mask, &ends);
+    if (ends.empty()) {
+        result->status = SIG_UNDECODABLE;
+        return;
+    }
+
+    // The run of bytes the resolver compares exactly, right at the start
+    // (after an operand tail the reloc prefilter wildcards, if any). Every
+    // position that matches must share it, and the suffix array lists those.
+    Pattern prefilter = RelocPrefilter(Pattern(value.data(), mask.data(), value.size()).View(), *index.relocations);
+    PatternView loose = prefilter.View();
+    size_t lead = 0;
+    while (lead < value.size() && loose.mask[lead] != MASK_EXACT) lead++;
+    size_t run = 0;
+    while (lead + run < value.size() && loose.mask[lead + run] == MASK_EXACT) run++;
+
+    size_t first, last;
+    index.suffixes.Range(value.data() + lead, run, &first, &last);
+    size_t need = 0;
+    bool sharedRun = false;
+    for (size_t rank = first; rank < last; rank++) {
+        size_t candidate = TextToImage(index, index.suffixes.At(rank)) - lead;
+        if (candidate == target || !InCode(index, candidate)) continue;
+
+        sharedRun = true;
+        size_t mismatch = FirstMismatch(index, candidate, value, mask, loose);
+        if (mismatch == value.size()) {
+            result->duplicates++;
+        } else if (mismatch + 1 > need) {
+            need = mismatch + 1;
+        }
+    }
+
+    if (!sharedRun) {
+        // Unique within the run already: shorten it while it stays unique
+        size_t shortest = run;
+        while (shortest > 1 && CountOthers(index, target, value.data() + lead, shortest - 1, lead) == 0) shortest--;
+        need = lead + shortest;
+    }
+    if (result->duplicates > 0) {
+        result->status = SIG_NOT_UNIQUE;
+        result->value = value;
+        result->mask = mask;
+        result->instructions = ends.size();
+        return;
+    }
+
+    // Whole instructions, at least minLength bytes, no trailing wildcards
+    if (need < options.minLength) need = options.minLength;
+    size_t instructions = 0;
+    while (instructions < ends.size() && ends[instructions] < need) instructions++;
+    size_t length = (instructions < ends.size()) ? ends[instructions] : ends.back();
+    instructions = (instructions < ends.size()) ? instructions + 1 : ends.size();
+    while (length > 0 && mask[length - 1] == MASK_WILDCARD) length--;
+
+    result->status = SIG_UNIQUE;
+    result->value.assign(value.begin(), value.begin() + length);
+    result->mask.assign(mask.begin(), mask.begin() + length);
+    result->instructions = instructions;
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+    Options options;
+    options.forceFile = false;
+    options.forceDump = false;
+    options.wildcardOperands = false;
+    options.minLength = 8;
+    options.maxLength = 64;
+    options.verify = false;
+
+    const char* path = nullptr;
+    std::vector<unsigned long long> addresses;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--file") == 0) {
+            options.forceFile = true;
+        } else if (strcmp(arg, "--dump") == 0) {
+            options.forceDump = true;
+        } else if (strcmp(arg, "-i") == 0) {
+            options.wildcardOperands = true;
+        } else if (strcmp(arg, "--verify") == 0) {
+            options.verify = true;
+        } else if (strcmp(arg, "-m") == 0 && i + 1 < argc) {
+            options.minLength = (size_t)atoi(argv[++i]);
+        } else if (strcmp(arg, "-n") == 0 && i + 1 < argc) {
+            int maxLength = atoi(argv[++i]);
+            options.maxLength = (maxLength < 1) ? 1 : (size_t)maxLength;
+        } else if (arg[0] == '-') {
+            PrintUsage();
+            return 1;
+        } else if (path == nullptr) {
+            path = arg;
+        } else {
+            addresses.push_back(strtoull(arg, nullptr, 16));
+        }
+    }
+    if (path == nullptr || addresses.empty()) {
+        PrintUsage();
+        return 1;
+    }
+
+    MappedFile file;
+    if (!file.Open(path)) {
+        printf("%s: cannot open\n", path);
+        return 1;
+    }
+
+    PeImage pe;
+    bool isPe = pe.Parse(file.Data(), file.Size(), PE_LAYOUT_FILE);
+    bool isDump = options.forceDump || (!options.forceFile && isPe && file.Size() == pe.sizeOfImage);
+    if (isPe && isDump) {
+        pe.Parse(file.Data(), file.Size(), PE_LAYOUT_MAPPED);
+    }
+    if (!isPe) {
+        printf("%s: not a PE image\n", path);
+        return 1;
+    }
+
+    RelocationTable relocations;
+    relocations.Load(pe);
+
+    double start = NowSeconds();
+    CodeIndex index;
+    BuildIndex(pe, relocations, options.maxLength, &index);
+    double built = NowSeconds();
+    printf("%s: %s, %.1f MB of code indexed in %.2f s, %u relocated DWORDs\n\n", path,
+           isDump ? "memory dump" : "file", index.text.size() / 1048576.0, built - start,
+           (unsigned)relocations.Count());
+
+    std::vector<SigResult> results(addresses.size());
+    std::vector<size_t> offsets(addresses.size());
+    for (size_t i = 0; i < addresses.size(); i++) {
+        unsigned long long rva = addresses[i];
+        if (rva >= pe.imageBase) rva -= pe.imageBase;
+        offsets[i] = pe.RvaToOffset((size_t)rva);
+        if (offsets[i] == (size_t)-1) {
+            results[i].status = SIG_NOT_CODE;
+            continue;
+        }
+        MakeSignature(index, offsets[i], options, &results[i]);
+    }
+    double made = NowSeconds();
+
+    bool allUnique = true;
+    for (size_t i = 0; i < addresses.size(); i++) {
+        const SigResult& result = results[i];
+        unsigned long long rva = (addresses[i] >= pe.imageBase) ? addresses[i] - pe.imageBase : addresses[i];
+        printf("VA 0x%08llX (RVA 0x%08llX): ", (unsigned long long)(pe.imageBase + rva), rva);
+
+        switch (result.status) {
+            case SIG_UNIQUE:
+                printf("unique with %u bytes (%u instructions)\n", (unsigned)result.value.size(),
+                       (unsigned)result.instructions);
+                printf("  %s\n", FormatSignature(result.value, result.mask).c_str());
+                printf("  HOOKLIB_SIGNATURE(\"%s\")\n\n", FormatSignature(result.value, result.mask).c_str());
+                break;
+            case SIG_NOT_UNIQUE:
+                printf("not unique within %u bytes, %u identical copies\n  %s\n\n", (unsigned)result.value.size(),
+                       (unsigned)result.duplicates, FormatSignature(result.value, result.mask).c_str());
+                allUnique = false;
+                break;
+            case SIG_NOT_CODE:
+                printf("not in an executable section\n\n");
+                allUnique = false;
+                break;
+            default:
+                printf("cannot decode the instruction there\n\n");
+                allUnique = false;
+                break;
+        }
+    }
+    printf("%u signature(s) in %.2f ms\n", (unsigned)addresses.size(), (made - built) * 1000.0);
+
+    if (options.verify) {
+        // One reloc-aware pass over the code, the way the DLLs resolve them
+        MultiPatternScanner scanner;
+        scanner.SetRelocations(&relocations);
+        std::vector<Pattern> patterns;
+        std::vector<size_t> owners;
+        for (size_t i = 0; i < results.size(); i++) {
+            if (results[i].status != SIG_UNIQUE) continue;
+            patterns.push_back(Pattern(results[i].value.data(), results[i].mask.data(), results[i].value.size()));
+            owners.push_back(i);
+        }
+        for (size_t p = 0; p < patterns.size(); p++) scanner.Add(patterns[p].View());
+        scanner.Build();
+
+        MultiScanMatches matches;
+        ScanSections(scanner, pe, &matches, SIGNATURE_CODE, DefaultScanThreads());
+        size_t failed = 0;
+        for (size_t p = 0; p < owners.size(); p++) {
+            if (matches[p].size() != 1 || matches[p][0] != offsets[owners[p]]) {
+                printf("verify: signature for 0x%08llX matched %u time(s)\n", addresses[owners[p]],
+                       (unsigned)matches[p].size());
+                failed++;
+                allUnique = false;
+            }
+        }
+        printf("verify: %u of %u signature(s) resolve to their address\n", (unsigned)(owners.size() - failed),
+               (unsigned)owners.size());
+    }
+    return allUnique ? 0 : 1;
+}
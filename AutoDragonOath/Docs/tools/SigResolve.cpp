@@ -0,0 +1,266 @@
+// SigResolve.cpp - Check the hook signatures against Game.exe files and dumps offline
+//
+// Memory-maps each file and runs the same signature table and scanner as the
+// DLLs (HookLib/GameSignatures.h). For every signature it prints the number
+// of matches, whether the match is unique, and its RVA/VA next to the
+// expected offset. No game, no injection, no Windows needed. Bytes on
+// relocated DWORDs are ignored, like in the DLLs (HookLib/Relocations.h).
+//
+// Build (Linux):
+//   g++ -O2 -std=c++17 -pthread SigResolve.cpp -o SigResolve
+// Build (Windows, VS Developer Command Prompt):
+//   cl /O2 /EHsc /std:c++17 SigResolve.cpp
+//
+// Usage: SigResolve [options] <file>...
+//   --file          treat inputs as PE files as stored on disk
+//   --dump          treat inputs as memory dumps of the loaded module (offset == RVA)
+//                   (default: a PE whose size equals SizeOfImage is a dump)
+//   -p "55 8B ??"   also resolve this signature (IDA style, may repeat)
+//   -k N            for missing signatures, list the closest matches with up to
+//                   N differing bytes (ApproxScan.h)
+//   -t N            scan threads (default: all cores, up to 8)
+//   -q              one summary line per file, for batch runs over many versions
+//
+// Exit status: 0 if every file was read, 1 otherwise.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../HookLib/GameSignatures.h"
+#include "MappedFile.h"
+
+using namespace HookLib;
+
+enum LayoutOption {
+    LAYOUT_AUTO = 0,
+    LAYOUT_FORCE_FILE,
+    LAYOUT_FORCE_DUMP
+};
+
+struct Options {
+    LayoutOption layout;
+    unsigned threads;
+    unsigned maxMismatches;
+    bool brief;
+    std::vector<std::string> extraText;
+    std::vector<Pattern> extraPatterns;
+};
+
+// Matches longer than this are summarized as "... N more"
+static const size_t MAX_LISTED_MATCHES = 8;
+static const size_t MAX_APPROX_CANDIDATES = 5;
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static double NowSeconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void PrintUsage() {
+    printf("Usage: SigResolve [--file | --dump] [-p \"55 8B ??\"]... [-k mismatches] [-t threads] [-q] <file>...\n");
+}
+
+// Buffer offsets -> RVAs (identity for dumps and non-PE buffers)
+static void ToRvas(const PeImage& pe, std::vector<size_t>* offsets) {
+    if (!pe.IsValid()) {
+        return;
+    }
+    for (size_t i = 0; i < offsets->size(); i++) {
+        (*offsets)[i] = pe.OffsetToRva((*offsets)[i]);
+    }
+}
+
+static void PrintMatches(const PeImage& pe, const char* name, const std::vector<size_t>& rvas,
+                         size_t expectedRva) {
+    printf(rvas.empty() ? "  %-26s %s" : "  %-26s %-10s", name, MatchUniquenessName(ClassifyMatches(rvas.size())));
+
+    for (size_t i = 0; i < rvas.size() && i < MAX_LISTED_MATCHES; i++) {
+        if (pe.IsValid()) {
+            printf(" RVA 0x%08llX (VA 0x%08llX)", (unsigned long long)rvas[i],
+                   (unsigned long long)(pe.imageBase + rvas[i]));
+        } else {
+            printf(" offset 0x%08llX", (unsigned long long)rvas[i]);
+        }
+        if (i + 1 < rvas.size()) printf(",");
+    }
+    if (rvas.size() > MAX_LISTED_MATCHES) {
+        printf(" ... %u more", (unsigned)(rvas.size() - MAX_LISTED_MATCHES));
+    }
+
+    if (expectedRva != 0 && rvas.size() == 1) {
+        long long delta = (long long)rvas[0] - (long long)expectedRva;
+        if (delta == 0) {
+            printf("  [at expected offset]");
+        } else {
+            printf("  [moved %s0x%llX]", delta < 0 ? "-" : "+", (unsigned long long)(delta < 0 ? -delta : delta));
+        }
+    }
+    printf("\n");
+}
+
+static void PrintClosestMatches(const PeImage& pe, int id, unsigned maxMismatches) {
+    std::vector<ApproxMatch> best;
+    FindGameSignatureApprox(pe, id, maxMismatches, MAX_APPROX_CANDIDATES, &best);
+    if (best.empty()) {
+        printf("      no match with up to %u differing bytes\n", maxMismatches);
+        return;
+    }
+    for (size_t i = 0; i < best.size(); i++) {
+        size_t rva = pe.IsValid() ? pe.OffsetToRva(best[i].offset) : best[i].offset;
+        printf("      closest: RVA 0x%08llX, %u byte(s) differ\n", (unsigned long long)rva, best[i].mismatches);
+    }
+}
+
+// ============================================================================
+// RESOLVE ONE FILE
+// ============================================================================
+
+static bool ResolveFile(const char* path, const Options& options) {
+    MappedFile file;
+    if (!file.Open(path)) {
+        printf("%s: cannot open\n", path);
+        return false;
+    }
+
+    // Decide the layout: probe as a file first, SizeOfImage tells dumps apart
+    PeImage pe;
+    bool isPe = pe.Parse(file.Data(), file.Size(), PE_LAYOUT_FILE);
+    bool isDump = (options.layout == LAYOUT_FORCE_DUMP) ||
+                  (options.layout == LAYOUT_AUTO && isPe && file.Size() == pe.sizeOfImage);
+    if (isPe && isDump) {
+        pe.Parse(file.Data(), file.Size(), PE_LAYOUT_MAPPED);
+    }
+
+    RelocationTable relocations;
+    relocations.Load(pe);
+
+    std::vector<ScanRegion> regions;
+    CollectScanRegions(pe, SIGNATURE_CODE, &regions);
+    size_t codeBytes = 0;
+    for (size_t r = 0; r < regions.size(); r++) codeBytes += regions[r].end - regions[r].begin;
+
+    double start = NowSeconds();
+    MultiScanMatches matches;
+    ScanGameSignatures(pe, &matches, options.threads);
+
+    MultiScanMatches extraMatches;
+    if (!options.extraPatterns.empty()) {
+        MultiPatternScanner scanner;
+        scanner.SetRelocations(&relocations);
+        for (size_t i = 0; i < options.extraPatterns.size(); i++) {
+            scanner.Add(options.extraPatterns[i].View());
+        }
+        scanner.Build();
+        ScanSections(scanner, pe, &extraMatches, SIGNATURE_CODE, options.threads);
+    }
+    double elapsed = NowSeconds() - start;
+
+    for (size_t i = 0; i < matches.size(); i++) ToRvas(pe, &matches[i]);
+    for (size_t i = 0; i < extraMatches.size(); i++) ToRvas(pe, &extraMatches[i]);
+
+    if (options.brief) {
+        printf("%s", path);
+        for (int i = 0; i < SIG_COUNT; i++) {
+            printf("  %s=%u", kGameSignatures[i].name, (unsigned)matches[i].size());
+            if (matches[i].size() == 1) printf("@0x%llX", (unsigned long long)matches[i][0]);
+        }
+        for (size_t i = 0; i < extraMatches.size(); i++) {
+            printf("  pattern#%u=%u", (unsigned)(i + 1), (unsigned)extraMatches[i].size());
+        }
+        printf("  %.1fms\n", elapsed * 1000.0);
+        return true;
+    }
+
+    printf("%s\n", path);
+    if (isPe) {
+        printf("  %s %s, %.1f MB, TimeDateStamp %08X, SizeOfImage 0x%X, ImageBase 0x%llX\n",
+               pe.Is64Bit() ? "PE32+" : "PE32", isDump ? "memory dump" : "file",
+               file.Size() / 1048576.0, pe.timeDateStamp, pe.sizeOfImage, (unsigned long long)pe.imageBase);
+        printf("  %u relocated DWORDs%s\n", (unsigned)relocations.Count(),
+               relocations.Empty() ? " (no .reloc, matching exactly)" : " (ignored by the signatures)");
+    } else {
+        printf("  not a PE image, %.1f MB, scanning everything (offsets are file offsets)\n",
+               file.Size() / 1048576.0);
+    }
+
+    for (int i = 0; i < SIG_COUNT; i++) {
+        PrintMatches(pe, kGameSignatures[i].name, matches[i], kGameSignatures[i].expectedRva);
+        if (matches[i].empty() && options.maxMismatches > 0) {
+            PrintClosestMatches(pe, i, options.maxMismatches);
+        }
+    }
+    for (size_t i = 0; i < extraMatches.size(); i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "pattern#%u", (unsigned)(i + 1));
+        PrintMatches(pe, name, extraMatches[i], 0);
+        printf("      %s\n", options.extraText[i].c_str());
+    }
+
+    printf("  scanned %.1f MB of code in %.2f ms (%.2f GB/s, %u threads)\n\n",
+           codeBytes / 1048576.0, elapsed * 1000.0, elapsed > 0 ? codeBytes / elapsed / 1e9 : 0.0,
+           options.threads);
+    return true;
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char** argv) {
+    Options options;
+    options.layout = LAYOUT_AUTO;
+    options.threads = DefaultScanThreads();
+    options.maxMismatches = 0;
+    options.brief = false;
+
+    std::vector<const char*> paths;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--file") == 0) {
+            options.layout = LAYOUT_FORCE_FILE;
+        } else if (strcmp(arg, "--dump") == 0) {
+            options.layout = LAYOUT_FORCE_DUMP;
+        } else if (strcmp(arg, "-q") == 0) {
+            options.brief = true;
+        } else if (strcmp(arg, "-k") == 0 && i + 1 < argc) {
+            int mismatches = atoi(argv[++i]);
+            options.maxMismatches = (mismatches < 0) ? 0 : (unsigned)mismatches;
+        } else if (strcmp(arg, "-t") == 0 && i + 1 < argc) {
+            int threads = atoi(argv[++i]);
+            options.threads = (threads < 1) ? 1 : (unsigned)threads;
+        } else if (strcmp(arg, "-p") == 0 && i + 1 < argc) {
+            Pattern pattern;
+            if (!ParsePattern(argv[++i], &pattern)) {
+                printf("Malformed signature: \"%s\"\n", argv[i]);
+                return 1;
+            }
+            options.extraText.push_back(argv[i]);
+            options.extraPatterns.push_back(pattern);
+        } else if (arg[0] == '-') {
+            PrintUsage();
+            return 1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    if (paths.empty()) {
+        PrintUsage();
+        return 1;
+    }
+
+    bool allRead = true;
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!ResolveFile(paths[i], options)) {
+            allRead = false;
+        }
+    }
+    return allRead ? 0 : 1;
+}
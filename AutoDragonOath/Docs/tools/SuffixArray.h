@@ -0,0 +1,178 @@
+// SuffixArray.h - Suffix array over a byte buffer (SA-IS, linear time)
+//
+// Sorts every suffix of the text once, after which "where does this byte
+// string occur" is two binary searches instead of a scan. SigMaker builds
+// one over the executable sections of Game.exe (25-30 MB: a few seconds and
+// about 20 bytes of memory per text byte) and then answers all of its
+// uniqueness questions from it.
+//
+// Induced sorting as in Nong, Zhang & Chan, "Two Efficient Algorithms for
+// Linear Time Suffix Array Construction" (2009).
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// Suffix array of s[0, n) over the alphabet [0, upper]. T is uint8_t at the
+// top level and int32_t for the reduced problems.
+template<class T>
+inline void BuildSuffixArray(const T* s, int32_t n, int32_t upper, std::vector<int32_t>* sa) {
+    sa->assign(n, -1);
+    if (n <= 1) {
+        if (n == 1) (*sa)[0] = 0;
+        return;
+    }
+
+    // ls[i]: suffix i is S-type (smaller than suffix i + 1)
+    std::vector<uint8_t> ls(n, 0);
+    for (int32_t i = n - 2; i >= 0; i--) {
+        ls[i] = (s[i] == s[i + 1]) ? ls[i + 1] : (s[i] < s[i + 1]);
+    }
+
+    // Bucket starts for L-type (sumL) and S-type (sumS) suffixes per symbol
+    std::vector<int32_t> sumL(upper + 2, 0), sumS(upper + 2, 0);
+    for (int32_t i = 0; i < n; i++) {
+        if (!ls[i]) {
+            sumS[s[i]]++;
+        } else {
+            sumL[s[i] + 1]++;
+        }
+    }
+    for (int32_t c = 0; c <= upper; c++) {
+        sumS[c] += sumL[c];
+        if (c < upper) sumL[c + 1] += sumS[c];
+    }
+
+    std::vector<int32_t> bucket(upper + 2);
+    auto induce = [&](const std::vector<int32_t>& lms) {
+        std::fill(sa->begin(), sa->end(), -1);
+        std::copy(sumS.begin(), sumS.end(), bucket.begin());
+        for (size_t k = 0; k < lms.size(); k++) {
+            int32_t d = lms[k];
+            if (d == n) continue;
+            (*sa)[bucket[s[d]]++] = d;
+        }
+        std::copy(sumL.begin(), sumL.end(), bucket.begin());
+        (*sa)[bucket[s[n - 1]]++] = n - 1;
+        for (int32_t i = 0; i < n; i++) {
+            int32_t v = (*sa)[i];
+            if (v >= 1 && !ls[v - 1]) {
+                (*sa)[bucket[s[v - 1]]++] = v - 1;
+            }
+        }
+        std::copy(sumL.begin(), sumL.end(), bucket.begin());
+        for (int32_t i = n - 1; i >= 0; i--) {
+            int32_t v = (*sa)[i];
+            if (v >= 1 && ls[v - 1]) {
+                (*sa)[--bucket[s[v - 1] + 1]] = v - 1;
+            }
+        }
+    };
+
+    // Leftmost S-type positions, numbered left to right
+    std::vector<int32_t> lmsIndex(n + 1, -1);
+    std::vector<int32_t> lms;
+    for (int32_t i = 1; i < n; i++) {
+        if (!ls[i - 1] && ls[i]) {
+            lmsIndex[i] = (int32_t)lms.size();
+            lms.push_back(i);
+        }
+    }
+    int32_t m = (int32_t)lms.size();
+    induce(lms);
+    if (m == 0) {
+        return;
+    }
+
+    // Name the LMS substrings in sorted order, then sort the names recursively
+    std::vector<int32_t> sortedLms;
+    sortedLms.reserve(m);
+    for (int32_t i = 0; i < n; i++) {
+        int32_t v = (*sa)[i];
+        if (v >= 0 && lmsIndex[v] != -1) sortedLms.push_back(v);
+    }
+
+    std::vector<int32_t> reduced(m);
+    int32_t names = 0;
+    reduced[lmsIndex[sortedLms[0]]] = 0;
+    for (int32_t i = 1; i < m; i++) {
+        int32_t l = sortedLms[i - 1], r = sortedLms[i];
+        int32_t endL = (lmsIndex[l] + 1 < m) ? lms[lmsIndex[l] + 1] : n;
+        int32_t endR = (lmsIndex[r] + 1 < m) ? lms[lmsIndex[r] + 1] : n;
+        bool same = true;
+        if (endL - l != endR - r) {
+            same = false;
+        } else {
+            while (l < endL && s[l] == s[r]) {
+                l++;
+                r++;
+            }
+            if (l == n || s[l] != s[r]) same = false;
+        }
+        if (!same) names++;
+        reduced[lmsIndex[sortedLms[i]]] = names;
+    }
+
+    std::vector<int32_t> reducedSa;
+    BuildSuffixArray(reduced.data(), m, names, &reducedSa);
+    for (int32_t i = 0; i < m; i++) {
+        sortedLms[i] = lms[reducedSa[i]];
+    }
+    induce(sortedLms);
+}
+
+class SuffixArray {
+public:
+    SuffixArray() : text(0), size(0) {}
+
+    // Indexes text[0, length). The text must stay valid while queries run.
+    void Build(const uint8_t* data, size_t length) {
+        text = data;
+        size = length;
+        BuildSuffixArray(data, (int32_t)length, 255, &order);
+    }
+
+    size_t Size() const { return size; }
+
+    // Text position of the suffix with rank `rank`
+    size_t At(size_t rank) const { return (size_t)order[rank]; }
+
+    // Ranks [*first, *last) of the suffixes that start with key[0, length)
+    void Range(const uint8_t* key, size_t length, size_t* first, size_t* last) const {
+        size_t lo = 0, hi = size;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (Compare(order[mid], key, length) < 0) lo = mid + 1; else hi = mid;
+        }
+        *first = lo;
+        hi = size;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (Compare(order[mid], key, length) <= 0) lo = mid + 1; else hi = mid;
+        }
+        *last = lo;
+    }
+
+    size_t Count(const uint8_t* key, size_t length) const {
+        size_t first, last;
+        Range(key, length, &first, &last);
+        return last - first;
+    }
+
+private:
+    // Suffix at `position`, cut to `length` bytes, against key
+    int Compare(int32_t position, const uint8_t* key, size_t length) const {
+        size_t available = size - (size_t)position;
+        int result = memcmp(text + position, key, (available < length) ? available : length);
+        if (result != 0) return result;
+        return (available < length) ? -1 : 0;
+    }
+
+    const uint8_t* text;
+    size_t size;
+    std::vector<int32_t> order;
+};